@@ -26,7 +26,9 @@ NETBENCH_WARMUP_MS ?= 5000
 NETBENCH_DRAIN_MS ?= 1000
 NETBENCH_SERVER_EXTRA_MS ?= 60000
 NETBENCH_SERVER_WORKERS ?= 1
+NETBENCH_TRANSPORT ?= udp
 NETBENCH_METRICS ?= $(BUILD_DIR)/netbench/socketwire-stress.jsonl
+NETBENCH_REPORT ?= $(BUILD_DIR)/netbench/socketwire-stress.html
 
 ifeq ($(JOBS),auto)
 PARALLEL_FLAG := --parallel
@@ -45,15 +47,17 @@ SIMPLE_TARGETS := \
 	crypto-handshake-demo thread-pool-demo
 
 RAYLIB_TARGETS := \
-	entity-eater-server entity-eater-client \
-	lobby-dots-lobby lobby-dots-game-server lobby-dots-client \
+	entity-eater-server entity-eater-client entity-eater-bots \
+	lobby-dots-lobby lobby-dots-game-server lobby-dots-client lobby-dots-bots \
 	prediction-ships-server prediction-ships-client \
-	ship-swarm-server ship-swarm-client \
-	projectile-arena-server projectile-arena-client
+	ship-swarm-server ship-swarm-client ship-swarm-bots \
+	projectile-arena-server projectile-arena-client projectile-arena-bots
 
 NETWORK_BENCH_TARGETS := netbench-socketwire-server netbench-socketwire-client
 
-EXAMPLE_TARGETS := $(SIMPLE_TARGETS) $(RAYLIB_TARGETS) $(NETWORK_BENCH_TARGETS)
+TOOL_TARGETS := metrics-report
+
+EXAMPLE_TARGETS := $(SIMPLE_TARGETS) $(RAYLIB_TARGETS) $(NETWORK_BENCH_TARGETS) $(TOOL_TARGETS)
 BUILD_TARGET_ALIASES := $(addprefix build-,$(EXAMPLE_TARGETS)) build-SocketWireTests
 RUN_TARGET_ALIASES := $(addprefix run-,$(EXAMPLE_TARGETS))
 
@@ -81,7 +85,7 @@ RAYLIB_RUN_SPECS := \
 .PHONY: run-echo run-math-duel run-packet-stream run-channels-demo run-large-message-demo run-stats-window-demo
 .PHONY: run-entity-eater run-prediction-ships run-ship-swarm run-projectile-arena run-lobby-dots
 .PHONY: run-simple-examples run-raylib-examples run-all-examples
-.PHONY: run-network-bench-sweep
+.PHONY: run-network-bench-sweep report-network-bench
 .PHONY: _run-pair _run-lobby _run-group
 .PHONY: $(BUILD_TARGET_ALIASES) $(RUN_TARGET_ALIASES)
 
@@ -105,6 +109,7 @@ help:
 	@printf '%s\n' '  make run-entity-eater | make run-prediction-ships | make run-ship-swarm'
 	@printf '%s\n' '  make run-projectile-arena | make run-lobby-dots'
 	@printf '%s\n' '  make run-network-bench-sweep'
+	@printf '%s\n' '  make report-network-bench    HTML report from NETBENCH_METRICS'
 	@printf '%s\n' ''
 	@printf '%s\n' 'Run groups:'
 	@printf '%s\n' '  make run-simple-examples'
@@ -186,7 +191,7 @@ run-network-bench-sweep: build-netbench-socketwire-server build-netbench-socketw
 	: > "$(NETBENCH_METRICS)"; \
 	run=0; \
 	for clients in $(NETBENCH_CLIENT_COUNTS); do \
-		echo "+ network-bench clients=$$clients profile=$(NETBENCH_PROFILE)"; \
+		echo "+ network-bench clients=$$clients profile=$(NETBENCH_PROFILE) transport=$(NETBENCH_TRANSPORT)"; \
 		server_duration=$$(( $(NETBENCH_WARMUP_MS) + $(NETBENCH_DURATION_MS) + $(NETBENCH_DRAIN_MS) + $(NETBENCH_SERVER_EXTRA_MS) )); \
 		"$(BIN_DIR)/netbench-socketwire-server" \
 			--port "$(NETBENCH_PORT)" \
@@ -196,6 +201,7 @@ run-network-bench-sweep: build-netbench-socketwire-server build-netbench-socketw
 			--warmup-ms 0 \
 			--drain-ms 0 \
 			--server-workers "$(NETBENCH_SERVER_WORKERS)" \
+			--transport "$(NETBENCH_TRANSPORT)" \
 			--metrics "$(NETBENCH_METRICS)" \
 			--run "$$run" & \
 		server_pid="$$!"; \
@@ -208,6 +214,7 @@ run-network-bench-sweep: build-netbench-socketwire-server build-netbench-socketw
 			--duration-ms "$(NETBENCH_DURATION_MS)" \
 			--warmup-ms "$(NETBENCH_WARMUP_MS)" \
 			--drain-ms "$(NETBENCH_DRAIN_MS)" \
+			--transport "$(NETBENCH_TRANSPORT)" \
 			--metrics "$(NETBENCH_METRICS)" \
 			--run "$$run"; \
 		client_status="$$?"; \
@@ -219,6 +226,9 @@ run-network-bench-sweep: build-netbench-socketwire-server build-netbench-socketw
 		run=$$((run + 1)); \
 	done
 
+report-network-bench: build-metrics-report
+	"$(BIN_DIR)/metrics-report" --out "$(NETBENCH_REPORT)" "$(NETBENCH_METRICS)"
+
 _run-pair:
 	@set -e; \
 	pids=""; \
@@ -243,7 +253,7 @@ _run-lobby:
 	trap cleanup EXIT; \
 	trap 'cleanup; exit 130' INT TERM; \
 	start_bg "$(BIN_DIR)/lobby-dots-lobby" localhost "$(LOBBY_DOTS_GAME_PORT)" "$(LOBBY_DOTS_LOBBY_PORT)"; \
-	start_bg "$(BIN_DIR)/lobby-dots-game-server" "$(LOBBY_DOTS_GAME_PORT)"; \
+	start_bg "$(BIN_DIR)/lobby-dots-game-server" "$(LOBBY_DOTS_GAME_PORT)" --lobby-port "$(LOBBY_DOTS_LOBBY_PORT)"; \
 	if [ "$(RUN_DURATION)" = "0" ]; then \
 		echo "+ $(BIN_DIR)/lobby-dots-client $(LOBBY_DOTS_LOBBY_PORT)"; \
 		"$(BIN_DIR)/lobby-dots-client" "$(LOBBY_DOTS_LOBBY_PORT)"; \
@@ -243,10 +243,10 @@ _run-lobby-dots:
 	printf '\n== %s ==\n' 'lobby-dots'; \
 	if [ "$(BENCH)" = "1" ]; then \
 		start_service "$(BIN_DIR_ABS)/lobby-dots-lobby" --host "$(CLIENT_HOST)" --game-port "$(LOBBY_DOTS_GAME_PORT)" --lobby-port "$(LOBBY_DOTS_LOBBY_PORT)" $$bench_args; \
-		start_service "$(BIN_DIR_ABS)/lobby-dots-game-server" --game-port "$(LOBBY_DOTS_GAME_PORT)" $$bench_args; \
+		start_service "$(BIN_DIR_ABS)/lobby-dots-game-server" --game-port "$(LOBBY_DOTS_GAME_PORT)" --lobby-port "$(LOBBY_DOTS_LOBBY_PORT)" $$bench_args; \
 	else \
 		start_service "$(BIN_DIR_ABS)/lobby-dots-lobby" "$(CLIENT_HOST)" "$(LOBBY_DOTS_GAME_PORT)" "$(LOBBY_DOTS_LOBBY_PORT)"; \
-		start_service "$(BIN_DIR_ABS)/lobby-dots-game-server" "$(LOBBY_DOTS_GAME_PORT)"; \
+		start_service "$(BIN_DIR_ABS)/lobby-dots-game-server" "$(LOBBY_DOTS_GAME_PORT)" --lobby-port "$(LOBBY_DOTS_LOBBY_PORT)"; \
 	fi; \
 	i=1; \
 	while [ "$$i" -le "$(CLIENTS)" ]; do \
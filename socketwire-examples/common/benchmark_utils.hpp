@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <charconv>
 #include <chrono>
 #include <cstddef>
@@ -7,12 +9,14 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <format>
 #include <print>
 #include <string>
 #include <string_view>
 #include <utility>
 
 #include "reliable_connection.hpp"
+#include "tick_profiler.hpp"
 
 #if defined(__APPLE__) || defined(__unix__)
 #include <sys/resource.h>
@@ -34,6 +38,14 @@ struct Options {
   std::string metricsMode = "samples";
   int clients = 1;
   int run = 0;
+  std::string capturePath;
+  std::string replayPath;
+  double replaySpeed = 1.0;
+  int botThreads = 0;
+  // Simulation threads besides the network thread; -1 picks from the cores.
+  int simWorkers = -1;
+  double tickBudgetMs = 0.0;
+  int slowTicks = 10;
 };
 
 struct NetworkStats {
@@ -77,6 +89,21 @@ struct GameMetrics {
   std::uint64_t malformedPacketsAccepted = 0;
   std::uint64_t tamperedPacketsAccepted = 0;
   std::uint64_t invalidHandshakesAccepted = 0;
+  // Server input buffers: mean frames queued per client, and ticks that
+  // found no input for a client's next frame.
+  double inputBufferDepth = 0.0;
+  std::uint64_t inputStarvationCount = 0;
+  // How far behind the estimated server time clients draw remote state.
+  double interpolationDelayMs = 0.0;
+};
+
+// Per-thread payload tally used by multi-threaded drivers; the owning thread
+// folds it into the collector, which is not thread-safe itself.
+struct PayloadCounters {
+  std::atomic<std::uint64_t> txBytes{0};
+  std::atomic<std::uint64_t> txPackets{0};
+  std::atomic<std::uint64_t> rxBytes{0};
+  std::atomic<std::uint64_t> rxPackets{0};
 };
 
 class MetricsCollector;
@@ -103,6 +130,22 @@ inline bool ParseUInt16(const char* text, std::uint16_t& out) {
   return true;
 }
 
+// "max" is 0, meaning no pacing; anything else must be a non-negative number.
+inline bool ParseReplaySpeed(const char* text, double& out) {
+  if (text == nullptr || *text == '\0') return false;
+  if (std::strcmp(text, "max") == 0) {
+    out = 0.0;
+    return true;
+  }
+
+  char* end = nullptr;
+  const double value = std::strtod(text, &end);
+  if (*end != '\0' || !(value >= 0.0)) return false;
+
+  out = value;
+  return true;
+}
+
 inline Options ParseOptions(int argc, const char** argv,
                             std::uint16_t default_port,
                             std::uint16_t default_lobby_port = 10887,
@@ -141,6 +184,24 @@ inline Options ParseOptions(int argc, const char** argv,
       ParseInt(argv[++i], options.clients);
     } else if (std::strcmp(arg, "--run") == 0 && i + 1 < argc) {
       ParseInt(argv[++i], options.run);
+    } else if (std::strcmp(arg, "--bot-threads") == 0 && i + 1 < argc) {
+      ParseInt(argv[++i], options.botThreads);
+    } else if (std::strcmp(arg, "--sim-workers") == 0 && i + 1 < argc) {
+      ParseInt(argv[++i], options.simWorkers);
+    } else if (std::strcmp(arg, "--tick-budget-ms") == 0 && i + 1 < argc) {
+      options.tickBudgetMs = std::strtod(argv[++i], nullptr);
+    } else if (std::strcmp(arg, "--slow-ticks") == 0 && i + 1 < argc) {
+      ParseInt(argv[++i], options.slowTicks);
+    } else if (std::strcmp(arg, "--capture") == 0 && i + 1 < argc) {
+      options.capturePath = argv[++i];
+    } else if (std::strcmp(arg, "--replay") == 0 && i + 1 < argc) {
+      options.replayPath = argv[++i];
+    } else if (std::strcmp(arg, "--replay-speed") == 0 && i + 1 < argc) {
+      const char* speed = argv[++i];
+      if (!ParseReplaySpeed(speed, options.replaySpeed)) {
+        std::println("Ignoring invalid --replay-speed '{}'; using {}", speed,
+                     options.replaySpeed);
+      }
     }
   }
 
@@ -148,6 +209,10 @@ inline Options ParseOptions(int argc, const char** argv,
   if (options.warmupMs < 0) options.warmupMs = 0;
   if (options.clients <= 0) options.clients = 1;
   if (options.metricsMode != "summary") options.metricsMode = "samples";
+  if (options.botThreads < 0) options.botThreads = 0;
+  if (options.simWorkers < -1) options.simWorkers = -1;
+  if (options.tickBudgetMs < 0.0) options.tickBudgetMs = 0.0;
+  if (options.slowTicks < 0) options.slowTicks = 0;
 
   return options;
 }
@@ -211,6 +276,8 @@ class MetricsCollector {
         lastCpuSeconds_(NowCpuSeconds()) {
     if (!options_.enabled) return;
 
+    ticks_.Configure(options_.tickBudgetMs,
+                     static_cast<std::size_t>(options_.slowTicks));
     if (!options_.metricsPath.empty()) {
       file_ = std::fopen(options_.metricsPath.c_str(), "a");
     }
@@ -245,6 +312,11 @@ class MetricsCollector {
   void SetConnectedClients(int count) { connectedClients_ = count; }
   void SetNetworkStats(NetworkStats stats) { networkStats_ = stats; }
   void SetGameMetrics(GameMetrics metrics) { gameMetrics_ = metrics; }
+  // Counters of a server fed by --replay.
+  void SetReplayStats(std::uint64_t packets, std::uint64_t dropped_send_bytes) {
+    replayedPackets_ = packets;
+    replayDroppedSendBytes_ = dropped_send_bytes;
+  }
 
   void RecordPayloadTx(std::size_t bytes) {
     if (!Measuring()) return;
@@ -258,6 +330,15 @@ class MetricsCollector {
     payloadRxPackets_ += 1;
   }
 
+  void RecordPayloadCounts(std::uint64_t tx_bytes, std::uint64_t tx_packets,
+                           std::uint64_t rx_bytes, std::uint64_t rx_packets) {
+    if (!Measuring()) return;
+    payloadTxBytes_ += tx_bytes;
+    payloadTxPackets_ += tx_packets;
+    payloadRxBytes_ += rx_bytes;
+    payloadRxPackets_ += rx_packets;
+  }
+
   void RecordFrameMs(double ms) {
     if (!Measuring()) return;
     frameMsSum_ += ms;
@@ -270,6 +351,51 @@ class MetricsCollector {
     updateSamples_ += 1;
   }
 
+  // Budget used when --tick-budget-ms is not given, normally the server's
+  // tick interval.
+  void SetDefaultTickBudgetMs(double ms) {
+    if (options_.tickBudgetMs <= 0.0) {
+      ticks_.Configure(ms, static_cast<std::size_t>(options_.slowTicks));
+    }
+  }
+
+  // One scheduler wakeup that ran |steps| simulation steps, the first |late|
+  // after its deadline, and dropped |dropped| ticks past the catch-up cap.
+  void RecordTickPacing(std::chrono::nanoseconds late, std::uint32_t steps,
+                        std::uint64_t dropped) {
+    if (!Measuring()) return;
+    tickLate_.Record(static_cast<std::uint64_t>(std::max<std::int64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(late).count(),
+      0)));
+    if (steps > 1) catchUpTicks_ += steps - 1;
+    droppedTicks_ += dropped;
+  }
+
+  void BeginTick() {
+    if (!options_.enabled) return;
+    ticks_.BeginTick(Clock::now());
+  }
+
+  void MarkTickPhase(TickPhase phase) {
+    if (!options_.enabled) return;
+    ticks_.MarkPhase(phase, Clock::now());
+  }
+
+  // Closes the tick opened by BeginTick(); time since the last mark is
+  // charged to TickPhase::kMetrics.
+  void EndTick() {
+    if (!options_.enabled) return;
+    const auto now = Clock::now();
+    const bool record = UpdateMeasurementState(now);
+    ticks_.EndTick(
+      now,
+      record ? std::chrono::duration_cast<std::chrono::milliseconds>(
+                 now - measurementStart_)
+                 .count()
+             : 0,
+      record);
+  }
+
   void MaybeWriteSample() {
     if (!options_.enabled) return;
 
@@ -291,6 +417,7 @@ class MetricsCollector {
     finished_ = true;
 
     if (options_.enabled && measuring_) WriteSample(Clock::now());
+    if (options_.enabled && ticks_.Ticks() > 0) WriteTickProfile();
 
     if (file_ != nullptr && file_ != stdout) std::fclose(file_);
     file_ = nullptr;
@@ -360,8 +487,14 @@ class MetricsCollector {
       "},\"duplicate_projectile_count\":{},\"duplicate_hit_event_count\":{},"
       "\"ghost_projectile_count\":{},\"malformed_packets_accepted\":{},"
       "\"tampered_packets_accepted\":{},\"invalid_handshakes_accepted\":{},"
-      "\"frame_ms_avg\":{:.6f},\"update_ms_avg\":{:.6f},\"cpu_percent\":{:.3f},"
-      "\"rss_kb\":{}}}",
+      "\"input_buffer_depth\":{:.3f},\"input_starvation_count\":{},"
+      "\"interpolation_delay_ms\":{:.3f},"
+      "\"frame_ms_avg\":{:.6f},\"update_ms_avg\":{:.6f},\"tick_ms_p50\":{:.3f},"
+      "\"tick_ms_p95\":{:.3f},\"tick_ms_p99\":{:.3f},\"tick_ms_max\":{:.3f},"
+      "\"tick_overruns\":{},\"tick_late_ms_p50\":{:.3f},\"tick_late_ms_p99\":"
+      "{:.3f},\"tick_late_ms_max\":{:.3f},\"catch_up_ticks\":{},\"dropped_"
+      "ticks\":{},\"replayed_packets\":{},\"replay_dropped_send_bytes\":{},"
+      "\"cpu_percent\":{:.3f},\"rss_kb\":{}}}",
       example_, backend_, role_, options_.clients, options_.run,
       static_cast<std::int64_t>(elapsed_ms), connectedClients_,
       static_cast<std::uint64_t>(payloadTxBytes_),
@@ -404,7 +537,15 @@ class MetricsCollector {
       static_cast<std::uint64_t>(gameMetrics_.malformedPacketsAccepted),
       static_cast<std::uint64_t>(gameMetrics_.tamperedPacketsAccepted),
       static_cast<std::uint64_t>(gameMetrics_.invalidHandshakesAccepted),
-      frame_avg, update_avg, cpu_percent, CurrentRssKb());
+      gameMetrics_.inputBufferDepth,
+      static_cast<std::uint64_t>(gameMetrics_.inputStarvationCount),
+      gameMetrics_.interpolationDelayMs,
+      frame_avg, update_avg, ticks_.Sample().PercentileMs(0.50),
+      ticks_.Sample().PercentileMs(0.95), ticks_.Sample().PercentileMs(0.99),
+      ticks_.Sample().MaxMs(), ticks_.SampleOverruns(),
+      tickLate_.PercentileMs(0.50), tickLate_.PercentileMs(0.99),
+      tickLate_.MaxMs(), catchUpTicks_, droppedTicks_, replayedPackets_,
+      replayDroppedSendBytes_, cpu_percent, CurrentRssKb());
     std::fflush(file_);
 
     lastSample_ = now;
@@ -412,6 +553,51 @@ class MetricsCollector {
     updateMsSum_ = 0.0;
     frameSamples_ = 0;
     updateSamples_ = 0;
+    ticks_.ResetSample();
+    tickLate_.Reset();
+    catchUpTicks_ = 0;
+    droppedTicks_ = 0;
+  }
+
+  // One line per run with the whole-run tick histogram and the slowest ticks.
+  // It carries "tick_profile" instead of "elapsed_ms", so sample readers can
+  // skip it.
+  void WriteTickProfile() {
+    if (file_ == nullptr) return;
+
+    const TickHistogram& run = ticks_.Run();
+    std::string histogram;
+    run.ForEachBucket([&](double upper_ms, std::uint64_t count) {
+      if (!histogram.empty()) histogram += ',';
+      histogram += std::format("[{:.3f},{}]", upper_ms, count);
+    });
+
+    std::string slowest;
+    for (const TickRecord& record : ticks_.Slowest()) {
+      if (!slowest.empty()) slowest += ',';
+      slowest += std::format("{{\"tick\":{},\"at_ms\":{},\"total_ms\":{:.3f}",
+                             record.tick, record.elapsedMs, record.totalMs);
+      for (std::size_t i = 0; i < kTickPhaseCount; ++i) {
+        slowest += std::format(",\"{}_ms\":{:.3f}",
+                               TickPhaseName(static_cast<TickPhase>(i)),
+                               record.phaseMs[i]);
+      }
+      slowest += '}';
+    }
+
+    std::println(
+      file_,
+      "{{\"example\":\"{}\",\"backend\":\"{}\",\"role\":\"{}\",\"clients\":{},"
+      "\"run\":{},\"tick_profile\":{{\"budget_ms\":{:.3f},\"ticks\":{},"
+      "\"overruns\":{},\"p50_ms\":{:.3f},\"p90_ms\":{:.3f},\"p95_ms\":{:.3f},"
+      "\"p99_ms\":{:.3f},\"p999_ms\":{:.3f},\"max_ms\":{:.3f},"
+      "\"histogram\":[{}],\"slowest\":[{}]}}}}",
+      example_, backend_, role_, options_.clients, options_.run,
+      ticks_.BudgetMs(), ticks_.Ticks(), ticks_.Overruns(),
+      run.PercentileMs(0.50), run.PercentileMs(0.90), run.PercentileMs(0.95),
+      run.PercentileMs(0.99), run.PercentileMs(0.999), run.MaxMs(), histogram,
+      slowest);
+    std::fflush(file_);
   }
 
   Options options_;
@@ -429,6 +615,8 @@ class MetricsCollector {
   int connectedClients_ = 0;
   NetworkStats networkStats_;
   GameMetrics gameMetrics_;
+  std::uint64_t replayedPackets_ = 0;
+  std::uint64_t replayDroppedSendBytes_ = 0;
   std::uint64_t payloadTxBytes_ = 0;
   std::uint64_t payloadRxBytes_ = 0;
   std::uint64_t payloadTxPackets_ = 0;
@@ -437,6 +625,10 @@ class MetricsCollector {
   double updateMsSum_ = 0.0;
   std::uint64_t frameSamples_ = 0;
   std::uint64_t updateSamples_ = 0;
+  TickProfiler ticks_;
+  TickHistogram tickLate_;
+  std::uint64_t catchUpTicks_ = 0;
+  std::uint64_t droppedTicks_ = 0;
 };
 
 inline MetricsCollector*& ActiveCollector() {
@@ -448,11 +640,26 @@ inline void SetActiveCollector(MetricsCollector* collector) {
   ActiveCollector() = collector;
 }
 
+inline PayloadCounters*& ThreadPayloadCounters() {
+  thread_local PayloadCounters* counters = nullptr;
+  return counters;
+}
+
 inline void RecordPayloadTx(std::size_t bytes) {
+  if (auto* counters = ThreadPayloadCounters(); counters != nullptr) {
+    counters->txBytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters->txPackets.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
   if (ActiveCollector() != nullptr) ActiveCollector()->RecordPayloadTx(bytes);
 }
 
 inline void RecordPayloadRx(std::size_t bytes) {
+  if (auto* counters = ThreadPayloadCounters(); counters != nullptr) {
+    counters->rxBytes.fetch_add(bytes, std::memory_order_relaxed);
+    counters->rxPackets.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
   if (ActiveCollector() != nullptr) ActiveCollector()->RecordPayloadRx(bytes);
 }
 
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "reliable_connection.hpp"
+
+namespace socketwire_examples::benchmark {
+
+// Aggregated view of a group of bots. Counters are summed, per-world gauges
+// (entity counts, errors, ages) keep the worst value seen by any bot.
+struct BotSample {
+  int bots = 0;
+  int connected = 0;
+  double rttMsSum = 0.0;
+  int rttSamples = 0;
+  NetworkStats network;
+  GameMetrics game;
+
+  void AddConnection(const socketwire::ReliableConnection& connection) {
+    if (!connection.IsConnected()) return;
+    connected += 1;
+    rttMsSum += connection.GetRtt();
+    rttSamples += 1;
+    network.lostPackets += connection.GetLostPackets();
+    network.inflightPackets += connection.GetInflightCount();
+    network.sendWindow += connection.GetSendWindow();
+  }
+
+  void Merge(const BotSample& other) {
+    bots += other.bots;
+    connected += other.connected;
+    rttMsSum += other.rttMsSum;
+    rttSamples += other.rttSamples;
+    network.lostPackets += other.network.lostPackets;
+    network.inflightPackets += other.network.inflightPackets;
+    network.sendWindow += other.network.sendWindow;
+    MergeGame(other.game);
+  }
+
+  [[nodiscard]] NetworkStats Network() const {
+    NetworkStats stats = network;
+    stats.rttMs =
+      rttSamples > 0 ? rttMsSum / static_cast<double>(rttSamples) : 0.0;
+    return stats;
+  }
+
+  void MergeGame(const GameMetrics& other) {
+    game.appSentPackets += other.appSentPackets;
+    game.appReceivedPackets += other.appReceivedPackets;
+    game.appLostPackets += other.appLostPackets;
+    game.appDuplicatePackets += other.appDuplicatePackets;
+    game.appReorderedPackets += other.appReorderedPackets;
+    game.joinSuccessCount += other.joinSuccessCount;
+    game.lobbyConvergenceTimeMs =
+      std::max(game.lobbyConvergenceTimeMs, other.lobbyConvergenceTimeMs);
+    game.lobbyStateMismatchCount += other.lobbyStateMismatchCount;
+    game.ghostPlayerCount += other.ghostPlayerCount;
+    game.stateDivergenceCount += other.stateDivergenceCount;
+    game.permanentDesyncCount += other.permanentDesyncCount;
+    game.nanPositionCount += other.nanPositionCount;
+    game.infPositionCount += other.infPositionCount;
+    game.invalidEntityStateCount += other.invalidEntityStateCount;
+    game.predictionErrorP95 =
+      std::max(game.predictionErrorP95, other.predictionErrorP95);
+    game.predictionErrorMax =
+      std::max(game.predictionErrorMax, other.predictionErrorMax);
+    game.correctionCount += other.correctionCount;
+    game.snapshotAgeMs = std::max(game.snapshotAgeMs, other.snapshotAgeMs);
+    game.interpolationUnderflowCount += other.interpolationUnderflowCount;
+    game.entityCountServer =
+      std::max(game.entityCountServer, other.entityCountServer);
+    game.entityCountClient =
+      std::max(game.entityCountClient, other.entityCountClient);
+    game.missingEntityCount += other.missingEntityCount;
+    game.ghostEntityCount += other.ghostEntityCount;
+    game.fireCommandSent += other.fireCommandSent;
+    game.fireCommandAccepted += other.fireCommandAccepted;
+    game.projectileSpawnCountServer =
+      std::max(game.projectileSpawnCountServer,
+               other.projectileSpawnCountServer);
+    game.projectileSpawnCountClient =
+      std::max(game.projectileSpawnCountClient,
+               other.projectileSpawnCountClient);
+    game.duplicateProjectileCount += other.duplicateProjectileCount;
+    game.duplicateHitEventCount += other.duplicateHitEventCount;
+    game.ghostProjectileCount += other.ghostProjectileCount;
+    game.malformedPacketsAccepted += other.malformedPacketsAccepted;
+    game.tamperedPacketsAccepted += other.tamperedPacketsAccepted;
+    game.invalidHandshakesAccepted += other.invalidHandshakesAccepted;
+    game.inputBufferDepth =
+      std::max(game.inputBufferDepth, other.inputBufferDepth);
+    game.inputStarvationCount += other.inputStarvationCount;
+    game.interpolationDelayMs =
+      std::max(game.interpolationDelayMs, other.interpolationDelayMs);
+  }
+};
+
+// Runs many scripted bots on a small number of threads. Each bot is owned by
+// exactly one shard thread, so its connection never crosses threads. A Bot
+// type provides:
+//   void Step(std::uint64_t frame);          poll, reconnect, send input
+//   void Collect(BotSample& sample) const;   add its metrics to |sample|
+//   void Disconnect();
+template <typename Bot>
+class BotDriver {
+ public:
+  using Factory = std::function<std::unique_ptr<Bot>(int index)>;
+
+  BotDriver(MetricsCollector& metrics, int thread_count,
+            std::chrono::milliseconds tick = std::chrono::milliseconds(16))
+      : metrics_(&metrics), tick_(tick) {
+    shards_.resize(static_cast<std::size_t>(std::max(thread_count, 1)));
+    for (auto& shard : shards_) shard = std::make_unique<Shard>();
+  }
+
+  static int DefaultThreadCount(const Options& options) {
+    if (options.botThreads > 0) return options.botThreads;
+    const int hardware =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    return std::clamp((options.clients + kBotsPerThread - 1) / kBotsPerThread,
+                      1, hardware);
+  }
+
+  int Spawn(int count, const Factory& factory) {
+    int spawned = 0;
+    for (int i = 0; i < count; ++i) {
+      auto bot = factory(i);
+      if (bot == nullptr) continue;
+      shards_[static_cast<std::size_t>(spawned) % shards_.size()]
+        ->bots.push_back(std::move(bot));
+      spawned += 1;
+    }
+    return spawned;
+  }
+
+  void Run() {
+    std::vector<std::thread> threads;
+    threads.reserve(shards_.size());
+    for (auto& shard : shards_) {
+      threads.emplace_back([this, raw = shard.get()] { RunShard(*raw); });
+    }
+
+    while (!metrics_->Done()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      Publish();
+    }
+
+    stop_.store(true, std::memory_order_release);
+    for (auto& thread : threads) thread.join();
+    Publish();
+  }
+
+ private:
+  static constexpr int kBotsPerThread = 128;
+
+  struct Shard {
+    std::vector<std::unique_ptr<Bot>> bots;
+    PayloadCounters payload;
+    std::mutex mutex;
+    BotSample sample;
+    double stepMsSum = 0.0;
+    std::uint64_t stepSamples = 0;
+  };
+
+  void RunShard(Shard& shard) {
+    ThreadPayloadCounters() = &shard.payload;
+
+    using Clock = std::chrono::steady_clock;
+    auto next_tick = Clock::now();
+    auto next_publish = next_tick;
+    std::uint64_t frame = 0;
+    while (!stop_.load(std::memory_order_acquire)) {
+      const auto step_start = Clock::now();
+      for (auto& bot : shard.bots) bot->Step(frame);
+      const auto step_end = Clock::now();
+      const double step_ms =
+        std::chrono::duration<double, std::milli>(step_end - step_start)
+          .count();
+
+      BotSample sample;
+      const bool publish = step_end >= next_publish;
+      if (publish) {
+        sample.bots = static_cast<int>(shard.bots.size());
+        for (const auto& bot : shard.bots) bot->Collect(sample);
+        next_publish = step_end + std::chrono::milliseconds(250);
+      }
+
+      {
+        const std::scoped_lock lock(shard.mutex);
+        shard.stepMsSum += step_ms;
+        shard.stepSamples += 1;
+        if (publish) shard.sample = sample;
+      }
+
+      ++frame;
+      next_tick += tick_;
+      if (next_tick < step_end) next_tick = step_end;
+      std::this_thread::sleep_until(next_tick);
+    }
+
+    for (auto& bot : shard.bots) bot->Disconnect();
+    ThreadPayloadCounters() = nullptr;
+  }
+
+  void Publish() {
+    BotSample total;
+    double step_ms_sum = 0.0;
+    std::uint64_t step_samples = 0;
+    std::uint64_t tx_bytes = 0;
+    std::uint64_t tx_packets = 0;
+    std::uint64_t rx_bytes = 0;
+    std::uint64_t rx_packets = 0;
+    for (auto& shard : shards_) {
+      tx_bytes += shard->payload.txBytes.exchange(0, std::memory_order_relaxed);
+      tx_packets +=
+        shard->payload.txPackets.exchange(0, std::memory_order_relaxed);
+      rx_bytes += shard->payload.rxBytes.exchange(0, std::memory_order_relaxed);
+      rx_packets +=
+        shard->payload.rxPackets.exchange(0, std::memory_order_relaxed);
+
+      const std::scoped_lock lock(shard->mutex);
+      total.Merge(shard->sample);
+      step_ms_sum += shard->stepMsSum;
+      step_samples += shard->stepSamples;
+      shard->stepMsSum = 0.0;
+      shard->stepSamples = 0;
+    }
+
+    metrics_->RecordPayloadCounts(tx_bytes, tx_packets, rx_bytes, rx_packets);
+    if (step_samples > 0) {
+      metrics_->RecordUpdateMs(step_ms_sum /
+                               static_cast<double>(step_samples));
+    }
+    metrics_->SetConnectedClients(total.connected);
+    metrics_->SetNetworkStats(total.Network());
+    metrics_->SetGameMetrics(total.game);
+    metrics_->MaybeWriteSample();
+  }
+
+  MetricsCollector* metrics_ = nullptr;
+  std::chrono::milliseconds tick_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<bool> stop_{false};
+};
+
+}  // namespace socketwire_examples::benchmark
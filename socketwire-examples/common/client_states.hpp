@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "server_connection_hub.hpp"
+
+namespace socketwire_examples {
+
+// Per-client server state reached straight from the connection: each entry
+// is linked through Client::userData, so packet handlers find their client's
+// state in O(1) without a map keyed by pointer. Entries also sit in a dense
+// list for per-tick passes and stay at the same address until erased, so
+// jobs may hold pointers to them.
+//
+// The table owns Client::userData; a server keeps one table per hub.
+template <typename State>
+class ClientStates {
+ public:
+  using Client = ServerConnectionHub::Client;
+
+  struct Entry {
+    Client* client = nullptr;
+    State state;
+    // Position in Entries(); kept up to date by Erase().
+    std::size_t index = 0;
+  };
+
+  // |client|'s state, or nullptr before Emplace().
+  [[nodiscard]] State* Find(const Client& client) const {
+    auto* entry = static_cast<Entry*>(client.userData);
+    return entry != nullptr ? &entry->state : nullptr;
+  }
+
+  // |client|'s state, default-constructed if it has none.
+  State& Emplace(Client& client) {
+    if (State* state = Find(client)) return *state;
+    auto& entry = entries_.emplace_back(std::make_unique<Entry>());
+    entry->client = &client;
+    entry->index = entries_.size() - 1;
+    client.userData = entry.get();
+    return entry->state;
+  }
+
+  // Drops |client|'s state, moving the last entry into its place. Safe to
+  // call twice, as hubs report both disconnects and timeouts.
+  void Erase(Client& client) {
+    auto* entry = static_cast<Entry*>(client.userData);
+    if (entry == nullptr) return;
+    client.userData = nullptr;
+    const std::size_t index = entry->index;
+    if (index + 1 != entries_.size()) {
+      entries_[index] = std::move(entries_.back());
+      entries_[index]->index = index;
+    }
+    entries_.pop_back();
+  }
+
+  [[nodiscard]] std::span<const std::unique_ptr<Entry>> Entries() const {
+    return entries_;
+  }
+  [[nodiscard]] std::size_t Size() const { return entries_.size(); }
+  [[nodiscard]] bool Empty() const { return entries_.empty(); }
+
+ private:
+  std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+}  // namespace socketwire_examples
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace socketwire_examples {
+
+// Server time on the wire: microseconds since the server's TickScheduler
+// started, so tick N is due at server time N * tick interval.
+inline std::int64_t ServerMicrosSince(
+  std::chrono::steady_clock::time_point start,
+  std::chrono::steady_clock::time_point now =
+    std::chrono::steady_clock::now()) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(now - start)
+    .count();
+}
+
+// Client side of NTP-style clock synchronisation with one server.
+//
+// The client stamps a request with its own clock and the server echoes the
+// stamp with its time at reply, which gives one round trip and one offset
+// sample per exchange. The offset is taken from the fastest of the last
+// eight samples, the one least skewed by queueing, and the drift from how
+// that offset moves over at least ten seconds. Replies much slower than the
+// connection's smoothed RTT sat in a queue and are ignored.
+//
+// The clock dates snapshots; how far behind it to draw them is up to
+// PlayoutDelay (interpolation_buffer.hpp).
+class ClockSync {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit ClockSync(Clock::duration tick_interval)
+      : tickMicros_(Micros(tick_interval)) {}
+
+  // Fast requests until the window is full, then a slow trickle for drift.
+  [[nodiscard]] bool RequestDue(Clock::time_point now) const {
+    const Clock::duration interval =
+      accepted_ < kWindow ? kFastInterval : kSlowInterval;
+    return !requested_ || now - lastRequest_ >= interval;
+  }
+
+  // The stamp to send in a request made at |now|.
+  std::uint64_t OnRequestSent(Clock::time_point now) {
+    requested_ = true;
+    lastRequest_ = now;
+    return static_cast<std::uint64_t>(Micros(now.time_since_epoch()));
+  }
+
+  // A reply to the request stamped |stamp|. |transport_rtt_ms| is the
+  // connection's smoothed RTT, 0 while it has none.
+  void OnReply(std::uint64_t stamp, std::int64_t server_micros,
+               Clock::time_point received, double transport_rtt_ms) {
+    const double sent = static_cast<double>(stamp);
+    const double now = Micros(received.time_since_epoch());
+    const double round_trip = now - sent;
+    if (round_trip < 0.0) return;
+    if (accepted_ > 0 && transport_rtt_ms > 0.0 &&
+        round_trip > 2.0 * transport_rtt_ms * 1000.0 + kRttSlackMicros) {
+      ++rejected_;
+      return;
+    }
+
+    // The server answered halfway through the round trip.
+    const double local = sent + round_trip * 0.5;
+    samples_[accepted_ % kWindow] = {
+      local, static_cast<double>(server_micros) - local, round_trip};
+    ++accepted_;
+
+    const Sample* best = &samples_[0];
+    for (std::size_t i = 1; i < std::min(accepted_, kWindow); ++i) {
+      if (samples_[i].roundTrip < best->roundTrip) best = &samples_[i];
+    }
+    if (accepted_ == 1) driftRef_ = *best;
+    const double span = best->local - driftRef_.local;
+    if (span >= kDriftSpanMicros) {
+      const double slope = (best->offset - driftRef_.offset) / span;
+      drift_ = std::clamp(drift_ + (slope - drift_) * 0.25, -kMaxDrift,
+                          kMaxDrift);
+      driftRef_ = *best;
+    }
+    anchor_ = *best;
+  }
+
+  [[nodiscard]] bool Synced() const { return accepted_ > 0; }
+
+  // Estimated server time in microseconds at local time |t|.
+  [[nodiscard]] double ServerMicros(Clock::time_point t) const {
+    const double local = Micros(t.time_since_epoch());
+    return local + anchor_.offset + drift_ * (local - anchor_.local);
+  }
+  [[nodiscard]] double ServerTick(Clock::time_point t) const {
+    return ServerMicros(t) / tickMicros_;
+  }
+
+  // Age of server tick |tick| at local time |t|.
+  [[nodiscard]] double TickAgeMs(std::uint32_t tick,
+                                 Clock::time_point t) const {
+    return (ServerMicros(t) - static_cast<double>(tick) * tickMicros_) /
+           1000.0;
+  }
+
+  [[nodiscard]] double OffsetMs() const { return anchor_.offset / 1000.0; }
+  [[nodiscard]] double DriftPpm() const { return drift_ * 1e6; }
+  // Round trip of the sample the offset comes from.
+  [[nodiscard]] double RoundTripMs() const {
+    return anchor_.roundTrip / 1000.0;
+  }
+  [[nodiscard]] std::uint64_t Rejected() const { return rejected_; }
+
+ private:
+  struct Sample {
+    double local = 0.0;
+    double offset = 0.0;
+    double roundTrip = 0.0;
+  };
+
+  static constexpr std::size_t kWindow = 8;
+  static constexpr Clock::duration kFastInterval =
+    std::chrono::milliseconds(100);
+  static constexpr Clock::duration kSlowInterval = std::chrono::seconds(1);
+  static constexpr double kRttSlackMicros = 5000.0;
+  static constexpr double kDriftSpanMicros = 10e6;
+  // Steady clocks drift by tens of ppm; more is a bad estimate.
+  static constexpr double kMaxDrift = 500e-6;
+
+  static double Micros(Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+  }
+
+  double tickMicros_;
+  std::array<Sample, kWindow> samples_{};
+  std::size_t accepted_ = 0;
+  std::uint64_t rejected_ = 0;
+  Sample anchor_;
+  Sample driftRef_;
+  double drift_ = 0.0;
+  bool requested_ = false;
+  Clock::time_point lastRequest_{};
+};
+
+}  // namespace socketwire_examples
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace socketwire_examples {
+
+// Live entity ids kept as a sparse set: |Ids()| is dense and ordered by
+// index, and every id maps back to its index in O(1). Per-entity data lives
+// in the game's own arrays parallel to Ids(); Remove() swaps the last entity
+// into the hole and callers do the same to their arrays (SwapRemove()).
+//
+// Ids come from a counter and are reused once freed, oldest first, so a
+// removed id stays unused for as long as possible and snapshots in flight
+// for the old entity are unlikely to land on a new one.
+template <typename Id>
+class EntityRegistry {
+ public:
+  // Ids handed out are below |capacity|; use the protocol's invalid id so it
+  // is never allocated.
+  explicit EntityRegistry(Id capacity) : capacity_(capacity) {}
+
+  // Allocates an id and appends it at index Size() - 1; nullopt when every
+  // id below the capacity is live.
+  std::optional<Id> Create() {
+    Id id{};
+    if (!free_.empty()) {
+      id = free_.front();
+      free_.pop_front();
+    } else if (next_ < capacity_) {
+      id = next_++;
+      sparse_.resize(next_, kAbsent);
+    } else {
+      return std::nullopt;
+    }
+    sparse_[id] = static_cast<std::uint32_t>(ids_.size());
+    ids_.push_back(id);
+    return id;
+  }
+
+  [[nodiscard]] bool Contains(Id id) const {
+    return id < sparse_.size() && sparse_[id] != kAbsent;
+  }
+
+  [[nodiscard]] std::optional<std::size_t> IndexOf(Id id) const {
+    if (!Contains(id)) return std::nullopt;
+    return sparse_[id];
+  }
+
+  // Frees |id| and moves the last entity into its index, which is returned
+  // so parallel arrays can follow; nullopt when |id| is not live.
+  std::optional<std::size_t> Remove(Id id) {
+    if (!Contains(id)) return std::nullopt;
+    const std::size_t index = sparse_[id];
+    const Id last = ids_.back();
+    ids_[index] = last;
+    sparse_[last] = static_cast<std::uint32_t>(index);
+    ids_.pop_back();
+    sparse_[id] = kAbsent;
+    free_.push_back(id);
+    return index;
+  }
+
+  [[nodiscard]] Id IdAt(std::size_t index) const { return ids_[index]; }
+  [[nodiscard]] const std::vector<Id>& Ids() const { return ids_; }
+  [[nodiscard]] std::size_t Size() const { return ids_.size(); }
+
+ private:
+  static constexpr std::uint32_t kAbsent = 0xffffffffu;
+
+  Id capacity_;
+  Id next_ = 0;
+  std::vector<std::uint32_t> sparse_;
+  std::vector<Id> ids_;
+  std::deque<Id> free_;
+};
+
+// The array side of EntityRegistry::Remove(): moves the last element into
+// |index| and drops the last slot.
+template <typename T>
+void SwapRemove(std::vector<T>& values, std::size_t index) {
+  if (index + 1 != values.size()) values[index] = std::move(values.back());
+  values.pop_back();
+}
+
+}  // namespace socketwire_examples
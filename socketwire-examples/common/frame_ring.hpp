@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace socketwire_examples {
+
+// Fixed-capacity history keyed by frame number. Frame f lives in slot
+// f % Capacity, so writes and lookups are O(1) and nothing allocates after
+// construction. Only the newest Capacity frames can be found; older ones
+// have been overwritten or are reported missing.
+template <typename T, std::size_t Capacity>
+class FrameRing {
+ public:
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "frame % Capacity must survive frame counter wrap");
+
+  T& Put(std::uint32_t frame, const T& value) {
+    Slot& slot = slots_[frame % Capacity];
+    slot.frame = frame;
+    slot.value = value;
+    slot.valid = true;
+    if (!any_ || static_cast<std::int32_t>(frame - newest_) > 0) {
+      newest_ = frame;
+    }
+    any_ = true;
+    return slot.value;
+  }
+
+  [[nodiscard]] T* Find(std::uint32_t frame) {
+    Slot& slot = slots_[frame % Capacity];
+    return Live(slot, frame) ? &slot.value : nullptr;
+  }
+  [[nodiscard]] const T* Find(std::uint32_t frame) const {
+    const Slot& slot = slots_[frame % Capacity];
+    return Live(slot, frame) ? &slot.value : nullptr;
+  }
+
+  [[nodiscard]] bool Empty() const { return !any_; }
+  // The highest frame written; meaningless while Empty().
+  [[nodiscard]] std::uint32_t Newest() const { return newest_; }
+
+  void Clear() {
+    for (Slot& slot : slots_) slot.valid = false;
+    any_ = false;
+  }
+
+ private:
+  struct Slot {
+    std::uint32_t frame = 0;
+    T value{};
+    bool valid = false;
+  };
+
+  bool Live(const Slot& slot, std::uint32_t frame) const {
+    return slot.valid && slot.frame == frame &&
+           newest_ - frame < static_cast<std::uint32_t>(Capacity);
+  }
+
+  std::array<Slot, Capacity> slots_{};
+  std::uint32_t newest_ = 0;
+  bool any_ = false;
+};
+
+}  // namespace socketwire_examples
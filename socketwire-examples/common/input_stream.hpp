@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace socketwire_examples {
+
+// Client side of a redundant input stream: the inputs of the last |Window|
+// consecutive client frames. Every input packet carries all of them, so a
+// frame's input still reaches the server when up to Window - 1 packets in a
+// row are lost, without waiting for a retransmit.
+template <typename Input, std::size_t Window>
+class InputWindow {
+ public:
+  static_assert(Window > 0 && (Window & (Window - 1)) == 0,
+                "frame % Window must survive frame counter wrap");
+
+  // A frame that does not follow the newest one starts a fresh window.
+  void Push(std::uint32_t frame, const Input& input) {
+    if (size_ != 0 && frame != newestFrame_ + 1) size_ = 0;
+    newestFrame_ = frame;
+    inputs_[frame % Window] = input;
+    size_ = std::min(size_ + 1, Window);
+  }
+
+  [[nodiscard]] std::size_t Size() const { return size_; }
+  [[nodiscard]] std::uint32_t NewestFrame() const { return newestFrame_; }
+  // |age| 0 is the newest input, Size() - 1 the oldest.
+  [[nodiscard]] const Input& At(std::size_t age) const {
+    return inputs_[(newestFrame_ - static_cast<std::uint32_t>(age)) % Window];
+  }
+
+ private:
+  std::array<Input, Window> inputs_{};
+  std::uint32_t newestFrame_ = 0;
+  std::size_t size_ = 0;
+};
+
+// Server side of one client's input stream. Offer() stores inputs by frame,
+// ignoring the redundant copies of frames already seen, and Consume() hands
+// out exactly one frame per simulation tick in frame order.
+//
+// A tick with no input for the next frame is starved. If newer frames are
+// already here, the missing ones were lost beyond the window and are
+// skipped. Otherwise the tick repeats the last input in that frame's place
+// and drops the frame if it turns up later, so LastConsumed() always names
+// the frame the tick simulated. A client that stops sending is stood in for
+// up to |max_depth| frames past its newest; later ticks repeat in place.
+// Frames more than |max_depth| ahead of the next one are skipped too, so a
+// client that runs fast or bursts after a stall cannot build up latency.
+template <typename Input, std::size_t Capacity>
+class InputBuffer {
+ public:
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "frame % Capacity must survive frame counter wrap");
+
+  explicit InputBuffer(std::uint32_t max_depth = 4)
+      : maxDepth_(std::clamp<std::uint32_t>(max_depth, 1, Capacity)) {}
+
+  // Returns true when |frame| was new. The first frame offered becomes the
+  // next one consumed, so offer a packet's inputs newest first.
+  bool Offer(std::uint32_t frame, const Input& input) {
+    if (!started_) {
+      started_ = true;
+      next_ = frame;
+      newest_ = frame - 1;
+    }
+    if (Before(frame, next_)) return false;
+    if (!Before(frame, next_ + Capacity)) SkipTo(frame - Capacity + 1);
+
+    Slot& slot = slots_[frame % Capacity];
+    if (slot.valid && slot.frame == frame) return false;
+    slot = {frame, input, true};
+    if (Before(newest_, frame)) newest_ = frame;
+    return true;
+  }
+
+  // The input for this tick; the neutral input until the first Offer().
+  const Input& Consume() {
+    if (!started_) return last_;
+    if (Depth() > maxDepth_) SkipTo(newest_ - maxDepth_ + 1);
+
+    if (!Holds(next_)) {
+      ++starved_;
+      std::uint32_t frame = next_;
+      while (Before(frame, newest_) && !Holds(frame)) ++frame;
+      if (!Holds(frame)) {
+        if (Before(next_, newest_ + maxDepth_ + 1)) lastFrame_ = next_++;
+        return last_;
+      }
+      SkipTo(frame);
+    }
+    Slot& slot = slots_[next_ % Capacity];
+    slot.valid = false;
+    last_ = slot.input;
+    lastFrame_ = next_++;
+    return last_;
+  }
+
+  // The frame the last tick simulated, with its own input or a repeat of the
+  // one before; nullopt until one is consumed. Clients reconcile their
+  // prediction against it.
+  [[nodiscard]] std::optional<std::uint32_t> LastConsumed() const {
+    return lastFrame_;
+  }
+
+  // Frames from the next one to the newest received, holes included.
+  [[nodiscard]] std::uint32_t Depth() const {
+    return started_ && !Before(newest_, next_) ? newest_ - next_ + 1 : 0;
+  }
+  // Ticks that found no input for the next frame.
+  [[nodiscard]] std::uint64_t Starved() const { return starved_; }
+  // Frames never consumed: lost beyond the window or trimmed for latency.
+  [[nodiscard]] std::uint64_t Skipped() const { return skipped_; }
+
+ private:
+  struct Slot {
+    std::uint32_t frame = 0;
+    Input input{};
+    bool valid = false;
+  };
+
+  static bool Before(std::uint32_t a, std::uint32_t b) {
+    return static_cast<std::int32_t>(a - b) < 0;
+  }
+
+  [[nodiscard]] bool Holds(std::uint32_t frame) const {
+    const Slot& slot = slots_[frame % Capacity];
+    return slot.valid && slot.frame == frame;
+  }
+
+  void SkipTo(std::uint32_t frame) {
+    if (!Before(next_, frame)) return;
+    const std::uint32_t count = frame - next_;
+    skipped_ += count;
+    if (count >= Capacity) {
+      for (Slot& slot : slots_) slot.valid = false;
+    } else {
+      for (; next_ != frame; ++next_) slots_[next_ % Capacity].valid = false;
+    }
+    next_ = frame;
+  }
+
+  std::array<Slot, Capacity> slots_{};
+  std::uint32_t maxDepth_;
+  bool started_ = false;
+  std::uint32_t next_ = 0;
+  std::uint32_t newest_ = 0;
+  Input last_{};
+  std::optional<std::uint32_t> lastFrame_;
+  std::uint64_t starved_ = 0;
+  std::uint64_t skipped_ = 0;
+};
+
+}  // namespace socketwire_examples
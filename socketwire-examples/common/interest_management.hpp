@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "spatial_grid.hpp"
+
+namespace socketwire_examples {
+
+struct InterestConfig {
+  float viewRadius = 0.f;
+  // Entities already in view stay until they are this much farther out, so
+  // ones on the edge do not flicker in and out every tick.
+  float leaveMargin = 0.f;
+  // When more entities are in range, the nearest win; 0 keeps all of them.
+  std::size_t maxEntities = 0;
+  // For a world that wraps around at +-wrapSize on both axes, distances are
+  // measured the short way round, across the seam. 0 means the world has
+  // edges. viewRadius + leaveMargin must stay under wrapSize.
+  float wrapSize = 0.f;
+};
+
+// The set of entities one client can see, recomputed each tick from a
+// SpatialGrid around the client's viewpoint. Ids are whatever the server put
+// in the grid and must stay stable between ticks for the enter/leave lists to
+// mean anything.
+class InterestSet {
+ public:
+  void Update(const SpatialGrid& grid, float x, float y,
+              const InterestConfig& config) {
+    const float enter_sq = config.viewRadius * config.viewRadius;
+    const float radius = config.viewRadius + config.leaveMargin;
+    const auto visit = [&](const SpatialGrid::Entry& entry,
+                           float distance_sq) {
+      if (distance_sq > enter_sq && !Contains(entry.id)) return;
+      candidates_.emplace_back(distance_sq, entry.id);
+    };
+    candidates_.clear();
+    if (config.wrapSize <= 0.f) {
+      grid.ForEachInRadius(x, y, radius, visit);
+    } else {
+      // Query the viewpoint and each of its copies one world over whose
+      // circle reaches back into the world. The circles are narrower than the
+      // world, so no entity is found twice.
+      const float size = config.wrapSize;
+      for (int wrap_y = -1; wrap_y <= 1; ++wrap_y) {
+        const float view_y = y + 2.f * size * static_cast<float>(wrap_y);
+        if (view_y + radius < -size || view_y - radius > size) continue;
+        for (int wrap_x = -1; wrap_x <= 1; ++wrap_x) {
+          const float view_x = x + 2.f * size * static_cast<float>(wrap_x);
+          if (view_x + radius < -size || view_x - radius > size) continue;
+          grid.ForEachInRadius(view_x, view_y, radius, visit);
+        }
+      }
+    }
+
+    // Ties break on id so every client sees the same order for equal input.
+    if (config.maxEntities != 0 && candidates_.size() > config.maxEntities) {
+      const auto nth = candidates_.begin() +
+                       static_cast<std::ptrdiff_t>(config.maxEntities);
+      std::ranges::nth_element(candidates_, nth);
+      candidates_.erase(nth, candidates_.end());
+    }
+    std::ranges::sort(candidates_);
+
+    previous_.swap(sorted_);
+    visible_.clear();
+    for (const auto& candidate : candidates_) {
+      visible_.push_back(candidate.second);
+    }
+    sorted_ = visible_;
+    std::ranges::sort(sorted_);
+
+    entered_.clear();
+    left_.clear();
+    std::ranges::set_difference(sorted_, previous_,
+                                std::back_inserter(entered_));
+    std::ranges::set_difference(previous_, sorted_, std::back_inserter(left_));
+  }
+
+  // Forgets the view, e.g. when the client's viewpoint teleports; the next
+  // Update() reports everything in range as entered.
+  void Reset() {
+    visible_.clear();
+    sorted_.clear();
+  }
+
+  // Ids in view, nearest first.
+  [[nodiscard]] const std::vector<std::uint32_t>& Visible() const {
+    return visible_;
+  }
+  // Ids that came into or went out of view in the last Update(), ascending.
+  [[nodiscard]] const std::vector<std::uint32_t>& Entered() const {
+    return entered_;
+  }
+  [[nodiscard]] const std::vector<std::uint32_t>& Left() const {
+    return left_;
+  }
+
+  [[nodiscard]] bool Contains(std::uint32_t id) const {
+    return std::ranges::binary_search(sorted_, id);
+  }
+
+ private:
+  std::vector<std::pair<float, std::uint32_t>> candidates_;
+  std::vector<std::uint32_t> visible_;
+  std::vector<std::uint32_t> sorted_;
+  std::vector<std::uint32_t> previous_;
+  std::vector<std::uint32_t> entered_;
+  std::vector<std::uint32_t> left_;
+};
+
+}  // namespace socketwire_examples
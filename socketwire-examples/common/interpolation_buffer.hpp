@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace socketwire_examples {
+
+struct PlayoutConfig {
+  // Server time between two snapshots.
+  double snapshotIntervalMs = 0.0;
+  // Share of recent snapshots that must be in before they are drawn.
+  double percentile = 0.95;
+  double maxDelayMs = 300.0;
+  // Longest stretch drawn past the newest snapshot before motion stops.
+  double maxExtrapolationMs = 100.0;
+};
+
+// Adaptive playout delay for snapshot interpolation.
+//
+// Every snapshot's transit, its arrival time minus its server time, is the
+// one-way delay plus an unknown clock offset plus jitter. The fastest of the
+// last kJitterWindow transits stands for delay plus offset, so the rest of
+// each transit is how late that snapshot was. The playout delay is one
+// snapshot interval plus the configured percentile of that lateness: on a
+// steady link the client draws about one interval behind the newest
+// snapshot, and a jittery one buys only as much delay as its jitter needs.
+//
+// Delay changes are slewed at kSlewRate so motion speeds up or slows down
+// slightly instead of jumping.
+class PlayoutDelay {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit PlayoutDelay(const PlayoutConfig& config) : config_(config) {}
+
+  // A snapshot of server time |server_ms| arrived at |arrival|.
+  void OnSnapshot(double server_ms, Clock::time_point arrival) {
+    if (transitCount_ == 0) epoch_ = arrival;
+    RecordTransit(Millis(arrival) - server_ms);
+  }
+
+  [[nodiscard]] bool Started() const { return transitCount_ > 0; }
+
+  // The server time in milliseconds to draw at |now|; needs Started().
+  double PlayoutMs(Clock::time_point now) {
+    const double now_ms = Millis(now);
+    if (!playing_) {
+      playing_ = true;
+      offset_ = targetOffset_;
+    } else {
+      const double step = kSlewRate * std::max(now_ms - lastSampleMs_, 0.0);
+      offset_ += std::clamp(targetOffset_ - offset_, -step, step);
+    }
+    lastSampleMs_ = now_ms;
+    return now_ms - offset_;
+  }
+
+  // Current playout delay behind the fastest snapshot transit.
+  [[nodiscard]] double DelayMs() const {
+    return playing_ ? offset_ - minTransit_ : 0.0;
+  }
+  // The configured percentile of recent snapshot lateness.
+  [[nodiscard]] double JitterMs() const { return jitter_; }
+
+ private:
+  static constexpr std::size_t kJitterWindow = 64;
+  // Playout runs at most 10% fast or slow while the delay adapts.
+  static constexpr double kSlewRate = 0.1;
+
+  double Millis(Clock::time_point t) const {
+    return std::chrono::duration<double, std::milli>(t - epoch_).count();
+  }
+
+  void RecordTransit(double transit) {
+    transits_[transitCount_ % kJitterWindow] = transit;
+    ++transitCount_;
+    const std::size_t n = std::min(transitCount_, kJitterWindow);
+    minTransit_ = *std::min_element(transits_.begin(), transits_.begin() + n);
+
+    for (std::size_t i = 0; i < n; ++i) {
+      lateness_[i] = transits_[i] - minTransit_;
+    }
+    const auto rank = static_cast<std::size_t>(std::max(
+      std::ceil(config_.percentile * static_cast<double>(n)) - 1.0, 0.0));
+    const auto nth = lateness_.begin() + std::min(rank, n - 1);
+    std::nth_element(lateness_.begin(), nth, lateness_.begin() + n);
+    jitter_ = *nth;
+
+    const double delay =
+      std::clamp(config_.snapshotIntervalMs + jitter_,
+                 config_.snapshotIntervalMs, config_.maxDelayMs);
+    targetOffset_ = minTransit_ + delay;
+  }
+
+  PlayoutConfig config_;
+  Clock::time_point epoch_{};
+
+  std::array<double, kJitterWindow> transits_{};
+  std::array<double, kJitterWindow> lateness_{};
+  std::size_t transitCount_ = 0;
+  double minTransit_ = 0.0;
+  double jitter_ = 0.0;
+  double targetOffset_ = 0.0;
+
+  bool playing_ = false;
+  double offset_ = 0.0;
+  double lastSampleMs_ = 0.0;
+};
+
+// Client-side jitter buffer for snapshot interpolation: snapshots wait here
+// until the PlayoutDelay's playout time reaches them. When the playout time
+// passes the newest snapshot the buffer underflows and extrapolates along
+// the last two snapshots for at most maxExtrapolationMs, then holds still.
+template <typename Snapshot, std::size_t Capacity = 32>
+class InterpolationBuffer {
+ public:
+  using Clock = PlayoutDelay::Clock;
+
+  struct Frame {
+    const Snapshot* from = nullptr;
+    const Snapshot* to = nullptr;
+    // 0 at |from|, 1 at |to|; above 1 while extrapolating past |to|.
+    float t = 1.f;
+  };
+
+  explicit InterpolationBuffer(const PlayoutConfig& config)
+      : config_(config), playout_(config) {}
+
+  // The slot for the snapshot of server time |server_ms| that arrived at
+  // |arrival|, to be filled by the caller; nullptr when it is not newer than
+  // the newest one, though its lateness still counts. Slots keep what they
+  // held, so assigning into one reuses its storage.
+  Snapshot* Push(double server_ms, Clock::time_point arrival) {
+    playout_.OnSnapshot(server_ms, arrival);
+    if (count_ > 0 && server_ms <= slots_[newest_].serverMs) return nullptr;
+
+    newest_ = count_ == 0 ? 0 : (newest_ + 1) % Capacity;
+    count_ = std::min(count_ + 1, Capacity);
+    slots_[newest_].serverMs = server_ms;
+    return &slots_[newest_].snapshot;
+  }
+
+  // The snapshots around the playout time at |now|. Both are nullptr until
+  // the first Push(); they stay valid until the next one.
+  Frame Sample(Clock::time_point now) {
+    if (count_ == 0) return {};
+    const double playout = playout_.PlayoutMs(now);
+
+    const Slot& newest = slots_[newest_];
+    if (playout >= newest.serverMs) {
+      ++underflows_;
+      if (count_ < 2) return {&newest.snapshot, &newest.snapshot, 1.f};
+      const Slot& previous = slots_[(newest_ + Capacity - 1) % Capacity];
+      const double ahead =
+        std::min(playout - newest.serverMs, config_.maxExtrapolationMs);
+      return {&previous.snapshot, &newest.snapshot,
+              static_cast<float>(
+                1.0 + ahead / (newest.serverMs - previous.serverMs))};
+    }
+
+    // Walk back to the newest snapshot at or before the playout time.
+    std::size_t newer = newest_;
+    for (std::size_t age = 1; age < count_; ++age) {
+      const std::size_t older = (newest_ + Capacity - age) % Capacity;
+      const Slot& from = slots_[older];
+      if (from.serverMs <= playout) {
+        const Slot& to = slots_[newer];
+        return {&from.snapshot, &to.snapshot,
+                static_cast<float>((playout - from.serverMs) /
+                                   (to.serverMs - from.serverMs))};
+      }
+      newer = older;
+    }
+    // Further back than the buffer reaches: show the oldest snapshot.
+    return {&slots_[newer].snapshot, &slots_[newer].snapshot, 0.f};
+  }
+
+  [[nodiscard]] double DelayMs() const { return playout_.DelayMs(); }
+  [[nodiscard]] double JitterMs() const { return playout_.JitterMs(); }
+  // Sample() calls that found no snapshot at or after the playout time.
+  [[nodiscard]] std::uint64_t Underflows() const { return underflows_; }
+
+ private:
+  struct Slot {
+    double serverMs = 0.0;
+    Snapshot snapshot{};
+  };
+
+  PlayoutConfig config_;
+  std::array<Slot, Capacity> slots_{};
+  std::size_t newest_ = 0;
+  std::size_t count_ = 0;
+  PlayoutDelay playout_;
+  std::uint64_t underflows_ = 0;
+};
+
+}  // namespace socketwire_examples
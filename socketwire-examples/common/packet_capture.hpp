@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <print>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "i_socket.hpp"
+#include "socketwire_example_utils.hpp"
+
+namespace socketwire_examples {
+
+// Capture log layout: "SWPC" magic, u16 version, u16 reserved, then one record
+// per inbound datagram:
+//   varint  microseconds since the previous record
+//   u8      flags (bit 0: IPv6 source)
+//   u32 LE  IPv4 host-order address | 16 bytes IPv6 + varint scope id
+//   u16 LE  source port
+//   varint  payload size, followed by the payload bytes
+struct CapturedPacket {
+  std::uint64_t timeUs = 0;
+  socketwire::SocketAddress address{};
+  std::uint16_t port = 0;
+  std::vector<std::uint8_t> payload;
+};
+
+inline constexpr std::array<std::uint8_t, 4> kCaptureMagic{'S', 'W', 'P', 'C'};
+inline constexpr std::uint16_t kCaptureVersion = 1;
+
+class PacketCaptureWriter {
+ public:
+  PacketCaptureWriter() = default;
+  explicit PacketCaptureWriter(const std::string& path) { Open(path); }
+
+  PacketCaptureWriter(const PacketCaptureWriter&) = delete;
+  PacketCaptureWriter& operator=(const PacketCaptureWriter&) = delete;
+
+  ~PacketCaptureWriter() { Close(); }
+
+  bool Open(const std::string& path) {
+    Close();
+    if (path.empty()) return false;
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+      std::println("Cannot open capture file {}", path);
+      return false;
+    }
+
+    std::array<std::uint8_t, 8> header{};
+    std::memcpy(header.data(), kCaptureMagic.data(), kCaptureMagic.size());
+    header[4] = static_cast<std::uint8_t>(kCaptureVersion & 0xFFu);
+    header[5] = static_cast<std::uint8_t>(kCaptureVersion >> 8);
+    std::fwrite(header.data(), 1, header.size(), file_);
+    start_ = std::chrono::steady_clock::now();
+    lastUs_ = 0;
+    return true;
+  }
+
+  [[nodiscard]] bool IsOpen() const { return file_ != nullptr; }
+  [[nodiscard]] std::uint64_t PacketCount() const { return packets_; }
+
+  void Record(const socketwire::SocketAddress& address, std::uint16_t port,
+              const void* data, std::size_t size) {
+    if (file_ == nullptr) return;
+
+    const auto now_us = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_)
+        .count());
+    const std::uint64_t delta_us = now_us >= lastUs_ ? now_us - lastUs_ : 0;
+    lastUs_ = now_us;
+
+    record_.clear();
+    WriteVarint(delta_us);
+    record_.push_back(address.isIPv6 ? 1u : 0u);
+    if (address.isIPv6) {
+      record_.insert(record_.end(), address.ipv6.bytes.begin(),
+                     address.ipv6.bytes.end());
+      WriteVarint(address.ipv6.scopeId);
+    } else {
+      const std::uint32_t ipv4 = address.ipv4.hostOrderAddress;
+      for (int shift = 0; shift < 32; shift += 8) {
+        record_.push_back(static_cast<std::uint8_t>((ipv4 >> shift) & 0xFFu));
+      }
+    }
+    record_.push_back(static_cast<std::uint8_t>(port & 0xFFu));
+    record_.push_back(static_cast<std::uint8_t>(port >> 8));
+    WriteVarint(size);
+
+    std::fwrite(record_.data(), 1, record_.size(), file_);
+    std::fwrite(data, 1, size, file_);
+    packets_ += 1;
+  }
+
+  void Close() {
+    if (file_ == nullptr) return;
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+ private:
+  void WriteVarint(std::uint64_t value) {
+    while (value >= 0x80u) {
+      record_.push_back(static_cast<std::uint8_t>((value & 0x7Fu) | 0x80u));
+      value >>= 7;
+    }
+    record_.push_back(static_cast<std::uint8_t>(value));
+  }
+
+  FILE* file_ = nullptr;
+  std::chrono::steady_clock::time_point start_{};
+  std::uint64_t lastUs_ = 0;
+  std::uint64_t packets_ = 0;
+  std::vector<std::uint8_t> record_;
+};
+
+class PacketCaptureReader {
+ public:
+  explicit PacketCaptureReader(const std::string& path) {
+    file_ = std::fopen(path.c_str(), "rb");
+    if (file_ == nullptr) return;
+
+    std::array<std::uint8_t, 8> header{};
+    if (std::fread(header.data(), 1, header.size(), file_) != header.size() ||
+        std::memcmp(header.data(), kCaptureMagic.data(),
+                    kCaptureMagic.size()) != 0 ||
+        (header[4] | (header[5] << 8)) != kCaptureVersion) {
+      std::fclose(file_);
+      file_ = nullptr;
+    }
+  }
+
+  PacketCaptureReader(const PacketCaptureReader&) = delete;
+  PacketCaptureReader& operator=(const PacketCaptureReader&) = delete;
+
+  ~PacketCaptureReader() {
+    if (file_ != nullptr) std::fclose(file_);
+  }
+
+  [[nodiscard]] bool IsOpen() const { return file_ != nullptr; }
+
+  // Reads the next record into |packet|, reusing its payload buffer. Returns
+  // false at end of file or on a truncated record.
+  bool Next(CapturedPacket& packet) {
+    if (file_ == nullptr) return false;
+
+    std::uint64_t delta_us = 0;
+    if (!ReadVarint(delta_us)) return false;
+    const int flags = std::fgetc(file_);
+    if (flags == EOF) return false;
+
+    packet.address = {};
+    packet.address.isIPv6 = (flags & 1) != 0;
+    if (packet.address.isIPv6) {
+      std::uint64_t scope_id = 0;
+      if (std::fread(packet.address.ipv6.bytes.data(), 1, 16, file_) != 16 ||
+          !ReadVarint(scope_id)) {
+        return false;
+      }
+      packet.address.ipv6.scopeId = static_cast<std::uint32_t>(scope_id);
+    } else {
+      std::array<std::uint8_t, 4> ipv4{};
+      if (std::fread(ipv4.data(), 1, ipv4.size(), file_) != ipv4.size()) {
+        return false;
+      }
+      packet.address.ipv4.hostOrderAddress =
+        static_cast<std::uint32_t>(ipv4[0]) |
+        (static_cast<std::uint32_t>(ipv4[1]) << 8) |
+        (static_cast<std::uint32_t>(ipv4[2]) << 16) |
+        (static_cast<std::uint32_t>(ipv4[3]) << 24);
+    }
+
+    std::array<std::uint8_t, 2> port{};
+    std::uint64_t size = 0;
+    if (std::fread(port.data(), 1, port.size(), file_) != port.size() ||
+        !ReadVarint(size) || size > kMaxPayloadBytes) {
+      return false;
+    }
+    packet.port = static_cast<std::uint16_t>(port[0] | (port[1] << 8));
+    packet.payload.resize(static_cast<std::size_t>(size));
+    if (size > 0 &&
+        std::fread(packet.payload.data(), 1, packet.payload.size(), file_) !=
+          packet.payload.size()) {
+      return false;
+    }
+
+    timeUs_ += delta_us;
+    packet.timeUs = timeUs_;
+    return true;
+  }
+
+ private:
+  static constexpr std::uint64_t kMaxPayloadBytes = 65536;
+
+  bool ReadVarint(std::uint64_t& out) {
+    out = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const int byte = std::fgetc(file_);
+      if (byte == EOF) return false;
+      out |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  FILE* file_ = nullptr;
+  std::uint64_t timeUs_ = 0;
+};
+
+// Socket that feeds a capture log back into a server as if the original
+// clients were sending it. |speed| scales the recorded timeline; 0 replays as
+// fast as the server polls. Either way one poll gets at most kMaxBurst
+// packets, so the capture spreads over server ticks instead of landing in a
+// single one. Outbound datagrams are counted and dropped.
+class ReplaySocket final : public socketwire::ISocket {
+ public:
+  // Packets handed out before Receive() reports kWouldBlock and ends the
+  // caller's poll.
+  static constexpr std::uint32_t kMaxBurst = 64;
+
+  ReplaySocket(const std::string& path, double speed)
+      : reader_(path), speed_(speed < 0.0 ? 0.0 : speed) {
+    pending_ = reader_.Next(next_);
+  }
+
+  [[nodiscard]] bool IsOpen() const { return reader_.IsOpen(); }
+  [[nodiscard]] bool Finished() const { return !pending_; }
+  [[nodiscard]] std::uint64_t ReplayedPackets() const { return replayed_; }
+  [[nodiscard]] std::uint64_t DroppedSendBytes() const { return sentBytes_; }
+
+  socketwire::SocketError Bind(const socketwire::SocketAddress&,
+                               std::uint16_t port) override {
+    localPort_ = port;
+    return reader_.IsOpen() ? socketwire::SocketError::kNone
+                            : socketwire::SocketError::kClosed;
+  }
+
+  socketwire::SocketResult SendTo(const void*, std::size_t size,
+                                  const socketwire::SocketAddress&,
+                                  std::uint16_t) override {
+    sentBytes_ += size;
+    return {.bytes = static_cast<int>(size),
+            .error = socketwire::SocketError::kNone};
+  }
+
+  socketwire::SocketResult Receive(void* buffer, std::size_t size,
+                                   socketwire::SocketAddress& from_addr,
+                                   std::uint16_t& from_port) override {
+    if (!pending_ || burst_ == kMaxBurst) {
+      burst_ = 0;
+      return {.bytes = 0, .error = socketwire::SocketError::kWouldBlock};
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (!started_) {
+      start_ = now;
+      started_ = true;
+    }
+    if (speed_ > 0.0) {
+      const double elapsed_us =
+        std::chrono::duration<double, std::micro>(now - start_).count() *
+        speed_;
+      if (elapsed_us < static_cast<double>(next_.timeUs)) {
+        burst_ = 0;
+        return {.bytes = 0, .error = socketwire::SocketError::kWouldBlock};
+      }
+    }
+
+    const std::size_t bytes = std::min(size, next_.payload.size());
+    std::memcpy(buffer, next_.payload.data(), bytes);
+    from_addr = next_.address;
+    from_port = next_.port;
+    replayed_ += 1;
+    burst_ += 1;
+    pending_ = reader_.Next(next_);
+    return {.bytes = static_cast<int>(bytes),
+            .error = socketwire::SocketError::kNone};
+  }
+
+  std::uint16_t LocalPort() const override { return localPort_; }
+
+  void Close() override { pending_ = false; }
+
+ private:
+  PacketCaptureReader reader_;
+  double speed_ = 1.0;
+  CapturedPacket next_{};
+  bool pending_ = false;
+  bool started_ = false;
+  std::uint32_t burst_ = 0;
+  std::chrono::steady_clock::time_point start_{};
+  std::uint64_t replayed_ = 0;
+  std::uint64_t sentBytes_ = 0;
+  std::uint16_t localPort_ = 0;
+};
+
+// A server's inbound socket; |replay| is set when it replays a capture.
+struct ServerSocket {
+  std::unique_ptr<socketwire::ISocket> socket;
+  const ReplaySocket* replay = nullptr;
+
+  // True once a replay has handed out its last packet; the server should
+  // stop and report instead of idling on an exhausted capture.
+  [[nodiscard]] bool ReplayFinished() const {
+    return replay != nullptr && replay->Finished();
+  }
+
+  void PrintReplaySummary() const {
+    if (replay == nullptr) return;
+    std::println("Replay finished: {} packets in, {} reply bytes dropped",
+                 replay->ReplayedPackets(), replay->DroppedSendBytes());
+  }
+};
+
+// Binds the usual UDP server socket, or a replay socket when |replay_path| is
+// set, so a server can run unchanged against a captured session.
+inline ServerSocket CreateServerSocket(std::uint16_t port,
+                                       const std::string& replay_path,
+                                       double replay_speed) {
+  ServerSocket server;
+  if (replay_path.empty()) {
+    server.socket = CreateUdpSocket(port);
+    return server;
+  }
+  auto replay = std::make_unique<ReplaySocket>(replay_path, replay_speed);
+  if (replay->Bind({}, port) != socketwire::SocketError::kNone) {
+    std::println("Cannot open replay capture {}", replay_path);
+    return server;
+  }
+  server.replay = replay.get();
+  server.socket = std::move(replay);
+  return server;
+}
+
+}  // namespace socketwire_examples
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <latch>
+#include <optional>
+#include <thread>
+
+#include "thread_pool.hpp"
+
+namespace socketwire_examples {
+
+// Splits one phase of a server tick into index ranges, runs them on a
+// socketwire::ThreadPool and the calling thread, and returns once every range
+// is done, so consecutive Run() calls are separated by a barrier. Launch()
+// and Wait() split that into two calls for a phase that overlaps the next
+// tick.
+//
+// The ranges depend only on the count, the minimum chunk size and the worker
+// count, never on timing. Bodies that write only the state of their own
+// indices, or their own chunk's slot of a result array, therefore give the
+// same result on every run. Bodies run on pool threads and must not touch
+// connections or anything else the network thread owns: they leave results
+// in per-index or per-chunk storage that the caller applies after Run().
+class ParallelFor {
+ public:
+  // |workers| pool threads help the calling thread; 0 runs every phase
+  // inline.
+  explicit ParallelFor(std::size_t workers) : workers_(workers) {
+    if (workers_ == 0) return;
+    pool_.emplace(workers_);
+    pool_->Start();
+  }
+
+  ~ParallelFor() {
+    Wait();
+    if (pool_) pool_->Stop();
+  }
+
+  ParallelFor(const ParallelFor&) = delete;
+  ParallelFor& operator=(const ParallelFor&) = delete;
+
+  // Worker count for a --sim-workers value. -1 leaves one hardware thread for
+  // the network thread and caps the rest: ticks are short and more chunks
+  // mostly add hand-off cost.
+  static std::size_t ResolveWorkers(int requested) {
+    if (requested >= 0) return static_cast<std::size_t>(requested);
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? std::min<std::size_t>(hardware - 1, 7) : 0;
+  }
+
+  // Upper bound on the chunks of one Run(), for sizing per-chunk results.
+  [[nodiscard]] std::size_t MaxChunks() const { return workers_ + 1; }
+
+  // Calls body(chunk, begin, end) for consecutive ranges covering
+  // [0, count), each at least |min_chunk| long unless |count| is smaller,
+  // and returns the number of chunks. Chunk 0 runs on the calling thread.
+  template <typename Body>
+  std::size_t Run(std::size_t count, std::size_t min_chunk, Body&& body) {
+    if (count == 0) return 0;
+    const std::size_t chunks = std::clamp<std::size_t>(
+      count / std::max<std::size_t>(min_chunk, 1), 1, MaxChunks());
+    if (chunks == 1) {
+      body(std::size_t{0}, std::size_t{0}, count);
+      return 1;
+    }
+
+    std::latch done(static_cast<std::ptrdiff_t>(chunks - 1));
+    for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+      const auto run_chunk = [&, chunk] {
+        body(chunk, ChunkBegin(count, chunks, chunk),
+             ChunkBegin(count, chunks, chunk + 1));
+        done.count_down();
+      };
+      // A pool that is shutting down refuses work; run it here instead.
+      if (!pool_->Submit(run_chunk)) run_chunk();
+    }
+    body(std::size_t{0}, std::size_t{0}, ChunkBegin(count, chunks, 1));
+    done.wait();
+    return chunks;
+  }
+
+  // Like Run(), but all chunks go to the pool and the call returns at once,
+  // so the caller can get on with the next tick; Wait() is the barrier. One
+  // launched phase at a time. |body| is kept until Wait() and must only
+  // reference state that stays put until then. Without workers it runs
+  // inline before returning.
+  template <typename Body>
+  void Launch(std::size_t count, std::size_t min_chunk, Body body) {
+    Wait();
+    if (count == 0) return;
+    if (!pool_) {
+      body(std::size_t{0}, std::size_t{0}, count);
+      return;
+    }
+    const std::size_t chunks = std::clamp<std::size_t>(
+      count / std::max<std::size_t>(min_chunk, 1), 1, workers_);
+    launched_ = std::move(body);
+    pending_.store(chunks);
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+      const auto run_chunk = [this, count, chunks, chunk] {
+        launched_(chunk, ChunkBegin(count, chunks, chunk),
+                  ChunkBegin(count, chunks, chunk + 1));
+        if (pending_.fetch_sub(1) == 1) pending_.notify_all();
+      };
+      if (!pool_->Submit(run_chunk)) run_chunk();
+    }
+  }
+
+  // Blocks until the phase started by Launch() is done.
+  void Wait() {
+    for (std::size_t left = pending_.load(); left != 0;
+         left = pending_.load()) {
+      pending_.wait(left);
+    }
+  }
+
+  [[nodiscard]] bool Busy() const { return pending_.load() != 0; }
+
+ private:
+  static std::size_t ChunkBegin(std::size_t count, std::size_t chunks,
+                                std::size_t chunk) {
+    return count / chunks * chunk + std::min(chunk, count % chunks);
+  }
+
+  std::size_t workers_;
+  std::optional<socketwire::ThreadPool> pool_;
+  std::function<void(std::size_t, std::size_t, std::size_t)> launched_;
+  std::atomic<std::size_t> pending_{0};
+};
+
+}  // namespace socketwire_examples
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#include "bit_stream.hpp"
+
+// Bit-field codecs shared by the game protocols. Fixed-width values are
+// written with BitStream::WriteBits in chunks of at most 16 bits; everything
+// here reads back with the TryRead* calls and reports truncation as false.
+namespace socketwire_examples::quantisation {
+
+inline void WriteBitField(socketwire::BitStream& bs, std::uint32_t value,
+                          unsigned bits) {
+  if (bits > 16) {
+    bs.WriteBits(value >> 16, bits - 16u);
+    bs.WriteBits(value & 0xffffu, 16);
+    return;
+  }
+  bs.WriteBits(value & ((1u << bits) - 1u), bits);
+}
+
+inline bool ReadBitField(socketwire::BitStream& bs, unsigned bits,
+                         std::uint32_t& value) {
+  if (bits > 16) {
+    const auto high = bs.TryReadBits(bits - 16u);
+    const auto low = bs.TryReadBits(16);
+    if (!high || !low) return false;
+    value = (*high << 16) | *low;
+    return true;
+  }
+  const auto read = bs.TryReadBits(bits);
+  if (!read) return false;
+  value = *read;
+  return true;
+}
+
+// Float in [lo, hi] rounded to the nearest of 2^Bits evenly spaced values.
+// Out-of-range values and NaN clamp to the bounds.
+template <unsigned Bits>
+struct BoundedFloat {
+  static_assert(Bits >= 1 && Bits <= 32, "1..32 bits");
+  static constexpr unsigned kBits = Bits;
+  static constexpr std::uint32_t kMaxValue =
+    Bits == 32 ? 0xffffffffu : (1u << Bits) - 1u;
+
+  float lo = 0.f;
+  float hi = 1.f;
+
+  [[nodiscard]] std::uint32_t Quantise(float value) const {
+    if (!(value > lo)) return 0;
+    if (value >= hi) return kMaxValue;
+    const double t = (static_cast<double>(value) - lo) /
+                     (static_cast<double>(hi) - lo);
+    return static_cast<std::uint32_t>(std::llround(t * kMaxValue));
+  }
+
+  [[nodiscard]] float Dequantise(std::uint32_t packed) const {
+    const double t =
+      static_cast<double>(std::min(packed, kMaxValue)) / kMaxValue;
+    return static_cast<float>(lo + (static_cast<double>(hi) - lo) * t);
+  }
+
+  // Largest round-trip error for a value inside the range.
+  [[nodiscard]] float Precision() const {
+    return static_cast<float>((static_cast<double>(hi) - lo) / kMaxValue /
+                              2.0);
+  }
+
+  void Write(socketwire::BitStream& bs, float value) const {
+    WriteBitField(bs, Quantise(value), Bits);
+  }
+
+  [[nodiscard]] bool Read(socketwire::BitStream& bs, float& value) const {
+    std::uint32_t packed = 0;
+    if (!ReadBitField(bs, Bits, packed)) return false;
+    value = Dequantise(packed);
+    return true;
+  }
+};
+
+// Angle in radians on a circle of 2^Bits steps. Any input is wrapped first,
+// so -pi and pi share a code and unbounded orientations need no clamping;
+// decoded angles lie in [-pi, pi).
+template <unsigned Bits>
+struct Angle {
+  static_assert(Bits >= 2 && Bits <= 24, "2..24 bits");
+  static constexpr unsigned kBits = Bits;
+  static constexpr std::uint32_t kSteps = 1u << Bits;
+
+  [[nodiscard]] static std::uint32_t Quantise(float radians) {
+    if (!std::isfinite(radians)) return 0;
+    const double turns = radians / (2.0 * std::numbers::pi);
+    const double fraction = turns - std::floor(turns);
+    return static_cast<std::uint32_t>(std::llround(fraction * kSteps)) &
+           (kSteps - 1u);
+  }
+
+  [[nodiscard]] static float Dequantise(std::uint32_t packed) {
+    double radians = static_cast<double>(packed & (kSteps - 1u)) / kSteps *
+                     2.0 * std::numbers::pi;
+    if (radians >= std::numbers::pi) radians -= 2.0 * std::numbers::pi;
+    return static_cast<float>(radians);
+  }
+
+  static void Write(socketwire::BitStream& bs, float radians) {
+    WriteBitField(bs, Quantise(radians), Bits);
+  }
+
+  [[nodiscard]] static bool Read(socketwire::BitStream& bs, float& radians) {
+    std::uint32_t packed = 0;
+    if (!ReadBitField(bs, Bits, packed)) return false;
+    radians = Dequantise(packed);
+    return true;
+  }
+};
+
+// Maps small magnitudes of either sign to small codes: 0, -1, 1, -2 -> 0, 1,
+// 2, 3.
+constexpr std::uint32_t ZigZagEncode(std::int32_t value) {
+  return (static_cast<std::uint32_t>(value) << 1) ^
+         static_cast<std::uint32_t>(value >> 31);
+}
+
+constexpr std::int32_t ZigZagDecode(std::uint32_t value) {
+  return static_cast<std::int32_t>((value >> 1) ^ (0u - (value & 1u)));
+}
+
+// Unsigned integer as groups of GroupBits bits, low group first, each
+// followed by a continuation bit. Values below 2^GroupBits cost
+// GroupBits + 1 bits.
+template <unsigned GroupBits = 7>
+void WriteVarUint(socketwire::BitStream& bs, std::uint32_t value) {
+  static_assert(GroupBits >= 1 && GroupBits <= 16, "1..16 bits per group");
+  constexpr std::uint32_t kMask = (1u << GroupBits) - 1u;
+  while (true) {
+    bs.WriteBits(value & kMask, GroupBits);
+    value >>= GroupBits;
+    bs.WriteBit(value != 0);
+    if (value == 0) return;
+  }
+}
+
+template <unsigned GroupBits = 7>
+bool ReadVarUint(socketwire::BitStream& bs, std::uint32_t& value) {
+  static_assert(GroupBits >= 1 && GroupBits <= 16, "1..16 bits per group");
+  value = 0;
+  for (unsigned shift = 0; shift < 32; shift += GroupBits) {
+    const auto group = bs.TryReadBits(GroupBits);
+    const auto more = bs.TryReadBits(1);
+    if (!group || !more) return false;
+    value |= *group << shift;
+    if (*more == 0) return true;
+  }
+  return false;
+}
+
+template <unsigned GroupBits = 7>
+void WriteVarInt(socketwire::BitStream& bs, std::int32_t value) {
+  WriteVarUint<GroupBits>(bs, ZigZagEncode(value));
+}
+
+template <unsigned GroupBits = 7>
+bool ReadVarInt(socketwire::BitStream& bs, std::int32_t& value) {
+  std::uint32_t encoded = 0;
+  if (!ReadVarUint<GroupBits>(bs, encoded)) return false;
+  value = ZigZagDecode(encoded);
+  return true;
+}
+
+}  // namespace socketwire_examples::quantisation
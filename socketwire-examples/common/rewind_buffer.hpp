@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace socketwire_examples {
+
+// Server-side history for lag compensation: where every entity was over the
+// last Depth ticks, so a command can be judged against the world its sender
+// saw instead of the one the server has moved on to.
+//
+// Each entity owns a slot, and a slot is a ring of Depth entries stored back
+// to back in one array, tick t at entry t % Depth. Memory per entity is fixed
+// at Depth states, a lookup is one index into a short contiguous run, and
+// nothing allocates once the number of slots has peaked. Ticks are the
+// caller's: a game that records once per snapshot rewinds to exactly the
+// states its clients interpolate between.
+template <typename State, std::size_t Depth>
+class RewindBuffer {
+ public:
+  static_assert(Depth > 1 && (Depth & (Depth - 1)) == 0,
+                "tick % Depth must survive tick counter wrap");
+
+  // The recorded states on either side of a fractional tick.
+  struct Span {
+    const State* from = nullptr;
+    const State* to = nullptr;
+    // 0 at |from|, 1 at |to|.
+    float t = 0.f;
+  };
+
+  // A slot with no history, reusing a released one when there is one.
+  std::uint32_t Acquire() {
+    if (!free_.empty()) {
+      const std::uint32_t slot = free_.back();
+      free_.pop_back();
+      return slot;
+    }
+    const auto slot = static_cast<std::uint32_t>(entries_.size() / Depth);
+    entries_.resize(entries_.size() + Depth);
+    return slot;
+  }
+
+  void Release(std::uint32_t slot) {
+    auto* ring = Ring(slot);
+    std::fill(ring, ring + Depth, Entry{});
+    free_.push_back(slot);
+  }
+
+  void Record(std::uint32_t slot, std::uint32_t tick, const State& state) {
+    Entry& entry = Ring(slot)[tick % Depth];
+    entry.stamp = tick + 1;
+    entry.state = state;
+  }
+
+  // |slot|'s state at |tick|; nullptr if it was not recorded then or has
+  // since been overwritten.
+  [[nodiscard]] const State* At(std::uint32_t slot, std::uint32_t tick) const {
+    const Entry& entry = Ring(slot)[tick % Depth];
+    return entry.stamp == tick + 1 ? &entry.state : nullptr;
+  }
+
+  // |slot|'s states around |time|: |from| is null when nothing was recorded
+  // at its whole tick, and |to| is |from| when the tick after is missing.
+  [[nodiscard]] Span Around(std::uint32_t slot, double time) const {
+    const double whole = std::floor(time);
+    const auto tick = static_cast<std::uint32_t>(whole);
+    Span span;
+    span.from = At(slot, tick);
+    if (span.from == nullptr) return span;
+    span.to = At(slot, tick + 1);
+    if (span.to == nullptr) {
+      span.to = span.from;
+    } else {
+      span.t = static_cast<float>(time - whole);
+    }
+    return span;
+  }
+
+ private:
+  struct Entry {
+    // tick + 1, so a zeroed entry holds nothing.
+    std::uint32_t stamp = 0;
+    State state{};
+  };
+
+  Entry* Ring(std::uint32_t slot) { return entries_.data() + slot * Depth; }
+  const Entry* Ring(std::uint32_t slot) const {
+    return entries_.data() + slot * Depth;
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<std::uint32_t> free_;
+};
+
+// |time| pulled into the rewind window: no later than |now| and no more than
+// |max_ticks| before it, so a client cannot claim an arbitrarily old view.
+inline double ClampRewindTime(double time, double now, double max_ticks) {
+  return std::clamp(time, now - max_ticks, now);
+}
+
+}  // namespace socketwire_examples
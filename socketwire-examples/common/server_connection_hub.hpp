@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "i_socket.hpp"
+#include "packet_capture.hpp"
 #include "reliable_connection.hpp"
 
 namespace socketwire_examples {
@@ -41,6 +42,7 @@ class ServerConnectionHub {
   void SetPacketCallback(PacketCallback callback) {
     onPacket_ = std::move(callback);
   }
+  void SetCaptureWriter(PacketCaptureWriter* writer) { capture_ = writer; }
 
   void Poll() {
     while (true) {
@@ -52,6 +54,10 @@ class ServerConnectionHub {
         socket_->Receive(buffer, sizeof(buffer), from_addr, from_port);
       if (result.Failed()) break;
       if (result.bytes <= 0) continue;
+      if (capture_ != nullptr) {
+        capture_->Record(from_addr, from_port, buffer,
+                         static_cast<std::size_t>(result.bytes));
+      }
 
       auto* client = FindClient(from_addr, from_port);
       if (client == nullptr) {
@@ -217,6 +223,7 @@ class ServerConnectionHub {
   ConnectedCallback onConnected_{};
   DisconnectedCallback onDisconnected_{};
   PacketCallback onPacket_{};
+  PacketCaptureWriter* capture_ = nullptr;
 };
 
 }  // namespace socketwire_examples
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+namespace socketwire_examples {
+
+// Constants of the ship model shared by ship-swarm and prediction-ships.
+// Each game passes the values its SimulateEntity uses.
+struct ShipTuning {
+  float thrustAccel = 1.5f;
+  float brakeAccel = 6.f;
+  float minThrottle = -0.3f;
+  float maxThrottle = 1.f;
+  float steerRate = 0.3f;
+  // Positions wrap at +-worldSize.
+  float worldSize = 120.f;
+  // Keep orientation in [-pi, pi] after each step.
+  bool wrapOrientation = false;
+};
+
+// Ship kinematics as parallel arrays, one element per ship. Per-ship
+// constants such as colour and id stay with the game's entity records.
+struct ShipArrays {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> vx;
+  std::vector<float> vy;
+  std::vector<float> ori;
+  std::vector<float> omega;
+  std::vector<float> thr;
+  std::vector<float> steer;
+
+  [[nodiscard]] std::size_t Size() const { return x.size(); }
+
+  // Appends the kinematic fields of |ship| and returns its index.
+  template <typename Ship>
+  std::size_t Add(const Ship& ship) {
+    x.push_back(ship.x);
+    y.push_back(ship.y);
+    vx.push_back(ship.vx);
+    vy.push_back(ship.vy);
+    ori.push_back(ship.ori);
+    omega.push_back(ship.omega);
+    thr.push_back(ship.thr);
+    steer.push_back(ship.steer);
+    return x.size() - 1;
+  }
+
+  // Copies ship |index|'s kinematics into |ship|.
+  template <typename Ship>
+  void Load(std::size_t index, Ship& ship) const {
+    ship.x = x[index];
+    ship.y = y[index];
+    ship.vx = vx[index];
+    ship.vy = vy[index];
+    ship.ori = ori[index];
+    ship.omega = omega[index];
+    ship.thr = thr[index];
+    ship.steer = steer[index];
+  }
+
+  // Moves the last ship into |index| and drops the last slot, the same
+  // swap-and-pop as EntityRegistry::Remove().
+  void Remove(std::size_t index) {
+    for (std::vector<float>* field :
+         {&x, &y, &vx, &vy, &ori, &omega, &thr, &steer}) {
+      (*field)[index] = field->back();
+      field->pop_back();
+    }
+  }
+};
+
+// sin and cos of |radians|: Cody-Waite reduction to [-pi/4, pi/4] and the
+// Cephes polynomials, within 1e-7 of the exact values for headings the ships
+// reach. Unlike sinf/cosf this is straight-line float code, so loops over it
+// vectorise, and the scalar and vector forms give the same bits. Huge or
+// non-finite input gives meaningless results but stays defined.
+inline void SinCos(float radians, float& sin_out, float& cos_out) {
+  constexpr float kTwoOverPi = 0.636619772f;
+  constexpr float kPiOver2A = 1.5703125f;
+  constexpr float kPiOver2B = 4.83751297e-4f;
+  constexpr float kPiOver2C = 7.54978995e-8f;
+  // Adding 1.5 * 2^23 rounds to the nearest integer and leaves it in the low
+  // mantissa bits, with no float-to-int conversion to overflow.
+  constexpr float kRoundShift = 12582912.f;
+
+  const float shifted = radians * kTwoOverPi + kRoundShift;
+  const auto q = std::bit_cast<std::uint32_t>(shifted);
+  const float qf = shifted - kRoundShift;
+  const float r =
+    ((radians - qf * kPiOver2A) - qf * kPiOver2B) - qf * kPiOver2C;
+  const float z = r * r;
+
+  const float s =
+    r + r * z *
+          (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+  const float c =
+    1.f - 0.5f * z +
+    z * z *
+      (4.166664568298827e-2f +
+       z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+
+  // The quadrant picks the polynomial and the sign bit of each result.
+  const bool swap = (q & 1u) != 0;
+  const std::uint32_t sin_sign = (q & 2u) << 30;
+  const std::uint32_t cos_sign = ((q + 1u) & 2u) << 30;
+  sin_out = std::bit_cast<float>(std::bit_cast<std::uint32_t>(swap ? c : s) ^
+                                 sin_sign);
+  cos_out = std::bit_cast<float>(std::bit_cast<std::uint32_t>(swap ? s : c) ^
+                                 cos_sign);
+}
+
+// Shifts |value| by one period when it lies past +-|limit|. Gives the same
+// bits as the games' branchy TileVal(), but the shift is arithmetic: loops
+// with a conditional float add do not vectorise without -fno-trapping-math.
+inline float WrapOnce(float value, float limit, float period) {
+  const int shift = static_cast<int>(value > limit) -
+                    static_cast<int>(value < -limit);
+  return value - period * static_cast<float>(shift);
+}
+
+// Advances ships [begin, end) by |dt|. The operations and their order match
+// the games' scalar SimulateEntity(). prediction-ships' version uses the same
+// SinCos(), so both produce the same bits and client prediction agrees with
+// the server. The loop body is branch-free; compilers vectorise it at -O3.
+// Ships are independent, so disjoint ranges can run on different threads.
+inline void IntegrateShips(ShipArrays& ships, const ShipTuning& tuning,
+                           float dt, std::size_t begin, std::size_t end) {
+  constexpr float kPi = 3.141592654f;
+  // Locals, so stores to the arrays cannot alias the tuning; an infinite
+  // limit turns the orientation wrap off without a branch in the loop.
+  const float min_throttle = tuning.minThrottle;
+  const float max_throttle = tuning.maxThrottle;
+  const float brake_accel = tuning.brakeAccel;
+  const float thrust_accel = tuning.thrustAccel;
+  const float steer_rate = tuning.steerRate;
+  const float wrap_limit = tuning.wrapOrientation
+                             ? kPi
+                             : std::numeric_limits<float>::infinity();
+  const float border = tuning.worldSize;
+  float* const x = ships.x.data();
+  float* const y = ships.y.data();
+  float* const vx = ships.vx.data();
+  float* const vy = ships.vy.data();
+  float* const ori = ships.ori.data();
+  float* const omega = ships.omega.data();
+  const float* const thr = ships.thr.data();
+  const float* const steer = ships.steer.data();
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const float throttle = thr[i] < min_throttle   ? min_throttle
+                           : thr[i] > max_throttle ? max_throttle
+                                                   : thr[i];
+    const float accel = throttle * (thr[i] < 0.f ? brake_accel : thrust_accel);
+    float sin_ori = 0.f;
+    float cos_ori = 0.f;
+    SinCos(ori[i], sin_ori, cos_ori);
+    vx[i] += cos_ori * accel * dt;
+    vy[i] += sin_ori * accel * dt;
+
+    omega[i] += steer[i] * dt * steer_rate;
+    ori[i] = WrapOnce(ori[i] + omega[i] * dt, wrap_limit, 2.f * kPi);
+
+    x[i] = WrapOnce(x[i] + vx[i] * dt, border, 2.f * border);
+    y[i] = WrapOnce(y[i] + vy[i] * dt, border, 2.f * border);
+  }
+}
+
+inline void IntegrateShips(ShipArrays& ships, const ShipTuning& tuning,
+                           float dt) {
+  IntegrateShips(ships, tuning, dt, 0, ships.Size());
+}
+
+}  // namespace socketwire_examples
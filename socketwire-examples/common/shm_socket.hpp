@@ -0,0 +1,409 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "i_socket.hpp"
+#include "socket_constants.hpp"
+
+#if defined(__APPLE__) || defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SOCKETWIRE_EXAMPLES_HAS_SHM 1
+#endif
+
+namespace socketwire_examples {
+
+// Loopback datagram transport over shared memory. A socket bound to a
+// non-zero port owns a segment named after that port and acts as the server
+// side; a socket bound to port 0 attaches to the segment of the first port it
+// sends to and claims one peer slot. Every slot holds two single-producer
+// single-consumer rings, so the same segment works between threads of one
+// process and between unrelated processes on the same host.
+//
+// A peer that closes leaves its slot kClosed; the owner drains what it sent,
+// resets the rings and frees the slot for the next peer. Each reuse bumps the
+// slot's generation, which is folded into the peer's port so a new peer never
+// looks like the connection of the one before it.
+class ShmSocket final : public socketwire::ISocket {
+ public:
+  static constexpr std::uint32_t kMagic = 0x53574D32;  // "SWM2"
+  static constexpr std::size_t kFrameBytes = 1472;
+  static constexpr std::uint32_t kFramesPerRing = 64;
+  // Each slot maps about 189 KB: two rings of kFramesPerRing frames of
+  // kFrameBytes. Owners should size the segment for the peers they expect;
+  // the default of 16 maps 3 MB, and the cap of 4096 already maps 775 MB.
+  static constexpr std::uint32_t kDefaultPeerSlots = 16;
+  static constexpr std::uint32_t kMaxPeerSlots = 4096;
+  // Pop() result for a frame larger than the caller's buffer.
+  static constexpr int kTruncated = -2;
+
+  struct Frame {
+    std::uint32_t size = 0;
+    std::array<std::uint8_t, kFrameBytes> data{};
+  };
+
+  struct alignas(64) Ring {
+    alignas(64) std::atomic<std::uint32_t> head{0};
+    alignas(64) std::atomic<std::uint32_t> tail{0};
+    std::array<Frame, kFramesPerRing> frames{};
+
+    bool Push(const void* data, std::size_t size) {
+      const std::uint32_t head_value = head.load(std::memory_order_relaxed);
+      if (head_value - tail.load(std::memory_order_acquire) >= kFramesPerRing) {
+        return false;
+      }
+      Frame& frame = frames[head_value % kFramesPerRing];
+      frame.size = static_cast<std::uint32_t>(size);
+      std::memcpy(frame.data.data(), data, size);
+      head.store(head_value + 1, std::memory_order_release);
+      return true;
+    }
+
+    // The frame's size, -1 when the ring is empty, or kTruncated when the
+    // frame does not fit in |capacity|; a frame that does not fit is dropped.
+    int Pop(void* buffer, std::size_t capacity) {
+      const std::uint32_t tail_value = tail.load(std::memory_order_relaxed);
+      if (tail_value == head.load(std::memory_order_acquire)) return -1;
+      const Frame& frame = frames[tail_value % kFramesPerRing];
+      const bool fits = frame.size <= capacity;
+      if (fits) std::memcpy(buffer, frame.data.data(), frame.size);
+      const auto size = static_cast<int>(frame.size);
+      tail.store(tail_value + 1, std::memory_order_release);
+      return fits ? size : kTruncated;
+    }
+
+    // Only while neither end is using the ring.
+    void Reset() {
+      head.store(0, std::memory_order_relaxed);
+      tail.store(0, std::memory_order_relaxed);
+    }
+  };
+
+  enum class SlotState : std::uint32_t { kFree = 0, kOpen = 1, kClosed = 2 };
+
+  struct Slot {
+    std::atomic<SlotState> state{SlotState::kFree};
+    // Times the slot has been reused; written by the owner while it is free.
+    std::atomic<std::uint32_t> generation{0};
+    Ring toServer;
+    Ring toClient;
+  };
+
+  struct SegmentHeader {
+    std::uint32_t magic = kMagic;
+    std::uint32_t slotCount = 0;
+    std::uint32_t frameBytes = static_cast<std::uint32_t>(kFrameBytes);
+    std::uint32_t framesPerRing = kFramesPerRing;
+    // Bumped after every slot claim, so the owner rescans only then.
+    std::atomic<std::uint32_t> claims{0};
+  };
+
+  static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+  static_assert(std::atomic<SlotState>::is_always_lock_free);
+
+  explicit ShmSocket(std::uint32_t peer_slots = kDefaultPeerSlots)
+      : peerSlots_(std::clamp<std::uint32_t>(peer_slots, 1, kMaxPeerSlots)) {}
+
+  ShmSocket(const ShmSocket&) = delete;
+  ShmSocket& operator=(const ShmSocket&) = delete;
+
+  ~ShmSocket() override { Close(); }
+
+  static std::string SegmentName(std::uint16_t port) {
+    return "/socketwire-shm-" + std::to_string(port);
+  }
+
+  static std::size_t SegmentBytes(std::uint32_t slots) {
+    return SlotOffset() + sizeof(Slot) * slots;
+  }
+
+  socketwire::SocketError Bind(const socketwire::SocketAddress&,
+                               std::uint16_t port) override {
+    if (header_ != nullptr) return socketwire::SocketError::kClosed;
+    if (port == 0) return socketwire::SocketError::kNone;
+    if (!CreateSegment(port)) return socketwire::SocketError::kClosed;
+    localPort_ = port;
+    return socketwire::SocketError::kNone;
+  }
+
+  socketwire::SocketResult SendTo(const void* data, std::size_t size,
+                                  const socketwire::SocketAddress&,
+                                  std::uint16_t port) override {
+    if (size > kFrameBytes) {
+      return {.bytes = 0, .error = socketwire::SocketError::kClosed};
+    }
+
+    Ring* ring = nullptr;
+    if (owner_) {
+      Slot* slot = PeerSlot(port);
+      if (slot == nullptr ||
+          slot->state.load(std::memory_order_acquire) != SlotState::kOpen) {
+        return {.bytes = 0, .error = socketwire::SocketError::kClosed};
+      }
+      ring = &slot->toClient;
+    } else {
+      if (slot_ == nullptr && !Attach(port)) {
+        return {.bytes = 0, .error = socketwire::SocketError::kClosed};
+      }
+      if (port != remotePort_) {
+        return {.bytes = 0, .error = socketwire::SocketError::kClosed};
+      }
+      ring = &slot_->toServer;
+    }
+
+    if (!ring->Push(data, size)) {
+      return {.bytes = 0, .error = socketwire::SocketError::kWouldBlock};
+    }
+    return {.bytes = static_cast<int>(size),
+            .error = socketwire::SocketError::kNone};
+  }
+
+  socketwire::SocketResult Receive(void* buffer, std::size_t size,
+                                   socketwire::SocketAddress& from_addr,
+                                   std::uint16_t& from_port) override {
+    int bytes = -1;
+    if (owner_) {
+      RefreshActive();
+      std::size_t visited = 0;
+      while (bytes == -1 && visited < active_.size()) {
+        if (cursor_ >= active_.size()) cursor_ = 0;
+        const std::uint32_t index = active_[cursor_];
+        Slot& slot = SlotAt(index);
+        // Read before popping: a peer closes only after its last push, so a
+        // slot seen closed and then empty has nothing left in flight.
+        const bool closed =
+          slot.state.load(std::memory_order_acquire) == SlotState::kClosed;
+        bytes = slot.toServer.Pop(buffer, size);
+        if (bytes != -1) {
+          from_port = PeerPort(index, slot);
+          ++cursor_;
+        } else if (closed) {
+          Reclaim(slot);
+          active_.erase(active_.begin() + static_cast<std::ptrdiff_t>(cursor_));
+        } else {
+          ++cursor_;
+          ++visited;
+        }
+      }
+    } else if (slot_ != nullptr) {
+      bytes = slot_->toClient.Pop(buffer, size);
+      from_port = remotePort_;
+    }
+
+    if (bytes == -1) {
+      return {.bytes = 0, .error = socketwire::SocketError::kWouldBlock};
+    }
+    // Like a UDP receive into a short buffer, a frame that does not fit is an
+    // error rather than a silently shortened datagram.
+    if (bytes == kTruncated) {
+      return {.bytes = 0, .error = socketwire::SocketError::kClosed};
+    }
+    from_addr = socketwire::socket_constants::Loopback();
+    return {.bytes = bytes, .error = socketwire::SocketError::kNone};
+  }
+
+  std::uint16_t LocalPort() const override { return localPort_; }
+
+  void Close() override {
+    if (slot_ != nullptr) {
+      slot_->state.store(SlotState::kClosed, std::memory_order_release);
+      slot_ = nullptr;
+    }
+#if defined(SOCKETWIRE_EXAMPLES_HAS_SHM)
+    if (header_ != nullptr) {
+      ::munmap(header_, mappedBytes_);
+      if (owner_) ::shm_unlink(SegmentName(localPort_).c_str());
+    }
+#endif
+    header_ = nullptr;
+    mappedBytes_ = 0;
+    owner_ = false;
+    slotCount_ = 0;
+    active_.clear();
+    cursor_ = 0;
+    seenClaims_ = 0;
+  }
+
+ private:
+  static constexpr std::size_t SlotOffset() {
+    return (sizeof(SegmentHeader) + alignof(Slot) - 1) / alignof(Slot) *
+           alignof(Slot);
+  }
+
+  Slot& SlotAt(std::uint32_t index) {
+    auto* base = reinterpret_cast<std::uint8_t*>(header_) + SlotOffset();
+    return reinterpret_cast<Slot*>(base)[index];
+  }
+
+  // Ports are 1 + index + slotCount * (generation % generations), so a reused
+  // slot shows up under a port its previous peer never had.
+  std::uint32_t Generations() const { return 65535u / slotCount_; }
+
+  std::uint16_t PeerPort(std::uint32_t index, const Slot& slot) const {
+    const std::uint32_t generation =
+      slot.generation.load(std::memory_order_relaxed) % Generations();
+    return static_cast<std::uint16_t>(1 + index + slotCount_ * generation);
+  }
+
+  Slot* PeerSlot(std::uint16_t port) {
+    if (port == 0) return nullptr;
+    const std::uint32_t index = (port - 1u) % slotCount_;
+    Slot& slot = SlotAt(index);
+    return PeerPort(index, slot) == port ? &slot : nullptr;
+  }
+
+  // Picks up slots claimed since the last call. A claim is the only way a
+  // slot joins |active_|, so polls between claims touch only live peers.
+  void RefreshActive() {
+    const std::uint32_t claims =
+      header_->claims.load(std::memory_order_acquire);
+    if (claims == seenClaims_) return;
+    seenClaims_ = claims;
+    active_.clear();
+    for (std::uint32_t index = 0; index < slotCount_; ++index) {
+      if (SlotAt(index).state.load(std::memory_order_acquire) !=
+          SlotState::kFree) {
+        active_.push_back(index);
+      }
+    }
+  }
+
+  // Returns a closed, drained slot to the pool.
+  static void Reclaim(Slot& slot) {
+    slot.toServer.Reset();
+    slot.toClient.Reset();
+    slot.generation.fetch_add(1, std::memory_order_relaxed);
+    slot.state.store(SlotState::kFree, std::memory_order_release);
+  }
+
+  bool CreateSegment(std::uint16_t port) {
+#if defined(SOCKETWIRE_EXAMPLES_HAS_SHM)
+    const std::string name = SegmentName(port);
+    const std::size_t bytes = SegmentBytes(peerSlots_);
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+      ::close(fd);
+      ::shm_unlink(name.c_str());
+      return false;
+    }
+    void* memory =
+      ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+      ::shm_unlink(name.c_str());
+      return false;
+    }
+
+    // ftruncate zero-fills the segment, which is already a valid empty state
+    // for every ring and slot; only the header needs real values.
+    header_ = new (memory) SegmentHeader{};
+    mappedBytes_ = bytes;
+    header_->slotCount = peerSlots_;
+    slotCount_ = peerSlots_;
+    owner_ = true;
+    return true;
+#else
+    (void)port;
+    return false;
+#endif
+  }
+
+  bool Attach(std::uint16_t port) {
+#if defined(SOCKETWIRE_EXAMPLES_HAS_SHM)
+    if (header_ != nullptr) return false;
+    const int fd = ::shm_open(SegmentName(port).c_str(), O_RDWR, 0600);
+    if (fd < 0) return false;
+
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < sizeof(SegmentHeader)) {
+      ::close(fd);
+      return false;
+    }
+    const auto bytes = static_cast<std::size_t>(info.st_size);
+    void* memory =
+      ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    auto* header = static_cast<SegmentHeader*>(memory);
+    if (header->magic != kMagic || header->frameBytes != kFrameBytes ||
+        header->framesPerRing != kFramesPerRing ||
+        bytes < SegmentBytes(header->slotCount)) {
+      ::munmap(memory, bytes);
+      return false;
+    }
+
+    header_ = header;
+    mappedBytes_ = bytes;
+    slotCount_ = header->slotCount;
+    for (std::uint32_t index = 0; index < slotCount_; ++index) {
+      Slot& slot = SlotAt(index);
+      SlotState expected = SlotState::kFree;
+      if (!slot.state.compare_exchange_strong(expected, SlotState::kOpen,
+                                              std::memory_order_acq_rel)) {
+        continue;
+      }
+      header->claims.fetch_add(1, std::memory_order_release);
+      slot_ = &slot;
+      remotePort_ = port;
+      localPort_ = PeerPort(index, slot);
+      return true;
+    }
+
+    ::munmap(memory, bytes);
+    header_ = nullptr;
+    mappedBytes_ = 0;
+    slotCount_ = 0;
+    return false;
+#else
+    (void)port;
+    return false;
+#endif
+  }
+
+  std::uint32_t peerSlots_ = kDefaultPeerSlots;
+  SegmentHeader* header_ = nullptr;
+  std::size_t mappedBytes_ = 0;
+  std::uint32_t slotCount_ = 0;
+  bool owner_ = false;
+  // Owner side: slots claimed and not yet reclaimed, polled round robin.
+  std::vector<std::uint32_t> active_;
+  std::size_t cursor_ = 0;
+  std::uint32_t seenClaims_ = 0;
+  Slot* slot_ = nullptr;
+  std::uint16_t localPort_ = 0;
+  std::uint16_t remotePort_ = 0;
+};
+
+inline std::unique_ptr<socketwire::ISocket> CreateShmSocket(
+  std::uint16_t port,
+  std::uint32_t peer_slots = ShmSocket::kDefaultPeerSlots) {
+#if defined(SOCKETWIRE_EXAMPLES_HAS_SHM)
+  auto socket = std::make_unique<ShmSocket>(peer_slots);
+  if (socket->Bind(socketwire::socket_constants::Loopback(), port) !=
+      socketwire::SocketError::kNone) {
+    return nullptr;
+  }
+  return socket;
+#else
+  (void)port;
+  (void)peer_slots;
+  return nullptr;
+#endif
+}
+
+}  // namespace socketwire_examples
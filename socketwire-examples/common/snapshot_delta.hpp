@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bit_stream.hpp"
+#include "quantisation.hpp"
+
+namespace socketwire_examples {
+
+inline constexpr std::size_t kDeltaHistoryCapacity = 32;
+
+// One entity of a delta-compressed snapshot: an id plus N unsigned fields.
+// Games quantise or bit_cast their state into the fields; a field counts as
+// changed when its bits differ from the baseline.
+template <std::size_t N>
+struct DeltaRecord {
+  std::uint32_t id = 0;
+  std::array<std::uint32_t, N> fields{};
+};
+
+// Wire widths of the id and of every field, 1..32 bits each.
+template <std::size_t N>
+struct DeltaSchema {
+  std::uint8_t idBits = 16;
+  std::array<std::uint8_t, N> fieldBits{};
+};
+
+template <std::size_t N>
+struct DeltaFrame {
+  std::uint32_t sequence = 0;
+  bool valid = false;
+  std::vector<DeltaRecord<N>> records;  // sorted by id
+};
+
+// Ring of the last |Capacity| frames indexed by sequence. Slots keep their
+// vectors' capacity, so steady-state ticks do not allocate.
+template <std::size_t N, std::size_t Capacity = kDeltaHistoryCapacity>
+class DeltaHistory {
+ public:
+  DeltaFrame<N>& Begin(std::uint32_t sequence) {
+    DeltaFrame<N>& frame = frames_[sequence % Capacity];
+    frame.sequence = sequence;
+    frame.valid = true;
+    frame.records.clear();
+    return frame;
+  }
+
+  [[nodiscard]] const DeltaFrame<N>* Find(std::uint32_t sequence) const {
+    const DeltaFrame<N>& frame = frames_[sequence % Capacity];
+    return frame.valid && frame.sequence == sequence ? &frame : nullptr;
+  }
+
+  void Invalidate(std::uint32_t sequence) {
+    DeltaFrame<N>& frame = frames_[sequence % Capacity];
+    if (frame.sequence == sequence) frame.valid = false;
+  }
+
+ private:
+  std::array<DeltaFrame<N>, Capacity> frames_{};
+};
+
+// Newest snapshot sequence a client has acknowledged. Acks travel unreliably
+// and may arrive out of order, so only newer ones move the baseline.
+struct DeltaBaseline {
+  bool valid = false;
+  std::uint32_t sequence = 0;
+
+  void Acknowledge(std::uint32_t acked) {
+    if (!valid || static_cast<std::int32_t>(acked - sequence) > 0) {
+      valid = true;
+      sequence = acked;
+    }
+  }
+};
+
+// Writes |current| relative to |baseline| (a full frame when null). Layout,
+// bit-packed after whatever header the caller wrote:
+//   sequence:32 has_baseline:1 [sequence - baseline:varint]
+//   removed: {1 id}* 0
+//   changed: {1 id is_new:1 (all fields | mask:N changed fields)}* 0
+template <std::size_t N>
+void WriteDelta(socketwire::BitStream& bs, const DeltaSchema<N>& schema,
+                const DeltaFrame<N>* baseline, const DeltaFrame<N>& current) {
+  static_assert(N > 0 && N <= 16, "change mask is written as one field");
+  using quantisation::WriteBitField;
+
+  WriteBitField(bs, current.sequence, 32);
+  bs.WriteBit(baseline != nullptr);
+  if (baseline != nullptr) {
+    quantisation::WriteVarUint<4>(bs, current.sequence - baseline->sequence);
+  }
+
+  const auto& now = current.records;
+  if (baseline != nullptr) {
+    std::size_t j = 0;
+    for (const DeltaRecord<N>& old : baseline->records) {
+      while (j < now.size() && now[j].id < old.id) ++j;
+      if (j < now.size() && now[j].id == old.id) continue;
+      bs.WriteBit(true);
+      WriteBitField(bs, old.id, schema.idBits);
+    }
+  }
+  bs.WriteBit(false);
+
+  std::size_t i = 0;
+  for (const DeltaRecord<N>& record : now) {
+    const DeltaRecord<N>* previous = nullptr;
+    if (baseline != nullptr) {
+      const auto& base = baseline->records;
+      while (i < base.size() && base[i].id < record.id) ++i;
+      if (i < base.size() && base[i].id == record.id) previous = &base[i];
+    }
+
+    if (previous == nullptr) {
+      bs.WriteBit(true);
+      WriteBitField(bs, record.id, schema.idBits);
+      bs.WriteBit(true);
+      for (std::size_t f = 0; f < N; ++f) {
+        WriteBitField(bs, record.fields[f], schema.fieldBits[f]);
+      }
+      continue;
+    }
+
+    std::uint32_t mask = 0;
+    for (std::size_t f = 0; f < N; ++f) {
+      if (record.fields[f] != previous->fields[f]) mask |= 1u << f;
+    }
+    if (mask == 0) continue;
+
+    bs.WriteBit(true);
+    WriteBitField(bs, record.id, schema.idBits);
+    bs.WriteBit(false);
+    WriteBitField(bs, mask, static_cast<std::uint8_t>(N));
+    for (std::size_t f = 0; f < N; ++f) {
+      if ((mask & (1u << f)) != 0) {
+        WriteBitField(bs, record.fields[f], schema.fieldBits[f]);
+      }
+    }
+  }
+  bs.WriteBit(false);
+}
+
+// Server side: keeps the frame history and encodes the current frame once per
+// distinct client baseline, so clients that acked the same snapshot share one
+// packet.
+template <std::size_t N, std::size_t Capacity = kDeltaHistoryCapacity>
+class SnapshotDeltaSender {
+ public:
+  explicit SnapshotDeltaSender(DeltaSchema<N> schema) : schema_(schema) {}
+
+  // Starts frame |sequence|; fill its records, then call Commit().
+  DeltaFrame<N>& BeginFrame(std::uint32_t sequence) {
+    cacheUsed_ = 0;
+    current_ = &history_.Begin(sequence);
+    return *current_;
+  }
+
+  void Commit() {
+    if (current_ == nullptr) return;
+    auto& records = current_->records;
+    const auto by_id = [](const DeltaRecord<N>& a, const DeltaRecord<N>& b) {
+      return a.id < b.id;
+    };
+    if (!std::ranges::is_sorted(records, by_id)) {
+      std::ranges::sort(records, by_id);
+    }
+  }
+
+  // Packet for a client whose newest ack is |baseline|. Baselines that fell
+  // out of the history get a full frame. |write_header(bs)| writes the game's
+  // byte-aligned message header before the delta bits.
+  template <typename WriteHeader>
+  const socketwire::BitStream& PacketFor(const DeltaBaseline& baseline,
+                                         WriteHeader&& write_header) {
+    const DeltaFrame<N>* base =
+      baseline.valid ? history_.Find(baseline.sequence) : nullptr;
+    if (base == current_) base = nullptr;
+    const std::optional<std::uint32_t> key =
+      base != nullptr ? std::optional<std::uint32_t>(base->sequence)
+                      : std::nullopt;
+
+    for (std::size_t i = 0; i < cacheUsed_; ++i) {
+      if (cache_[i].first == key) return cache_[i].second;
+    }
+    if (cacheUsed_ == cache_.size()) cache_.emplace_back();
+    auto& [cached_key, bs] = cache_[cacheUsed_++];
+    cached_key = key;
+    bs.Clear();
+    write_header(bs);
+    WriteDelta(bs, schema_, base, *current_);
+    return bs;
+  }
+
+  [[nodiscard]] std::size_t EncodedThisFrame() const { return cacheUsed_; }
+
+ private:
+  DeltaSchema<N> schema_;
+  DeltaHistory<N, Capacity> history_;
+  DeltaFrame<N>* current_ = nullptr;
+  std::vector<std::pair<std::optional<std::uint32_t>, socketwire::BitStream>>
+    cache_;
+  std::size_t cacheUsed_ = 0;
+};
+
+enum class DeltaReadStatus : std::uint8_t {
+  kOk,
+  kMissingBaseline,  // baseline never arrived or was already overwritten
+  kStale,            // older than every frame the history still holds
+  kMalformed,
+};
+
+// Client side: rebuilds full frames from delta packets against the frames it
+// already decoded. After kOk, acknowledge Latest().sequence to the server.
+template <std::size_t N, std::size_t Capacity = kDeltaHistoryCapacity>
+class SnapshotDeltaReceiver {
+ public:
+  explicit SnapshotDeltaReceiver(DeltaSchema<N> schema) : schema_(schema) {}
+
+  // Reads the delta bits that follow the game header in |bs|.
+  DeltaReadStatus Read(socketwire::BitStream& bs) {
+    using quantisation::ReadBitField;
+
+    std::uint32_t sequence = 0;
+    std::uint32_t baseline_sequence = 0;
+    if (!ReadBitField(bs, 32, sequence)) return DeltaReadStatus::kMalformed;
+    const auto has_baseline = bs.TryReadBits(1);
+    if (!has_baseline) return DeltaReadStatus::kMalformed;
+    // Decoding it would overwrite the slot of a newer frame.
+    if (hasLatest_ && static_cast<std::int32_t>(latestSequence_ - sequence) >=
+                        static_cast<std::int32_t>(Capacity)) {
+      return DeltaReadStatus::kStale;
+    }
+
+    const DeltaFrame<N>* baseline = nullptr;
+    if (*has_baseline != 0) {
+      std::uint32_t distance = 0;
+      if (!quantisation::ReadVarUint<4>(bs, distance) || distance == 0 ||
+          distance >= Capacity) {
+        return DeltaReadStatus::kMalformed;
+      }
+      baseline_sequence = sequence - distance;
+      baseline = history_.Find(baseline_sequence);
+      if (baseline == nullptr) return DeltaReadStatus::kMissingBaseline;
+    }
+
+    removed_.clear();
+    while (true) {
+      const auto more = bs.TryReadBits(1);
+      if (!more) return DeltaReadStatus::kMalformed;
+      if (*more == 0) break;
+      std::uint32_t id = 0;
+      if (!ReadBitField(bs, schema_.idBits, id)) {
+        return DeltaReadStatus::kMalformed;
+      }
+      removed_.push_back(id);
+    }
+
+    DeltaFrame<N>& frame = history_.Begin(sequence);
+    if (!ReadRecords(bs, baseline, frame.records)) {
+      history_.Invalidate(sequence);
+      return DeltaReadStatus::kMalformed;
+    }
+
+    if (!hasLatest_ ||
+        static_cast<std::int32_t>(sequence - latestSequence_) > 0) {
+      hasLatest_ = true;
+      latestSequence_ = sequence;
+    }
+    lastRead_ = &frame;
+    return DeltaReadStatus::kOk;
+  }
+
+  // Frame rebuilt by the last successful Read(); may be older than Latest()
+  // when packets arrive out of order.
+  [[nodiscard]] const DeltaFrame<N>* LastRead() const { return lastRead_; }
+  [[nodiscard]] const DeltaFrame<N>* Latest() const {
+    return hasLatest_ ? history_.Find(latestSequence_) : nullptr;
+  }
+
+ private:
+  bool ReadRecords(socketwire::BitStream& bs, const DeltaFrame<N>* baseline,
+                   std::vector<DeltaRecord<N>>& out) {
+    using quantisation::ReadBitField;
+
+    static const std::vector<DeltaRecord<N>> kNoRecords;
+    const auto& base = baseline != nullptr ? baseline->records : kNoRecords;
+    std::size_t k = 0;
+    std::size_t r = 0;
+    // Copies unchanged baseline records below |limit| (all when nullopt).
+    const auto copy_before = [&](std::optional<std::uint32_t> limit) {
+      for (; k < base.size() && (!limit || base[k].id < *limit); ++k) {
+        while (r < removed_.size() && removed_[r] < base[k].id) ++r;
+        if (r < removed_.size() && removed_[r] == base[k].id) continue;
+        out.push_back(base[k]);
+      }
+    };
+
+    bool has_previous_id = false;
+    std::uint32_t previous_id = 0;
+    while (true) {
+      const auto more = bs.TryReadBits(1);
+      if (!more) return false;
+      if (*more == 0) break;
+
+      DeltaRecord<N> record;
+      const auto is_new = [&]() -> std::optional<bool> {
+        if (!ReadBitField(bs, schema_.idBits, record.id)) return std::nullopt;
+        const auto bit = bs.TryReadBits(1);
+        if (!bit) return std::nullopt;
+        return *bit != 0;
+      }();
+      if (!is_new) return false;
+      if (has_previous_id && record.id <= previous_id) return false;
+      has_previous_id = true;
+      previous_id = record.id;
+
+      copy_before(record.id);
+      const bool in_baseline = k < base.size() && base[k].id == record.id;
+      if (*is_new) {
+        if (in_baseline) ++k;
+        for (std::size_t f = 0; f < N; ++f) {
+          if (!ReadBitField(bs, schema_.fieldBits[f], record.fields[f])) {
+            return false;
+          }
+        }
+      } else {
+        if (!in_baseline) return false;
+        record.fields = base[k++].fields;
+        std::uint32_t mask = 0;
+        if (!ReadBitField(bs, static_cast<std::uint8_t>(N), mask)) return false;
+        for (std::size_t f = 0; f < N; ++f) {
+          if ((mask & (1u << f)) != 0 &&
+              !ReadBitField(bs, schema_.fieldBits[f], record.fields[f])) {
+            return false;
+          }
+        }
+      }
+      out.push_back(record);
+    }
+    copy_before(std::nullopt);
+    return true;
+  }
+
+  DeltaSchema<N> schema_;
+  DeltaHistory<N, Capacity> history_;
+  std::vector<std::uint32_t> removed_;
+  const DeltaFrame<N>* lastRead_ = nullptr;
+  bool hasLatest_ = false;
+  std::uint32_t latestSequence_ = 0;
+};
+
+}  // namespace socketwire_examples
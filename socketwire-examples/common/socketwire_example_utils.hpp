@@ -173,6 +173,16 @@ inline void WriteString(socketwire::BitStream& stream,
   stream.WriteBytes(value.c_str(), value.size() + 1);
 }
 
+// Refills |stream| with a received packet and rewinds it for reading. A
+// handler that keeps one stream and loads every packet into it reuses the
+// stream's buffer instead of allocating a new BitStream per packet.
+inline void LoadPacket(socketwire::BitStream& stream, const void* data,
+                       std::size_t size) {
+  stream.Clear();
+  stream.WriteBytes(data, size);
+  stream.ResetRead();
+}
+
 inline std::string ReadStringPayload(const void* data, std::size_t size) {
   if (data == nullptr || size == 0) return {};
 
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace socketwire_examples {
+
+// Uniform grid of ids bucketed by position, meant to be rebuilt every tick
+// with Clear() and Insert(). Cells live in a hash map, so the world needs no
+// bounds; cells that stay empty for a whole tick are dropped, the others keep
+// their storage and steady-state rebuilds do not allocate.
+class SpatialGrid {
+ public:
+  struct Entry {
+    std::uint32_t id = 0;
+    float x = 0.f;
+    float y = 0.f;
+  };
+
+  explicit SpatialGrid(float cell_size)
+      : cellSize_(cell_size), invCellSize_(1.f / cell_size) {}
+
+  void Clear() {
+    for (auto it = cells_.begin(); it != cells_.end();) {
+      if (it->second.empty()) {
+        it = cells_.erase(it);
+      } else {
+        it->second.clear();
+        ++it;
+      }
+    }
+    size_ = 0;
+  }
+
+  void Insert(std::uint32_t id, float x, float y) {
+    cells_[Key(CellOf(x), CellOf(y))].push_back(Entry{id, x, y});
+    ++size_;
+  }
+
+  // Calls visit(entry) for every entry in a cell overlapping the box; entries
+  // may lie slightly outside it.
+  template <typename Visit>
+  void ForEachInBox(float min_x, float min_y, float max_x, float max_y,
+                    Visit&& visit) const {
+    const int x0 = CellOf(min_x);
+    const int y0 = CellOf(min_y);
+    const int x1 = CellOf(max_x);
+    const int y1 = CellOf(max_y);
+    const auto box_cells = (static_cast<std::uint64_t>(x1 - x0) + 1u) *
+                           (static_cast<std::uint64_t>(y1 - y0) + 1u);
+    // Large boxes over a sparse grid: scan the occupied cells instead.
+    if (box_cells > cells_.size()) {
+      for (const auto& [key, entries] : cells_) {
+        const int cx = static_cast<std::int32_t>(key >> 32);
+        const int cy = static_cast<std::int32_t>(key & 0xffffffffu);
+        if (cx < x0 || cx > x1 || cy < y0 || cy > y1) continue;
+        for (const Entry& entry : entries) visit(entry);
+      }
+      return;
+    }
+    for (int cy = y0; cy <= y1; ++cy) {
+      for (int cx = x0; cx <= x1; ++cx) {
+        const auto it = cells_.find(Key(cx, cy));
+        if (it == cells_.end()) continue;
+        for (const Entry& entry : it->second) visit(entry);
+      }
+    }
+  }
+
+  // Calls visit(entry, distance_sq) for every entry within |radius| of (x, y).
+  template <typename Visit>
+  void ForEachInRadius(float x, float y, float radius, Visit&& visit) const {
+    const float radius_sq = radius * radius;
+    ForEachInBox(x - radius, y - radius, x + radius, y + radius,
+                 [&](const Entry& entry) {
+                   const float dx = entry.x - x;
+                   const float dy = entry.y - y;
+                   const float distance_sq = dx * dx + dy * dy;
+                   if (distance_sq <= radius_sq) visit(entry, distance_sq);
+                 });
+  }
+
+  [[nodiscard]] float CellSize() const { return cellSize_; }
+  [[nodiscard]] std::size_t Size() const { return size_; }
+
+ private:
+  // Keeps far-off and non-finite positions in a few edge cells.
+  static constexpr float kMaxCell = 1 << 20;
+
+  [[nodiscard]] int CellOf(float value) const {
+    const float cell = std::floor(value * invCellSize_);
+    if (!(cell > -kMaxCell)) return -static_cast<int>(kMaxCell);
+    if (cell > kMaxCell) return static_cast<int>(kMaxCell);
+    return static_cast<int>(cell);
+  }
+
+  static std::uint64_t Key(int cx, int cy) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) |
+           static_cast<std::uint32_t>(cy);
+  }
+
+  float cellSize_;
+  float invCellSize_;
+  std::unordered_map<std::uint64_t, std::vector<Entry>> cells_;
+  std::size_t size_ = 0;
+};
+
+}  // namespace socketwire_examples
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace socketwire_examples::benchmark {
+
+enum class TickPhase : std::uint8_t {
+  kPoll = 0,
+  kSimulate,
+  kBroadcast,
+  kMetrics,
+};
+
+inline constexpr std::size_t kTickPhaseCount = 4;
+
+inline constexpr const char* TickPhaseName(TickPhase phase) {
+  switch (phase) {
+    case TickPhase::kPoll:
+      return "poll";
+    case TickPhase::kSimulate:
+      return "simulate";
+    case TickPhase::kBroadcast:
+      return "broadcast";
+    case TickPhase::kMetrics:
+      return "metrics";
+  }
+  return "unknown";
+}
+
+// Log-linear histogram of durations in microseconds: exact below 16 us, then
+// 16 buckets per power of two (about 6% relative error) up to ~35 minutes.
+class TickHistogram {
+ public:
+  static constexpr std::size_t kSubBuckets = 16;
+  static constexpr std::size_t kBucketCount = 28 * kSubBuckets;
+
+  void Record(std::uint64_t us) {
+    counts_[BucketIndex(us)] += 1;
+    total_ += 1;
+    maxUs_ = std::max(maxUs_, us);
+  }
+
+  void Reset() {
+    counts_.fill(0);
+    total_ = 0;
+    maxUs_ = 0;
+  }
+
+  [[nodiscard]] std::uint64_t Count() const { return total_; }
+  [[nodiscard]] double MaxMs() const {
+    return static_cast<double>(maxUs_) / 1000.0;
+  }
+
+  // Upper edge of the bucket holding the |fraction| quantile, clamped to the
+  // largest recorded value.
+  [[nodiscard]] double PercentileMs(double fraction) const {
+    if (total_ == 0) return 0.0;
+    const auto rank = static_cast<std::uint64_t>(
+      std::max(1.0, fraction * static_cast<double>(total_) + 0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return static_cast<double>(std::min(BucketUpperUs(i), maxUs_)) /
+               1000.0;
+      }
+    }
+    return MaxMs();
+  }
+
+  // Calls |fn(upper_ms, count)| for every non-empty bucket in order.
+  template <typename Fn>
+  void ForEachBucket(Fn&& fn) const {
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+      if (counts_[i] == 0) continue;
+      fn(static_cast<double>(BucketUpperUs(i)) / 1000.0, counts_[i]);
+    }
+  }
+
+ private:
+  static std::size_t BucketIndex(std::uint64_t us) {
+    if (us < kSubBuckets) return static_cast<std::size_t>(us);
+    const auto exponent = static_cast<std::size_t>(std::bit_width(us) - 1);
+    const auto sub =
+      static_cast<std::size_t>((us >> (exponent - 4)) & (kSubBuckets - 1));
+    return std::min((exponent - 3) * kSubBuckets + sub, kBucketCount - 1);
+  }
+
+  static std::uint64_t BucketUpperUs(std::size_t index) {
+    if (index < kSubBuckets) return index + 1;
+    const std::size_t exponent = index / kSubBuckets + 3;
+    const std::uint64_t sub = index % kSubBuckets;
+    return (kSubBuckets + sub + 1) << (exponent - 4);
+  }
+
+  std::array<std::uint64_t, kBucketCount> counts_{};
+  std::uint64_t total_ = 0;
+  std::uint64_t maxUs_ = 0;
+};
+
+struct TickRecord {
+  std::uint64_t tick = 0;
+  std::int64_t elapsedMs = 0;
+  double totalMs = 0.0;
+  std::array<double, kTickPhaseCount> phaseMs{};
+};
+
+// Times one server tick at a time. BeginTick() starts the clock, every
+// MarkPhase() charges the time since the previous mark to that phase, and
+// EndTick() charges the remainder to kMetrics. Keeps a run-wide and a
+// per-sample histogram, the overrun count against |budgetMs|, and the
+// |slowCapacity| slowest ticks with their phase breakdown.
+class TickProfiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  void Configure(double budget_ms, std::size_t slow_capacity) {
+    budgetMs_ = budget_ms;
+    slowCapacity_ = slow_capacity;
+    slowest_.reserve(slow_capacity);
+  }
+
+  [[nodiscard]] double BudgetMs() const { return budgetMs_; }
+  [[nodiscard]] bool InTick() const { return inTick_; }
+
+  void BeginTick(Clock::time_point now) {
+    inTick_ = true;
+    tickStart_ = now;
+    lastMark_ = now;
+    current_ = {};
+  }
+
+  void MarkPhase(TickPhase phase, Clock::time_point now) {
+    if (!inTick_) return;
+    current_.phaseMs[static_cast<std::size_t>(phase)] += ElapsedMs(lastMark_,
+                                                                   now);
+    lastMark_ = now;
+  }
+
+  // |record| is false during warmup: the tick is closed but not counted.
+  void EndTick(Clock::time_point now, std::int64_t elapsed_ms, bool record) {
+    if (!inTick_) return;
+    MarkPhase(TickPhase::kMetrics, now);
+    inTick_ = false;
+    if (!record) return;
+
+    const auto total_us = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(now - tickStart_)
+        .count());
+    current_.tick = ticks_;
+    current_.elapsedMs = elapsed_ms;
+    current_.totalMs = static_cast<double>(total_us) / 1000.0;
+    ticks_ += 1;
+    run_.Record(total_us);
+    sample_.Record(total_us);
+    if (budgetMs_ > 0.0 && current_.totalMs > budgetMs_) {
+      overruns_ += 1;
+      sampleOverruns_ += 1;
+    }
+    KeepIfSlow(current_);
+  }
+
+  [[nodiscard]] std::uint64_t Ticks() const { return ticks_; }
+  [[nodiscard]] std::uint64_t Overruns() const { return overruns_; }
+  [[nodiscard]] const TickHistogram& Run() const { return run_; }
+  [[nodiscard]] const TickHistogram& Sample() const { return sample_; }
+  [[nodiscard]] std::uint64_t SampleOverruns() const {
+    return sampleOverruns_;
+  }
+
+  void ResetSample() {
+    sample_.Reset();
+    sampleOverruns_ = 0;
+  }
+
+  // Slowest ticks, longest first.
+  [[nodiscard]] std::vector<TickRecord> Slowest() const {
+    std::vector<TickRecord> sorted = slowest_;
+    std::ranges::sort(sorted, LongerTick);
+    return sorted;
+  }
+
+ private:
+  static double ElapsedMs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  }
+
+  static bool LongerTick(const TickRecord& a, const TickRecord& b) {
+    return a.totalMs > b.totalMs;
+  }
+
+  // |slowest_| is a min-heap on totalMs so the fastest kept tick is evicted.
+  void KeepIfSlow(const TickRecord& record) {
+    if (slowCapacity_ == 0) return;
+    if (slowest_.size() < slowCapacity_) {
+      slowest_.push_back(record);
+      std::ranges::push_heap(slowest_, LongerTick);
+      return;
+    }
+    if (record.totalMs <= slowest_.front().totalMs) return;
+    std::ranges::pop_heap(slowest_, LongerTick);
+    slowest_.back() = record;
+    std::ranges::push_heap(slowest_, LongerTick);
+  }
+
+  double budgetMs_ = 0.0;
+  std::size_t slowCapacity_ = 0;
+  bool inTick_ = false;
+  Clock::time_point tickStart_{};
+  Clock::time_point lastMark_{};
+  TickRecord current_{};
+  std::uint64_t ticks_ = 0;
+  std::uint64_t overruns_ = 0;
+  std::uint64_t sampleOverruns_ = 0;
+  TickHistogram run_;
+  TickHistogram sample_;
+  std::vector<TickRecord> slowest_;
+};
+
+}  // namespace socketwire_examples::benchmark
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace socketwire_examples {
+
+struct TickSchedulerConfig {
+  // Fixed simulation step; every step advances the world by exactly this.
+  std::chrono::steady_clock::duration simInterval{};
+  // How often the loop wakes to poll the network between steps.
+  std::chrono::steady_clock::duration pollInterval{};
+  // Most steps one wakeup may run after a stall; older ticks are dropped.
+  std::uint32_t maxCatchUpTicks = 4;
+};
+
+// Paces a server loop against absolute deadlines: tick N is due at
+// start + N * simInterval, so sleeping late or a slow tick never shifts the
+// ticks after it. The loop also wakes every pollInterval to poll the network,
+// so input waits at most one poll interval instead of one simulation step.
+//
+// A loop that falls behind runs up to maxCatchUpTicks steps in a row and then
+// drops the rest: a long stall makes the world skip ahead once instead of
+// running a burst of ticks that would fall behind again.
+class TickScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit TickScheduler(const TickSchedulerConfig& config,
+                         Clock::time_point start = Clock::now())
+      : config_(Sanitise(config)),
+        nextSim_(start + config_.simInterval),
+        nextPoll_(start + config_.pollInterval) {}
+
+  // Sleeps until the next poll or simulation deadline and returns the number
+  // of simulation steps due now; 0 means poll only.
+  std::uint32_t WaitNext() {
+    std::this_thread::sleep_until(std::min(nextSim_, nextPoll_));
+    const Clock::time_point now = Clock::now();
+    if (now >= nextPoll_) {
+      nextPoll_ += ((now - nextPoll_) / config_.pollInterval + 1) *
+                   config_.pollInterval;
+    }
+
+    lastDropped_ = 0;
+    if (now < nextSim_) return 0;
+    const auto due =
+      static_cast<std::uint64_t>((now - nextSim_) / config_.simInterval) + 1;
+    const auto steps = static_cast<std::uint32_t>(
+      std::min<std::uint64_t>(due, config_.maxCatchUpTicks));
+    lastLateness_ = now - nextSim_;
+    lastDropped_ = due - steps;
+    dropped_ += lastDropped_;
+    nextSim_ += static_cast<Clock::rep>(due) * config_.simInterval;
+    ticks_ += steps;
+    return steps;
+  }
+
+  [[nodiscard]] float StepSeconds() const {
+    return std::chrono::duration<float>(config_.simInterval).count();
+  }
+  // Simulation steps handed out so far.
+  [[nodiscard]] std::uint64_t Ticks() const { return ticks_; }
+  // The tick whose deadline passed last, dropped ticks included: the newest
+  // step stands for server time CurrentTick() * simInterval since start.
+  [[nodiscard]] std::uint64_t CurrentTick() const {
+    return ticks_ + dropped_;
+  }
+  // How long after its deadline the first step of the last simulating
+  // wakeup started.
+  [[nodiscard]] Clock::duration LastLateness() const { return lastLateness_; }
+  // Ticks the last WaitNext() dropped, and all dropped so far.
+  [[nodiscard]] std::uint64_t LastDropped() const { return lastDropped_; }
+  [[nodiscard]] std::uint64_t Dropped() const { return dropped_; }
+
+ private:
+  // Both intervals are divisors in WaitNext(), so a zero or negative one is
+  // raised to a microsecond. A catch-up limit of 0 would never simulate.
+  static TickSchedulerConfig Sanitise(TickSchedulerConfig config) {
+    constexpr Clock::duration kMinInterval = std::chrono::microseconds(1);
+    config.simInterval = std::max(config.simInterval, kMinInterval);
+    config.pollInterval = std::max(config.pollInterval, kMinInterval);
+    config.maxCatchUpTicks = std::max<std::uint32_t>(config.maxCatchUpTicks, 1);
+    return config;
+  }
+
+  TickSchedulerConfig config_;
+  Clock::time_point nextSim_;
+  Clock::time_point nextPoll_;
+  Clock::duration lastLateness_{};
+  std::uint64_t lastDropped_ = 0;
+  std::uint64_t dropped_ = 0;
+  std::uint64_t ticks_ = 0;
+};
+
+}  // namespace socketwire_examples
@@ -11,6 +11,7 @@
 #include "i_socket.hpp"
 #include "netbench_common.hpp"
 #include "reliable_connection.hpp"
+#include "shm_socket.hpp"
 #include "socketwire_example_utils.hpp"
 
 namespace {
@@ -254,7 +255,9 @@ int main(int argc, const char** argv) {
   for (int i = 0; i < options.clients; ++i) {
     auto client = std::make_unique<ClientState>(
       stats, options.seed + static_cast<std::uint32_t>(i));
-    client->socket = socketwire_examples::CreateUdpSocket(0);
+    client->socket = options.transport == "shm"
+                       ? socketwire_examples::CreateShmSocket(0)
+                       : socketwire_examples::CreateUdpSocket(0);
     if (client->socket == nullptr) {
       stats.connectFailures +=
         static_cast<std::uint64_t>(options.clients - i);
@@ -277,8 +280,9 @@ int main(int argc, const char** argv) {
     clients.push_back(std::move(client));
   }
 
-  std::cout << std::format("netbench client created {}/{} real UDP clients",
-                           clients.size(), options.clients) << "\n";
+  std::cout << std::format("netbench client created {}/{} {} clients",
+                           clients.size(), options.clients, options.transport)
+            << "\n";
 
   netbench::MetricsWriter metrics(options, "client");
   bool reset_at_measurement = false;
@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <string>
@@ -75,6 +76,7 @@ struct Options {
   int serverMaxClients = 0;
   std::uint32_t seed = 1;
   std::string profile = "mixed_latency";
+  std::string transport = "udp";
   std::string metricsPath;
   std::string metricsMode = "samples";
 };
@@ -232,6 +234,8 @@ inline Options ParseOptions(int argc, const char** argv,
       }
     } else if (std::strcmp(arg, "--profile") == 0 && i + 1 < argc) {
       options.profile = argv[++i];
+    } else if (std::strcmp(arg, "--transport") == 0 && i + 1 < argc) {
+      options.transport = argv[++i];
     } else if (std::strcmp(arg, "--metrics") == 0 && i + 1 < argc) {
       options.metricsPath = argv[++i];
     } else if (std::strcmp(arg, "--metrics-mode") == 0 && i + 1 < argc) {
@@ -245,6 +249,11 @@ inline Options ParseOptions(int argc, const char** argv,
   if (options.drainMs < 0) options.drainMs = 0;
   if (options.serverWorkers <= 0) options.serverWorkers = 1;
   if (options.metricsMode != "summary") options.metricsMode = "samples";
+  if (options.transport != "udp" && options.transport != "shm") {
+    std::fprintf(stderr, "unknown --transport '%s'; expected udp or shm\n",
+                 options.transport.c_str());
+    std::exit(2);
+  }
   return options;
 }
 
@@ -661,7 +670,8 @@ class MetricsWriter {
       if (out == nullptr) return;
       const auto json = std::format(
         "{{\"example\":\"network-bench\",\"backend\":\"socketwire\","
-        "\"role\":\"{}\",\"record\":\"{}\",\"profile\":\"{}\",\"run\":{},"
+        "\"transport\":\"{}\",\"role\":\"{}\",\"record\":\"{}\","
+        "\"profile\":\"{}\",\"run\":{},"
         "\"elapsed_ms\":{},\"clients_requested\":{},\"clients_created\":{},"
         "\"connected_clients\":{},\"status\":\"{}\","
         "\"server_workers\":{},\"reuse_port\":{},"
@@ -694,7 +704,8 @@ class MetricsWriter {
         "\"update_ms_avg\":{:.6f},\"update_ms_max\":{:.6f},"
         "\"cpu_percent\":{:.3f},\"cpu_process_percent\":{:.3f},"
         "\"rss_kb\":{}}}",
-        role_, record, options_.profile, options_.run, ElapsedMs(now),
+        options_.transport, role_, record, options_.profile, options_.run,
+        ElapsedMs(now),
         process.clientsRequested, process.clientsCreated,
         process.connectedClients, process.status, process.serverWorkers,
         process.reusePort, process.workerConnectedMin,
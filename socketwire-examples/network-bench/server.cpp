@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <iostream>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -12,6 +13,7 @@
 #include "netbench_common.hpp"
 #include "server_connection_hub.hpp"
 #include "sharded_connection_manager.hpp"
+#include "shm_socket.hpp"
 #include "socketwire_example_utils.hpp"
 
 namespace {
@@ -106,11 +108,37 @@ netbench::TransportStats TransportStats(
   return stats;
 }
 
+std::unique_ptr<socketwire::ISocket> CreateServerSocket(
+  const netbench::Options& options) {
+  if (options.transport != "shm") {
+    return socketwire_examples::CreateUdpSocket(options.port);
+  }
+  // One slot per concurrent client, so the segment maps only what the run
+  // needs; --server-max-clients sizes it when --clients is not the peak.
+  const int capacity =
+    options.serverMaxClients > 0 ? options.serverMaxClients : options.clients;
+  constexpr auto kMaxSlots =
+    static_cast<int>(socketwire_examples::ShmSocket::kMaxPeerSlots);
+  if (capacity > kMaxSlots) {
+    std::cerr << "--transport shm supports at most " << kMaxSlots
+              << " clients, " << capacity << " requested\n";
+    return nullptr;
+  }
+  return socketwire_examples::CreateShmSocket(
+    options.port, static_cast<std::uint32_t>(std::max(capacity, 1)));
+}
+
 }  // namespace
 
 int main(int argc, const char** argv) {
   auto options = netbench::ParseOptions(argc, argv);
   netbench::AppStats stats;
+
+  if (options.serverWorkers > 1 && options.transport == "shm") {
+    std::cerr << "--transport shm uses a single server worker\n";
+    options.serverWorkers = 1;
+  }
+  // After the override, so the metrics report the workers that ran.
   netbench::MetricsWriter metrics(options, "server");
 
   if (options.serverWorkers > 1) {
@@ -226,7 +254,7 @@ int main(int argc, const char** argv) {
     return 0;
   }
 
-  auto socket = socketwire_examples::CreateUdpSocket(options.port);
+  auto socket = CreateServerSocket(options);
   if (socket == nullptr) {
     metrics.Finish(stats, {.clientsRequested = options.clients,
                            .clientsCreated = 0,
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <print>
 #include <string>
@@ -9,6 +10,7 @@
 
 #include "benchmark_utils.hpp"
 #include "entity.h"
+#include "interpolation_buffer.hpp"
 #include "protocol.h"
 #include "raylib.h"
 #include "reliable_connection.hpp"
@@ -23,6 +25,20 @@ static int game_time_remaining = 60;
 static bool game_over = false;
 static std::uint16_t winner_eid = kInvalidEntity;
 static int winner_score = 0;
+static WorldSnapshotDecoder snapshot_decoder;
+static std::vector<SnapshotEntity> snapshot_entries;
+static std::vector<GameEvent> snapshot_events;
+// Entities in the server's view of this client, ascending; the others stay on
+// the leaderboard but are not drawn.
+static std::vector<std::uint16_t> visible_eids;
+// Snapshots wait here until their playout time, which trails the server by
+// one tick plus the jitter the link has shown lately.
+static socketwire_examples::InterpolationBuffer<std::vector<SnapshotEntity>>
+  snapshot_buffer({.snapshotIntervalMs =
+                     std::chrono::duration<double, std::milli>(kTickInterval)
+                       .count()});
+// Farther than this between two snapshots is a respawn, not movement.
+static constexpr float kTeleportDistance = 50.f;
 
 static void OnNewEntityPacket(const void* data, std::size_t size) {
   Entity new_entity;
@@ -43,62 +59,82 @@ static void GetEntity(std::uint16_t eid, Callable callable) {
   if (it != index_map.end()) callable(entities[it->second]);
 }
 
-static void OnSnapshot(const void* data, std::size_t size) {
-  std::uint16_t eid = kInvalidEntity;
-  float x = 0.f;
-  float y = 0.f;
-  float entity_size = 0.f;
-  DeserializeSnapshot(data, size, eid, x, y, entity_size);
-  GetEntity(eid, [&](Entity& e) {
-    if (eid != my_entity) {
-      e.x = x;
-      e.y = y;
-    }
-    e.size = entity_size;
-  });
+// Entities in the newer snapshot around the playout time, placed between
+// their two states. Entities that just came into view or respawned start at
+// the newer one; our own position stays client-side.
+static void ApplySnapshots(std::chrono::steady_clock::time_point now) {
+  const auto frame = snapshot_buffer.Sample(now);
+  if (frame.to == nullptr) return;
+  visible_eids.clear();
+  for (const SnapshotEntity& to : *frame.to) {
+    visible_eids.push_back(to.eid);
+    const auto from = std::ranges::lower_bound(*frame.from, to.eid, {},
+                                               &SnapshotEntity::eid);
+    const bool moved = from != frame.from->end() && from->eid == to.eid &&
+                       std::hypot(to.x - from->x, to.y - from->y) <
+                         kTeleportDistance;
+    GetEntity(to.eid, [&](Entity& e) {
+      e.size = moved ? std::lerp(from->size, to.size, frame.t) : to.size;
+      if (to.eid == my_entity) return;
+      e.x = moved ? std::lerp(from->x, to.x, frame.t) : to.x;
+      e.y = moved ? std::lerp(from->y, to.y, frame.t) : to.y;
+    });
+  }
 }
 
-static void OnEntityDevoured(const void* data, std::size_t size) {
-  std::uint16_t devoured_eid = kInvalidEntity;
-  std::uint16_t devourer_eid = kInvalidEntity;
-  float devourer_new_size = 0.f;
-  float devoured_new_size = 0.f;
-  float new_x = 0.f;
-  float new_y = 0.f;
-  DeserializeEntityDevoured(data, size, devoured_eid, devourer_eid,
-                            devourer_new_size, devoured_new_size, new_x, new_y);
-
-  GetEntity(devourer_eid, [&](Entity& e) { e.size = devourer_new_size; });
-  GetEntity(devoured_eid, [&](Entity& e) {
-    e.x = new_x;
-    e.y = new_y;
-    e.size = devoured_new_size;
-  });
+// Events apply as they arrive, not at their snapshot's playout time.
+static void ApplyEvent(const GameEvent& event) {
+  switch (event.type) {
+    case GameEventType::kDevoured:
+      GetEntity(event.otherEid, [&](Entity& e) { e.size = event.otherSize; });
+      GetEntity(event.eid, [&](Entity& e) {
+        e.x = event.x;
+        e.y = event.y;
+        e.size = event.size;
+      });
+      break;
+    case GameEventType::kScore:
+      GetEntity(event.eid, [&](Entity& e) { e.score = event.value; });
+      break;
+    case GameEventType::kGameTime:
+      game_time_remaining = event.value;
+      break;
+    case GameEventType::kGameOver:
+      game_over = true;
+      winner_eid = event.eid;
+      winner_score = event.value;
+      std::println("Game Over! Winner is entity {} with score {}", winner_eid,
+                   winner_score);
+      break;
+  }
 }
 
-static void OnScoreUpdate(const void* data, std::size_t size) {
-  std::uint16_t eid = kInvalidEntity;
-  int score = 0;
-  DeserializeScoreUpdate(data, size, eid, score);
-  GetEntity(eid, [&](Entity& e) { e.score = score; });
+static void OnSnapshot(const void* data, std::size_t size) {
+  std::uint32_t sequence = 0;
+  const bool has_snapshot = snapshot_decoder.Read(
+    data, size, snapshot_entries, sequence, snapshot_events);
+  for (const GameEvent& event : snapshot_events) ApplyEvent(event);
+  if (!has_snapshot) return;
+  const double server_ms =
+    static_cast<double>(sequence) *
+    std::chrono::duration<double, std::milli>(kTickInterval).count();
+  if (auto* slot = snapshot_buffer.Push(server_ms,
+                                        std::chrono::steady_clock::now())) {
+    *slot = snapshot_entries;
+  }
 }
 
-static void OnGameTime(const void* data, std::size_t size) {
-  int seconds_remaining = 0;
-  DeserializeGameTime(data, size, seconds_remaining);
-  game_time_remaining = seconds_remaining;
+static void OnEvents(const void* data, std::size_t size) {
+  snapshot_decoder.ReadEvents(data, size, snapshot_events);
+  for (const GameEvent& event : snapshot_events) ApplyEvent(event);
 }
 
-static void OnGameOver(const void* data, std::size_t size) {
-  std::uint16_t w_eid = kInvalidEntity;
-  int w_score = 0;
-  DeserializeGameOver(data, size, w_eid, w_score);
-
-  game_over = true;
-  winner_eid = w_eid;
-  winner_score = w_score;
-  std::println("Game Over! Winner is entity {} with score {}", winner_eid,
-               winner_score);
+// Restates what the events before the resync point would have told us.
+static void OnResync(const void* data, std::size_t size) {
+  std::uint32_t next_event = 0;
+  if (!DeserializeResync(data, size, next_event, snapshot_events)) return;
+  snapshot_decoder.SkipEventsBefore(next_event);
+  for (const GameEvent& event : snapshot_events) ApplyEvent(event);
 }
 
 static bool CompareEntityScores(const Entity& a, const Entity& b) {
@@ -137,20 +173,15 @@ class ClientHandler final : public socketwire::IReliableConnectionHandler {
       case MessageType::kEServerToClientSnapshot:
         OnSnapshot(data, size);
         break;
-      case MessageType::kEServerToClientEntityDevoured:
-        OnEntityDevoured(data, size);
-        break;
-      case MessageType::kEServerToClientScoreUpdate:
-        OnScoreUpdate(data, size);
-        break;
-      case MessageType::kEServerToClientGameTime:
-        OnGameTime(data, size);
+      case MessageType::kEServerToClientEvents:
+        OnEvents(data, size);
         break;
-      case MessageType::kEServerToClientGameOver:
-        OnGameOver(data, size);
+      case MessageType::kEServerToClientResync:
+        OnResync(data, size);
         break;
       case MessageType::kEClientToServerJoin:
       case MessageType::kEClientToServerState:
+      case MessageType::kEClientToServerSnapshotAck:
         break;
     }
   }
@@ -228,11 +259,13 @@ int main(int argc, const char** argv) {
     }
     connection.Poll();
     connection.Update();
+    snapshot_decoder.FlushAcks(&connection);
 
     if (handler.connected && !sent_join) {
       SendJoin(&connection);
       sent_join = true;
     }
+    ApplySnapshots(std::chrono::steady_clock::now());
 
     if (my_entity != kInvalidEntity) {
       const float axis_x =
@@ -263,6 +296,10 @@ int main(int argc, const char** argv) {
       ClearBackground(Color{40, 40, 40, 255});
       BeginMode2D(camera);
       for (const Entity& e : entities) {
+        if (e.eid != my_entity &&
+            !std::ranges::binary_search(visible_eids, e.eid)) {
+          continue;
+        }
         DrawCircle(static_cast<int>(e.x), static_cast<int>(e.y), e.size,
                    GetColor(e.color));
 
@@ -337,6 +374,11 @@ int main(int argc, const char** argv) {
       metrics.SetConnectedClients(handler.connected ? 1 : 0);
       metrics.SetNetworkStats(
         socketwire_examples::benchmark::StatsFromConnection(connection));
+      socketwire_examples::benchmark::GameMetrics game_metrics;
+      game_metrics.entityCountClient = entities.size();
+      game_metrics.interpolationDelayMs = snapshot_buffer.DelayMs();
+      game_metrics.interpolationUnderflowCount = snapshot_buffer.Underflows();
+      metrics.SetGameMetrics(game_metrics);
       metrics.RecordUpdateMs(
         static_cast<double>(
           std::chrono::duration_cast<std::chrono::microseconds>(update_end -
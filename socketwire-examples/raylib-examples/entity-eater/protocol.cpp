@@ -1,7 +1,10 @@
 #include "protocol.h"
 
+#include <algorithm>
+
 #include "benchmark_utils.hpp"
 #include "bit_stream.hpp"
+#include "quantisation.hpp"
 #include "reliable_connection.hpp"
 
 namespace {
@@ -10,8 +13,146 @@ void WriteMessageType(socketwire::BitStream& bs, MessageType type) {
   bs.Write<std::uint8_t>(static_cast<std::uint8_t>(type));
 }
 
+using socketwire_examples::quantisation::BoundedFloat;
+
+// Spawns stay inside +-500 units but players steer freely, so positions get a
+// wide range at about 0.016-unit steps. Sizes are capped at 100 by the server.
+constexpr BoundedFloat<18> kPositionCodec{-4096.f, 4096.f};
+constexpr BoundedFloat<12> kSizeCodec{0.f, 128.f};
+
+constexpr socketwire_examples::DeltaSchema<3> kSnapshotSchema{
+  .idBits = 16,
+  .fieldBits = {kPositionCodec.kBits, kPositionCodec.kBits, kSizeCodec.kBits},
+};
+
+constexpr std::uint8_t kEidBits = 16;
+constexpr std::uint8_t kEventTypeBits = 2;
+
+// Devoured events cost 94 bits; the others at most 58.
+void WriteEvent(socketwire::BitStream& bs, const GameEvent& event) {
+  using socketwire_examples::quantisation::WriteBitField;
+  using socketwire_examples::quantisation::WriteVarInt;
+  WriteBitField(bs, static_cast<std::uint32_t>(event.type), kEventTypeBits);
+  switch (event.type) {
+    case GameEventType::kDevoured:
+      WriteBitField(bs, event.eid, kEidBits);
+      WriteBitField(bs, event.otherEid, kEidBits);
+      kSizeCodec.Write(bs, event.size);
+      kSizeCodec.Write(bs, event.otherSize);
+      kPositionCodec.Write(bs, event.x);
+      kPositionCodec.Write(bs, event.y);
+      break;
+    case GameEventType::kScore:
+    case GameEventType::kGameOver:
+      WriteBitField(bs, event.eid, kEidBits);
+      WriteVarInt(bs, event.value);
+      break;
+    case GameEventType::kGameTime:
+      WriteVarInt(bs, event.value);
+      break;
+  }
+}
+
+bool ReadEvent(socketwire::BitStream& bs, GameEvent& event) {
+  using socketwire_examples::quantisation::ReadBitField;
+  using socketwire_examples::quantisation::ReadVarInt;
+  std::uint32_t type = 0;
+  if (!ReadBitField(bs, kEventTypeBits, type)) return false;
+  event = GameEvent{};
+  event.type = static_cast<GameEventType>(type);
+  std::uint32_t eid = kInvalidEntity;
+  std::uint32_t other_eid = kInvalidEntity;
+  switch (event.type) {
+    case GameEventType::kDevoured:
+      if (!ReadBitField(bs, kEidBits, eid) ||
+          !ReadBitField(bs, kEidBits, other_eid) ||
+          !kSizeCodec.Read(bs, event.size) ||
+          !kSizeCodec.Read(bs, event.otherSize) ||
+          !kPositionCodec.Read(bs, event.x) ||
+          !kPositionCodec.Read(bs, event.y)) {
+        return false;
+      }
+      break;
+    case GameEventType::kScore:
+    case GameEventType::kGameOver:
+      if (!ReadBitField(bs, kEidBits, eid) || !ReadVarInt(bs, event.value)) {
+        return false;
+      }
+      break;
+    case GameEventType::kGameTime:
+      if (!ReadVarInt(bs, event.value)) return false;
+      break;
+  }
+  event.eid = static_cast<std::uint16_t>(eid);
+  event.otherEid = static_cast<std::uint16_t>(other_eid);
+  return true;
+}
+
+// Layout, ahead of the snapshot bits:
+//   count:varint [first sequence:32 {event}*count]
+void WriteEvents(socketwire::BitStream& bs, std::uint32_t first,
+                 std::span<const GameEvent> events) {
+  socketwire_examples::quantisation::WriteVarUint<3>(
+    bs, static_cast<std::uint32_t>(events.size()));
+  if (events.empty()) return;
+  socketwire_examples::quantisation::WriteBitField(bs, first, 32);
+  for (const GameEvent& event : events) WriteEvent(bs, event);
+}
+
+// Reads what WriteEvents() wrote into |events|, keeping only the ones not
+// handed out yet and moving |next_event| past them. Events are applied in
+// order, so a block that starts past |next_event| is dropped; the server
+// sends the gap again.
+bool ReadNewEvents(socketwire::BitStream& bs, std::size_t max_count,
+                   std::optional<std::uint32_t>& next_event,
+                   std::vector<GameEvent>& events) {
+  std::uint32_t count = 0;
+  std::uint32_t first = 0;
+  if (!socketwire_examples::quantisation::ReadVarUint<3>(bs, count) ||
+      count > max_count ||
+      (count > 0 &&
+       !socketwire_examples::quantisation::ReadBitField(bs, 32, first))) {
+    return false;
+  }
+  const bool in_order =
+    next_event && static_cast<std::int32_t>(first - *next_event) <= 0;
+  for (std::uint32_t i = 0; i < count; ++i) {
+    GameEvent event;
+    if (!ReadEvent(bs, event)) {
+      events.clear();
+      return false;
+    }
+    // An earlier packet may already have brought it.
+    if (in_order && static_cast<std::int32_t>(first + i - *next_event) >= 0) {
+      events.push_back(event);
+    }
+  }
+  if (count > 0 && in_order &&
+      static_cast<std::int32_t>(first + count - *next_event) > 0) {
+    next_event = first + count;
+  }
+  return true;
+}
+
 }  // namespace
 
+std::span<const GameEvent> GameEventLog::Since(std::uint32_t sequence) const {
+  const auto skip = static_cast<std::int32_t>(sequence - first_);
+  if (skip <= 0) return events_;
+  return std::span<const GameEvent>(events_).subspan(
+    std::min(static_cast<std::size_t>(skip), events_.size()));
+}
+
+void GameEventLog::TrimBefore(std::uint32_t sequence) {
+  const auto count = static_cast<std::int32_t>(sequence - first_);
+  if (count <= 0) return;
+  const std::size_t erased =
+    std::min(static_cast<std::size_t>(count), events_.size());
+  events_.erase(events_.begin(),
+                events_.begin() + static_cast<std::ptrdiff_t>(erased));
+  first_ += static_cast<std::uint32_t>(erased);
+}
+
 void SendJoin(socketwire::ReliableConnection* connection) {
   socketwire::BitStream bs;
   WriteMessageType(bs, MessageType::kEClientToServerJoin);
@@ -53,70 +194,189 @@ void SendEntityState(socketwire::ReliableConnection* connection,
   socketwire::BitStream bs;
   WriteMessageType(bs, MessageType::kEClientToServerState);
   bs.Write<std::uint16_t>(eid);
-  bs.Write<float>(x);
-  bs.Write<float>(y);
+  kPositionCodec.Write(bs, x);
+  kPositionCodec.Write(bs, y);
   if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
 
-void SendSnapshot(socketwire::ReliableConnection* connection, std::uint16_t eid,
-                  float x, float y, float size) {
-  socketwire::BitStream bs;
-  WriteMessageType(bs, MessageType::kEServerToClientSnapshot);
-  bs.Write<std::uint16_t>(eid);
-  bs.Write<float>(x);
-  bs.Write<float>(y);
-  bs.Write<float>(size);
+WorldSnapshotEncoder::WorldSnapshotEncoder() : sender_(kSnapshotSchema) {}
+
+void WorldSnapshotEncoder::Build(const std::vector<Entity>& entities,
+                                 const std::vector<std::uint32_t>& visible,
+                                 std::uint32_t sequence) {
+  sequence_ = sequence;
+  auto& frame = sender_.BeginFrame(sequence);
+  for (const std::uint32_t index : visible) {
+    const Entity& e = entities[index];
+    frame.records.push_back({
+      .id = e.eid,
+      .fields = {kPositionCodec.Quantise(e.x), kPositionCodec.Quantise(e.y),
+                 kSizeCodec.Quantise(e.size)},
+    });
+  }
+  sender_.Commit();
+}
+
+void WorldSnapshotEncoder::SendTo(
+  socketwire::ReliableConnection* connection,
+  const socketwire_examples::DeltaBaseline& ack, const GameEventLog& events) {
+  // Events still in flight are not repeated; a later ack resends them if
+  // they were lost. The server resyncs a client before this would have to
+  // skip events the log dropped (EventsLost()).
+  if (static_cast<std::int32_t>(eventsSent_ - eventsConfirmed_) < 0) {
+    eventsSent_ = eventsConfirmed_;
+  }
+  std::uint32_t first =
+    static_cast<std::int32_t>(events.FirstSequence() - eventsSent_) > 0
+      ? events.FirstSequence()
+      : eventsSent_;
+  auto pending = events.Since(first);
+  // A backlog the snapshot has no room for goes first in event-only
+  // packets, so the snapshot's ack also tells whether they arrived.
+  for (std::size_t packet = 0;
+       packet < kEventPacketsPerTick && pending.size() > kEventsPerPacket;
+       ++packet) {
+    const auto batch =
+      pending.first(std::min(pending.size(), kEventsPerEventPacket));
+    socketwire::BitStream bs;
+    WriteMessageType(bs, MessageType::kEServerToClientEvents);
+    WriteEvents(bs, first, batch);
+    if (connection->SendUnreliable(1, bs)) {
+      socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+    }
+    first += static_cast<std::uint32_t>(batch.size());
+    pending = pending.subspan(batch.size());
+  }
+  pending = pending.first(std::min(pending.size(), kEventsPerPacket));
+  eventsSent_ = first + static_cast<std::uint32_t>(pending.size());
+  if (static_cast<std::int32_t>(eventsSent_ - eventsEnd_) > 0) {
+    eventsEnd_ = eventsSent_;
+  }
+  carried_[sequence_ % kSnapshotHistory] =
+    EventsCarried{sequence_, eventsSent_, true};
+
+  const socketwire::BitStream& bs =
+    sender_.PacketFor(ack, [&](socketwire::BitStream& header) {
+      WriteMessageType(header, MessageType::kEServerToClientSnapshot);
+      WriteEvents(header, first, pending);
+    });
   if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
 
-void SendEntityDevoured(socketwire::ReliableConnection* connection,
-                        std::uint16_t devoured_eid, std::uint16_t devourer_eid,
-                        float devourer_new_size, float devoured_new_size,
-                        float new_x, float new_y) {
-  socketwire::BitStream bs;
-  WriteMessageType(bs, MessageType::kEServerToClientEntityDevoured);
-  bs.Write<std::uint16_t>(devoured_eid);
-  bs.Write<std::uint16_t>(devourer_eid);
-  bs.Write<float>(devourer_new_size);
-  bs.Write<float>(devoured_new_size);
-  bs.Write<float>(new_x);
-  bs.Write<float>(new_y);
-  if (connection->SendReliable(0, bs)) {
-    socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+void WorldSnapshotEncoder::SkipEventsBefore(std::uint32_t sequence) {
+  eventsConfirmed_ = sequence;
+  eventsSent_ = sequence;
+  eventsEnd_ = sequence;
+}
+
+void WorldSnapshotEncoder::ConfirmSnapshot(
+  std::uint32_t sequence, std::optional<std::uint32_t> next_event) {
+  // A client cannot have events it was never sent.
+  if (!next_event ||
+      static_cast<std::int32_t>(*next_event - eventsEnd_) > 0) {
+    return;
+  }
+  if (static_cast<std::int32_t>(*next_event - eventsConfirmed_) > 0) {
+    eventsConfirmed_ = *next_event;
+  }
+
+  // The client got this snapshot but not every event sent up to it, so a
+  // packet before it was lost or reordered: send again from the gap.
+  const EventsCarried& carried = carried_[sequence % kSnapshotHistory];
+  if (!carried.valid || carried.snapshot != sequence) return;
+  if (static_cast<std::int32_t>(carried.end - eventsConfirmed_) > 0 &&
+      static_cast<std::int32_t>(sequence - resentAt_) > 0) {
+    eventsSent_ = eventsConfirmed_;
+    resentAt_ = sequence_;
   }
 }
 
-void SendScoreUpdate(socketwire::ReliableConnection* connection,
-                     std::uint16_t eid, int score) {
-  socketwire::BitStream bs;
-  WriteMessageType(bs, MessageType::kEServerToClientScoreUpdate);
-  bs.Write<std::uint16_t>(eid);
-  bs.Write<int>(score);
-  if (connection->SendReliable(0, bs)) {
-    socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+bool WorldSnapshotEncoder::EventsLost(const GameEventLog& events) const {
+  return static_cast<std::int32_t>(events.FirstSequence() -
+                                   eventsConfirmed_) > 0;
+}
+
+WorldSnapshotDecoder::WorldSnapshotDecoder() : receiver_(kSnapshotSchema) {}
+
+bool WorldSnapshotDecoder::Read(const void* data, std::size_t size,
+                                std::vector<SnapshotEntity>& entries,
+                                std::uint32_t& sequence,
+                                std::vector<GameEvent>& events) {
+  entries.clear();
+  events.clear();
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  std::uint8_t type = 0;
+  bs.Read<std::uint8_t>(type);
+
+  // Events come first so a packet whose snapshot cannot be used still
+  // delivers them; packets repeat events until an ack confirms them.
+  if (!ReadNewEvents(bs, kEventsPerPacket, nextEvent_, events)) return false;
+
+  if (receiver_.Read(bs) != socketwire_examples::DeltaReadStatus::kOk) {
+    return false;
   }
+  const socketwire_examples::DeltaFrame<3>* frame = receiver_.LastRead();
+  if (!pendingAck_ ||
+      static_cast<std::int32_t>(frame->sequence - *pendingAck_) > 0) {
+    pendingAck_ = frame->sequence;
+  }
+  if (frame != receiver_.Latest()) return false;
+
+  sequence = frame->sequence;
+  for (const auto& record : frame->records) {
+    entries.push_back(SnapshotEntity{
+      .eid = static_cast<std::uint16_t>(record.id),
+      .x = kPositionCodec.Dequantise(record.fields[0]),
+      .y = kPositionCodec.Dequantise(record.fields[1]),
+      .size = kSizeCodec.Dequantise(record.fields[2]),
+    });
+  }
+  return true;
+}
+
+bool WorldSnapshotDecoder::ReadEvents(const void* data, std::size_t size,
+                                      std::vector<GameEvent>& events) {
+  events.clear();
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  std::uint8_t type = 0;
+  bs.Read<std::uint8_t>(type);
+  return ReadNewEvents(bs, kEventsPerEventPacket, nextEvent_, events);
 }
 
-void SendGameTime(socketwire::ReliableConnection* connection,
-                  int seconds_remaining) {
+void WorldSnapshotDecoder::SkipEventsBefore(std::uint32_t sequence) {
+  if (!nextEvent_ || static_cast<std::int32_t>(sequence - *nextEvent_) > 0) {
+    nextEvent_ = sequence;
+  }
+}
+
+void WorldSnapshotDecoder::FlushAcks(
+  socketwire::ReliableConnection* connection) {
+  if (!pendingAck_) return;
   socketwire::BitStream bs;
-  WriteMessageType(bs, MessageType::kEServerToClientGameTime);
-  bs.Write<int>(seconds_remaining);
-  if (connection->SendReliable(0, bs)) {
+  WriteMessageType(bs, MessageType::kEClientToServerSnapshotAck);
+  bs.Write<std::uint32_t>(*pendingAck_);
+  // The next event expected confirms every one before it.
+  bs.Write<bool>(nextEvent_.has_value());
+  if (nextEvent_) bs.Write<std::uint32_t>(*nextEvent_);
+  if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
+  pendingAck_.reset();
 }
 
-void SendGameOver(socketwire::ReliableConnection* connection,
-                  std::uint16_t winner_eid, int winner_score) {
+// Layout: next event:32 count:varint {event}*count
+void SendResync(socketwire::ReliableConnection* connection,
+                std::uint32_t next_event, std::span<const GameEvent> events) {
   socketwire::BitStream bs;
-  WriteMessageType(bs, MessageType::kEServerToClientGameOver);
-  bs.Write<std::uint16_t>(winner_eid);
-  bs.Write<int>(winner_score);
+  WriteMessageType(bs, MessageType::kEServerToClientResync);
+  socketwire_examples::quantisation::WriteBitField(bs, next_event, 32);
+  socketwire_examples::quantisation::WriteVarUint(
+    bs, static_cast<std::uint32_t>(events.size()));
+  for (const GameEvent& event : events) WriteEvent(bs, event);
   if (connection->SendReliable(0, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
@@ -156,60 +416,44 @@ void DeserializeEntityState(const void* data, std::size_t size,
   std::uint8_t type = 0;
   bs.Read<std::uint8_t>(type);
   bs.Read<std::uint16_t>(eid);
-  bs.Read<float>(x);
-  bs.Read<float>(y);
+  (void)kPositionCodec.Read(bs, x);
+  (void)kPositionCodec.Read(bs, y);
 }
 
-void DeserializeSnapshot(const void* data, std::size_t size, std::uint16_t& eid,
-                         float& x, float& y, float& size_out) {
+void DeserializeSnapshotAck(const void* data, std::size_t size,
+                           std::uint32_t& sequence,
+                           std::optional<std::uint32_t>& next_event) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
   bs.Read<std::uint8_t>(type);
-  bs.Read<std::uint16_t>(eid);
-  bs.Read<float>(x);
-  bs.Read<float>(y);
-  bs.Read<float>(size_out);
-}
-
-void DeserializeEntityDevoured(const void* data, std::size_t size,
-                               std::uint16_t& devoured_eid,
-                               std::uint16_t& devourer_eid,
-                               float& devourer_new_size,
-                               float& devoured_new_size, float& new_x,
-                               float& new_y) {
-  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
-  std::uint8_t type = 0;
-  bs.Read<std::uint8_t>(type);
-  bs.Read<std::uint16_t>(devoured_eid);
-  bs.Read<std::uint16_t>(devourer_eid);
-  bs.Read<float>(devourer_new_size);
-  bs.Read<float>(devoured_new_size);
-  bs.Read<float>(new_x);
-  bs.Read<float>(new_y);
-}
-
-void DeserializeScoreUpdate(const void* data, std::size_t size,
-                            std::uint16_t& eid, int& score) {
-  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
-  std::uint8_t type = 0;
-  bs.Read<std::uint8_t>(type);
-  bs.Read<std::uint16_t>(eid);
-  bs.Read<int>(score);
-}
-
-void DeserializeGameOver(const void* data, std::size_t size,
-                         std::uint16_t& winner_eid, int& winner_score) {
-  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
-  std::uint8_t type = 0;
-  bs.Read<std::uint8_t>(type);
-  bs.Read<std::uint16_t>(winner_eid);
-  bs.Read<int>(winner_score);
+  bs.Read<std::uint32_t>(sequence);
+  bool has_next_event = false;
+  bs.Read<bool>(has_next_event);
+  next_event.reset();
+  if (has_next_event) {
+    std::uint32_t next = 0;
+    bs.Read<std::uint32_t>(next);
+    next_event = next;
+  }
 }
 
-void DeserializeGameTime(const void* data, std::size_t size,
-                         int& seconds_remaining) {
+bool DeserializeResync(const void* data, std::size_t size,
+                       std::uint32_t& next_event,
+                       std::vector<GameEvent>& events) {
+  events.clear();
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
   bs.Read<std::uint8_t>(type);
-  bs.Read<int>(seconds_remaining);
+  std::uint32_t count = 0;
+  if (!socketwire_examples::quantisation::ReadBitField(bs, 32, next_event) ||
+      !socketwire_examples::quantisation::ReadVarUint(bs, count)) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < count; ++i) {
+    if (!ReadEvent(bs, events.emplace_back())) {
+      events.clear();
+      return false;
+    }
+  }
+  return true;
 }
@@ -1,24 +1,34 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
 
 #include "entity.h"
+#include "snapshot_delta.hpp"
 
 namespace socketwire {
 class ReliableConnection;
 }
 
+// The server's fixed step; it sends each client one snapshot per tick.
+constexpr std::chrono::milliseconds kTickInterval{20};
+
 enum class MessageType : std::uint8_t {
   kEClientToServerJoin = 0,
   kEServerToClientNewEntity,
   kEServerToClientSetControlledEntity,
   kEClientToServerState,
+  // Gameplay events ride in the same packet, ahead of the snapshot.
   kEServerToClientSnapshot,
-  kEServerToClientEntityDevoured,
-  kEServerToClientScoreUpdate,
-  kEServerToClientGameTime,
-  kEServerToClientGameOver
+  kEClientToServerSnapshotAck,
+  kEServerToClientResync,
+  // Events the next snapshot packet has no room for, sent just ahead of it.
+  kEServerToClientEvents
 };
 
 void SendJoin(socketwire::ReliableConnection* connection);
@@ -28,19 +38,174 @@ void SendSetControlledEntity(socketwire::ReliableConnection* connection,
                              std::uint16_t eid);
 void SendEntityState(socketwire::ReliableConnection* connection,
                      std::uint16_t eid, float x, float y);
-void SendSnapshot(socketwire::ReliableConnection* connection, std::uint16_t eid,
-                  float x, float y, float size);
-
-void SendEntityDevoured(socketwire::ReliableConnection* connection,
-                        std::uint16_t devoured_eid, std::uint16_t devourer_eid,
-                        float devourer_new_size, float devoured_new_size,
-                        float new_x, float new_y);
-void SendScoreUpdate(socketwire::ReliableConnection* connection,
-                     std::uint16_t eid, int score);
-void SendGameOver(socketwire::ReliableConnection* connection,
-                  std::uint16_t winner_eid, int winner_score);
-void SendGameTime(socketwire::ReliableConnection* connection,
-                  int seconds_remaining);
+
+struct SnapshotEntity {
+  std::uint16_t eid = kInvalidEntity;
+  float x = 0.f;
+  float y = 0.f;
+  float size = 0.f;
+};
+
+enum class GameEventType : std::uint8_t {
+  kDevoured,
+  kScore,
+  kGameTime,
+  kGameOver,
+};
+
+// One entry of the gameplay event log. The fields used depend on |type|:
+//   kDevoured: |otherEid| ate |eid| and grew to |otherSize|; |eid| respawned
+//              at (x, y) with |size|.
+//   kScore:    |eid|'s score is now |value|.
+//   kGameTime: |value| seconds are left.
+//   kGameOver: |eid| won with a score of |value|.
+struct GameEvent {
+  GameEventType type = GameEventType::kGameTime;
+  std::uint16_t eid = kInvalidEntity;
+  std::uint16_t otherEid = kInvalidEntity;
+  float size = 0.f;
+  float otherSize = 0.f;
+  float x = 0.f;
+  float y = 0.f;
+  int value = 0;
+};
+
+// A client sees at most kSnapshotEntitiesPerPacket entities around its own,
+// with quantised fields (quantisation.hpp): a changed entity costs at most 69
+// bits. At most kEventsPerPacket events of at most 94 bits go ahead of them,
+// so the packet stays under the default 1400-byte transport packet.
+constexpr std::size_t kSnapshotEntitiesPerPacket = 144;
+constexpr std::size_t kEventsPerPacket = 8;
+// A longer backlog goes out in up to kEventPacketsPerTick event-only packets
+// ahead of the snapshot, each filling the transport packet but for 64 bits
+// of type, count and first sequence: about 24000 events/s at kTickInterval.
+constexpr std::size_t kEventsPerEventPacket = (1400 * 8 - 64) / 94;
+constexpr std::size_t kEventPacketsPerTick = 4;
+// Slowest ack round trip, including the client's frame, that still gets a
+// delta; later acks fall back to full snapshots. One snapshot goes out per
+// kTickInterval, plus the one being built.
+constexpr std::chrono::milliseconds kMaxAckRoundTrip{500};
+constexpr std::size_t kSnapshotHistory =
+  static_cast<std::size_t>(kMaxAckRoundTrip / kTickInterval) + 1;
+
+// Server-side log of the gameplay events every client must get. Events are
+// numbered in order; snapshot packets carry the ones their client has not
+// confirmed, so they are delivered reliably without reliable messages, and
+// the log drops them once every client has confirmed them. A client the log
+// had to leave behind gets a resync instead.
+class GameEventLog {
+ public:
+  // Logs a blank event for the caller to fill in; the reference lasts until
+  // the next Append().
+  GameEvent& Append() { return events_.emplace_back(); }
+
+  // Number the next event will get; a new client starts here.
+  [[nodiscard]] std::uint32_t NextSequence() const {
+    return first_ + static_cast<std::uint32_t>(events_.size());
+  }
+  [[nodiscard]] std::uint32_t FirstSequence() const { return first_; }
+
+  // Logged events from |sequence| on, or from the oldest one kept.
+  [[nodiscard]] std::span<const GameEvent> Since(std::uint32_t sequence) const;
+
+  // Forgets events before |sequence|.
+  void TrimBefore(std::uint32_t sequence);
+
+ private:
+  std::vector<GameEvent> events_;
+  std::uint32_t first_ = 0;
+};
+
+// Server side of one client's snapshot stream. Build() records the entities
+// the client can see; SendTo() sends them as a delta against the client's
+// newest ack, so entities entering or leaving the view go out as adds and
+// removes, together with the next events not yet sent; a backlog too long
+// for the snapshot packet goes ahead in event-only packets. Acks confirm
+// events by the client's next expected one; an acked snapshot that came
+// after an event the client still lacks sends the events again from there.
+class WorldSnapshotEncoder {
+ public:
+  WorldSnapshotEncoder();
+
+  // |visible| holds indices into |entities|.
+  void Build(const std::vector<Entity>& entities,
+             const std::vector<std::uint32_t>& visible,
+             std::uint32_t sequence);
+  void SendTo(socketwire::ReliableConnection* connection,
+              const socketwire_examples::DeltaBaseline& ack,
+              const GameEventLog& events);
+
+  // The client has every event before |sequence|, such as a client that
+  // just got a resync.
+  void SkipEventsBefore(std::uint32_t sequence);
+  // The client acked snapshot |sequence| expecting event |next_event| next,
+  // if it has started on the event stream.
+  void ConfirmSnapshot(std::uint32_t sequence,
+                       std::optional<std::uint32_t> next_event);
+  // The first event the client may not have.
+  [[nodiscard]] std::uint32_t EventsConfirmed() const {
+    return eventsConfirmed_;
+  }
+  // The log dropped events the client never confirmed; it needs a resync.
+  [[nodiscard]] bool EventsLost(const GameEventLog& events) const;
+
+ private:
+  // End of the events a sent snapshot carried.
+  struct EventsCarried {
+    std::uint32_t snapshot = 0;
+    std::uint32_t end = 0;
+    bool valid = false;
+  };
+
+  socketwire_examples::SnapshotDeltaSender<3, kSnapshotHistory> sender_;
+  std::uint32_t sequence_ = 0;
+  std::uint32_t eventsConfirmed_ = 0;
+  // The first event no packet has carried since the last resend, and the
+  // first no packet has carried at all.
+  std::uint32_t eventsSent_ = 0;
+  std::uint32_t eventsEnd_ = 0;
+  // The newest snapshot built when events were last resent; acks of older
+  // ones report the same missing event and must not resend it again.
+  std::uint32_t resentAt_ = 0;
+  std::array<EventsCarried, kSnapshotHistory> carried_{};
+};
+
+// Client side of the snapshot stream. Read() rebuilds the entities in view
+// and queues an ack; FlushAcks() sends it.
+class WorldSnapshotDecoder {
+ public:
+  WorldSnapshotDecoder();
+
+  // Replaces |entries| with every entity in view, ordered by eid, and
+  // |sequence| with the snapshot's. Returns false when the packet is
+  // truncated, references a lost baseline or is older than the state
+  // already applied. |events| gets the gameplay events the packet brought
+  // that no earlier packet did, in order, whatever this returns; events
+  // past one still missing wait for the server to send them again.
+  bool Read(const void* data, std::size_t size,
+            std::vector<SnapshotEntity>& entries, std::uint32_t& sequence,
+            std::vector<GameEvent>& events);
+  // Hands out an event-only packet's events like Read(). Returns false when
+  // the packet is truncated.
+  bool ReadEvents(const void* data, std::size_t size,
+                  std::vector<GameEvent>& events);
+  // A resync restated everything before event |sequence|. Events are not
+  // handed out before the first resync, which comes with the join.
+  void SkipEventsBefore(std::uint32_t sequence);
+  void FlushAcks(socketwire::ReliableConnection* connection);
+
+ private:
+  socketwire_examples::SnapshotDeltaReceiver<3, kSnapshotHistory> receiver_;
+  std::optional<std::uint32_t> pendingAck_;
+  // Sequence of the next event not yet handed out.
+  std::optional<std::uint32_t> nextEvent_;
+};
+
+// Sent reliably at join and to a client the event log left behind. |events|
+// restate every score, the clock and the result, standing in for the events
+// before |next_event|; snapshots carry the events from |next_event| on.
+void SendResync(socketwire::ReliableConnection* connection,
+                std::uint32_t next_event, std::span<const GameEvent> events);
 
 MessageType GetPacketType(const void* data, std::size_t size);
 
@@ -49,18 +214,10 @@ void DeserializeSetControlledEntity(const void* data, std::size_t size,
                                     std::uint16_t& eid);
 void DeserializeEntityState(const void* data, std::size_t size,
                             std::uint16_t& eid, float& x, float& y);
-void DeserializeSnapshot(const void* data, std::size_t size, std::uint16_t& eid,
-                         float& x, float& y, float& size_out);
-
-void DeserializeScoreUpdate(const void* data, std::size_t size,
-                            std::uint16_t& eid, int& score);
-void DeserializeEntityDevoured(const void* data, std::size_t size,
-                               std::uint16_t& devoured_eid,
-                               std::uint16_t& devourer_eid,
-                               float& devourer_new_size,
-                               float& devoured_new_size, float& new_x,
-                               float& new_y);
-void DeserializeGameOver(const void* data, std::size_t size,
-                         std::uint16_t& winner_eid, int& winner_score);
-void DeserializeGameTime(const void* data, std::size_t size,
-                         int& seconds_remaining);
+void DeserializeSnapshotAck(const void* data, std::size_t size,
+                           std::uint32_t& sequence,
+                           std::optional<std::uint32_t>& next_event);
+// Returns false when the packet is truncated.
+bool DeserializeResync(const void* data, std::size_t size,
+                       std::uint32_t& next_event,
+                       std::vector<GameEvent>& events);
@@ -2,21 +2,61 @@
 #include <chrono>
 #include <cmath>
 #include <cstdio>
-#include <map>
+#include <optional>
 #include <random>
-#include <thread>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "client_states.hpp"
 #include "entity.h"
+#include "entity_registry.hpp"
+#include "interest_management.hpp"
+#include "packet_capture.hpp"
+#include "parallel_for.hpp"
 #include "protocol.h"
 #include "server_connection_hub.hpp"
 #include "socketwire_example_utils.hpp"
+#include "tick_scheduler.hpp"
 
+// |entities| and |controllers| are parallel to entity_ids.Ids().
+static socketwire_examples::EntityRegistry<std::uint16_t> entity_ids(
+  kInvalidEntity);
 static std::vector<Entity> entities;
-static std::map<std::uint16_t,
-                socketwire_examples::ServerConnectionHub::Client*>
-  controlled_map;
+static std::vector<socketwire_examples::ServerConnectionHub::Client*>
+  controllers;
+
+// What one client can see. Entities respawn instead of being removed, so
+// indices into |entities| double as interest ids.
+struct ClientView {
+  std::size_t entityIndex = 0;
+  socketwire_examples::InterestSet interest;
+  WorldSnapshotEncoder snapshots;
+  socketwire_examples::DeltaBaseline ack;
+};
+
+// Covers the 800x600 client window around the player plus the largest
+// entity radius.
+static constexpr socketwire_examples::InterestConfig kInterestConfig{
+  .viewRadius = 600.f,
+  .leaveMargin = 50.f,
+  .maxEntities = kSnapshotEntitiesPerPacket,
+};
+
+// Entity indices bucketed by position, rebuilt before collisions and before
+// snapshots. Entities respawned since the last rebuild are listed separately
+// because respawns happen while the collision pass walks the grid.
+static socketwire_examples::SpatialGrid entity_grid(100.f);
+static std::vector<std::size_t> respawned_since_rebuild;
+static std::uint32_t snapshot_sequence = 0;
+static socketwire_examples::ClientStates<ClientView> client_views;
+// Gameplay events of recent ticks, sent to every client with its snapshots
+// until it confirms them.
+static GameEventLog game_events;
+// The clock and, once the game ends, its kGameOver event; resyncs restate
+// them with every score.
+constexpr int kGameDuration = 60;
+static int game_time_remaining = kGameDuration;
+static std::optional<GameEvent> game_result;
 
 constexpr float kMinEntitySize = 5.f;
 constexpr float kMaxEntitySize = 100.f;
@@ -25,6 +65,29 @@ constexpr float kEatCooldownSeconds = 0.25f;
 constexpr float kRespawnEatCooldownSeconds = 0.75f;
 constexpr float kMinEatSizeDelta = 1.f;
 constexpr int kFreeSpawnAttempts = 32;
+// A client this many events behind gets a resync instead of growing the log
+// without bound.
+constexpr std::uint32_t kMaxLoggedEvents = 4096;
+
+// Network poll cadence between kTickInterval steps; the game clock counts
+// steps.
+static constexpr std::chrono::milliseconds kPollInterval{1};
+static constexpr auto kTicksPerSecond =
+  static_cast<std::uint32_t>(std::chrono::seconds{1} / kTickInterval);
+// Entities per movement and collision-search chunk and clients per
+// interest/encode chunk; smaller worlds stay on the network thread.
+constexpr std::size_t kMinEntitiesPerChunk = 256;
+constexpr std::size_t kMinViewsPerChunk = 8;
+
+// A pair that may eat this tick, found from the state before any eating.
+struct EatCandidate {
+  std::uint32_t first = 0;
+  std::uint32_t second = 0;
+};
+
+// Per-chunk results of the parallel phases, read back in chunk order.
+static std::vector<std::vector<EatCandidate>> eat_candidates;
+static std::vector<std::vector<std::size_t>> ai_arrivals;
 
 struct SpawnPoint {
   float x = 0.f;
@@ -54,17 +117,39 @@ static float RandomRespawnSize() {
   return kMinEntitySize + static_cast<float>(RandomInt(0, 4));
 }
 
+static void RebuildEntityGrid() {
+  respawned_since_rebuild.clear();
+  entity_grid.Clear();
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    entity_grid.Insert(static_cast<std::uint32_t>(i), entities[i].x,
+                       entities[i].y);
+  }
+}
+
+// Respawned entities also keep their old grid entry until the next rebuild,
+// which only makes this check more conservative.
 static bool OverlapsExistingEntity(float x, float y, float size,
                                    const Entity* ignored = nullptr) {
-  for (const Entity& entity : entities) {
-    if (&entity == ignored || entity.size <= 0.f) continue;
+  const auto overlaps_entity = [&](const Entity& entity, float distance_sq) {
+    if (&entity == ignored || entity.size <= 0.f) return false;
+    const float min_distance = size + entity.size + kSpawnPadding;
+    return distance_sq < min_distance * min_distance;
+  };
 
+  for (const std::size_t index : respawned_since_rebuild) {
+    const Entity& entity = entities[index];
     const float dx = x - entity.x;
     const float dy = y - entity.y;
-    const float min_distance = size + entity.size + kSpawnPadding;
-    if (dx * dx + dy * dy < min_distance * min_distance) return true;
+    if (overlaps_entity(entity, dx * dx + dy * dy)) return true;
   }
-  return false;
+  bool overlaps = false;
+  entity_grid.ForEachInRadius(
+    x, y, size + kMaxEntitySize + kSpawnPadding,
+    [&](const socketwire_examples::SpatialGrid::Entry& entry,
+        float distance_sq) {
+      overlaps = overlaps || overlaps_entity(entities[entry.id], distance_sq);
+    });
+  return overlaps;
 }
 
 static SpawnPoint RandomFreeSpawn(float size, const Entity* ignored = nullptr) {
@@ -91,10 +176,14 @@ static void RespawnEntity(Entity& entity) {
   entity.y = spawn.y;
   entity.eatCooldownSeconds = kRespawnEatCooldownSeconds;
   if (entity.serverControlled) PickAiTarget(entity);
+  respawned_since_rebuild.push_back(*entity_ids.IndexOf(entity.eid));
 }
 
-static std::uint16_t CreateRandomEntity() {
-  const auto new_eid = static_cast<std::uint16_t>(entities.size());
+// Returns the new entity's index, or nullopt when every eid is taken.
+static std::optional<std::size_t> CreateRandomEntity(
+  socketwire_examples::ServerConnectionHub::Client* controller) {
+  const std::optional<std::uint16_t> new_eid = entity_ids.Create();
+  if (!new_eid) return std::nullopt;
   const std::uint32_t color =
     0xff000000u + 0x00440000u * static_cast<std::uint32_t>(RandomInt(1, 4)) +
     0x00004400u * static_cast<std::uint32_t>(RandomInt(1, 4)) +
@@ -102,8 +191,8 @@ static std::uint16_t CreateRandomEntity() {
 
   Entity ent;
   ent.color = color;
-  ent.eid = new_eid;
-  ent.serverControlled = false;
+  ent.eid = *new_eid;
+  ent.serverControlled = controller == nullptr;
   ent.size = RandomInitialSize();
   const SpawnPoint spawn = RandomFreeSpawn(ent.size);
   ent.x = spawn.x;
@@ -112,8 +201,11 @@ static std::uint16_t CreateRandomEntity() {
   ent.score = 0;
   ent.eatCooldownSeconds = kRespawnEatCooldownSeconds;
 
+  const std::size_t index = entities.size();
   entities.push_back(ent);
-  return new_eid;
+  controllers.push_back(controller);
+  entity_grid.Insert(static_cast<std::uint32_t>(index), ent.x, ent.y);
+  return index;
 }
 
 static void BroadcastNewEntity(socketwire_examples::ServerConnectionHub& hub,
@@ -126,52 +218,267 @@ static void BroadcastNewEntity(socketwire_examples::ServerConnectionHub& hub,
   }
 }
 
+// Everything the event log has told clients, as events: every score, the
+// clock and the result if the game is over.
+static const std::vector<GameEvent>& CurrentGameState() {
+  static std::vector<GameEvent> state;
+  state.clear();
+  for (const Entity& e : entities) {
+    GameEvent& score = state.emplace_back();
+    score.type = GameEventType::kScore;
+    score.eid = e.eid;
+    score.value = e.score;
+  }
+  GameEvent& time_left = state.emplace_back();
+  time_left.type = GameEventType::kGameTime;
+  time_left.value = game_time_remaining;
+  if (game_result) state.push_back(*game_result);
+  return state;
+}
+
+static void Resync(socketwire_examples::ServerConnectionHub::Client& client,
+                   ClientView& view) {
+  view.snapshots.SkipEventsBefore(game_events.NextSequence());
+  SendResync(client.connection.get(), game_events.NextSequence(),
+             CurrentGameState());
+}
+
+// A client that joins again keeps its entity; a second one would be orphaned.
 static void OnJoin(socketwire_examples::ServerConnectionHub& hub,
                    socketwire_examples::ServerConnectionHub::Client& client) {
+  if (const ClientView* view = client_views.Find(client)) {
+    SendSetControlledEntity(client.connection.get(),
+                            entities[view->entityIndex].eid);
+    return;
+  }
+
   for (const Entity& ent : entities) {
     SendNewEntity(client.connection.get(), ent);
   }
 
-  const std::uint16_t new_eid = CreateRandomEntity();
-  const Entity& ent = entities[new_eid];
-  controlled_map[new_eid] = &client;
+  const std::optional<std::size_t> index = CreateRandomEntity(&client);
+  if (!index) return;
+  const Entity& ent = entities[*index];
+  ClientView& view = client_views.Emplace(client);
+  view.entityIndex = *index;
 
   BroadcastNewEntity(hub, ent);
-  SendSetControlledEntity(client.connection.get(), new_eid);
+  SendSetControlledEntity(client.connection.get(), ent.eid);
+  // Starts the client's event stream at the next event.
+  Resync(client, view);
 }
 
-static void OnState(const void* data, std::size_t size) {
+// Clients may only move the entity they control; updates for anyone else's,
+// or for an AI entity, are dropped.
+static void OnState(socketwire_examples::ServerConnectionHub::Client& client,
+                    const void* data, std::size_t size) {
   std::uint16_t eid = kInvalidEntity;
   float x = 0.f;
   float y = 0.f;
   DeserializeEntityState(data, size, eid, x, y);
 
-  for (Entity& e : entities) {
-    if (e.eid == eid) {
-      e.x = x;
-      e.y = y;
-      return;
-    }
+  const std::optional<std::size_t> index = entity_ids.IndexOf(eid);
+  if (!index || controllers[*index] != &client) return;
+  entities[*index].x = x;
+  entities[*index].y = y;
+}
+
+static void OnSnapshotAck(
+  socketwire_examples::ServerConnectionHub::Client& client, const void* data,
+  std::size_t size) {
+  std::uint32_t sequence = 0;
+  std::optional<std::uint32_t> next_event;
+  DeserializeSnapshotAck(data, size, sequence, next_event);
+  // Acks for ticks not sent yet would pin a baseline the client never saw.
+  if (static_cast<std::int32_t>(snapshot_sequence - sequence) < 0) return;
+
+  ClientView* view = client_views.Find(client);
+  if (view == nullptr) return;
+  view->ack.Acknowledge(sequence);
+  view->snapshots.ConfirmSnapshot(sequence, next_event);
+}
+
+// Drops the events every client has confirmed.
+static void TrimGameEvents() {
+  std::uint32_t oldest = game_events.NextSequence();
+  for (const auto& entry : client_views.Entries()) {
+    const std::uint32_t confirmed = entry->state.snapshots.EventsConfirmed();
+    if (static_cast<std::int32_t>(confirmed - oldest) < 0) oldest = confirmed;
   }
+  if (game_events.NextSequence() - oldest > kMaxLoggedEvents) {
+    oldest = game_events.NextSequence() - kMaxLoggedEvents;
+  }
+  game_events.TrimBefore(oldest);
 }
 
-static void SendToAll(socketwire_examples::ServerConnectionHub& hub,
-                      void (*send_fn)(socketwire::ReliableConnection*, int),
-                      int value) {
+// Each joined client gets the entities around its own, nearest first, as a
+// delta against its newest ack, together with the gameplay events it has not
+// confirmed. New entities still go to everyone, and events cover the whole
+// world, because the client leaderboard lists all of it.
+static void BroadcastSnapshots(socketwire_examples::ServerConnectionHub& hub,
+                               socketwire_examples::ParallelFor& parallel) {
+  ++snapshot_sequence;
+  // Respawns in the collision pass moved entities off their grid entries.
+  RebuildEntityGrid();
+
+  struct ActiveView {
+    socketwire_examples::ServerConnectionHub::Client* client = nullptr;
+    ClientView* view = nullptr;
+  };
+  static std::vector<ActiveView> active;
+  active.clear();
   for (auto* client : hub.Clients()) {
-    if (client != nullptr && client->connection != nullptr &&
-        client->connection->IsConnected()) {
-      send_fn(client->connection.get(), value);
+    if (client == nullptr || client->connection == nullptr ||
+        !client->connection->IsConnected()) {
+      continue;
     }
+    if (ClientView* view = client_views.Find(*client)) {
+      active.push_back({client, view});
+    }
+  }
+
+  // Interest and encoding touch only the client's own view; sends stay here.
+  parallel.Run(active.size(), kMinViewsPerChunk,
+               [](std::size_t, std::size_t begin, std::size_t end) {
+                 for (std::size_t i = begin; i < end; ++i) {
+                   ClientView& view = *active[i].view;
+                   const Entity& own = entities[view.entityIndex];
+                   view.interest.Update(entity_grid, own.x, own.y,
+                                        kInterestConfig);
+                   view.snapshots.Build(entities, view.interest.Visible(),
+                                        snapshot_sequence);
+                 }
+               });
+  for (const ActiveView& entry : active) {
+    if (entry.view->snapshots.EventsLost(game_events)) {
+      Resync(*entry.client, *entry.view);
+    }
+    entry.view->snapshots.SendTo(entry.client->connection.get(),
+                                 entry.view->ack, game_events);
   }
+  TrimGameEvents();
 }
 
-static void BroadcastScoreUpdate(socketwire_examples::ServerConnectionHub& hub,
-                                 std::uint16_t eid, int score) {
-  for (auto* client : hub.Clients()) {
-    if (client != nullptr && client->connection != nullptr &&
-        client->connection->IsConnected()) {
-      SendScoreUpdate(client->connection.get(), eid, score);
+// Counts down cooldowns and walks AI entities toward their targets. A new
+// target draws from the shared generator, so arrivals are collected per chunk
+// and retargeted afterwards in index order, the same draws as a serial loop.
+static void MoveEntities(socketwire_examples::ParallelFor& parallel,
+                         float dt) {
+  ai_arrivals.resize(parallel.MaxChunks());
+  const std::size_t chunks = parallel.Run(
+    entities.size(), kMinEntitiesPerChunk,
+    [dt](std::size_t chunk, std::size_t begin, std::size_t end) {
+      std::vector<std::size_t>& arrived = ai_arrivals[chunk];
+      arrived.clear();
+      for (std::size_t i = begin; i < end; ++i) {
+        Entity& e = entities[i];
+        e.eatCooldownSeconds = std::max(0.f, e.eatCooldownSeconds - dt);
+        if (!e.serverControlled) continue;
+
+        const float diff_x = e.targetX - e.x;
+        const float diff_y = e.targetY - e.y;
+        const float distance = std::sqrt(diff_x * diff_x + diff_y * diff_y);
+        constexpr float speed = 50.f;
+        if (distance <= 10.f) {
+          arrived.push_back(i);
+        } else if (distance > 0.001f) {
+          const float step = std::min(speed * dt, distance);
+          e.x += (diff_x / distance) * step;
+          e.y += (diff_y / distance) * step;
+        }
+      }
+    });
+
+  for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+    for (const std::size_t index : ai_arrivals[chunk]) {
+      PickAiTarget(entities[index]);
+    }
+  }
+}
+
+static bool CanEatOrBeEaten(const Entity& e) {
+  return e.size > 0.f && e.size <= 1000.f && e.eatCooldownSeconds <= 0.f;
+}
+
+static bool IsEatablePair(const Entity& e1, const Entity& e2,
+                          float distance_sq) {
+  if (!CanEatOrBeEaten(e1) || !CanEatOrBeEaten(e2)) return false;
+  if (std::fabs(e1.size - e2.size) < kMinEatSizeDelta) return false;
+
+  const float reach = e1.size + e2.size;
+  if (distance_sq >= reach * reach || distance_sq <= 0.01f) return false;
+
+  const float size_gain = std::min(e1.size, e2.size) / 2.f;
+  return size_gain > 0.f && size_gain < 50.f;
+}
+
+// Every overlapping pair is checked each tick through the grid, so the cost
+// follows local density. Eating puts both entities on cooldown, which also
+// keeps a respawned entity from matching its old grid entry.
+//
+// The grid search runs in parallel on the state before any eating. Entities
+// that eat or are eaten go on cooldown, so an entity changed by an earlier
+// pair never passes the cooldown re-check below: resolving the candidates in
+// index order gives exactly what a serial pass over the grid would.
+static void ResolveCollisions(socketwire_examples::ParallelFor& parallel) {
+  RebuildEntityGrid();
+  eat_candidates.resize(parallel.MaxChunks());
+  const std::size_t chunks = parallel.Run(
+    entities.size(), kMinEntitiesPerChunk,
+    [](std::size_t chunk, std::size_t begin, std::size_t end) {
+      std::vector<EatCandidate>& found = eat_candidates[chunk];
+      found.clear();
+      for (std::size_t i = begin; i < end; ++i) {
+        const Entity& e1 = entities[i];
+        if (!CanEatOrBeEaten(e1)) continue;
+        entity_grid.ForEachInRadius(
+          e1.x, e1.y, e1.size + kMaxEntitySize,
+          [&](const socketwire_examples::SpatialGrid::Entry& entry,
+              float distance_sq) {
+            // Lower indices find this pair from their side.
+            if (entry.id <= i) return;
+            if (!IsEatablePair(e1, entities[entry.id], distance_sq)) return;
+            found.push_back({static_cast<std::uint32_t>(i), entry.id});
+          });
+      }
+    });
+
+  for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+    for (const EatCandidate& candidate : eat_candidates[chunk]) {
+      Entity& e1 = entities[candidate.first];
+      Entity& e2 = entities[candidate.second];
+      if (e1.eatCooldownSeconds > 0.f || e2.eatCooldownSeconds > 0.f) {
+        continue;
+      }
+
+      Entity* devourer = e1.size > e2.size ? &e1 : &e2;
+      Entity* devoured = e1.size > e2.size ? &e2 : &e1;
+      const float size_gain = devoured->size / 2.f;
+
+      devourer->size = std::min(devourer->size + size_gain, kMaxEntitySize);
+      devourer->eatCooldownSeconds = kEatCooldownSeconds;
+
+      RespawnEntity(*devoured);
+      devoured->score = 0;
+
+      devourer->score += static_cast<int>(size_gain);
+
+      GameEvent& devourer_score = game_events.Append();
+      devourer_score.type = GameEventType::kScore;
+      devourer_score.eid = devourer->eid;
+      devourer_score.value = devourer->score;
+      GameEvent& devoured_score = game_events.Append();
+      devoured_score.type = GameEventType::kScore;
+      devoured_score.eid = devoured->eid;
+      devoured_score.value = devoured->score;
+      GameEvent& devoured_event = game_events.Append();
+      devoured_event.type = GameEventType::kDevoured;
+      devoured_event.eid = devoured->eid;
+      devoured_event.otherEid = devourer->eid;
+      devoured_event.size = devoured->size;
+      devoured_event.otherSize = devourer->size;
+      devoured_event.x = devoured->x;
+      devoured_event.y = devoured->y;
     }
   }
 }
@@ -182,6 +489,11 @@ int main(int argc, const char** argv) {
   socketwire_examples::benchmark::MetricsCollector metrics(
     bench_options, "entity-eater", "socketwire", "server");
   socketwire_examples::benchmark::SetActiveCollector(&metrics);
+  metrics.SetDefaultTickBudgetMs(
+    std::chrono::duration<double, std::milli>(kTickInterval).count());
+  socketwire_examples::ParallelFor parallel(
+    socketwire_examples::ParallelFor::ResolveWorkers(
+      bench_options.simWorkers));
 
   const std::uint16_t listen_port =
     bench_options.enabled
@@ -189,25 +501,26 @@ int main(int argc, const char** argv) {
       : socketwire_examples::PortFromArgsOrEnv(
           argc, argv, 1, "SOCKETWIRE_ENTITY_EATER_PORT", 10131);
 
-  auto socket = socketwire_examples::CreateUdpSocket(listen_port);
-  if (socket == nullptr) return 1;
+  const auto server_socket = socketwire_examples::CreateServerSocket(
+    listen_port, bench_options.replayPath, bench_options.replaySpeed);
+  if (server_socket.socket == nullptr) return 1;
 
   socketwire::ReliableConnectionConfig cfg;
   cfg.numChannels = 2;
-  socketwire_examples::ServerConnectionHub hub(socket.get(), cfg);
+  socketwire_examples::ServerConnectionHub hub(server_socket.socket.get(), cfg);
+  socketwire_examples::PacketCaptureWriter capture(bench_options.capturePath);
+  hub.SetCaptureWriter(&capture);
 
   bool created_ai_entities = false;
   constexpr int num_ai = 10;
 
-  constexpr int game_duration = 60;
-  int game_time_remaining = game_duration;
-  auto last_time_update = std::chrono::steady_clock::now();
-  bool game_over = false;
+  std::uint32_t game_clock_ticks = 0;
 
   hub.SetDisconnectedCallback([](auto& client) {
-    for (auto& entry : controlled_map) {
-      if (entry.second == &client) entry.second = nullptr;
+    for (auto*& controller : controllers) {
+      if (controller == &client) controller = nullptr;
     }
+    client_views.Erase(client);
   });
 
   hub.SetPacketCallback(
@@ -216,63 +529,60 @@ int main(int argc, const char** argv) {
       switch (GetPacketType(data, size)) {
         case MessageType::kEClientToServerJoin: {
           if (!created_ai_entities) {
-            for (int i = 0; i < num_ai; ++i) {
-              const std::uint16_t eid = CreateRandomEntity();
-              entities[eid].serverControlled = true;
-              entities[eid].score = 0;
-              controlled_map[eid] = nullptr;
-            }
+            for (int i = 0; i < num_ai; ++i) CreateRandomEntity(nullptr);
             created_ai_entities = true;
           }
           OnJoin(hub, client);
           break;
         }
         case MessageType::kEClientToServerState:
-          OnState(data, size);
+          OnState(client, data, size);
+          break;
+        case MessageType::kEClientToServerSnapshotAck:
+          OnSnapshotAck(client, data, size);
           break;
         case MessageType::kEServerToClientNewEntity:
         case MessageType::kEServerToClientSetControlledEntity:
         case MessageType::kEServerToClientSnapshot:
-        case MessageType::kEServerToClientEntityDevoured:
-        case MessageType::kEServerToClientScoreUpdate:
-        case MessageType::kEServerToClientGameTime:
-        case MessageType::kEServerToClientGameOver:
+        case MessageType::kEServerToClientResync:
+        case MessageType::kEServerToClientEvents:
           break;
       }
     });
 
-  auto last_time = std::chrono::steady_clock::now();
+  socketwire_examples::TickScheduler scheduler(
+    {.simInterval = kTickInterval, .pollInterval = kPollInterval});
   while (true) {
-    if (bench_options.enabled && metrics.Done()) break;
+    if ((bench_options.enabled && metrics.Done()) ||
+        server_socket.ReplayFinished()) {
+      break;
+    }
+    const std::uint32_t steps = scheduler.WaitNext();
+    if (steps == 0) {
+      hub.Poll();
+      hub.Update();
+      continue;
+    }
+    metrics.RecordTickPacing(scheduler.LastLateness(), steps,
+                             scheduler.LastDropped());
     const auto frame_start = std::chrono::steady_clock::now();
-    const auto cur_time = std::chrono::steady_clock::now();
-    const float dt =
-      static_cast<float>(std::chrono::duration_cast<std::chrono::milliseconds>(
-                           cur_time - last_time)
-                           .count()) *
-      0.001f;
-    last_time = cur_time;
-
-    const auto update_start = std::chrono::steady_clock::now();
+    const auto update_start = frame_start;
+    metrics.BeginTick();
     hub.Poll();
     hub.Update();
+    metrics.MarkTickPhase(socketwire_examples::benchmark::TickPhase::kPoll);
 
-    for (Entity& e : entities) {
-      e.eatCooldownSeconds = std::max(0.f, e.eatCooldownSeconds - dt);
-    }
-
-    if (!game_over && created_ai_entities) {
-      const auto time_since_update =
-        std::chrono::duration_cast<std::chrono::milliseconds>(cur_time -
-                                                              last_time_update)
-          .count();
-      if (time_since_update >= 1000) {
+    for (std::uint32_t step = 0; step < steps; ++step) {
+      // The game clock counts steps, so a game second is always
+      // kTicksPerSecond of them however the loop was paced.
+      if (!game_result && created_ai_entities &&
+          ++game_clock_ticks % kTicksPerSecond == 0) {
         --game_time_remaining;
-        last_time_update = cur_time;
-        SendToAll(hub, SendGameTime, game_time_remaining);
+        GameEvent& time_event = game_events.Append();
+        time_event.type = GameEventType::kGameTime;
+        time_event.value = game_time_remaining;
 
         if (game_time_remaining <= 0) {
-          game_over = true;
           std::uint16_t winner_eid = kInvalidEntity;
           int highest_score = -1;
 
@@ -283,98 +593,24 @@ int main(int argc, const char** argv) {
             }
           }
 
-          for (auto* client : hub.Clients()) {
-            if (client != nullptr && client->connection != nullptr &&
-                client->connection->IsConnected()) {
-              SendGameOver(client->connection.get(), winner_eid, highest_score);
-            }
-          }
+          game_result.emplace();
+          game_result->type = GameEventType::kGameOver;
+          game_result->eid = winner_eid;
+          game_result->value = highest_score;
+          game_events.Append() = *game_result;
         }
       }
-    }
 
-    for (Entity& e : entities) {
-      if (e.serverControlled) {
-        const float diff_x = e.targetX - e.x;
-        const float diff_y = e.targetY - e.y;
-        const float distance = std::sqrt(diff_x * diff_x + diff_y * diff_y);
-        constexpr float speed = 50.f;
-        if (distance <= 10.f) {
-          PickAiTarget(e);
-        } else if (distance > 0.001f) {
-          const float step = std::min(speed * dt, distance);
-          e.x += (diff_x / distance) * step;
-          e.y += (diff_y / distance) * step;
-        }
-      }
+      MoveEntities(parallel, scheduler.StepSeconds());
+      ResolveCollisions(parallel);
     }
 
-    bool collision_occurred = false;
-    for (std::size_t i = 0; i < entities.size() && !collision_occurred; ++i) {
-      for (std::size_t j = 0; j < entities.size(); ++j) {
-        if (i == j) continue;
-
-        Entity& e1 = entities[i];
-        Entity& e2 = entities[j];
-        if (e1.size <= 0.f || e2.size <= 0.f || e1.size > 1000.f ||
-            e2.size > 1000.f) {
-          continue;
-        }
-        if (e1.eatCooldownSeconds > 0.f || e2.eatCooldownSeconds > 0.f) {
-          continue;
-        }
-        if (std::fabs(e1.size - e2.size) < kMinEatSizeDelta) {
-          continue;
-        }
-
-        const float dx = e1.x - e2.x;
-        const float dy = e1.y - e2.y;
-        const float distance = std::sqrt(dx * dx + dy * dy);
-
-        if (distance < (e1.size + e2.size) && distance > 0.1f) {
-          Entity* devourer = e1.size > e2.size ? &e1 : &e2;
-          Entity* devoured = e1.size > e2.size ? &e2 : &e1;
-          const float size_gain = devoured->size / 2.f;
-
-          if (size_gain > 0.f && size_gain < 50.f) {
-            devourer->size =
-              std::min(devourer->size + size_gain, kMaxEntitySize);
-            devourer->eatCooldownSeconds = kEatCooldownSeconds;
-
-            RespawnEntity(*devoured);
-            devoured->score = 0;
-
-            devourer->score += static_cast<int>(size_gain);
-
-            BroadcastScoreUpdate(hub, devourer->eid, devourer->score);
-            BroadcastScoreUpdate(hub, devoured->eid, devoured->score);
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kSimulate);
 
-            for (auto* client : hub.Clients()) {
-              if (client == nullptr || client->connection == nullptr ||
-                  !client->connection->IsConnected()) {
-                continue;
-              }
-              SendEntityDevoured(client->connection.get(), devoured->eid,
-                                 devourer->eid, devourer->size, devoured->size,
-                                 devoured->x, devoured->y);
-            }
-
-            collision_occurred = true;
-          }
-          break;
-        }
-      }
-    }
-
-    for (const Entity& e : entities) {
-      for (auto* client : hub.Clients()) {
-        if (client == nullptr || client->connection == nullptr ||
-            !client->connection->IsConnected()) {
-          continue;
-        }
-        SendSnapshot(client->connection.get(), e.eid, e.x, e.y, e.size);
-      }
-    }
+    BroadcastSnapshots(hub, parallel);
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kBroadcast);
     const auto update_end = std::chrono::steady_clock::now();
 
     if (bench_options.enabled) {
@@ -396,10 +632,14 @@ int main(int argc, const char** argv) {
         1000.0);
       metrics.MaybeWriteSample();
     }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    metrics.EndTick();
   }
 
+  if (server_socket.replay != nullptr) {
+    metrics.SetReplayStats(server_socket.replay->ReplayedPackets(),
+                           server_socket.replay->DroppedSendBytes());
+    server_socket.PrintReplaySummary();
+  }
   metrics.Finish();
   socketwire_examples::benchmark::SetActiveCollector(nullptr);
 }
@@ -0,0 +1,308 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "bot_driver.hpp"
+#include "protocol.hpp"
+#include "reliable_connection.hpp"
+#include "socketwire_example_utils.hpp"
+
+static constexpr std::uint16_t kDefaultLobbyPort = 10887;
+static constexpr std::uint16_t kDefaultGamePort = 10888;
+
+static bool IsLocalHost(std::string_view host) {
+  return host == "localhost" || host == "127.0.0.1" || host == "::1";
+}
+
+static void Send(socketwire::ReliableConnection& connection,
+                 const socketwire::BitStream& packet, bool reliable = false) {
+  const bool sent = reliable ? connection.SendReliable(0, packet)
+                             : connection.SendUnsequenced(0, packet);
+  if (sent) {
+    socketwire_examples::benchmark::RecordPayloadTx(packet.GetSizeBytes());
+  }
+}
+
+// Plays one lobby-dots client: joins the lobby, asks it for a game server,
+// follows the game-server redirect and then streams its position every 50 ms.
+class DotBot final {
+ public:
+  DotBot(std::string lobby_host,
+         socketwire_examples::ResolvedEndpoint lobby_endpoint,
+         std::uint16_t lobby_port, std::uint32_t seed)
+      : lobbyHost_(std::move(lobby_host)),
+        lobbyEndpoint_(std::move(lobby_endpoint)),
+        lobbyPort_(lobby_port),
+        seed_(seed),
+        lobbyHandler_(*this, Target::kLobby),
+        gameHandler_(*this, Target::kGame) {
+    posX_ = 100.f + static_cast<float>(seed % 400u);
+    posY_ = 100.f + static_cast<float>((seed / 400u) % 400u);
+  }
+
+  bool Start() {
+    lobbySocket_ = socketwire_examples::CreateUdpSocket(0);
+    if (lobbySocket_ == nullptr) return false;
+
+    lobbyConnection_ =
+      std::make_unique<socketwire::ReliableConnection>(lobbySocket_.get(),
+                                                       Config());
+    lobbyConnection_->SetHandler(&lobbyHandler_);
+    (void)socketwire_examples::ConnectNextAddress(*lobbyConnection_,
+                                                  lobbyEndpoint_, lobbyPort_);
+    nextLobbyConnectAttempt_ =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
+    return true;
+  }
+
+  void Step(std::uint64_t frame) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!connectedToLobby_ && now >= nextLobbyConnectAttempt_) {
+      (void)socketwire_examples::ConnectNextAddress(*lobbyConnection_,
+                                                    lobbyEndpoint_, lobbyPort_);
+      nextLobbyConnectAttempt_ = now + std::chrono::milliseconds(250);
+    }
+    if (gameConnection_ != nullptr && !connectedToGame_ &&
+        now >= nextGameConnectAttempt_) {
+      (void)socketwire_examples::ConnectNextAddress(*gameConnection_,
+                                                    *gameEndpoint_, gamePort_);
+      nextGameConnectAttempt_ = now + std::chrono::milliseconds(250);
+    }
+    lobbyConnection_->Poll();
+    if (gameConnection_ != nullptr) gameConnection_->Poll();
+    lobbyConnection_->Update();
+    if (gameConnection_ != nullptr) gameConnection_->Update();
+
+    if (!pendingGameHost_.empty() && gameConnection_ == nullptr) {
+      OpenGameConnection();
+    }
+
+    if (connectedToLobby_ && !startSent_) {
+      Send(*lobbyConnection_, lobby_dots::MakeStartSession(), true);
+      startSent_ = true;
+    }
+
+    constexpr float dt = 1.f / 60.f;
+    constexpr float accel = 30.f;
+    velX_ +=
+      socketwire_examples::benchmark::DeterministicAxis(seed_, frame, 0) * dt *
+      accel;
+    velY_ +=
+      socketwire_examples::benchmark::DeterministicAxis(seed_, frame, 1) * dt *
+      accel;
+    posX_ += velX_ * dt;
+    posY_ += velY_ * dt;
+    velX_ *= 0.99f;
+    velY_ *= 0.99f;
+
+    if (connectedToGame_ && now - lastPositionSend_ >
+                              std::chrono::milliseconds(50)) {
+      lastPositionSend_ = now;
+      Send(*gameConnection_, lobby_dots::MakePosition(posX_, posY_));
+    }
+  }
+
+  void Collect(socketwire_examples::benchmark::BotSample& sample) const {
+    sample.AddConnection(*lobbyConnection_);
+    if (gameConnection_ != nullptr) sample.AddConnection(*gameConnection_);
+    socketwire_examples::benchmark::GameMetrics game;
+    game.joinSuccessCount = myPlayerId_ >= 0 ? 1 : 0;
+    game.entityCountClient = players_.size();
+    game.nanPositionCount = nanPositionCount_;
+    game.infPositionCount = infPositionCount_;
+    sample.MergeGame(game);
+  }
+
+  void Disconnect() {
+    lobbyConnection_->Disconnect();
+    if (gameConnection_ != nullptr) gameConnection_->Disconnect();
+  }
+
+ private:
+  enum class Target { kLobby, kGame };
+
+  class Handler final : public socketwire::IReliableConnectionHandler {
+   public:
+    Handler(DotBot& bot, Target target) : bot_(bot), target_(target) {}
+
+    void OnConnected() override { bot_.SetConnected(target_, true); }
+    void OnDisconnected() override { bot_.SetConnected(target_, false); }
+
+    void OnReliableReceived(std::uint8_t, const void* data,
+                            std::size_t size) override {
+      bot_.HandlePacket(target_, data, size);
+    }
+
+    void OnUnreliableReceived(std::uint8_t, const void* data,
+                              std::size_t size) override {
+      bot_.HandlePacket(target_, data, size);
+    }
+
+   private:
+    DotBot& bot_;
+    Target target_;
+  };
+
+  static socketwire::ReliableConnectionConfig Config() {
+    socketwire::ReliableConnectionConfig cfg;
+    cfg.numChannels = 2;
+    return cfg;
+  }
+
+  void SetConnected(Target target, bool connected) {
+    if (target == Target::kLobby) {
+      connectedToLobby_ = connected;
+    } else {
+      connectedToGame_ = connected;
+    }
+  }
+
+  void OpenGameConnection() {
+    gameEndpoint_ =
+      socketwire_examples::ResolveEndpoint(pendingGameHost_, gamePort_);
+    pendingGameHost_.clear();
+    if (!gameEndpoint_) return;
+
+    gameSocket_ = socketwire_examples::CreateUdpSocket(0);
+    if (gameSocket_ == nullptr) return;
+    gameConnection_ = std::make_unique<socketwire::ReliableConnection>(
+      gameSocket_.get(), Config());
+    gameConnection_->SetHandler(&gameHandler_);
+    (void)socketwire_examples::ConnectNextAddress(*gameConnection_,
+                                                  *gameEndpoint_, gamePort_);
+    nextGameConnectAttempt_ =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
+  }
+
+  void HandlePacket(Target target, const void* data, std::size_t size) {
+    socketwire_examples::benchmark::RecordPayloadRx(size);
+    socketwire::BitStream stream(static_cast<const std::uint8_t*>(data), size);
+    lobby_dots::MessageType type{};
+    if (!lobby_dots::ReadType(stream, type)) return;
+
+    if (target == Target::kLobby) {
+      std::uint16_t port = 0;
+      if (gameConnection_ == nullptr &&
+          type == lobby_dots::MessageType::kGameServer &&
+          lobby_dots::ReadGameServer(stream, pendingGameHost_, port)) {
+        if (IsLocalHost(pendingGameHost_) && !IsLocalHost(lobbyHost_)) {
+          pendingGameHost_ = lobbyHost_;
+        }
+        gamePort_ = port;
+      }
+      return;
+    }
+
+    switch (type) {
+      case lobby_dots::MessageType::kWelcome: {
+        std::uint16_t id = 0;
+        if (lobby_dots::ReadWelcome(stream, id)) {
+          myPlayerId_ = id;
+          players_.insert(id);
+        }
+        break;
+      }
+      case lobby_dots::MessageType::kPlayers:
+        (void)lobby_dots::ReadPlayers(stream, roster_);
+        players_.clear();
+        for (const auto& entry : roster_) {
+          players_.insert(entry.id);
+          NotePosition(entry.x, entry.y);
+        }
+        break;
+      case lobby_dots::MessageType::kPositions:
+        (void)lobby_dots::ReadPositions(stream, positions_);
+        for (const auto& entry : positions_) {
+          players_.insert(entry.id);
+          NotePosition(entry.x, entry.y);
+        }
+        break;
+      case lobby_dots::MessageType::kStartSession:
+      case lobby_dots::MessageType::kGameServer:
+      case lobby_dots::MessageType::kPosition:
+      case lobby_dots::MessageType::kRegisterServer:
+      case lobby_dots::MessageType::kServerHeartbeat:
+      case lobby_dots::MessageType::kQueued:
+        break;
+    }
+  }
+
+  void NotePosition(float x, float y) {
+    if (std::isnan(x) || std::isnan(y)) ++nanPositionCount_;
+    if (std::isinf(x) || std::isinf(y)) ++infPositionCount_;
+  }
+
+  std::string lobbyHost_;
+  socketwire_examples::ResolvedEndpoint lobbyEndpoint_;
+  std::uint16_t lobbyPort_ = kDefaultLobbyPort;
+  std::uint32_t seed_ = 1;
+  Handler lobbyHandler_;
+  Handler gameHandler_;
+  std::unique_ptr<socketwire::ISocket> lobbySocket_;
+  std::unique_ptr<socketwire::ReliableConnection> lobbyConnection_;
+  std::unique_ptr<socketwire::ISocket> gameSocket_;
+  std::unique_ptr<socketwire::ReliableConnection> gameConnection_;
+  std::optional<socketwire_examples::ResolvedEndpoint> gameEndpoint_;
+  std::string pendingGameHost_;
+  std::uint16_t gamePort_ = kDefaultGamePort;
+  std::chrono::steady_clock::time_point nextLobbyConnectAttempt_{};
+  std::chrono::steady_clock::time_point nextGameConnectAttempt_{};
+  std::chrono::steady_clock::time_point lastPositionSend_{};
+  bool connectedToLobby_ = false;
+  bool connectedToGame_ = false;
+  bool startSent_ = false;
+  int myPlayerId_ = -1;
+  std::unordered_set<int> players_;
+  std::vector<lobby_dots::PlayerEntry> roster_;
+  std::vector<lobby_dots::PositionEntry> positions_;
+  float posX_ = 0.f;
+  float posY_ = 0.f;
+  float velX_ = 0.f;
+  float velY_ = 0.f;
+  std::uint64_t nanPositionCount_ = 0;
+  std::uint64_t infPositionCount_ = 0;
+};
+
+int main(int argc, const char** argv) {
+  auto bench_options = socketwire_examples::benchmark::ParseOptions(
+    argc, argv, 0, kDefaultLobbyPort, kDefaultGamePort);
+  bench_options.enabled = true;
+  socketwire_examples::benchmark::MetricsCollector metrics(
+    bench_options, "lobby-dots", "socketwire", "bots");
+
+  auto lobby_endpoint = socketwire_examples::ResolveEndpoint(
+    bench_options.host, bench_options.lobbyPort);
+  if (!lobby_endpoint) {
+    std::println("cannot resolve host '{}'", bench_options.host);
+    return 1;
+  }
+
+  using Driver = socketwire_examples::benchmark::BotDriver<DotBot>;
+  const int threads = Driver::DefaultThreadCount(bench_options);
+  Driver driver(metrics, threads);
+  const int spawned = driver.Spawn(
+    bench_options.clients, [&](int index) -> std::unique_ptr<DotBot> {
+      auto bot = std::make_unique<DotBot>(
+        bench_options.host, *lobby_endpoint, bench_options.lobbyPort,
+        bench_options.seed + static_cast<std::uint32_t>(index));
+      if (!bot->Start()) return nullptr;
+      return bot;
+    });
+  std::println("lobby-dots bots: {}/{} bots on {} threads against {}:{}",
+               spawned, bench_options.clients, threads, bench_options.host,
+               static_cast<unsigned>(bench_options.lobbyPort));
+  if (spawned == 0) return 1;
+
+  driver.Run();
+  metrics.Finish();
+  return 0;
+}
@@ -1,16 +1,16 @@
 #include <algorithm>
 #include <chrono>
-#include <cstdio>
 #include <memory>
 #include <optional>
 #include <print>
-#include <sstream>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "protocol.hpp"
 #include "raylib.h"
 #include "reliable_connection.hpp"
 #include "socketwire_example_utils.hpp"
@@ -31,6 +31,9 @@ struct ClientState {
   std::string lobbyHost;
   std::string pendingGameHost;
   std::uint16_t pendingGamePort = 0;
+  // Decode scratch, reused across packets.
+  std::vector<lobby_dots::PlayerEntry> roster;
+  std::vector<lobby_dots::PositionEntry> positions;
 };
 
 static Player* FindPlayer(std::vector<Player>& players, int id) {
@@ -90,11 +93,13 @@ static void SendMicroPacket(socketwire::ReliableConnection& connection) {
   SendText(connection, "dv/dt", false);
 }
 
-static void SendPosition(socketwire::ReliableConnection& connection, float x,
-                         float y) {
-  char pos_msg[64]{};
-  std::snprintf(pos_msg, sizeof(pos_msg), "POS %.2f %.2f", x, y);
-  SendText(connection, pos_msg, false);
+static void Send(socketwire::ReliableConnection& connection,
+                 const socketwire::BitStream& packet, bool reliable = false) {
+  const bool sent = reliable ? connection.SendReliable(0, packet)
+                             : connection.SendUnsequenced(0, packet);
+  if (sent) {
+    socketwire_examples::benchmark::RecordPayloadTx(packet.GetSizeBytes());
+  }
 }
 
 static bool IsLocalHost(std::string_view host) {
@@ -146,97 +151,74 @@ class ClientHandler final : public socketwire::IReliableConnectionHandler {
 
   void HandlePacket([[maybe_unused]] std::uint8_t channel, const void* data,
                     std::size_t size) {
-    const std::string text = socketwire_examples::ReadStringPayload(data, size);
-    std::println("Packet received '{}'", text);
+    socketwire::BitStream stream(static_cast<const std::uint8_t*>(data), size);
+    lobby_dots::MessageType type{};
+    if (!lobby_dots::ReadType(stream, type)) return;
 
     if (target_ == ConnectionTarget::kLobby) {
-      if (!state_.connectedToGameServer && text.starts_with("GAMESERVER")) {
-        char server_ip[256]{};
-        int server_port = 0;
-        if (std::sscanf(text.c_str(), "GAMESERVER %255s %d", server_ip,
-                        &server_port) == 2) {
-          state_.pendingGameHost = server_ip;
-          if (IsLocalHost(state_.pendingGameHost) &&
-              !IsLocalHost(state_.lobbyHost)) {
-            state_.pendingGameHost = state_.lobbyHost;
-          }
-          state_.pendingGamePort = static_cast<std::uint16_t>(server_port);
-          state_.gameServerStatus = "Connecting to game server...";
+      std::uint16_t position = 0;
+      if (type == lobby_dots::MessageType::kQueued &&
+          lobby_dots::ReadQueued(stream, position)) {
+        state_.gameServerStatus =
+          "Every game server is full; queued at position " +
+          std::to_string(position);
+        return;
+      }
+      std::string host;
+      std::uint16_t port = 0;
+      if (!state_.connectedToGameServer &&
+          type == lobby_dots::MessageType::kGameServer &&
+          lobby_dots::ReadGameServer(stream, host, port)) {
+        std::println("Game server at {}:{}", host, port);
+        state_.pendingGameHost = std::move(host);
+        if (IsLocalHost(state_.pendingGameHost) &&
+            !IsLocalHost(state_.lobbyHost)) {
+          state_.pendingGameHost = state_.lobbyHost;
         }
+        state_.pendingGamePort = port;
+        state_.gameServerStatus = "Connecting to game server...";
       }
       return;
     }
 
-    if (text.starts_with("WELCOME")) {
-      int id = -1;
-      char name[256]{};
-      if (std::sscanf(text.c_str(), "WELCOME %d %255s", &id, name) >= 1) {
-        state_.myPlayerId = id;
-        state_.gameServerStatus =
-          "Playing as player " + std::to_string(state_.myPlayerId);
-      }
-    } else if (text.starts_with("PLAYERS")) {
-      state_.players.clear();
-      std::istringstream ss(text.substr(8));
-      Player player;
-      std::string token;
-
-      while (std::getline(ss, token, ';')) {
-        std::istringstream player_stream(token);
-        if (player_stream >> player.id >> player.x >> player.y >> player.ping) {
-          state_.players.push_back(player);
+    switch (type) {
+      case lobby_dots::MessageType::kWelcome: {
+        std::uint16_t id = 0;
+        if (lobby_dots::ReadWelcome(stream, id)) {
+          state_.myPlayerId = id;
+          state_.gameServerStatus =
+            "Playing as player " + std::to_string(state_.myPlayerId);
         }
+        break;
       }
-    } else if (text.starts_with("POS")) {
-      int player_id = -1;
-      float x = 0.f;
-      float y = 0.f;
-      if (std::sscanf(text.c_str(), "POS %d %f %f", &player_id, &x, &y) == 3) {
-        if (Player* player = FindPlayer(state_.players, player_id);
-            player != nullptr) {
-          player->x = x;
-          player->y = y;
-        } else if (player_id != state_.myPlayerId) {
-          state_.players.push_back(Player{player_id, x, y, 0});
+      case lobby_dots::MessageType::kPlayers:
+        (void)lobby_dots::ReadPlayers(stream, state_.roster);
+        state_.players.clear();
+        for (const auto& entry : state_.roster) {
+          state_.players.push_back(
+            Player{entry.id, entry.x, entry.y, entry.ping});
         }
-      }
-    } else if (text.starts_with("NEWPLAYER")) {
-      std::istringstream ss(text.substr(10));
-      Player player;
-      if (ss >> player.id) {
-        if (!(ss >> player.x >> player.y >> player.ping)) {
-          player.x = 0.f;
-          player.y = 0.f;
-          player.ping = 0;
-        }
-        UpsertPlayer(state_.players, player);
-      }
-    } else if (text.starts_with("PLAYERLEFT")) {
-      int player_id = -1;
-      if (std::sscanf(text.c_str(), "PLAYERLEFT %d", &player_id) == 1) {
-        std::erase_if(state_.players, [player_id](const Player& player) {
-          return player.id == player_id;
-        });
-      }
-    } else if (text.starts_with("PINGS")) {
-      std::println("Processing ping data: {}", text);
-      std::istringstream ss(text.substr(6));
-      std::string token;
-      while (std::getline(ss, token, ';')) {
-        if (token.empty()) continue;
-
-        int player_id = -1;
-        int ping_value = 0;
-        std::istringstream ping_stream(token);
-        if (ping_stream >> player_id >> ping_value) {
-          if (Player* player = FindPlayer(state_.players, player_id);
+        break;
+      case lobby_dots::MessageType::kPositions:
+        (void)lobby_dots::ReadPositions(stream, state_.positions);
+        for (const auto& entry : state_.positions) {
+          if (entry.id == state_.myPlayerId) continue;
+          if (Player* player = FindPlayer(state_.players, entry.id);
               player != nullptr) {
-            player->ping = ping_value;
-          } else if (player_id != state_.myPlayerId) {
-            state_.players.push_back(Player{player_id, 0.f, 0.f, ping_value});
+            player->x = entry.x;
+            player->y = entry.y;
+          } else {
+            state_.players.push_back(Player{entry.id, entry.x, entry.y, 0});
           }
         }
-      }
+        break;
+      case lobby_dots::MessageType::kStartSession:
+      case lobby_dots::MessageType::kGameServer:
+      case lobby_dots::MessageType::kPosition:
+      case lobby_dots::MessageType::kRegisterServer:
+      case lobby_dots::MessageType::kServerHeartbeat:
+      case lobby_dots::MessageType::kQueued:
+        break;
     }
   }
 };
@@ -376,7 +358,7 @@ int main(int argc, const char** argv) {
           now - last_position_send_time)
             .count() > 50) {
       last_position_send_time = now;
-      SendPosition(*game_connection, posx, posy);
+      Send(*game_connection, lobby_dots::MakePosition(posx, posy));
     }
 
     if (state.connectedToLobby) {
@@ -401,7 +383,7 @@ int main(int argc, const char** argv) {
     if (((bench_options.enabled && !start_sent) ||
          (!bench_options.enabled && IsKeyPressed(KEY_ENTER))) &&
         state.connectedToLobby) {
-      SendText(lobby_connection, "Start!", false);
+      Send(lobby_connection, lobby_dots::MakeStartSession(), true);
       start_sent = true;
     }
 
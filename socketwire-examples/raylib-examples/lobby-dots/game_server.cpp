@@ -2,19 +2,22 @@
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <print>
-#include <sstream>
+#include <span>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "protocol.hpp"
 #include "raylib.h"
+#include "reliable_connection.hpp"
 #include "server_connection_hub.hpp"
 #include "socketwire_example_utils.hpp"
 
 struct Player {
-  int id = -1;
+  std::uint16_t id = 0;
   float x = 0.f;
   float y = 0.f;
   int ping = 0;
@@ -22,65 +25,66 @@ struct Player {
   std::string name;
 };
 
-static int GeneratePlayerId() {
-  static int next_id = 1;
+// Players the lobby places here at most; --capacity overrides it.
+static constexpr std::uint16_t kDefaultCapacity = 256;
+
+static std::uint16_t GeneratePlayerId() {
+  static std::uint16_t next_id = 1;
   return next_id++;
 }
 
-static void SendText(socketwire_examples::ServerConnectionHub::Client& client,
-                     const std::string& text, bool reliable = false) {
-  const std::size_t bytes = text.size() + 1;
-  const bool sent =
-    reliable ? client.connection->SendReliable(0, text.c_str(), bytes)
-             : client.connection->SendUnsequenced(0, text.c_str(), bytes);
-  if (sent) socketwire_examples::benchmark::RecordPayloadTx(bytes);
+static bool Send(socketwire::ReliableConnection& connection,
+                 const socketwire::BitStream& packet, bool reliable = false) {
+  const bool sent = reliable ? connection.SendReliable(0, packet)
+                             : connection.SendUnsequenced(0, packet);
+  if (sent) {
+    socketwire_examples::benchmark::RecordPayloadTx(packet.GetSizeBytes());
+  }
+  return sent;
 }
 
-static void SendPlayerList(
-  const std::vector<Player>& players,
-  socketwire_examples::ServerConnectionHub::Client& target_client) {
-  std::stringstream ss;
-  ss << "PLAYERS ";
-  for (const auto& player : players) {
-    ss << player.id << " " << player.x << " " << player.y << " " << player.ping
-       << ";";
+static void Send(socketwire_examples::ServerConnectionHub::Client& client,
+                 const socketwire::BitStream& packet, bool reliable = false) {
+  (void)Send(*client.connection, packet, reliable);
+}
+
+// This server's link to the lobby, which places players on it.
+class LobbyHandler final : public socketwire::IReliableConnectionHandler {
+ public:
+  void OnConnected() override { connected = true; }
+  void OnDisconnected() override {
+    connected = false;
+    registered = false;
   }
+  void OnReliableReceived(std::uint8_t, const void*, std::size_t) override {}
+  void OnUnreliableReceived(std::uint8_t, const void*, std::size_t) override {}
 
-  SendText(target_client, ss.str());
-}
+  bool connected = false;
+  bool registered = false;
+};
 
+// The roster carries every player's ping, so it doubles as the ping update.
 static void BroadcastPlayerList(const std::vector<Player>& players) {
+  const auto packet =
+    lobby_dots::MakePlayers(std::span<const Player>(players));
   for (const auto& player : players) {
-    if (player.client != nullptr) SendPlayerList(players, *player.client);
+    if (player.client != nullptr) Send(*player.client, packet);
   }
 }
 
+// Every receiver gets the same packets, so each is encoded once; receivers
+// skip their own entry.
 static void BroadcastPositions(const std::vector<Player>& players) {
-  for (const auto& sender : players) {
-    const std::string pos_str = "POS " + std::to_string(sender.id) + " " +
-                                std::to_string(sender.x) + " " +
-                                std::to_string(sender.y);
-
+  const std::span<const Player> all(players);
+  for (std::size_t first = 0; first < all.size();
+       first += lobby_dots::kPositionsPerPacket) {
+    const auto packet = lobby_dots::MakePositions(all.subspan(first));
     for (const auto& receiver : players) {
-      if (receiver.id != sender.id && receiver.client != nullptr) {
-        SendText(*receiver.client, pos_str, false);
-      }
+      if (receiver.client != nullptr) Send(*receiver.client, packet);
     }
   }
 }
 
-static void BroadcastPings(const std::vector<Player>& players) {
-  for (const auto& player : players) {
-    if (player.client == nullptr) continue;
-
-    std::stringstream ss;
-    ss << "PINGS ";
-    for (const auto& p : players) ss << p.id << " " << p.ping << ";";
-
-    SendText(*player.client, ss.str());
-  }
-}
-
 int main(int argc, const char** argv) {
   auto bench_options =
     socketwire_examples::benchmark::ParseOptions(argc, argv, 0, 10887, 10888);
@@ -120,10 +124,8 @@ int main(int argc, const char** argv) {
     new_player.ping = static_cast<int>(client.connection->GetRtt());
     new_player.client = &client;
 
-    const std::string welcome_msg =
-      "WELCOME " + std::to_string(new_player.id) + " " + new_player.name;
     players.push_back(new_player);
-    SendText(client, welcome_msg);
+    Send(client, lobby_dots::MakeWelcome(new_player.id), true);
     BroadcastPlayerList(players);
   });
 
@@ -150,30 +152,75 @@ int main(int argc, const char** argv) {
     if (it == players.end()) return;
 
     it->ping = static_cast<int>(client.connection->GetRtt());
-    const std::string msg = socketwire_examples::ReadStringPayload(data, size);
-
-    if (msg.starts_with("POS")) {
-      std::istringstream ss(msg.substr(4));
-      float x = 0.f;
-      float y = 0.f;
-      if (ss >> x >> y) {
-        it->x = x;
-        it->y = y;
-      }
+    socketwire::BitStream stream(static_cast<const std::uint8_t*>(data), size);
+    lobby_dots::MessageType type{};
+    if (lobby_dots::ReadType(stream, type) &&
+        type == lobby_dots::MessageType::kPosition) {
+      (void)lobby_dots::ReadPosition(stream, it->x, it->y);
     }
   });
 
+  std::uint16_t capacity = kDefaultCapacity;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], "--capacity") == 0) {
+      socketwire_examples::benchmark::ParseUInt16(argv[++i], capacity);
+    }
+  }
+  capacity = std::max<std::uint16_t>(capacity, 1);
+
+  // Register with the lobby at --host and --lobby-port.
+  const std::uint16_t lobby_port =
+    bench_options.enabled ||
+        socketwire_examples::HasCommandLineOption(argc, argv, "--lobby-port")
+      ? bench_options.lobbyPort
+      : socketwire_examples::PortFromArgsOrEnv(
+          argc, argv, 0, "SOCKETWIRE_LOBBY_DOTS_LOBBY_PORT", 10887);
+  auto lobby_endpoint =
+    socketwire_examples::ResolveEndpoint(bench_options.host, lobby_port);
+  if (!lobby_endpoint) {
+    std::println("cannot resolve lobby host '{}'", bench_options.host);
+    return 1;
+  }
+  auto lobby_socket = socketwire_examples::CreateUdpSocket(0);
+  if (lobby_socket == nullptr) return 1;
+  socketwire::ReliableConnection lobby_connection(lobby_socket.get(), cfg);
+  LobbyHandler lobby_handler;
+  lobby_connection.SetHandler(&lobby_handler);
+  (void)socketwire_examples::ConnectNextAddress(lobby_connection,
+                                                *lobby_endpoint, lobby_port);
+  auto next_lobby_connect_attempt =
+    std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
+
   auto last_broadcast_time = std::chrono::steady_clock::now();
   auto last_ping_time = std::chrono::steady_clock::now();
+  auto last_heartbeat_time = last_broadcast_time;
+  // Time spent polling and broadcasting since the last heartbeat.
+  std::chrono::steady_clock::duration busy{};
 
-  std::println("Game server started on port {}",
-               static_cast<unsigned>(listen_port));
+  std::println("Game server started on port {} for {} players, lobby {}:{}",
+               static_cast<unsigned>(listen_port), capacity,
+               bench_options.host, static_cast<unsigned>(lobby_port));
   while (true) {
     if (bench_options.enabled && metrics.Done()) break;
     const auto frame_start = std::chrono::steady_clock::now();
     const auto update_start = frame_start;
+    if (!lobby_handler.connected &&
+        update_start >= next_lobby_connect_attempt) {
+      (void)socketwire_examples::ConnectNextAddress(
+        lobby_connection, *lobby_endpoint, lobby_port);
+      next_lobby_connect_attempt =
+        update_start + std::chrono::milliseconds(250);
+    }
     hub.Poll();
+    lobby_connection.Poll();
     hub.Update();
+    lobby_connection.Update();
+
+    if (lobby_handler.connected && !lobby_handler.registered) {
+      lobby_handler.registered = Send(
+        lobby_connection, lobby_dots::MakeRegisterServer(listen_port, capacity),
+        true);
+    }
 
     const auto current_time = std::chrono::steady_clock::now();
     if (std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -187,12 +234,23 @@ int main(int argc, const char** argv) {
                                                               last_ping_time)
           .count() > 500) {
       last_ping_time = current_time;
-      if (!players.empty()) {
-        BroadcastPlayerList(players);
-        BroadcastPings(players);
+      if (!players.empty()) BroadcastPlayerList(players);
+    }
+
+    if (current_time - last_heartbeat_time >= lobby_dots::kHeartbeatInterval) {
+      const auto window = current_time - last_heartbeat_time;
+      last_heartbeat_time = current_time;
+      if (lobby_handler.registered) {
+        Send(lobby_connection,
+             lobby_dots::MakeServerHeartbeat(
+               static_cast<std::uint16_t>(players.size()),
+               std::chrono::duration<double>(busy) /
+                 std::chrono::duration<double>(window)));
       }
+      busy = {};
     }
     const auto update_end = std::chrono::steady_clock::now();
+    busy += update_end - update_start;
 
     if (bench_options.enabled) {
       const auto clients = hub.Clients();
@@ -217,6 +275,7 @@ int main(int argc, const char** argv) {
     std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
 
+  lobby_connection.Disconnect();
   metrics.Finish();
   socketwire_examples::benchmark::SetActiveCollector(nullptr);
 }
@@ -1,26 +1,126 @@
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <format>
 #include <print>
 #include <string>
 #include <thread>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "protocol.hpp"
 #include "server_connection_hub.hpp"
 #include "socketwire_example_utils.hpp"
 
-struct GameServerInfo {
-  int port = 10888;
-  std::string host = "127.0.0.1";
-  bool sessionStarted = false;
+using Client = socketwire_examples::ServerConnectionHub::Client;
+
+// A lobby-dots-game-server that registered over its own lobby connection.
+struct GameServerEntry {
+  Client* link = nullptr;
+  std::string host;
+  std::uint16_t port = 0;
+  std::uint16_t capacity = 0;
+  std::uint16_t players = 0;
+  double tickLoad = 0.0;
+  std::chrono::steady_clock::time_point lastHeartbeat{};
+  // Players sent here recently, who count against the capacity until a
+  // heartbeat's player count rises to include them or kPlacementGrace ends.
+  std::vector<std::chrono::steady_clock::time_point> placements;
+};
+
+// A client waiting for a game server slot, and the queue position it was
+// last told.
+struct QueuedClient {
+  Client* client = nullptr;
+  std::uint16_t reportedPosition = 0;
 };
 
-static void SendText(socketwire_examples::ServerConnectionHub::Client& client,
-                     const std::string& text) {
-  const std::size_t bytes = text.size() + 1;
-  if (client.connection->SendUnsequenced(0, text.c_str(), bytes)) {
-    socketwire_examples::benchmark::RecordPayloadTx(bytes);
+// Long enough for a placed player to connect and show up in a heartbeat.
+static constexpr auto kPlacementGrace = 4 * lobby_dots::kHeartbeatInterval;
+// A server this long without a heartbeat gets no new players.
+static constexpr auto kHeartbeatTimeout = 3 * lobby_dots::kHeartbeatInterval;
+// A server busier than this gets no new players, whatever its capacity.
+static constexpr double kMaxTickLoad = 0.9;
+
+// Placements and queue positions go out once, after the client has left the
+// queue or moved in it, so they must not be lost.
+static void Send(Client& client, const socketwire::BitStream& packet) {
+  if (client.connection->SendReliable(0, packet)) {
+    socketwire_examples::benchmark::RecordPayloadTx(packet.GetSizeBytes());
+  }
+}
+
+static std::string FormatAddress(const Client& client) {
+  const std::uint32_t ip = client.address.ipv4.hostOrderAddress;
+  return std::format("{}.{}.{}.{}:{}", ip >> 24, (ip >> 16) & 0xFF,
+                     (ip >> 8) & 0xFF, ip & 0xFF, client.port);
+}
+
+// The host clients should use for a server that registered from |link|: its
+// source address, or |configured_host| when it runs next to the lobby.
+static std::string AdvertisedHost(const Client& link,
+                                  const std::string& configured_host) {
+  const std::uint32_t ip = link.address.ipv4.hostOrderAddress;
+  if (link.address.isIPv6 || ip == 0 || (ip >> 24) == 127) {
+    return configured_host;
+  }
+  return std::format("{}.{}.{}.{}", ip >> 24, (ip >> 16) & 0xFF,
+                     (ip >> 8) & 0xFF, ip & 0xFF);
+}
+
+static std::size_t Occupancy(const GameServerEntry& server) {
+  return server.players + server.placements.size();
+}
+
+// Occupancy or tick load, whichever is higher, both as a share of what the
+// server can take.
+static double Load(const GameServerEntry& server) {
+  return std::max(static_cast<double>(Occupancy(server)) / server.capacity,
+                  server.tickLoad);
+}
+
+static GameServerEntry* LeastLoaded(std::vector<GameServerEntry>& servers,
+                                    std::chrono::steady_clock::time_point now) {
+  GameServerEntry* best = nullptr;
+  for (auto& server : servers) {
+    std::erase_if(server.placements, [&](auto placed) {
+      return now - placed > kPlacementGrace;
+    });
+    if (now - server.lastHeartbeat > kHeartbeatTimeout) continue;
+    if (Occupancy(server) >= server.capacity) continue;
+    if (server.tickLoad > kMaxTickLoad) continue;
+    if (best == nullptr || Load(server) < Load(*best)) best = &server;
+  }
+  return best;
+}
+
+// Sends queued clients to the least-loaded servers while any has room, then
+// tells those still waiting where they stand.
+static void PlaceQueued(std::deque<QueuedClient>& queue,
+                        std::vector<GameServerEntry>& servers,
+                        std::chrono::steady_clock::time_point now) {
+  while (!queue.empty()) {
+    GameServerEntry* server = LeastLoaded(servers, now);
+    if (server == nullptr) break;
+    Client& client = *queue.front().client;
+    queue.pop_front();
+    Send(client, lobby_dots::MakeGameServer(server->host, server->port));
+    server->placements.push_back(now);
+    std::println("Placed {} on {}:{} ({}/{} players, {:.0f}% load)",
+                 FormatAddress(client), server->host, server->port,
+                 Occupancy(*server), server->capacity,
+                 server->tickLoad * 100.0);
+  }
+
+  std::uint16_t position = 0;
+  for (auto& queued : queue) {
+    ++position;
+    if (queued.reportedPosition == position) continue;
+    queued.reportedPosition = position;
+    Send(*queued.client, lobby_dots::MakeQueued(position));
   }
 }
 
@@ -35,13 +135,10 @@ int main(int argc, const char** argv) {
     socketwire_examples::HasCommandLineOption(argc, argv, "--host");
   const bool has_lobby_port_option =
     socketwire_examples::HasCommandLineOption(argc, argv, "--lobby-port");
-  const bool has_game_port_option =
-    socketwire_examples::HasCommandLineOption(argc, argv, "--game-port");
   const bool has_positional_game_host =
     argc > 1 && argv[1] != nullptr &&
     !socketwire_examples::IsCommandLineOption(argv[1]) &&
     !socketwire_examples::ParsePort(argv[1]).has_value();
-  const int game_port_arg_index = has_positional_game_host ? 2 : 0;
   const int lobby_port_arg_index = has_positional_game_host ? 3 : 0;
 
   const std::uint16_t listen_port =
@@ -54,78 +151,121 @@ int main(int argc, const char** argv) {
   auto socket = socketwire_examples::CreateUdpSocket(listen_port);
   if (socket == nullptr) return 1;
 
-  GameServerInfo game_server;
+  // Host handed out for game servers on the lobby's own machine.
+  std::string local_game_host = "127.0.0.1";
   if (bench_options.enabled || has_host_option) {
-    game_server.host = bench_options.host;
+    local_game_host = bench_options.host;
   } else if (has_positional_game_host) {
-    game_server.host = argv[1];
-  }
-
-  if (bench_options.enabled || has_game_port_option) {
-    game_server.port = bench_options.gamePort;
-  } else {
-    game_server.port = socketwire_examples::PortFromArgsOrEnv(
-      argc, argv, game_port_arg_index, "SOCKETWIRE_LOBBY_DOTS_GAME_PORT",
-      static_cast<std::uint16_t>(game_server.port));
+    local_game_host = argv[1];
   }
 
   socketwire::ReliableConnectionConfig cfg;
   cfg.numChannels = 2;
   socketwire_examples::ServerConnectionHub hub(socket.get(), cfg);
-  std::vector<socketwire_examples::ServerConnectionHub::Client*>
-    connected_clients;
+  std::vector<GameServerEntry> servers;
+  std::deque<QueuedClient> queue;
 
-  hub.SetConnectedCallback([&](auto& client) {
-    std::println("Client connected from {:d}:{:d}",
-                 client.address.ipv4.hostOrderAddress, client.port);
-    connected_clients.push_back(&client);
-
-    if (game_server.sessionStarted) {
-      const std::string game_server_msg = "GAMESERVER " + game_server.host +
-                                          " " +
-                                          std::to_string(game_server.port);
-      SendText(client, game_server_msg);
-      std::println("Sent game server info to new player: {}", game_server_msg);
+  const auto find_server = [&](const Client& client) {
+    return std::ranges::find(servers, &client, &GameServerEntry::link);
+  };
+  const auto enqueue = [&](Client& client) {
+    if (std::ranges::find(queue, &client, &QueuedClient::client) ==
+        queue.end()) {
+      queue.emplace_back().client = &client;
     }
+  };
+
+  hub.SetConnectedCallback([&](auto& client) {
+    std::println("Client connected from {}", FormatAddress(client));
   });
 
   hub.SetDisconnectedCallback([&](auto& client) {
-    std::println("Client disconnected from {:d}:{:d}",
-                 client.address.ipv4.hostOrderAddress, client.port);
-    std::erase(connected_clients, &client);
+    std::println("Client disconnected from {}", FormatAddress(client));
+    std::erase_if(queue, [&](const QueuedClient& queued) {
+      return queued.client == &client;
+    });
+    if (const auto server = find_server(client); server != servers.end()) {
+      std::println("Game server {}:{} left", server->host, server->port);
+      servers.erase(server);
+    }
   });
 
   hub.SetPacketCallback(
     [&](auto& client, std::uint8_t, const void* data, std::size_t size, bool) {
       socketwire_examples::benchmark::RecordPayloadRx(size);
-      const std::string packet =
-        socketwire_examples::ReadStringPayload(data, size);
-      std::println("Packet received from {:d}:{:d}: '{}'",
-                   client.address.ipv4.hostOrderAddress, client.port, packet);
-
-      if (!game_server.sessionStarted && packet == "Start!") {
-        std::println("Game session start requested!");
-        game_server.sessionStarted = true;
-        const std::string game_server_msg = "GAMESERVER " + game_server.host +
-                                            " " +
-                                            std::to_string(game_server.port);
-
-        for (auto* peer : connected_clients) {
-          if (peer != nullptr && peer->connection != nullptr &&
-              peer->connection->IsConnected()) {
-            SendText(*peer, game_server_msg);
+      socketwire::BitStream stream(static_cast<const std::uint8_t*>(data),
+                                   size);
+      lobby_dots::MessageType type{};
+      if (!lobby_dots::ReadType(stream, type)) return;
+      const auto now = std::chrono::steady_clock::now();
+
+      switch (type) {
+        case lobby_dots::MessageType::kRegisterServer: {
+          std::uint16_t port = 0;
+          std::uint16_t capacity = 0;
+          if (!lobby_dots::ReadRegisterServer(stream, port, capacity) ||
+              capacity == 0) {
+            return;
+          }
+          // Registration is authoritative: a game server is never a player,
+          // even if it asked for a game server first.
+          std::erase_if(queue, [&](const QueuedClient& queued) {
+            return queued.client == &client;
+          });
+          auto server = find_server(client);
+          if (server == servers.end()) {
+            server = servers.emplace(servers.end());
+            server->link = &client;
           }
+          server->host = AdvertisedHost(client, local_game_host);
+          server->port = port;
+          server->capacity = capacity;
+          server->lastHeartbeat = now;
+          std::println("Game server {}:{} registered for {} players",
+                       server->host, server->port, server->capacity);
+          break;
         }
-
-        std::println("Sent game server info to all connected players: {}",
-                     game_server_msg);
+        case lobby_dots::MessageType::kServerHeartbeat: {
+          const auto server = find_server(client);
+          if (server == servers.end()) break;
+          const std::uint16_t players_before = server->players;
+          if (!lobby_dots::ReadServerHeartbeat(stream, server->players,
+                                               server->tickLoad)) {
+            break;
+          }
+          server->lastHeartbeat = now;
+          // Players the heartbeat counts for the first time are most likely
+          // the oldest placements; stop counting those twice.
+          if (server->players > players_before) {
+            const std::size_t arrived = std::min<std::size_t>(
+              server->players - players_before, server->placements.size());
+            server->placements.erase(
+              server->placements.begin(),
+              server->placements.begin() +
+                static_cast<std::ptrdiff_t>(arrived));
+          }
+          break;
+        }
+        case lobby_dots::MessageType::kStartSession:
+          // Only players ask for a game server.
+          if (find_server(client) != servers.end()) break;
+          std::println("Game server requested by {}", FormatAddress(client));
+          enqueue(client);
+          break;
+        case lobby_dots::MessageType::kGameServer:
+        case lobby_dots::MessageType::kPosition:
+        case lobby_dots::MessageType::kWelcome:
+        case lobby_dots::MessageType::kPlayers:
+        case lobby_dots::MessageType::kPositions:
+        case lobby_dots::MessageType::kQueued:
+          break;
       }
     });
 
   std::println("Lobby server started on port {}",
                static_cast<unsigned>(listen_port));
-  std::println("Game server will be at {}:{}", game_server.host,
-               game_server.port);
+  std::println("Game servers on this machine are advertised as {}",
+               local_game_host);
 
   while (true) {
     if (bench_options.enabled && metrics.Done()) break;
@@ -133,6 +273,7 @@ int main(int argc, const char** argv) {
     const auto update_start = frame_start;
     hub.Poll();
     hub.Update();
+    PlaceQueued(queue, servers, std::chrono::steady_clock::now());
     const auto update_end = std::chrono::steady_clock::now();
     if (bench_options.enabled) {
       const auto clients = hub.Clients();
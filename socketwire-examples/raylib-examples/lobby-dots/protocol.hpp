@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bit_stream.hpp"
+
+namespace lobby_dots {
+
+// Every packet starts with its type byte; the rest is fixed-width binary.
+enum class MessageType : std::uint8_t {
+  // Client to lobby: place this client on a game server. Only players send
+  // it, so it tells them apart from game servers on the same lobby port.
+  kStartSession = 1,
+  // Lobby to client: host string and port of the game server to join.
+  kGameServer = 2,
+  // Client to game server: its dot's position.
+  kPosition = 3,
+  // Game server to client: the id of the client's player.
+  kWelcome = 4,
+  // Game server to client: every player's id, position and ping.
+  kPlayers = 5,
+  // Game server to client: every player's id and position.
+  kPositions = 6,
+  // Game server to lobby, once connected: its game port and player capacity.
+  kRegisterServer = 7,
+  // Game server to lobby, every kHeartbeatInterval: players and tick load.
+  kServerHeartbeat = 8,
+  // Lobby to client: every game server is full; its place in the queue.
+  kQueued = 9,
+};
+
+struct PlayerEntry {
+  std::uint16_t id = 0;
+  float x = 0.f;
+  float y = 0.f;
+  std::uint16_t ping = 0;
+};
+
+struct PositionEntry {
+  std::uint16_t id = 0;
+  float x = 0.f;
+  float y = 0.f;
+};
+
+// A 16-bit count plus 10 bytes per player keeps a positions packet under the
+// default 1400-byte transport packet; larger sessions send several.
+constexpr std::size_t kPositionsPerPacket = 128;
+
+constexpr std::chrono::milliseconds kHeartbeatInterval{500};
+
+inline socketwire::BitStream BeginMessage(MessageType type) {
+  socketwire::BitStream stream;
+  stream.Write<std::uint8_t>(static_cast<std::uint8_t>(type));
+  return stream;
+}
+
+inline socketwire::BitStream MakeStartSession() {
+  return BeginMessage(MessageType::kStartSession);
+}
+
+inline socketwire::BitStream MakeGameServer(const std::string& host,
+                                            std::uint16_t port) {
+  auto stream = BeginMessage(MessageType::kGameServer);
+  stream.Write(host);
+  stream.Write<std::uint16_t>(port);
+  return stream;
+}
+
+inline socketwire::BitStream MakePosition(float x, float y) {
+  auto stream = BeginMessage(MessageType::kPosition);
+  stream.Write<float>(x);
+  stream.Write<float>(y);
+  return stream;
+}
+
+inline socketwire::BitStream MakeWelcome(std::uint16_t player_id) {
+  auto stream = BeginMessage(MessageType::kWelcome);
+  stream.Write<std::uint16_t>(player_id);
+  return stream;
+}
+
+inline socketwire::BitStream MakeRegisterServer(std::uint16_t game_port,
+                                                std::uint16_t capacity) {
+  auto stream = BeginMessage(MessageType::kRegisterServer);
+  stream.Write<std::uint16_t>(game_port);
+  stream.Write<std::uint16_t>(capacity);
+  return stream;
+}
+
+// |tick_load| is the share of wall time the server spent working since the
+// last heartbeat, sent in thousandths.
+inline socketwire::BitStream MakeServerHeartbeat(std::uint16_t players,
+                                                 double tick_load) {
+  auto stream = BeginMessage(MessageType::kServerHeartbeat);
+  stream.Write<std::uint16_t>(players);
+  stream.Write<std::uint16_t>(static_cast<std::uint16_t>(
+    std::clamp(tick_load, 0.0, 1.0) * 1000.0 + 0.5));
+  return stream;
+}
+
+inline socketwire::BitStream MakeQueued(std::uint16_t position) {
+  auto stream = BeginMessage(MessageType::kQueued);
+  stream.Write<std::uint16_t>(position);
+  return stream;
+}
+
+inline std::uint16_t PingField(int ping_ms) {
+  return static_cast<std::uint16_t>(std::clamp(ping_ms, 0, 0xFFFF));
+}
+
+// |players| holds any struct with id, x, y and ping members, so the game
+// server can write its own player records without copying them. Rosters go
+// out twice a second and may be fragmented.
+template <typename Player>
+socketwire::BitStream MakePlayers(std::span<const Player> players) {
+  players = players.first(std::min<std::size_t>(
+    players.size(), std::numeric_limits<std::uint16_t>::max()));
+  auto stream = BeginMessage(MessageType::kPlayers);
+  stream.Write<std::uint16_t>(static_cast<std::uint16_t>(players.size()));
+  for (const Player& player : players) {
+    stream.Write<std::uint16_t>(static_cast<std::uint16_t>(player.id));
+    stream.Write<float>(player.x);
+    stream.Write<float>(player.y);
+    stream.Write<std::uint16_t>(PingField(player.ping));
+  }
+  return stream;
+}
+
+// At most kPositionsPerPacket of |players|; the caller sends the rest in
+// further packets. Receivers skip their own entry.
+template <typename Player>
+socketwire::BitStream MakePositions(std::span<const Player> players) {
+  players = players.first(std::min(players.size(), kPositionsPerPacket));
+  auto stream = BeginMessage(MessageType::kPositions);
+  stream.Write<std::uint16_t>(static_cast<std::uint16_t>(players.size()));
+  for (const Player& player : players) {
+    stream.Write<std::uint16_t>(static_cast<std::uint16_t>(player.id));
+    stream.Write<float>(player.x);
+    stream.Write<float>(player.y);
+  }
+  return stream;
+}
+
+inline bool ReadType(socketwire::BitStream& stream, MessageType& type) {
+  const auto value = stream.TryRead<std::uint8_t>();
+  if (!value) return false;
+  type = static_cast<MessageType>(*value);
+  return true;
+}
+
+inline bool ReadGameServer(socketwire::BitStream& stream, std::string& host,
+                           std::uint16_t& port) {
+  auto value = stream.TryReadString();
+  const auto port_value = stream.TryRead<std::uint16_t>();
+  if (!value || !port_value) return false;
+  host = std::move(*value);
+  port = *port_value;
+  return true;
+}
+
+inline bool ReadPosition(socketwire::BitStream& stream, float& x, float& y) {
+  const auto x_value = stream.TryRead<float>();
+  const auto y_value = stream.TryRead<float>();
+  if (!x_value || !y_value) return false;
+  x = *x_value;
+  y = *y_value;
+  return true;
+}
+
+inline bool ReadWelcome(socketwire::BitStream& stream,
+                        std::uint16_t& player_id) {
+  const auto value = stream.TryRead<std::uint16_t>();
+  if (!value) return false;
+  player_id = *value;
+  return true;
+}
+
+inline bool ReadRegisterServer(socketwire::BitStream& stream,
+                               std::uint16_t& game_port,
+                               std::uint16_t& capacity) {
+  const auto port_value = stream.TryRead<std::uint16_t>();
+  const auto capacity_value = stream.TryRead<std::uint16_t>();
+  if (!port_value || !capacity_value) return false;
+  game_port = *port_value;
+  capacity = *capacity_value;
+  return true;
+}
+
+inline bool ReadServerHeartbeat(socketwire::BitStream& stream,
+                                std::uint16_t& players, double& tick_load) {
+  const auto players_value = stream.TryRead<std::uint16_t>();
+  const auto load_value = stream.TryRead<std::uint16_t>();
+  if (!players_value || !load_value) return false;
+  players = *players_value;
+  tick_load = *load_value / 1000.0;
+  return true;
+}
+
+inline bool ReadQueued(socketwire::BitStream& stream,
+                       std::uint16_t& position) {
+  const auto value = stream.TryRead<std::uint16_t>();
+  if (!value) return false;
+  position = *value;
+  return true;
+}
+
+// Replaces |players|; on a truncated packet it holds the entries that fit.
+inline bool ReadPlayers(socketwire::BitStream& stream,
+                        std::vector<PlayerEntry>& players) {
+  players.clear();
+  const auto count = stream.TryRead<std::uint16_t>();
+  if (!count) return false;
+  for (std::uint16_t i = 0; i < *count; ++i) {
+    const auto id = stream.TryRead<std::uint16_t>();
+    const auto x = stream.TryRead<float>();
+    const auto y = stream.TryRead<float>();
+    const auto ping = stream.TryRead<std::uint16_t>();
+    if (!id || !x || !y || !ping) return false;
+    players.push_back(PlayerEntry{*id, *x, *y, *ping});
+  }
+  return true;
+}
+
+// Replaces |positions|; on a truncated packet it holds the entries that fit.
+inline bool ReadPositions(socketwire::BitStream& stream,
+                          std::vector<PositionEntry>& positions) {
+  positions.clear();
+  const auto count = stream.TryRead<std::uint16_t>();
+  if (!count) return false;
+  for (std::uint16_t i = 0; i < *count; ++i) {
+    const auto id = stream.TryRead<std::uint16_t>();
+    const auto x = stream.TryRead<float>();
+    const auto y = stream.TryRead<float>();
+    if (!id || !x || !y) return false;
+    positions.push_back(PositionEntry{*id, *x, *y});
+  }
+  return true;
+}
+
+}  // namespace lobby_dots
@@ -0,0 +1,187 @@
+// Compares one position broadcast in the binary protocol (protocol.hpp) with
+// the text messages it replaced: a "POS id x y" string per sender, sent to
+// every other player and parsed with sscanf. Both encode the same players and
+// decode everything each receiver would get; the binary positions must come
+// back bit for bit.
+//
+//   lobby-dots-protocol-bench [--players N] [--rounds N]
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <print>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "protocol.hpp"
+
+namespace {
+
+struct Player {
+  std::uint16_t id = 0;
+  float x = 0.f;
+  float y = 0.f;
+  int ping = 0;
+};
+
+struct Cost {
+  std::chrono::steady_clock::duration encode{};
+  std::chrono::steady_clock::duration decode{};
+  std::size_t packets = 0;
+  std::size_t bytes = 0;
+};
+
+std::vector<Player> MakePlayers(int count) {
+  std::mt19937 generator(1234);
+  std::uniform_real_distribution<float> position(0.f, 800.f);
+  std::vector<Player> players(static_cast<std::size_t>(count));
+  for (std::size_t i = 0; i < players.size(); ++i) {
+    players[i].id = static_cast<std::uint16_t>(i + 1);
+    players[i].x = position(generator);
+    players[i].y = position(generator);
+  }
+  return players;
+}
+
+// The old game server: one string per sender, one packet per receiver.
+void TextBroadcast(const std::vector<Player>& players, Cost& cost,
+                   float& checksum) {
+  std::vector<std::string> packets;
+  const auto encode_start = std::chrono::steady_clock::now();
+  for (const auto& sender : players) {
+    const std::string pos_str = "POS " + std::to_string(sender.id) + " " +
+                                std::to_string(sender.x) + " " +
+                                std::to_string(sender.y);
+    for (const auto& receiver : players) {
+      if (receiver.id != sender.id) packets.push_back(pos_str);
+    }
+  }
+  const auto decode_start = std::chrono::steady_clock::now();
+  for (const auto& packet : packets) {
+    int player_id = -1;
+    float x = 0.f;
+    float y = 0.f;
+    if (std::sscanf(packet.c_str(), "POS %d %f %f", &player_id, &x, &y) == 3) {
+      checksum += x + y;
+    }
+  }
+  const auto decode_end = std::chrono::steady_clock::now();
+
+  cost.encode += decode_start - encode_start;
+  cost.decode += decode_end - decode_start;
+  cost.packets += packets.size();
+  for (const auto& packet : packets) cost.bytes += packet.size() + 1;
+}
+
+// The binary game server: shared packets of up to kPositionsPerPacket
+// players, decoded once per receiver.
+std::size_t BinaryBroadcast(const std::vector<Player>& players, Cost& cost,
+                            float& checksum) {
+  std::vector<socketwire::BitStream> packets;
+  const std::span<const Player> all(players);
+  const auto encode_start = std::chrono::steady_clock::now();
+  for (std::size_t first = 0; first < all.size();
+       first += lobby_dots::kPositionsPerPacket) {
+    packets.push_back(lobby_dots::MakePositions(all.subspan(first)));
+  }
+  const auto decode_start = std::chrono::steady_clock::now();
+  std::vector<lobby_dots::PositionEntry> positions;
+  std::size_t mismatches = 0;
+  for (std::size_t receiver = 0; receiver < players.size(); ++receiver) {
+    std::size_t next = 0;
+    for (const auto& packet : packets) {
+      socketwire::BitStream stream(packet.GetData(), packet.GetSizeBytes());
+      lobby_dots::MessageType type{};
+      if (!lobby_dots::ReadType(stream, type) ||
+          !lobby_dots::ReadPositions(stream, positions)) {
+        ++mismatches;
+        continue;
+      }
+      for (const auto& entry : positions) {
+        const Player& expected = players[next++];
+        if (entry.id != expected.id ||
+            std::bit_cast<std::uint32_t>(entry.x) !=
+              std::bit_cast<std::uint32_t>(expected.x) ||
+            std::bit_cast<std::uint32_t>(entry.y) !=
+              std::bit_cast<std::uint32_t>(expected.y)) {
+          ++mismatches;
+        }
+        if (entry.id != players[receiver].id) checksum += entry.x + entry.y;
+      }
+    }
+  }
+  const auto decode_end = std::chrono::steady_clock::now();
+
+  cost.encode += decode_start - encode_start;
+  cost.decode += decode_end - decode_start;
+  cost.packets += packets.size() * players.size();
+  for (const auto& packet : packets) {
+    cost.bytes += packet.GetSizeBytes() * players.size();
+  }
+  return mismatches;
+}
+
+double MicrosPerRound(std::chrono::steady_clock::duration elapsed,
+                      int rounds) {
+  return static_cast<double>(
+           std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+             .count()) /
+         1000.0 / rounds;
+}
+
+void PrintCost(const char* name, const Cost& cost, int rounds) {
+  std::println("  {:6}  encode {:9.1f} us  decode {:9.1f} us  {:7} packets  "
+               "{:8} bytes per broadcast",
+               name, MicrosPerRound(cost.encode, rounds),
+               MicrosPerRound(cost.decode, rounds),
+               cost.packets / static_cast<std::size_t>(rounds),
+               cost.bytes / static_cast<std::size_t>(rounds));
+}
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+  int player_count = 100;
+  int rounds = 200;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+      socketwire_examples::benchmark::ParseInt(argv[++i], player_count);
+    } else if (std::strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+      socketwire_examples::benchmark::ParseInt(argv[++i], rounds);
+    }
+  }
+  player_count = std::clamp(player_count, 1, 0xFFFF);
+  rounds = std::max(rounds, 1);
+
+  const std::vector<Player> players = MakePlayers(player_count);
+  Cost text;
+  Cost binary;
+  float checksum = 0.f;
+  std::size_t mismatches = 0;
+  for (int round = 0; round < rounds; ++round) {
+    TextBroadcast(players, text, checksum);
+    mismatches += BinaryBroadcast(players, binary, checksum);
+  }
+
+  const auto total = [](const Cost& cost) {
+    return cost.encode + cost.decode;
+  };
+  std::println("{} players x {} broadcasts (checksum {})", player_count,
+               rounds, checksum);
+  PrintCost("text", text, rounds);
+  PrintCost("binary", binary, rounds);
+  std::println("  speedup {:.2f}x, {:.2f}x fewer bytes, {} mismatched entries",
+               MicrosPerRound(total(text), rounds) /
+                 MicrosPerRound(total(binary), rounds),
+               static_cast<double>(text.bytes) /
+                 static_cast<double>(binary.bytes),
+               mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
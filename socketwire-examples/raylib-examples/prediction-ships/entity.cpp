@@ -2,8 +2,6 @@
 
 #include "mathUtils.h"
 
-constexpr float kWorldSize = 30.f;
-
 float TileVal(float val, float border) {
   if (val < -border) {
     return val + 2.f * border;
@@ -18,8 +16,11 @@ void SimulateEntity(Entity& e, float dt) {
   // float accel = isBraking ? 6.f : 1.5f;
   float const accel = is_braking ? 12.f : 3.5f;
   float const va = Clamp(e.thr, -0.3, 3.f) * accel;
-  e.vx += cosf(e.ori) * va * dt;
-  e.vy += sinf(e.ori) * va * dt;
+  float sin_ori = 0.f;
+  float cos_ori = 0.f;
+  socketwire_examples::SinCos(e.ori, sin_ori, cos_ori);
+  e.vx += cos_ori * va * dt;
+  e.vy += sin_ori * va * dt;
   e.omega += e.steer * dt * 0.3f;
   e.ori += e.omega * dt;
   e.x += e.vx * dt;
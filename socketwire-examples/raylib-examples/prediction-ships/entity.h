@@ -1,7 +1,10 @@
 #pragma once
 #include <cstdint>
 
+#include "ship_soa.hpp"
+
 constexpr uint16_t kInvalidEntity = -1;
+constexpr float kWorldSize = 30.f;
 struct Entity {
   // immutable state
   uint32_t color = 0x2f80edff;
@@ -23,3 +26,15 @@ struct Entity {
 };
 
 void SimulateEntity(Entity& e, float dt);
+
+// SimulateEntity's model for the server's bulk integrator (ship_soa.hpp).
+// Both must produce the same bits or client prediction drifts.
+constexpr socketwire_examples::ShipTuning kShipTuning{
+  .thrustAccel = 3.5f,
+  .brakeAccel = 12.f,
+  .minThrottle = -0.3f,
+  .maxThrottle = 3.f,
+  .steerRate = 0.3f,
+  .worldSize = kWorldSize,
+  .wrapOrientation = false,
+};
@@ -2,14 +2,18 @@
 #include <chrono>
 #include <cmath>
 #include <cstdio>
-#include <deque>
+#include <limits>
+#include <optional>
 #include <print>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "clock_sync.hpp"
 #include "entity.h"
+#include "frame_ring.hpp"
+#include "interpolation_buffer.hpp"
 #include "protocol.h"
 #include "raylib.h"
 #include "reliable_connection.hpp"
@@ -41,27 +45,54 @@ struct Snapshot {
   float vx = 0.f;
   float vy = 0.f;
   float omega = 0.f;
-  TimePoint timestamp;
+  std::uint32_t serverTick = 0;
   std::uint32_t frameNumber = 0;
 };
 
 static std::vector<Entity> entities;
 static std::unordered_map<std::uint16_t, std::size_t> index_map;
 static std::uint16_t my_entity = kInvalidEntity;
-static std::unordered_map<std::uint16_t, std::vector<Snapshot>>
+// Server clock estimate, used to tell how old the newest snapshot is.
+static socketwire_examples::ClockSync clock_sync(kTickInterval);
+// Other ships are drawn at this playout time, which trails the server by one
+// tick plus the jitter the link has shown lately.
+static constexpr double kTickMs =
+  std::chrono::duration<double, std::milli>(kTickInterval).count();
+static socketwire_examples::PlayoutDelay playout_delay(
+  {.snapshotIntervalMs = kTickMs});
+static std::uint32_t newest_snapshot_tick = 0;
+// Frames that drew a ship past its newest snapshot.
+static std::uint64_t interpolation_underflows = 0;
+
+// Histories are rings keyed by frame number: inputs and predicted states by
+// client frame, snapshots and input acks by server frame. Lookups are O(1),
+// reconciliation replays only the frames after the acked one, and nothing
+// allocates once every ship has been seen, however long the RTT.
+static constexpr std::size_t kHistoryFrames = 128;
+static constexpr std::size_t kSnapshotFrames = 16;
+static std::unordered_map<
+  std::uint16_t, socketwire_examples::FrameRing<Snapshot, kSnapshotFrames>>
   snapshot_history;
-static constexpr std::chrono::milliseconds kInterpolationTime{200};
-
-static std::deque<InputCommand> input_history;
+static socketwire_examples::FrameRing<InputCommand, kHistoryFrames>
+  input_history;
+static socketwire_examples::FrameRing<EntityState, kHistoryFrames>
+  state_history;
+// Server frame -> the client frame whose input it applied to our ship.
+static socketwire_examples::FrameRing<std::uint32_t, kHistoryFrames>
+  input_acks;
+
+static ShipInputWindow input_window;
 static std::uint32_t client_frame_counter = 0;
 static std::uint32_t last_acknowledged_frame = 0;
+static std::uint32_t last_acknowledged_input = 0;
+static std::uint32_t last_replayed_frames = 0;
 static bool pending_correction = false;
+// Set by a snapshot of our ship until its input ack lets us check it.
+static bool server_state_unchecked = false;
 static Snapshot server_state;
+static WorldSnapshotDecoder snapshot_decoder;
+static std::vector<SnapshotEntity> snapshot_entries;
 static constexpr float kPredictionErrorThreshold = 0.5f;
-static std::uint32_t estimated_server_time_msec = 0;
-
-static std::deque<EntityState> state_history;
-static constexpr std::size_t kStateHistoryLimit = 200;
 
 static void OnNewEntityPacket(const void* data, std::size_t size) {
   Entity new_entity;
@@ -84,80 +115,91 @@ static void GetEntity(std::uint16_t eid, Callable callable) {
   if (it != index_map.end()) callable(entities[it->second]);
 }
 
-static void OnSnapshot(const void* data, std::size_t size) {
-  std::uint16_t eid = kInvalidEntity;
-  float x = 0.f;
-  float y = 0.f;
-  float ori = 0.f;
-  float vx = 0.f;
-  float vy = 0.f;
-  float omega = 0.f;
-  TimePoint timestamp;
-  std::uint32_t frame_number = 0;
-
-  if (!DeserializeSnapshot(data, size, eid, x, y, ori, vx, vy, omega, timestamp,
-                           frame_number)) {
+// Compares the newest snapshot of our ship with what we predicted for the
+// client frame it reflects. Runs when both the snapshot and its input ack are
+// in, whichever arrives last.
+static void CheckServerState() {
+  if (!server_state_unchecked) return;
+  const std::uint32_t* input_frame =
+    input_acks.Find(server_state.frameNumber);
+  if (input_frame == nullptr) return;
+  server_state_unchecked = false;
+  last_acknowledged_input = *input_frame;
+
+  const EntityState* predicted = state_history.Find(*input_frame);
+  if (predicted == nullptr) {
+    pending_correction = true;
     return;
   }
-  const Snapshot snapshot{eid, x,     y,         ori,         vx,
-                          vy,  omega, timestamp, frame_number};
-
-  if (eid == my_entity) {
-    server_state = snapshot;
-    last_acknowledged_frame = frame_number;
+  const float dx = predicted->x - server_state.x;
+  const float dy = predicted->y - server_state.y;
+  const float pos_error = std::sqrt(dx * dx + dy * dy);
+  if (pos_error > kPredictionErrorThreshold) pending_correction = true;
+}
 
-    while (!input_history.empty() &&
-           input_history.front().frameNumber <= frame_number) {
-      input_history.pop_front();
+static void ApplySnapshot(const Snapshot& snapshot) {
+  if (snapshot.eid == my_entity) {
+    if (!server_state_unchecked ||
+        static_cast<std::int32_t>(snapshot.frameNumber -
+                                  server_state.frameNumber) > 0) {
+      server_state = snapshot;
+      server_state_unchecked = true;
+      last_acknowledged_frame = snapshot.frameNumber;
+      CheckServerState();
     }
-
-    GetEntity(my_entity, [&](Entity& e) {
-      const float dx = e.x - x;
-      const float dy = e.y - y;
-      const float pos_error = std::sqrt(dx * dx + dy * dy);
-      if (pos_error > kPredictionErrorThreshold) pending_correction = true;
-    });
+    return;
   }
+  snapshot_history[snapshot.eid].Put(snapshot.frameNumber, snapshot);
+}
 
-  snapshot_history[eid].push_back(snapshot);
-  auto& snapshots = snapshot_history[eid];
-  if (snapshots.size() > 1 && snapshots.back().frameNumber <
-                                snapshots[snapshots.size() - 2].frameNumber) {
-    std::sort(snapshots.begin(), snapshots.end(),
-              [](const Snapshot& a, const Snapshot& b) {
-                return a.frameNumber < b.frameNumber;
-              });
+static void OnSnapshot(const void* data, std::size_t size) {
+  std::uint32_t tick = 0;
+  std::uint32_t frame_number = 0;
+  if (!snapshot_decoder.Read(data, size, snapshot_entries, tick,
+                             frame_number)) {
+    return;
+  }
+  playout_delay.OnSnapshot(static_cast<double>(tick) * kTickMs,
+                          std::chrono::steady_clock::now());
+  if (static_cast<std::int32_t>(tick - newest_snapshot_tick) > 0) {
+    newest_snapshot_tick = tick;
+  }
+  for (const SnapshotEntity& entry : snapshot_entries) {
+    ApplySnapshot(Snapshot{entry.eid, entry.x, entry.y, entry.ori, entry.vx,
+                           entry.vy, entry.omega, tick, frame_number});
   }
 }
 
+// Other ships are drawn at the playout time, between the two snapshots
+// around it; ours is predicted instead. Until the first snapshot they show
+// their newest one.
 static void ProcessSnapshotHistory(const TimePoint& current_time) {
-  const TimePoint target_time = current_time - kInterpolationTime;
+  const double target_tick =
+    playout_delay.Started() ? playout_delay.PlayoutMs(current_time) / kTickMs
+                            : std::numeric_limits<double>::infinity();
+  bool underflow = false;
 
   for (auto& [eid, snapshots] : snapshot_history) {
-    if (snapshots.empty()) continue;
-
-    while (snapshots.size() > 2 && snapshots[1].timestamp < target_time) {
-      snapshots.erase(snapshots.begin());
-    }
-
-    if (snapshots.size() < 2 || target_time <= snapshots[0].timestamp) {
-      const auto& snapshot = snapshots[0];
-      GetEntity(eid, [&](Entity& e) {
-        e.x = snapshot.x;
-        e.y = snapshot.y;
-        e.ori = snapshot.ori;
-      });
-      continue;
-    }
-
-    std::size_t index = 0;
-    while (index < snapshots.size() - 1 &&
-           snapshots[index + 1].timestamp <= target_time) {
-      ++index;
+    if (eid == my_entity || snapshots.Empty()) continue;
+
+    // Walk back from the newest frame to the first snapshot at or before
+    // the target tick; |newer| ends up as the one after it.
+    const Snapshot* older = nullptr;
+    const Snapshot* newer = nullptr;
+    for (std::uint32_t age = 0; age < kSnapshotFrames; ++age) {
+      const Snapshot* snapshot = snapshots.Find(snapshots.Newest() - age);
+      if (snapshot == nullptr) continue;
+      if (snapshot->serverTick <= target_tick) {
+        older = snapshot;
+        break;
+      }
+      newer = snapshot;
     }
 
-    if (index >= snapshots.size() - 1) {
-      const auto& snapshot = snapshots.back();
+    if (older == nullptr || newer == nullptr) {
+      // Past the newest snapshot: the delay was too short for this one.
+      if (newer == nullptr && playout_delay.Started()) underflow = true;
+      const Snapshot& snapshot = older != nullptr ? *older : *newer;
       GetEntity(eid, [&](Entity& e) {
         e.x = snapshot.x;
         e.y = snapshot.y;
@@ -166,15 +208,13 @@ static void ProcessSnapshotHistory(const TimePoint& current_time) {
       continue;
     }
 
-    const auto& s1 = snapshots[index];
-    const auto& s2 = snapshots[index + 1];
+    const auto& s1 = *older;
+    const auto& s2 = *newer;
 
     float t = 0.f;
-    const auto s2_minus_s1 = s2.timestamp - s1.timestamp;
-    const auto target_minus_s1 = target_time - s1.timestamp;
-    if (s2_minus_s1.count() > 0) {
-      t = static_cast<float>(target_minus_s1.count()) /
-          static_cast<float>(s2_minus_s1.count());
+    const std::uint32_t s2_minus_s1 = s2.serverTick - s1.serverTick;
+    if (s2_minus_s1 > 0) {
+      t = static_cast<float>((target_tick - s1.serverTick) / s2_minus_s1);
       t = std::clamp(t, 0.f, 1.f);
     }
 
@@ -195,14 +235,24 @@ static void ProcessSnapshotHistory(const TimePoint& current_time) {
       e.ori = interp_ori;
     });
   }
+  if (underflow) ++interpolation_underflows;
+}
+
+static void OnInputAck(const void* data, std::size_t size) {
+  std::uint32_t frame_number = 0;
+  std::uint32_t input_frame = 0;
+  if (!DeserializeInputAck(data, size, frame_number, input_frame)) return;
+  input_acks.Put(frame_number, input_frame);
+  CheckServerState();
 }
 
-static void OnTime(const void* data, std::size_t size,
-                   const socketwire::ReliableConnection& connection) {
-  std::uint32_t time_msec = 0;
-  if (!DeserializeTimeMsec(data, size, time_msec)) return;
-  estimated_server_time_msec =
-    time_msec + static_cast<std::uint32_t>(connection.GetRtt() * 0.5f);
+static void OnClockReply(const void* data, std::size_t size,
+                         const socketwire::ReliableConnection& connection) {
+  std::uint64_t stamp = 0;
+  std::int64_t server_micros = 0;
+  if (!DeserializeClockReply(data, size, stamp, server_micros)) return;
+  clock_sync.OnReply(stamp, server_micros, std::chrono::steady_clock::now(),
+                     connection.GetRtt());
 }
 
 static void DrawEntity(const Entity& e) {
@@ -256,11 +306,16 @@ class ClientHandler final : public socketwire::IReliableConnectionHandler {
       case kEServerToClientSnapshot:
         OnSnapshot(data, size);
         break;
-      case kEServerToClientTimeMsec:
-        OnTime(data, size, connection_);
+      case kEServerToClientInputAck:
+        OnInputAck(data, size);
+        break;
+      case kEServerToClientClockReply:
+        OnClockReply(data, size, connection_);
         break;
       case kEClientToServerJoin:
       case kEClientToServerInput:
+      case kEClientToServerClockRequest:
+      case kEClientToServerSnapshotAck:
         break;
     }
   }
@@ -283,58 +338,43 @@ static void SimulateWorld(
                         : ((IsKeyDown(KEY_LEFT) ? -1.f : 0.f) +
                            (IsKeyDown(KEY_RIGHT) ? 1.f : 0.f));
 
-  input_history.push_back(InputCommand{client_frame_counter, thr, steer,
-                                       std::chrono::steady_clock::now()});
-  while (input_history.size() > 100) input_history.pop_front();
+  input_history.Put(client_frame_counter,
+                    InputCommand{client_frame_counter, thr, steer,
+                                 std::chrono::steady_clock::now()});
 
-  SendEntityInput(&connection, my_entity, thr, steer);
+  input_window.Push(client_frame_counter, ShipInput{thr, steer});
+  SendEntityInput(&connection, my_entity, input_window);
 
+  // Normally only this frame is simulated. After a misprediction the ship
+  // restarts from the server state and replays the inputs after the client
+  // frame that state reflects, rewriting their predicted states.
   GetEntity(my_entity, [&](Entity& e) {
+    std::uint32_t replay_from = client_frame_counter;
     if (pending_correction) {
-      const auto it =
-        std::find_if(state_history.begin(), state_history.end(),
-                     [](const EntityState& state) {
-                       return state.frameNumber == server_state.frameNumber;
-                     });
-      if (it != state_history.end()) {
-        const float dx = server_state.x - it->x;
-        const float dy = server_state.y - it->y;
-        const float dvx = server_state.vx - it->vx;
-        const float dvy = server_state.vy - it->vy;
-        const float dori = server_state.ori - it->ori;
-        const float domega = server_state.omega - it->omega;
-        for (auto jt = it; jt != state_history.end(); ++jt) {
-          jt->x += dx;
-          jt->y += dy;
-          jt->vx += dvx;
-          jt->vy += dvy;
-          jt->ori += dori;
-          jt->omega += domega;
-        }
-      }
-
       e.x = server_state.x;
       e.y = server_state.y;
       e.vx = server_state.vx;
       e.vy = server_state.vy;
       e.ori = server_state.ori;
       e.omega = server_state.omega;
-
-      for (const auto& input : input_history) {
-        e.thr = input.thr;
-        e.steer = input.steer;
-        SimulateEntity(e, kFixedDt);
+      replay_from = last_acknowledged_input + 1;
+      if (client_frame_counter - replay_from >= kHistoryFrames) {
+        replay_from = client_frame_counter - (kHistoryFrames - 1);
       }
       pending_correction = false;
-    } else {
-      e.thr = thr;
-      e.steer = steer;
-      SimulateEntity(e, kFixedDt);
     }
+    last_replayed_frames = client_frame_counter - replay_from;
 
-    state_history.push_back(
-      EntityState{e.x, e.y, e.ori, e.vx, e.vy, e.omega, client_frame_counter});
-    if (state_history.size() > kStateHistoryLimit) state_history.pop_front();
+    for (std::uint32_t frame = replay_from;; ++frame) {
+      if (const InputCommand* input = input_history.Find(frame)) {
+        e.thr = input->thr;
+        e.steer = input->steer;
+      }
+      SimulateEntity(e, kFixedDt);
+      state_history.Put(
+        frame, EntityState{e.x, e.y, e.ori, e.vx, e.vy, e.omega, frame});
+      if (frame == client_frame_counter) break;
+    }
   });
 }
 
@@ -356,13 +396,14 @@ static void DrawWorld(const Camera2D& camera) {
                     "Ori: %+2.2f  Omega: %+2.2f\n"
                     "Thr: %+1.2f  Steer: %+1.2f\n"
                     "Frame: %3u | Last server frame: %3u\n"
-                    "InputHist: %zu | StateHist: %zu\n"
+                    "Acked input: %3u | Replayed: %u\n"
                     "PendingCorrection: %s\n"
-                    "Server Delay: 200 ms",
+                    "Interp delay: %.0f ms | Clock offset: %+.1f ms",
                     e.x, e.y, e.vx, e.vy, e.ori, e.omega, e.thr, e.steer,
                     client_frame_counter, last_acknowledged_frame,
-                    input_history.size(), state_history.size(),
-                    pending_correction ? "YES" : "NO");
+                    last_acknowledged_input, last_replayed_frames,
+                    pending_correction ? "YES" : "NO",
+                    playout_delay.DelayMs(), clock_sync.OffsetMs());
     });
     DrawText(buffer, 5, 5, 10, BLACK);
   }
@@ -448,6 +489,10 @@ int main(int argc, const char** argv) {
     }
     connection.Poll();
     connection.Update();
+    snapshot_decoder.FlushAcks(&connection);
+    if (handler.connected && clock_sync.RequestDue(now)) {
+      SendClockRequest(&connection, clock_sync.OnRequestSent(now));
+    }
     if (handler.connected && !sent_join) {
       SendJoin(&connection);
       sent_join = true;
@@ -469,6 +514,15 @@ int main(int argc, const char** argv) {
       metrics.SetConnectedClients(handler.connected ? 1 : 0);
       metrics.SetNetworkStats(
         socketwire_examples::benchmark::StatsFromConnection(connection));
+      socketwire_examples::benchmark::GameMetrics game_metrics;
+      game_metrics.entityCountClient = entities.size();
+      game_metrics.interpolationUnderflowCount = interpolation_underflows;
+      game_metrics.interpolationDelayMs = playout_delay.DelayMs();
+      if (clock_sync.Synced()) {
+        game_metrics.snapshotAgeMs =
+          clock_sync.TickAgeMs(newest_snapshot_tick, update_end);
+      }
+      metrics.SetGameMetrics(game_metrics);
       metrics.RecordUpdateMs(
         static_cast<double>(
           std::chrono::duration_cast<std::chrono::microseconds>(update_end -
@@ -1,7 +1,10 @@
 #include "protocol.h"
 
+#include <algorithm>
+
 #include "benchmark_utils.hpp"
 #include "bit_stream.hpp"
+#include "quantisation.hpp"
 #include "reliable_connection.hpp"
 
 namespace {
@@ -14,6 +17,23 @@ bool Read(socketwire::BitStream& stream, T& value) {
   return true;
 }
 
+using socketwire_examples::quantisation::Angle;
+using socketwire_examples::quantisation::BoundedFloat;
+
+// Ships wrap inside +-30 units. Velocities are not clamped by the sim, so the
+// ranges leave room for a ship that holds thrust for a long time.
+constexpr BoundedFloat<16> kPositionCodec{-32.f, 32.f};
+constexpr Angle<12> kOrientationCodec{};
+constexpr BoundedFloat<16> kVelocityCodec{-256.f, 256.f};
+constexpr BoundedFloat<14> kAngularVelocityCodec{-32.f, 32.f};
+
+constexpr socketwire_examples::DeltaSchema<6> kSnapshotSchema{
+  .idBits = 16,
+  .fieldBits = {kPositionCodec.kBits, kPositionCodec.kBits,
+                kOrientationCodec.kBits, kVelocityCodec.kBits,
+                kVelocityCodec.kBits, kAngularVelocityCodec.kBits},
+};
+
 }  // namespace
 
 void SendJoin(socketwire::ReliableConnection* connection) {
@@ -55,50 +75,168 @@ void SendSetControlledEntity(socketwire::ReliableConnection* connection,
 }
 
 void SendEntityInput(socketwire::ReliableConnection* connection,
-                     std::uint16_t eid, float thr, float steer) {
+                     std::uint16_t eid, const ShipInputWindow& inputs) {
   socketwire::BitStream bs;
   bs.Write<std::uint8_t>(kEClientToServerInput);
   bs.Write<std::uint16_t>(eid);
-  bs.Write<float>(thr);
-  bs.Write<float>(steer);
+  bs.Write<std::uint32_t>(inputs.NewestFrame());
+  bs.Write<std::uint8_t>(static_cast<std::uint8_t>(inputs.Size()));
+  for (std::size_t age = 0; age < inputs.Size(); ++age) {
+    bs.Write<float>(inputs.At(age).thr);
+    bs.Write<float>(inputs.At(age).steer);
+  }
   if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
 
-void SendSnapshot(socketwire::ReliableConnection* connection, std::uint16_t eid,
-                  float x, float y, float ori, float vx, float vy, float omega,
-                  TimePoint timestamp, std::uint32_t frame_number) {
-  const auto duration = timestamp.time_since_epoch();
-  const auto timestamp_ms = static_cast<std::uint64_t>(
-    std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+// Unreliable: a retransmitted request would measure the retransmit timer.
+void SendClockRequest(socketwire::ReliableConnection* connection,
+                      std::uint64_t stamp) {
+  socketwire::BitStream bs;
+  bs.Write<std::uint8_t>(kEClientToServerClockRequest);
+  bs.Write<std::uint64_t>(stamp);
+  if (connection->SendUnreliable(1, bs)) {
+    socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+  }
+}
 
+void SendClockReply(socketwire::ReliableConnection* connection,
+                    std::uint64_t stamp, std::int64_t server_micros) {
   socketwire::BitStream bs;
-  bs.Write<std::uint8_t>(kEServerToClientSnapshot);
-  bs.Write<std::uint16_t>(eid);
-  bs.Write<float>(x);
-  bs.Write<float>(y);
-  bs.Write<float>(ori);
-  bs.Write<float>(vx);
-  bs.Write<float>(vy);
-  bs.Write<float>(omega);
-  bs.Write<std::uint64_t>(timestamp_ms);
-  bs.Write<std::uint32_t>(frame_number);
+  bs.Write<std::uint8_t>(kEServerToClientClockReply);
+  bs.Write<std::uint64_t>(stamp);
+  bs.Write<std::int64_t>(server_micros);
   if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
 
-void SendTimeMsec(socketwire::ReliableConnection* connection,
-                  std::uint32_t time_msec) {
+void SendInputAck(socketwire::ReliableConnection* connection,
+                  std::uint32_t frame_number, std::uint32_t input_frame) {
   socketwire::BitStream bs;
-  bs.Write<std::uint8_t>(kEServerToClientTimeMsec);
-  bs.Write<std::uint32_t>(time_msec);
-  if (connection->SendReliable(0, bs)) {
+  bs.Write<std::uint8_t>(kEServerToClientInputAck);
+  bs.Write<std::uint32_t>(frame_number);
+  bs.Write<std::uint32_t>(input_frame);
+  if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
 
+void WorldSnapshotEncoder::Build(const std::vector<Entity>& entities,
+                                 const socketwire_examples::ShipArrays& ships,
+                                 std::uint32_t tick,
+                                 std::uint32_t frame_number) {
+  tick_ = tick;
+
+  std::size_t chunk_count = 0;
+  for (const Entity& e : entities) {
+    chunk_count =
+      std::max(chunk_count, e.eid / kSnapshotEntitiesPerPacket + 1);
+  }
+  while (chunks_.size() < chunk_count) chunks_.emplace_back(kSnapshotSchema);
+
+  frames_.clear();
+  for (auto& chunk : chunks_) {
+    frames_.push_back(&chunk.BeginFrame(frame_number));
+  }
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    const std::uint16_t eid = entities[i].eid;
+    frames_[eid / kSnapshotEntitiesPerPacket]->records.push_back({
+      .id = eid,
+      .fields = {kPositionCodec.Quantise(ships.x[i]),
+                 kPositionCodec.Quantise(ships.y[i]),
+                 kOrientationCodec.Quantise(ships.ori[i]),
+                 kVelocityCodec.Quantise(ships.vx[i]),
+                 kVelocityCodec.Quantise(ships.vy[i]),
+                 kAngularVelocityCodec.Quantise(ships.omega[i])},
+    });
+  }
+  for (auto& chunk : chunks_) chunk.Commit();
+}
+
+void WorldSnapshotEncoder::SendTo(
+  socketwire::ReliableConnection* connection,
+  std::vector<socketwire_examples::DeltaBaseline>& acks) {
+  if (acks.size() < chunks_.size()) acks.resize(chunks_.size());
+  for (std::size_t c = 0; c < chunks_.size(); ++c) {
+    const socketwire::BitStream& bs =
+      chunks_[c].PacketFor(acks[c], [&](socketwire::BitStream& header) {
+        header.Write<std::uint8_t>(kEServerToClientSnapshot);
+        header.Write<std::uint16_t>(static_cast<std::uint16_t>(c));
+        header.Write<std::uint32_t>(tick_);
+      });
+    if (connection->SendUnreliable(1, bs)) {
+      socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+    }
+  }
+}
+
+bool WorldSnapshotDecoder::Read(const void* data, std::size_t size,
+                                std::vector<SnapshotEntity>& entries,
+                                std::uint32_t& tick,
+                                std::uint32_t& frame_number) {
+  entries.clear();
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  const auto type = bs.TryRead<std::uint8_t>();
+  const auto chunk = bs.TryRead<std::uint16_t>();
+  const auto server_tick = bs.TryRead<std::uint32_t>();
+  if (!type || !chunk || !server_tick || *chunk >= kMaxSnapshotChunks) {
+    return false;
+  }
+  while (chunks_.size() <= *chunk) chunks_.emplace_back(kSnapshotSchema);
+
+  auto& receiver = chunks_[*chunk];
+  if (receiver.Read(bs) != socketwire_examples::DeltaReadStatus::kOk) {
+    return false;
+  }
+  const socketwire_examples::DeltaFrame<6>* frame = receiver.LastRead();
+  QueueAck(*chunk, frame->sequence);
+  if (frame != receiver.Latest()) return false;
+
+  tick = *server_tick;
+  frame_number = frame->sequence;
+  for (const auto& record : frame->records) {
+    entries.push_back(SnapshotEntity{
+      .eid = static_cast<std::uint16_t>(record.id),
+      .x = kPositionCodec.Dequantise(record.fields[0]),
+      .y = kPositionCodec.Dequantise(record.fields[1]),
+      .ori = kOrientationCodec.Dequantise(record.fields[2]),
+      .vx = kVelocityCodec.Dequantise(record.fields[3]),
+      .vy = kVelocityCodec.Dequantise(record.fields[4]),
+      .omega = kAngularVelocityCodec.Dequantise(record.fields[5]),
+    });
+  }
+  return true;
+}
+
+// Keeps one ack per chunk between flushes; newer frames win.
+void WorldSnapshotDecoder::QueueAck(std::uint16_t chunk,
+                                    std::uint32_t frame_number) {
+  for (auto& [pending_chunk, pending_frame] : pendingAcks_) {
+    if (pending_chunk != chunk) continue;
+    if (static_cast<std::int32_t>(frame_number - pending_frame) > 0) {
+      pending_frame = frame_number;
+    }
+    return;
+  }
+  pendingAcks_.emplace_back(chunk, frame_number);
+}
+
+void WorldSnapshotDecoder::FlushAcks(
+  socketwire::ReliableConnection* connection) {
+  for (const auto& [chunk, frame_number] : pendingAcks_) {
+    socketwire::BitStream bs;
+    bs.Write<std::uint8_t>(kEClientToServerSnapshotAck);
+    bs.Write<std::uint16_t>(chunk);
+    bs.Write<std::uint32_t>(frame_number);
+    if (connection->SendUnreliable(1, bs)) {
+      socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+    }
+  }
+  pendingAcks_.clear();
+}
+
 MessageType GetPacketType(const void* data, std::size_t size) {
   if (data == nullptr || size < 1) return kEClientToServerJoin;
   return static_cast<MessageType>(*static_cast<const std::uint8_t*>(data));
@@ -121,32 +259,47 @@ bool DeserializeSetControlledEntity(const void* data, std::size_t size,
 }
 
 bool DeserializeEntityInput(const void* data, std::size_t size,
-                            std::uint16_t& eid, float& thr, float& steer) {
+                            std::uint16_t& eid, std::uint32_t& newest_frame,
+                            std::vector<ShipInput>& inputs) {
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  std::uint8_t type = 0;
+  std::uint8_t count = 0;
+  if (!Read(bs, type) || !Read(bs, eid) || !Read(bs, newest_frame) ||
+      !Read(bs, count) || count > kInputWindow) {
+    return false;
+  }
+  inputs.resize(count);
+  for (ShipInput& input : inputs) {
+    if (!Read(bs, input.thr) || !Read(bs, input.steer)) return false;
+  }
+  return true;
+}
+
+bool DeserializeSnapshotAck(const void* data, std::size_t size,
+                            std::uint16_t& chunk, std::uint32_t& frame_number) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
-  return Read(bs, type) && Read(bs, eid) && Read(bs, thr) && Read(bs, steer);
+  return Read(bs, type) && Read(bs, chunk) && Read(bs, frame_number);
 }
 
-bool DeserializeSnapshot(const void* data, std::size_t size, std::uint16_t& eid,
-                         float& x, float& y, float& ori, float& vx, float& vy,
-                         float& omega, TimePoint& timestamp,
-                         std::uint32_t& frame_number) {
+bool DeserializeClockRequest(const void* data, std::size_t size,
+                             std::uint64_t& stamp) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
-  std::uint64_t timestamp_ms = 0;
-  if (!Read(bs, type) || !Read(bs, eid) || !Read(bs, x) || !Read(bs, y) ||
-      !Read(bs, ori) || !Read(bs, vx) || !Read(bs, vy) ||
-      !Read(bs, omega) || !Read(bs, timestamp_ms) ||
-      !Read(bs, frame_number)) {
-    return false;
-  }
-  timestamp = TimePoint(std::chrono::milliseconds(timestamp_ms));
-  return true;
+  return Read(bs, type) && Read(bs, stamp);
+}
+
+bool DeserializeClockReply(const void* data, std::size_t size,
+                           std::uint64_t& stamp, std::int64_t& server_micros) {
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  std::uint8_t type = 0;
+  return Read(bs, type) && Read(bs, stamp) && Read(bs, server_micros);
 }
 
-bool DeserializeTimeMsec(const void* data, std::size_t size,
-                         std::uint32_t& time_msec) {
+bool DeserializeInputAck(const void* data, std::size_t size,
+                         std::uint32_t& frame_number,
+                         std::uint32_t& input_frame) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
-  return Read(bs, type) && Read(bs, time_msec);
+  return Read(bs, type) && Read(bs, frame_number) && Read(bs, input_frame);
 }
@@ -3,8 +3,12 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "entity.h"
+#include "input_stream.hpp"
+#include "snapshot_delta.hpp"
 
 namespace socketwire {
 class ReliableConnection;
@@ -13,6 +17,9 @@ class ReliableConnection;
 using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
 
 constexpr float kFixedDt = 1.0f / 10.0f;
+// The server's tick; snapshot ticks are counted in it.
+constexpr auto kTickInterval = std::chrono::round<std::chrono::milliseconds>(
+  std::chrono::duration<float>(kFixedDt));
 
 enum MessageType : std::uint8_t {
   kEClientToServerJoin = 0,
@@ -20,7 +27,10 @@ enum MessageType : std::uint8_t {
   kEServerToClientSetControlledEntity,
   kEClientToServerInput,
   kEServerToClientSnapshot,
-  kEServerToClientTimeMsec
+  kEClientToServerClockRequest,
+  kEClientToServerSnapshotAck,
+  kEServerToClientInputAck,
+  kEServerToClientClockReply
 };
 
 void SendJoin(socketwire::ReliableConnection* connection);
@@ -28,24 +38,107 @@ void SendNewEntity(socketwire::ReliableConnection* connection,
                    const Entity& ent);
 void SendSetControlledEntity(socketwire::ReliableConnection* connection,
                              std::uint16_t eid);
+
+struct ShipInput {
+  float thr = 0.f;
+  float steer = 0.f;
+};
+
+// Fixed steps per input packet; a step's input survives kInputWindow - 1
+// lost packets in a row.
+constexpr std::size_t kInputWindow = 8;
+using ShipInputWindow =
+  socketwire_examples::InputWindow<ShipInput, kInputWindow>;
+using ShipInputBuffer = socketwire_examples::InputBuffer<ShipInput, 32>;
+
+// The newest client frame, a count, then throttle and steer per frame,
+// newest first. Floats stay unquantised so the server steps the ship with
+// the same inputs the client predicted with.
 void SendEntityInput(socketwire::ReliableConnection* connection,
-                     std::uint16_t eid, float thr, float steer);
-void SendSnapshot(socketwire::ReliableConnection* connection, std::uint16_t eid,
-                  float x, float y, float ori, float vx, float vy, float omega,
-                  TimePoint timestamp, std::uint32_t frame_number);
-void SendTimeMsec(socketwire::ReliableConnection* connection,
-                  std::uint32_t time_msec);
+                     std::uint16_t eid, const ShipInputWindow& inputs);
+// Clock sync (clock_sync.hpp): the client's stamp, echoed back with the
+// server's time in microseconds since its first tick.
+void SendClockRequest(socketwire::ReliableConnection* connection,
+                      std::uint64_t stamp);
+void SendClockReply(socketwire::ReliableConnection* connection,
+                    std::uint64_t stamp, std::int64_t server_micros);
+// Which of the client's frames server frame |frame_number| applied to its
+// ship, so the client can line that snapshot up with its own history.
+void SendInputAck(socketwire::ReliableConnection* connection,
+                  std::uint32_t frame_number, std::uint32_t input_frame);
+
+struct SnapshotEntity {
+  std::uint16_t eid = kInvalidEntity;
+  float x = 0.f;
+  float y = 0.f;
+  float ori = 0.f;
+  float vx = 0.f;
+  float vy = 0.f;
+  float omega = 0.f;
+};
+
+// Ships are split into chunks of kSnapshotEntitiesPerPacket eids. Fields are
+// quantised (quantisation.hpp), so a changed ship costs at most 114 bits and
+// a full chunk stays under the default 1400-byte transport packet.
+constexpr std::size_t kSnapshotEntitiesPerPacket = 88;
+constexpr std::size_t kMaxSnapshotChunks =
+  (kInvalidEntity + kSnapshotEntitiesPerPacket - 1) /
+  kSnapshotEntitiesPerPacket;
+
+// Server side of the world snapshot. Build() records the fixed-step frame
+// into every chunk's history; SendTo() sends each chunk as a delta against
+// the client's newest ack. The frame number doubles as the delta sequence;
+// the server tick stamps when the frame was due, dropped ticks included.
+class WorldSnapshotEncoder {
+ public:
+  // |entities| supplies eids and |ships| the kinematics at the same index.
+  void Build(const std::vector<Entity>& entities,
+             const socketwire_examples::ShipArrays& ships, std::uint32_t tick,
+             std::uint32_t frame_number);
+  // |acks| holds the client's newest ack per chunk and grows with the world.
+  void SendTo(socketwire::ReliableConnection* connection,
+              std::vector<socketwire_examples::DeltaBaseline>& acks);
+
+ private:
+  std::vector<socketwire_examples::SnapshotDeltaSender<6>> chunks_;
+  std::vector<socketwire_examples::DeltaFrame<6>*> frames_;
+  std::uint32_t tick_ = 0;
+};
+
+// Client side of the world snapshot. Read() rebuilds the chunk a packet
+// carries and queues its ack; FlushAcks() sends the queued acks.
+class WorldSnapshotDecoder {
+ public:
+  // Replaces |entries| with the chunk's full state. Returns false when the
+  // packet is truncated, references a lost baseline or is older than the
+  // chunk state already applied.
+  bool Read(const void* data, std::size_t size,
+            std::vector<SnapshotEntity>& entries, std::uint32_t& tick,
+            std::uint32_t& frame_number);
+  void FlushAcks(socketwire::ReliableConnection* connection);
+
+ private:
+  void QueueAck(std::uint16_t chunk, std::uint32_t frame_number);
+
+  std::vector<socketwire_examples::SnapshotDeltaReceiver<6>> chunks_;
+  std::vector<std::pair<std::uint16_t, std::uint32_t>> pendingAcks_;
+};
 
 MessageType GetPacketType(const void* data, std::size_t size);
 
 bool DeserializeNewEntity(const void* data, std::size_t size, Entity& ent);
 bool DeserializeSetControlledEntity(const void* data, std::size_t size,
                                     std::uint16_t& eid);
+// |inputs| gets the packet's inputs newest first.
 bool DeserializeEntityInput(const void* data, std::size_t size,
-                            std::uint16_t& eid, float& thr, float& steer);
-bool DeserializeSnapshot(const void* data, std::size_t size, std::uint16_t& eid,
-                         float& x, float& y, float& ori, float& vx, float& vy,
-                         float& omega, TimePoint& timestamp,
-                         std::uint32_t& frame_number);
-bool DeserializeTimeMsec(const void* data, std::size_t size,
-                         std::uint32_t& time_msec);
+                            std::uint16_t& eid, std::uint32_t& newest_frame,
+                            std::vector<ShipInput>& inputs);
+bool DeserializeSnapshotAck(const void* data, std::size_t size,
+                            std::uint16_t& chunk, std::uint32_t& frame_number);
+bool DeserializeClockRequest(const void* data, std::size_t size,
+                             std::uint64_t& stamp);
+bool DeserializeClockReply(const void* data, std::size_t size,
+                           std::uint64_t& stamp, std::int64_t& server_micros);
+bool DeserializeInputAck(const void* data, std::size_t size,
+                         std::uint32_t& frame_number,
+                         std::uint32_t& input_frame);
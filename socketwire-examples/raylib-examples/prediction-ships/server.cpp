@@ -1,23 +1,41 @@
-#include <algorithm>
 #include <chrono>
 #include <cstdio>
-#include <map>
+#include <optional>
 #include <random>
-#include <thread>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "client_states.hpp"
+#include "clock_sync.hpp"
 #include "entity.h"
+#include "entity_registry.hpp"
 #include "mathUtils.h"
+#include "parallel_for.hpp"
 #include "protocol.h"
 #include "server_connection_hub.hpp"
+#include "ship_soa.hpp"
 #include "socketwire_example_utils.hpp"
+#include "tick_scheduler.hpp"
 
 static std::uint32_t frame_counter = 0;
+// Colour and eid per ship; the kinematics live in |ships| at the same index.
+// All three and |controllers| are parallel to ship_ids.Ids().
+static socketwire_examples::EntityRegistry<std::uint16_t> ship_ids(
+  kInvalidEntity);
 static std::vector<Entity> entities;
-static std::map<std::uint16_t,
-                socketwire_examples::ServerConnectionHub::Client*>
-  controlled_map;
+static socketwire_examples::ShipArrays ships;
+static std::vector<socketwire_examples::ServerConnectionHub::Client*>
+  controllers;
+static WorldSnapshotEncoder snapshot_encoder;
+
+// The client's snapshot acks per chunk and, once it has joined, the ship it
+// controls and the inputs it has sent for coming steps.
+struct ClientState {
+  std::vector<socketwire_examples::DeltaBaseline> acks;
+  std::uint16_t eid = kInvalidEntity;
+  ShipInputBuffer buffer;
+};
+static socketwire_examples::ClientStates<ClientState> client_states;
 
 static std::mt19937& RandomGenerator() {
   static std::random_device random_device;
@@ -47,10 +65,11 @@ static std::uint32_t RandomShipColor() {
   return colors[RandomInt(0, 5)];
 }
 
-static std::uint16_t NextEntityId() {
-  std::uint16_t max_eid = entities.empty() ? kInvalidEntity : entities[0].eid;
-  for (const Entity& e : entities) max_eid = std::max(max_eid, e.eid);
-  return static_cast<std::uint16_t>(max_eid + 1);
+// Ship |index| with its current kinematics, for reliable introductions.
+static Entity ShipEntity(std::size_t index) {
+  Entity ent = entities[index];
+  ships.Load(index, ent);
+  return ent;
 }
 
 static void BroadcastEntity(socketwire_examples::ServerConnectionHub& hub,
@@ -63,13 +82,21 @@ static void BroadcastEntity(socketwire_examples::ServerConnectionHub& hub,
   }
 }
 
+// A client that joins again keeps its ship; a second one would be orphaned.
 static void OnJoin(socketwire_examples::ServerConnectionHub& hub,
                    socketwire_examples::ServerConnectionHub::Client& client) {
-  for (const Entity& ent : entities) {
-    SendNewEntity(client.connection.get(), ent);
+  ClientState& state = client_states.Emplace(client);
+  if (state.eid != kInvalidEntity) {
+    SendSetControlledEntity(client.connection.get(), state.eid);
+    return;
   }
 
-  const std::uint16_t new_eid = NextEntityId();
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    SendNewEntity(client.connection.get(), ShipEntity(i));
+  }
+
+  const std::optional<std::uint16_t> new_eid = ship_ids.Create();
+  if (!new_eid) return;
   const std::uint32_t color = RandomShipColor();
 
   Entity ent;
@@ -82,50 +109,107 @@ static void OnJoin(socketwire_examples::ServerConnectionHub& hub,
   ent.omega = 0.f;
   ent.thr = 0.f;
   ent.steer = 0.f;
-  ent.eid = new_eid;
+  ent.eid = *new_eid;
   entities.push_back(ent);
-  controlled_map[new_eid] = &client;
+  ships.Add(ent);
+  controllers.push_back(&client);
+  state.eid = *new_eid;
 
   BroadcastEntity(hub, ent);
-  SendSetControlledEntity(client.connection.get(), new_eid);
+  SendSetControlledEntity(client.connection.get(), *new_eid);
 }
 
-static void OnInput(const void* data, std::size_t size) {
+// Every packet repeats the client's last few frames, so a lost packet costs
+// nothing as long as a later one arrives before the step that needs it.
+static void OnInput(socketwire_examples::ServerConnectionHub::Client& client,
+                    const void* data, std::size_t size) {
+  static std::vector<ShipInput> inputs;
   std::uint16_t eid = kInvalidEntity;
-  float thr = 0.f;
-  float steer = 0.f;
-  if (!DeserializeEntityInput(data, size, eid, thr, steer)) return;
-
-  for (Entity& e : entities) {
-    if (e.eid == eid) {
-      e.thr = thr;
-      e.steer = steer;
-      return;
-    }
+  std::uint32_t newest_frame = 0;
+  if (!DeserializeEntityInput(data, size, eid, newest_frame, inputs)) return;
+
+  // Clients may only steer the ship they control.
+  const std::optional<std::size_t> index = ship_ids.IndexOf(eid);
+  if (!index || controllers[*index] != &client) return;
+  ClientState* state = client_states.Find(client);
+  if (state == nullptr) return;
+  for (std::size_t age = 0; age < inputs.size(); ++age) {
+    state->buffer.Offer(newest_frame - static_cast<std::uint32_t>(age),
+                        inputs[age]);
   }
 }
 
-static void SimulateWorld(socketwire_examples::ServerConnectionHub& hub,
-                          float dt) {
-  const TimePoint cur_time = std::chrono::steady_clock::now();
-  for (Entity& e : entities) {
-    SimulateEntity(e, dt);
-    for (auto* client : hub.Clients()) {
-      if (client != nullptr && client->connection != nullptr &&
-          client->connection->IsConnected()) {
-        SendSnapshot(client->connection.get(), e.eid, e.x, e.y, e.ori, e.vx,
-                     e.vy, e.omega, cur_time, frame_counter);
-      }
-    }
+// Each controlled ship takes exactly one buffered input per fixed step.
+static void ConsumeInputs() {
+  for (const auto& entry : client_states.Entries()) {
+    ClientState& state = entry->state;
+    const std::optional<std::size_t> index = ship_ids.IndexOf(state.eid);
+    if (!index) continue;
+    const ShipInput& input = state.buffer.Consume();
+    ships.thr[*index] = input.thr;
+    ships.steer[*index] = input.steer;
   }
 }
 
-static void UpdateTime(socketwire_examples::ServerConnectionHub& hub,
-                       std::uint32_t cur_time) {
+static constexpr std::chrono::milliseconds kPollInterval{1};
+
+// Ships per simulation chunk; smaller worlds stay on the network thread.
+static constexpr std::size_t kMinShipsPerChunk = 4096;
+
+// Same bits as SimulateEntity() per ship, which the clients predict with,
+// however the ships are split across threads.
+static void SimulateWorld(socketwire_examples::ParallelFor& parallel,
+                          float dt) {
+  ConsumeInputs();
+  parallel.Run(ships.Size(), kMinShipsPerChunk,
+               [dt](std::size_t, std::size_t begin, std::size_t end) {
+                 socketwire_examples::IntegrateShips(ships, kShipTuning, dt,
+                                                     begin, end);
+               });
+}
+
+static void OnSnapshotAck(
+  socketwire_examples::ServerConnectionHub::Client& client, const void* data,
+  std::size_t size) {
+  std::uint16_t chunk = 0;
+  std::uint32_t frame_number = 0;
+  if (!DeserializeSnapshotAck(data, size, chunk, frame_number)) return;
+  // Acks for frames not sent yet would pin a baseline the client never saw.
+  if (static_cast<std::int32_t>(frame_counter - frame_number) < 0) return;
+  if (chunk >= kMaxSnapshotChunks) return;
+
+  auto& acks = client_states.Emplace(client).acks;
+  if (acks.size() <= chunk) acks.resize(chunk + 1u);
+  acks[chunk].Acknowledge(frame_number);
+}
+
+// Answered as soon as the request is read, so the reply time sits halfway
+// through the client's measured round trip.
+static void OnClockRequest(
+  socketwire_examples::ServerConnectionHub::Client& client, const void* data,
+  std::size_t size, std::chrono::steady_clock::time_point start) {
+  std::uint64_t stamp = 0;
+  if (!DeserializeClockRequest(data, size, stamp)) return;
+  SendClockReply(client.connection.get(), stamp,
+                 socketwire_examples::ServerMicrosSince(start));
+}
+
+// Every chunk is sent as a delta against the client's newest ack; clients
+// with the same acks share one encoding. Each client also learns which of
+// its input frames this frame applied to its ship.
+static void BroadcastWorld(socketwire_examples::ServerConnectionHub& hub,
+                           std::uint64_t tick) {
+  snapshot_encoder.Build(entities, ships, static_cast<std::uint32_t>(tick),
+                         frame_counter);
   for (auto* client : hub.Clients()) {
-    if (client != nullptr && client->connection != nullptr &&
-        client->connection->IsConnected()) {
-      SendTimeMsec(client->connection.get(), cur_time);
+    if (client == nullptr || client->connection == nullptr ||
+        !client->connection->IsConnected()) {
+      continue;
+    }
+    ClientState& state = client_states.Emplace(*client);
+    snapshot_encoder.SendTo(client->connection.get(), state.acks);
+    if (const auto input_frame = state.buffer.LastConsumed()) {
+      SendInputAck(client->connection.get(), frame_counter, *input_frame);
     }
   }
 }
@@ -136,6 +220,10 @@ int main(int argc, const char** argv) {
   socketwire_examples::benchmark::MetricsCollector metrics(
     bench_options, "prediction-ships", "socketwire", "server");
   socketwire_examples::benchmark::SetActiveCollector(&metrics);
+  metrics.SetDefaultTickBudgetMs(kFixedDt * 1000.0);
+  socketwire_examples::ParallelFor parallel(
+    socketwire_examples::ParallelFor::ResolveWorkers(
+      bench_options.simWorkers));
 
   const std::uint16_t listen_port =
     bench_options.enabled
@@ -151,11 +239,13 @@ int main(int argc, const char** argv) {
   socketwire_examples::ServerConnectionHub hub(socket.get(), cfg);
 
   hub.SetDisconnectedCallback([](auto& client) {
-    for (auto& entry : controlled_map) {
-      if (entry.second == &client) entry.second = nullptr;
+    for (auto*& controller : controllers) {
+      if (controller == &client) controller = nullptr;
     }
+    client_states.Erase(client);
   });
 
+  const auto start = std::chrono::steady_clock::now();
   hub.SetPacketCallback(
     [&](auto& client, std::uint8_t, const void* data, std::size_t size, bool) {
       socketwire_examples::benchmark::RecordPayloadRx(size);
@@ -164,66 +254,88 @@ int main(int argc, const char** argv) {
           OnJoin(hub, client);
           break;
         case kEClientToServerInput:
-          OnInput(data, size);
+          OnInput(client, data, size);
+          break;
+        case kEClientToServerSnapshotAck:
+          OnSnapshotAck(client, data, size);
+          break;
+        case kEClientToServerClockRequest:
+          OnClockRequest(client, data, size, start);
           break;
         case kEServerToClientNewEntity:
         case kEServerToClientSetControlledEntity:
         case kEServerToClientSnapshot:
-        case kEServerToClientTimeMsec:
+        case kEServerToClientInputAck:
+        case kEServerToClientClockReply:
           break;
       }
     });
 
-  const auto start = std::chrono::steady_clock::now();
-  auto last_time = start;
-  float accumulated_time_ms = 0.f;
+  socketwire_examples::TickScheduler scheduler(
+    {.simInterval = kTickInterval, .pollInterval = kPollInterval}, start);
   frame_counter = 0;
 
   while (true) {
     if (bench_options.enabled && metrics.Done()) break;
-    const auto frame_start = std::chrono::steady_clock::now();
-    const auto cur_time = std::chrono::steady_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                           cur_time - last_time)
-                           .count();
-    last_time = cur_time;
-    accumulated_time_ms += static_cast<float>(elapsed);
-
-    if (accumulated_time_ms >= kFixedDt * 1000.f) {
-      const auto update_start = std::chrono::steady_clock::now();
-      SimulateWorld(hub, kFixedDt);
+    // Input is polled between fixed steps too, so it waits at most one poll
+    // interval for the next step instead of a whole step for the next poll.
+    const std::uint32_t steps = scheduler.WaitNext();
+    if (steps == 0) {
       hub.Poll();
       hub.Update();
-      const auto elapsed_ms =
-        std::chrono::duration_cast<std::chrono::milliseconds>(cur_time - start)
-          .count();
-      UpdateTime(hub, static_cast<std::uint32_t>(elapsed_ms));
-
+      continue;
+    }
+    metrics.RecordTickPacing(scheduler.LastLateness(), steps,
+                             scheduler.LastDropped());
+    const auto frame_start = std::chrono::steady_clock::now();
+    const auto update_start = frame_start;
+    metrics.BeginTick();
+    hub.Poll();
+    hub.Update();
+    metrics.MarkTickPhase(socketwire_examples::benchmark::TickPhase::kPoll);
+    for (std::uint32_t step = 0; step < steps; ++step) {
+      SimulateWorld(parallel, kFixedDt);
       ++frame_counter;
-      accumulated_time_ms -= kFixedDt * 1000.f;
-      const auto update_end = std::chrono::steady_clock::now();
-      if (bench_options.enabled) {
-        const auto clients = hub.Clients();
-        metrics.SetConnectedClients(static_cast<int>(clients.size()));
-        metrics.SetNetworkStats(
-          socketwire_examples::benchmark::StatsFromClients(clients));
-        metrics.RecordUpdateMs(
-          static_cast<double>(
-            std::chrono::duration_cast<std::chrono::microseconds>(update_end -
-                                                                  update_start)
-              .count()) /
-          1000.0);
-        metrics.RecordFrameMs(
-          static_cast<double>(
-            std::chrono::duration_cast<std::chrono::microseconds>(
-              std::chrono::steady_clock::now() - frame_start)
-              .count()) /
-          1000.0);
-        metrics.MaybeWriteSample();
+    }
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kSimulate);
+    BroadcastWorld(hub, scheduler.CurrentTick());
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kBroadcast);
+    const auto update_end = std::chrono::steady_clock::now();
+    if (bench_options.enabled) {
+      const auto clients = hub.Clients();
+      metrics.SetConnectedClients(static_cast<int>(clients.size()));
+      metrics.SetNetworkStats(
+        socketwire_examples::benchmark::StatsFromClients(clients));
+      socketwire_examples::benchmark::GameMetrics game_metrics;
+      game_metrics.entityCountServer = entities.size();
+      std::size_t players = 0;
+      for (const auto& entry : client_states.Entries()) {
+        if (entry->state.eid == kInvalidEntity) continue;
+        ++players;
+        game_metrics.inputBufferDepth += entry->state.buffer.Depth();
+        game_metrics.inputStarvationCount += entry->state.buffer.Starved();
       }
+      if (players != 0) {
+        game_metrics.inputBufferDepth /= static_cast<double>(players);
+      }
+      metrics.SetGameMetrics(game_metrics);
+      metrics.RecordUpdateMs(
+        static_cast<double>(
+          std::chrono::duration_cast<std::chrono::microseconds>(update_end -
+                                                                update_start)
+            .count()) /
+        1000.0);
+      metrics.RecordFrameMs(
+        static_cast<double>(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - frame_start)
+            .count()) /
+        1000.0);
+      metrics.MaybeWriteSample();
     }
-
-    std::this_thread::sleep_for(std::chrono::microseconds(200000));
+    metrics.EndTick();
   }
 
   metrics.Finish();
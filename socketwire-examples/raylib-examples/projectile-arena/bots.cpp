@@ -0,0 +1,257 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <print>
+#include <utility>
+
+#include "benchmark_utils.hpp"
+#include "bot_driver.hpp"
+#include "protocol.hpp"
+#include "reliable_connection.hpp"
+#include "socketwire_example_utils.hpp"
+
+using namespace socketwire;  // NOLINT
+
+namespace {
+
+class ArenaBot final : public IReliableConnectionHandler {
+ public:
+  ArenaBot(socketwire_examples::ResolvedEndpoint endpoint, std::uint16_t port,
+           std::uint32_t seed)
+      : endpoint_(std::move(endpoint)), port_(port), seed_(seed) {}
+
+  bool Start() {
+    socket_ = socketwire_examples::CreateUdpSocket(0);
+    if (socket_ == nullptr) return false;
+
+    ReliableConnectionConfig cfg;
+    cfg.numChannels = 2;
+    connection_ = std::make_unique<ReliableConnection>(socket_.get(), cfg);
+    connection_->SetHandler(this);
+    (void)socketwire_examples::ConnectNextAddress(*connection_, endpoint_,
+                                                  port_);
+    nextConnectAttempt_ =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
+    return true;
+  }
+
+  void Step(std::uint64_t frame) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!connected_ && now >= nextConnectAttempt_) {
+      (void)socketwire_examples::ConnectNextAddress(*connection_, endpoint_,
+                                                    port_);
+      nextConnectAttempt_ = now + std::chrono::milliseconds(250);
+    }
+    connection_->Poll();
+    connection_->Update();
+    FlushSnapshotAck();
+
+    if (connected_ && !joinSent_) {
+      auto join = projectile_arena::MakeJoin();
+      joinSent_ = connection_->SendReliable(0, join);
+      if (joinSent_) {
+        socketwire_examples::benchmark::RecordPayloadTx(join.GetSizeBytes());
+        ++appSentPackets_;
+      }
+    }
+
+    if (welcomed_) {
+      projectile_arena::InputState input;
+      input.tick = tick_;
+      input.axisX =
+        socketwire_examples::benchmark::DeterministicAxis(seed_, frame, 0);
+      input.axisY =
+        socketwire_examples::benchmark::DeterministicAxis(seed_, frame, 1);
+      auto input_packet = projectile_arena::MakeInput(input);
+      if (connection_->SendUnreliable(1, input_packet)) {
+        socketwire_examples::benchmark::RecordPayloadTx(
+          input_packet.GetSizeBytes());
+        ++appSentPackets_;
+      }
+
+      if (frame % 30 == 0) {
+        projectile_arena::FireCommand fire;
+        // Bots look at the newest snapshot as it arrives.
+        fire.viewTick = lastSnapshotTick_;
+        fire.aimX = 450.0f + 220.0f * input.axisX;
+        fire.aimY = 300.0f + 180.0f * input.axisY;
+        auto fire_packet = projectile_arena::MakeFire(fire);
+        if (connection_->SendUnsequenced(0, fire_packet)) {
+          socketwire_examples::benchmark::RecordPayloadTx(
+            fire_packet.GetSizeBytes());
+          ++appSentPackets_;
+          ++fireCommandSent_;
+        }
+      }
+    }
+    ++tick_;
+  }
+
+  void Collect(socketwire_examples::benchmark::BotSample& sample) const {
+    sample.AddConnection(*connection_);
+    socketwire_examples::benchmark::GameMetrics game;
+    game.appSentPackets = appSentPackets_;
+    game.appReceivedPackets = appReceivedPackets_;
+    game.appReorderedPackets = appReorderedPackets_;
+    game.joinSuccessCount = welcomed_ ? 1 : 0;
+    game.entityCountClient = playerCount_;
+    game.projectileSpawnCountClient = observedProjectileIds_.count();
+    game.fireCommandSent = fireCommandSent_;
+    game.duplicateProjectileCount = duplicateProjectileCount_;
+    game.nanPositionCount = nanPositionCount_;
+    game.infPositionCount = infPositionCount_;
+    game.malformedPacketsAccepted = malformedPacketsAccepted_;
+    sample.MergeGame(game);
+  }
+
+  void Disconnect() { connection_->Disconnect(); }
+
+  void OnConnected() override { connected_ = true; }
+  void OnDisconnected() override { connected_ = false; }
+
+  void OnReliableReceived(std::uint8_t, const void* data,
+                          std::size_t size) override {
+    socketwire_examples::benchmark::RecordPayloadRx(size);
+    ++appReceivedPackets_;
+
+    BitStream& stream = stream_;
+    socketwire_examples::LoadPacket(stream, data, size);
+    projectile_arena::MessageType type{};
+    if (!projectile_arena::ReadType(stream, type)) {
+      ++malformedPacketsAccepted_;
+      return;
+    }
+
+    if (type == projectile_arena::MessageType::kWelcome) {
+      std::uint16_t id = 0;
+      if (projectile_arena::ReadWelcome(stream, id)) welcomed_ = true;
+      return;
+    }
+
+    if (type == projectile_arena::MessageType::kSnapshot) {
+      const auto status =
+        projectile_arena::ReadSnapshot(stream, snapshotReceiver_, snapshot_);
+      if (status == socketwire_examples::DeltaReadStatus::kOk) {
+        NoteSnapshot();
+        QueueSnapshotAck(snapshot_.tick);
+      } else if (status == socketwire_examples::DeltaReadStatus::kMalformed) {
+        ++malformedPacketsAccepted_;
+      }
+    }
+  }
+
+  void OnUnreliableReceived(std::uint8_t channel, const void* data,
+                            std::size_t size) override {
+    OnReliableReceived(channel, data, size);
+  }
+
+ private:
+  void QueueSnapshotAck(std::uint32_t tick) {
+    if (!pendingSnapshotAck_ ||
+        static_cast<std::int32_t>(tick - *pendingSnapshotAck_) > 0) {
+      pendingSnapshotAck_ = tick;
+    }
+  }
+
+  void FlushSnapshotAck() {
+    if (!pendingSnapshotAck_) return;
+    auto ack = projectile_arena::MakeSnapshotAck(*pendingSnapshotAck_);
+    pendingSnapshotAck_.reset();
+    if (connection_->SendUnreliable(1, ack)) {
+      socketwire_examples::benchmark::RecordPayloadTx(ack.GetSizeBytes());
+      ++appSentPackets_;
+    }
+  }
+
+  void NoteSnapshot() {
+    if (hasSnapshot_ && snapshot_.tick < lastSnapshotTick_) {
+      ++appReorderedPackets_;
+    }
+    hasSnapshot_ = true;
+    lastSnapshotTick_ = snapshot_.tick;
+    playerCount_ = snapshot_.players.size();
+
+    duplicateProjectileCount_ +=
+      projectile_arena::NoteProjectileIds(snapshot_, observedProjectileIds_);
+    for (const auto& projectile : snapshot_.projectiles) {
+      NotePosition(projectile.x, projectile.y);
+    }
+    for (const auto& player : snapshot_.players) {
+      NotePosition(player.x, player.y);
+    }
+  }
+
+  void NotePosition(float x, float y) {
+    if (std::isnan(x) || std::isnan(y)) ++nanPositionCount_;
+    if (std::isinf(x) || std::isinf(y)) ++infPositionCount_;
+  }
+
+  socketwire_examples::ResolvedEndpoint endpoint_;
+  std::uint16_t port_ = projectile_arena::kKPort;
+  std::uint32_t seed_ = 1;
+  std::unique_ptr<ISocket> socket_;
+  std::unique_ptr<ReliableConnection> connection_;
+  std::chrono::steady_clock::time_point nextConnectAttempt_{};
+  bool connected_ = false;
+  bool joinSent_ = false;
+  bool welcomed_ = false;
+  std::uint32_t tick_ = 0;
+  // Reused for every received packet and snapshot.
+  BitStream stream_;
+  projectile_arena::WorldSnapshot snapshot_;
+  projectile_arena::SnapshotReceiver snapshotReceiver_{
+    projectile_arena::kSnapshotSchema};
+  std::optional<std::uint32_t> pendingSnapshotAck_;
+  bool hasSnapshot_ = false;
+  std::uint32_t lastSnapshotTick_ = 0;
+  std::size_t playerCount_ = 0;
+  projectile_arena::ProjectileIdSet observedProjectileIds_;
+  std::uint64_t appSentPackets_ = 0;
+  std::uint64_t appReceivedPackets_ = 0;
+  std::uint64_t appReorderedPackets_ = 0;
+  std::uint64_t fireCommandSent_ = 0;
+  std::uint64_t duplicateProjectileCount_ = 0;
+  std::uint64_t malformedPacketsAccepted_ = 0;
+  std::uint64_t nanPositionCount_ = 0;
+  std::uint64_t infPositionCount_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, const char** argv) {
+  auto bench_options = socketwire_examples::benchmark::ParseOptions(
+    argc, argv, projectile_arena::kKPort);
+  bench_options.enabled = true;
+  socketwire_examples::benchmark::MetricsCollector metrics(
+    bench_options, "projectile-arena", "socketwire", "bots");
+
+  auto server_endpoint = socketwire_examples::ResolveEndpoint(
+    bench_options.host, bench_options.port);
+  if (!server_endpoint) {
+    std::println("cannot resolve host '{}'", bench_options.host);
+    return 1;
+  }
+
+  using Driver = socketwire_examples::benchmark::BotDriver<ArenaBot>;
+  const int threads = Driver::DefaultThreadCount(bench_options);
+  Driver driver(metrics, threads);
+  const int spawned = driver.Spawn(
+    bench_options.clients, [&](int index) -> std::unique_ptr<ArenaBot> {
+      auto bot = std::make_unique<ArenaBot>(
+        *server_endpoint, bench_options.port,
+        bench_options.seed + static_cast<std::uint32_t>(index));
+      if (!bot->Start()) return nullptr;
+      return bot;
+    });
+  std::println(
+    "projectile-arena bots: {}/{} bots on {} threads against {}:{}", spawned,
+    bench_options.clients, threads, bench_options.host,
+    static_cast<unsigned>(bench_options.port));
+  if (spawned == 0) return 1;
+
+  driver.Run();
+  metrics.Finish();
+  return 0;
+}
@@ -2,12 +2,13 @@
 #include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <optional>
 #include <print>
 #include <thread>
-#include <utility>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "interpolation_buffer.hpp"
 #include "protocol.hpp"
 #include "raylib.h"
 #include "reliable_connection.hpp"
@@ -19,15 +20,32 @@ namespace {
 
 constexpr float kKPlayerRadius = 15.0f;
 constexpr float kKProjectileDrawRadius = 6.0f;
+// Farther than this between two snapshots is a jump, not movement.
+constexpr float kKTeleportDistance = 60.0f;
+constexpr double kKSnapshotIntervalMs =
+  std::chrono::duration<double, std::milli>(projectile_arena::kSnapshotInterval)
+    .count();
 
 struct ClientState {
   bool connected = false;
   bool welcomed = false;
   std::uint16_t playerId = 0;
+  // Newest snapshot received.
   projectile_arena::WorldSnapshot snapshot;
+  // What is drawn: the buffered snapshots around the playout time, blended.
+  projectile_arena::WorldSnapshot view;
+  // Snapshot tick |view| shows, fractional while it blends two snapshots;
+  // shots carry it so the server can judge them against this view.
+  double viewTime = 0.0;
+  socketwire_examples::InterpolationBuffer<projectile_arena::WorldSnapshot>
+    snapshotBuffer{socketwire_examples::PlayoutConfig{
+      .snapshotIntervalMs = kKSnapshotIntervalMs}};
   bool hasSnapshot = false;
   std::uint32_t lastSnapshotTick = 0;
-  std::vector<std::uint16_t> observedProjectileIds;
+  projectile_arena::SnapshotReceiver snapshotReceiver{
+    projectile_arena::kSnapshotSchema};
+  std::optional<std::uint32_t> pendingSnapshotAck;
+  projectile_arena::ProjectileIdSet observedProjectileIds;
   std::uint64_t appSentPackets = 0;
   std::uint64_t appReceivedPackets = 0;
   std::uint64_t appReorderedPackets = 0;
@@ -46,21 +64,9 @@ void NoteSnapshot(ClientState& state,
   state.hasSnapshot = true;
   state.lastSnapshotTick = snapshot.tick;
 
-  std::vector<std::uint16_t> ids_in_snapshot;
-  ids_in_snapshot.reserve(snapshot.projectiles.size());
+  state.duplicateProjectileCount +=
+    projectile_arena::NoteProjectileIds(snapshot, state.observedProjectileIds);
   for (const auto& projectile : snapshot.projectiles) {
-    if (std::ranges::find(ids_in_snapshot, projectile.id) !=
-        ids_in_snapshot.end()) {
-      ++state.duplicateProjectileCount;
-    } else {
-      ids_in_snapshot.push_back(projectile.id);
-    }
-
-    if (std::ranges::find(state.observedProjectileIds, projectile.id) ==
-        state.observedProjectileIds.end()) {
-      state.observedProjectileIds.push_back(projectile.id);
-    }
-
     if (std::isnan(projectile.x) || std::isnan(projectile.y)) {
       ++state.nanPositionCount;
     }
@@ -75,6 +81,57 @@ void NoteSnapshot(ClientState& state,
   }
 }
 
+// Entries of |to| moved |t| of the way from their place in |from|; both are
+// ordered by id, as snapshot records are.
+template <typename Entry>
+void BlendEntries(const std::vector<Entry>& from, const std::vector<Entry>& to,
+                  float t, std::vector<Entry>& out) {
+  out.clear();
+  for (const auto& next : to) {
+    Entry entry = next;
+    const auto previous =
+      std::ranges::lower_bound(from, next.id, {}, &Entry::id);
+    if (previous != from.end() && previous->id == next.id &&
+        std::hypot(next.x - previous->x, next.y - previous->y) <
+          kKTeleportDistance) {
+      entry.x = std::lerp(previous->x, next.x, t);
+      entry.y = std::lerp(previous->y, next.y, t);
+    }
+    out.push_back(entry);
+  }
+}
+
+void UpdateView(ClientState& state, std::chrono::steady_clock::time_point now) {
+  const auto frame = state.snapshotBuffer.Sample(now);
+  if (frame.to == nullptr) return;
+  state.view.tick = frame.to->tick;
+  state.viewTime =
+    frame.from->tick +
+    std::min(frame.t, 1.0f) * static_cast<double>(frame.to->tick -
+                                                   frame.from->tick);
+  BlendEntries(frame.from->players, frame.to->players, frame.t,
+               state.view.players);
+  BlendEntries(frame.from->projectiles, frame.to->projectiles, frame.t,
+               state.view.projectiles);
+}
+
+void QueueSnapshotAck(ClientState& state, std::uint32_t tick) {
+  if (!state.pendingSnapshotAck ||
+      static_cast<std::int32_t>(tick - *state.pendingSnapshotAck) > 0) {
+    state.pendingSnapshotAck = tick;
+  }
+}
+
+void FlushSnapshotAck(ReliableConnection& connection, ClientState& state) {
+  if (!state.pendingSnapshotAck) return;
+  auto ack = projectile_arena::MakeSnapshotAck(*state.pendingSnapshotAck);
+  state.pendingSnapshotAck.reset();
+  if (connection.SendUnreliable(1, ack)) {
+    socketwire_examples::benchmark::RecordPayloadTx(ack.GetSizeBytes());
+    ++state.appSentPackets;
+  }
+}
+
 class ClientHandler final : public IReliableConnectionHandler {
  public:
   explicit ClientHandler(ClientState& state) : state_(state) {}
@@ -87,7 +144,8 @@ class ClientHandler final : public IReliableConnectionHandler {
     socketwire_examples::benchmark::RecordPayloadRx(size);
     ++state_.appReceivedPackets;
 
-    BitStream stream(static_cast<const std::uint8_t*>(data), size);
+    BitStream& stream = stream_;
+    socketwire_examples::LoadPacket(stream, data, size);
     projectile_arena::MessageType type{};
     if (!projectile_arena::ReadType(stream, type)) {
       ++state_.malformedPacketsAccepted;
@@ -104,11 +162,19 @@ class ClientHandler final : public IReliableConnectionHandler {
     }
 
     if (type == projectile_arena::MessageType::kSnapshot) {
-      projectile_arena::WorldSnapshot snapshot;
-      if (projectile_arena::ReadSnapshot(stream, snapshot)) {
+      // Decoded in place; copying into the buffer slot reuses its vectors.
+      const auto status = projectile_arena::ReadSnapshot(
+        stream, state_.snapshotReceiver, state_.snapshot);
+      if (status == socketwire_examples::DeltaReadStatus::kOk) {
+        const auto& snapshot = state_.snapshot;
         NoteSnapshot(state_, snapshot);
-        state_.snapshot = std::move(snapshot);
-      } else {
+        QueueSnapshotAck(state_, snapshot.tick);
+        if (auto* slot = state_.snapshotBuffer.Push(
+              static_cast<double>(snapshot.tick) * kKSnapshotIntervalMs,
+              std::chrono::steady_clock::now())) {
+          *slot = snapshot;
+        }
+      } else if (status == socketwire_examples::DeltaReadStatus::kMalformed) {
         ++state_.malformedPacketsAccepted;
       }
     }
@@ -121,6 +187,7 @@ class ClientHandler final : public IReliableConnectionHandler {
 
  private:
   ClientState& state_;
+  BitStream stream_;
 };
 
 Color PlayerColor(std::uint16_t id, std::uint16_t local_id) {
@@ -159,7 +226,7 @@ void DrawHealthBar(const projectile_arena::PlayerSnapshot& player) {
 }
 
 Vector2 LocalPlayerPosition(const ClientState& state) {
-  for (const auto& player : state.snapshot.players) {
+  for (const auto& player : state.view.players) {
     if (player.id == state.playerId) return Vector2{player.x, player.y};
   }
   return Vector2{450.0f, 300.0f};
@@ -173,12 +240,14 @@ socketwire_examples::benchmark::GameMetrics CollectGameMetrics(
   game.appReorderedPackets = state.appReorderedPackets;
   game.joinSuccessCount = state.welcomed ? 1 : 0;
   game.entityCountClient = state.snapshot.players.size();
-  game.projectileSpawnCountClient = state.observedProjectileIds.size();
+  game.projectileSpawnCountClient = state.observedProjectileIds.count();
   game.fireCommandSent = state.fireCommandSent;
   game.duplicateProjectileCount = state.duplicateProjectileCount;
   game.nanPositionCount = state.nanPositionCount;
   game.infPositionCount = state.infPositionCount;
   game.malformedPacketsAccepted = state.malformedPacketsAccepted;
+  game.interpolationDelayMs = state.snapshotBuffer.DelayMs();
+  game.interpolationUnderflowCount = state.snapshotBuffer.Underflows();
   return game;
 }
 
@@ -242,6 +311,8 @@ int main(int argc, const char** argv) {
     }
     connection.Poll();
     connection.Update();
+    FlushSnapshotAck(connection, state);
+    UpdateView(state, std::chrono::steady_clock::now());
 
     if (state.connected && !join_sent) {
       auto join = projectile_arena::MakeJoin();
@@ -282,7 +353,9 @@ int main(int argc, const char** argv) {
                                           300.0f + 180.0f * input.axisY}
                                 : GetMousePosition();
         projectile_arena::FireCommand fire;
-        fire.tick = tick;
+        fire.viewTick = static_cast<std::uint32_t>(state.viewTime);
+        fire.viewFraction =
+          static_cast<float>(state.viewTime - std::floor(state.viewTime));
         fire.aimX = mouse.x;
         fire.aimY = mouse.y;
         auto fire_packet = projectile_arena::MakeFire(fire);
@@ -303,7 +376,7 @@ int main(int argc, const char** argv) {
       ClearBackground(Color{245, 246, 242, 255});
       DrawRectangleLines(12, 12, 876, 576, Color{58, 66, 72, 255});
 
-      for (const auto& projectile : state.snapshot.projectiles) {
+      for (const auto& projectile : state.view.projectiles) {
         DrawCircleV(Vector2{projectile.x, projectile.y},
                     kKProjectileDrawRadius + 2.0f,
                     Color{58, 50, 36, 220});
@@ -311,7 +384,7 @@ int main(int argc, const char** argv) {
                     Color{236, 182, 50, 255});
       }
 
-      for (const auto& player : state.snapshot.players) {
+      for (const auto& player : state.view.players) {
         const auto color = PlayerColor(player.id, state.playerId);
         DrawHealthBar(player);
         DrawCircleV(Vector2{player.x, player.y}, kKPlayerRadius, color);
@@ -331,6 +404,12 @@ int main(int argc, const char** argv) {
       DrawText(
         state.connected ? "connected" : "connecting", 20, 44, 16,
         state.connected ? Color{34, 120, 76, 255} : Color{180, 92, 45, 255});
+      DrawText(TextFormat("interp %.0fms  jitter p95 %.1fms  underflows %llu",
+                          state.snapshotBuffer.DelayMs(),
+                          state.snapshotBuffer.JitterMs(),
+                          static_cast<unsigned long long>(
+                            state.snapshotBuffer.Underflows())),
+               20, 64, 16, Color{32, 38, 42, 255});
       EndDrawing();
     } else {
       const auto update_end = std::chrono::steady_clock::now();
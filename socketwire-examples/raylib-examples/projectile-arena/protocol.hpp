@@ -1,14 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <vector>
 
 #include "bit_stream.hpp"
+#include "quantisation.hpp"
+#include "snapshot_delta.hpp"
 
 namespace projectile_arena {
 
 constexpr std::uint16_t kKPort = 53477;
 constexpr std::uint16_t kKMaxHealth = 100;
+constexpr std::chrono::milliseconds kTickInterval{16};
+// Snapshots every third step, about 20 per second; their tick counts
+// snapshots, not steps.
+constexpr std::uint32_t kTicksPerSnapshot = 3;
+constexpr std::chrono::milliseconds kSnapshotInterval =
+  kTickInterval * kTicksPerSnapshot;
 
 enum class MessageType : std::uint8_t {
   kJoin = 1,
@@ -16,6 +29,7 @@ enum class MessageType : std::uint8_t {
   kInput = 3,
   kFire = 4,
   kSnapshot = 5,
+  kSnapshotAck = 6,
 };
 
 struct InputState {
@@ -24,8 +38,12 @@ struct InputState {
   float axisY = 0.0f;
 };
 
+// Fired while the shooter was drawing snapshot |viewTick| blended
+// |viewFraction| of the way to the next one; the server rewinds to that view
+// to judge the shot.
 struct FireCommand {
-  std::uint32_t tick = 0;
+  std::uint32_t viewTick = 0;
+  float viewFraction = 0.0f;
   float aimX = 0.0f;
   float aimY = 0.0f;
 };
@@ -44,12 +62,33 @@ struct ProjectileSnapshot {
   float y = 0.0f;
 };
 
+// Both sides keep one of these and refill it every snapshot, so its vectors
+// stop allocating once they have grown to the busiest tick.
 struct WorldSnapshot {
   std::uint32_t tick = 0;
   std::vector<PlayerSnapshot> players;
   std::vector<ProjectileSnapshot> projectiles;
 };
 
+// Projectile ids a client has seen, one bit per possible id.
+using ProjectileIdSet =
+  std::bitset<std::size_t{std::numeric_limits<std::uint16_t>::max()} + 1u>;
+
+// Marks |snapshot|'s projectiles in |observed| and returns how many repeat an
+// id already in the snapshot. Snapshots list projectiles by id, so a repeat
+// sits right after its twin.
+inline std::size_t NoteProjectileIds(const WorldSnapshot& snapshot,
+                                     ProjectileIdSet& observed) {
+  std::size_t duplicates = 0;
+  const ProjectileSnapshot* previous = nullptr;
+  for (const auto& projectile : snapshot.projectiles) {
+    if (previous != nullptr && previous->id == projectile.id) ++duplicates;
+    observed.set(projectile.id);
+    previous = &projectile;
+  }
+  return duplicates;
+}
+
 inline socketwire::BitStream MakeJoin() {
   socketwire::BitStream stream;
   stream.Write<std::uint8_t>(static_cast<std::uint8_t>(MessageType::kJoin));
@@ -75,33 +114,72 @@ inline socketwire::BitStream MakeInput(const InputState& input) {
 inline socketwire::BitStream MakeFire(const FireCommand& fire) {
   socketwire::BitStream stream;
   stream.Write<std::uint8_t>(static_cast<std::uint8_t>(MessageType::kFire));
-  stream.Write<std::uint32_t>(fire.tick);
+  stream.Write<std::uint32_t>(fire.viewTick);
+  stream.Write<std::uint8_t>(static_cast<std::uint8_t>(
+    std::clamp(fire.viewFraction, 0.0f, 1.0f) * 255.0f + 0.5f));
   stream.Write<float>(fire.aimX);
   stream.Write<float>(fire.aimY);
   return stream;
 }
 
-inline socketwire::BitStream MakeSnapshot(const WorldSnapshot& snapshot) {
-  socketwire::BitStream stream;
-  stream.Write<std::uint8_t>(static_cast<std::uint8_t>(MessageType::kSnapshot));
-  stream.Write<std::uint32_t>(snapshot.tick);
-  stream.Write<std::uint16_t>(
-    static_cast<std::uint16_t>(snapshot.players.size()));
+// Snapshots are delta-encoded against the newest tick the client acked.
+// Players and projectiles share one record list: the top id bit tells them
+// apart, and the third field is health for players and ownerId for
+// projectiles.
+using SnapshotSender = socketwire_examples::SnapshotDeltaSender<3>;
+using SnapshotReceiver = socketwire_examples::SnapshotDeltaReceiver<3>;
+
+// Positions cover the projectile culling bounds (players are clamped well
+// inside them) at about 0.06-unit steps.
+inline constexpr socketwire_examples::quantisation::BoundedFloat<14>
+  kSnapshotXCodec{-20.f, 920.f};
+inline constexpr socketwire_examples::quantisation::BoundedFloat<13>
+  kSnapshotYCodec{-20.f, 620.f};
+
+inline constexpr socketwire_examples::DeltaSchema<3> kSnapshotSchema{
+  .idBits = 17,
+  .fieldBits = {kSnapshotXCodec.kBits, kSnapshotYCodec.kBits, 16},
+};
+inline constexpr std::uint32_t kProjectileRecordBit = 1u << 16;
+
+// Sizes the frame's record vector once and fills it in place; history frames
+// keep their capacity, so this stops allocating after warmup.
+inline void RecordSnapshot(SnapshotSender& sender,
+                           const WorldSnapshot& snapshot) {
+  auto& records = sender.BeginFrame(snapshot.tick).records;
+  records.resize(snapshot.players.size() + snapshot.projectiles.size());
+  auto record = records.begin();
   for (const auto& player : snapshot.players) {
-    stream.Write<std::uint16_t>(player.id);
-    stream.Write<float>(player.x);
-    stream.Write<float>(player.y);
-    stream.Write<std::uint16_t>(player.health);
+    record->id = player.id;
+    record->fields = {kSnapshotXCodec.Quantise(player.x),
+                      kSnapshotYCodec.Quantise(player.y), player.health};
+    ++record;
   }
-
-  stream.Write<std::uint16_t>(
-    static_cast<std::uint16_t>(snapshot.projectiles.size()));
   for (const auto& projectile : snapshot.projectiles) {
-    stream.Write<std::uint16_t>(projectile.id);
-    stream.Write<std::uint16_t>(projectile.ownerId);
-    stream.Write<float>(projectile.x);
-    stream.Write<float>(projectile.y);
+    record->id = kProjectileRecordBit | projectile.id;
+    record->fields = {kSnapshotXCodec.Quantise(projectile.x),
+                      kSnapshotYCodec.Quantise(projectile.y),
+                      projectile.ownerId};
+    ++record;
   }
+  sender.Commit();
+}
+
+// Packet of the last recorded snapshot for a client whose newest ack is
+// |baseline|; clients with the same ack share the encoding.
+inline const socketwire::BitStream& SnapshotPacketFor(
+  SnapshotSender& sender, const socketwire_examples::DeltaBaseline& baseline) {
+  return sender.PacketFor(baseline, [](socketwire::BitStream& stream) {
+    stream.Write<std::uint8_t>(
+      static_cast<std::uint8_t>(MessageType::kSnapshot));
+  });
+}
+
+inline socketwire::BitStream MakeSnapshotAck(std::uint32_t tick) {
+  socketwire::BitStream stream;
+  stream.Write<std::uint8_t>(
+    static_cast<std::uint8_t>(MessageType::kSnapshotAck));
+  stream.Write<std::uint32_t>(tick);
   return stream;
 }
 
@@ -131,44 +209,60 @@ inline bool ReadInput(socketwire::BitStream& stream, InputState& input) {
 
 inline bool ReadFire(socketwire::BitStream& stream, FireCommand& fire) {
   const auto tick = stream.TryRead<std::uint32_t>();
+  const auto fraction = stream.TryRead<std::uint8_t>();
   const auto aim_x = stream.TryRead<float>();
   const auto aim_y = stream.TryRead<float>();
-  if (!tick || !aim_x || !aim_y) return false;
-  fire = FireCommand{*tick, *aim_x, *aim_y};
+  if (!tick || !fraction || !aim_x || !aim_y) return false;
+  fire = FireCommand{*tick, *fraction / 255.0f, *aim_x, *aim_y};
   return true;
 }
 
-inline bool ReadSnapshot(socketwire::BitStream& stream,
-                         WorldSnapshot& snapshot) {
-  const auto tick = stream.TryRead<std::uint32_t>();
-  const auto player_count = stream.TryRead<std::uint16_t>();
-  if (!tick || !player_count) return false;
-
-  snapshot = {};
-  snapshot.tick = *tick;
-  snapshot.players.reserve(*player_count);
-  for (std::uint16_t i = 0; i < *player_count; ++i) {
-    const auto id = stream.TryRead<std::uint16_t>();
-    const auto x = stream.TryRead<float>();
-    const auto y = stream.TryRead<float>();
-    const auto health = stream.TryRead<std::uint16_t>();
-    if (!id || !x || !y || !health) return false;
-    snapshot.players.push_back(PlayerSnapshot{*id, *x, *y, *health});
-  }
+inline bool ReadSnapshotAck(socketwire::BitStream& stream,
+                            std::uint32_t& tick) {
+  const auto value = stream.TryRead<std::uint32_t>();
+  if (!value) return false;
+  tick = *value;
+  return true;
+}
+
+// Rebuilds the snapshot a packet carries from the receiver's history. On kOk,
+// |snapshot| holds the full world at that tick and the tick should be acked.
+// Records are sorted by id, so players come before projectiles and both
+// vectors are sized once and filled in place.
+inline socketwire_examples::DeltaReadStatus ReadSnapshot(
+  socketwire::BitStream& stream, SnapshotReceiver& receiver,
+  WorldSnapshot& snapshot) {
+  const auto status = receiver.Read(stream);
+  if (status != socketwire_examples::DeltaReadStatus::kOk) return status;
 
-  const auto projectile_count = stream.TryRead<std::uint16_t>();
-  if (!projectile_count) return false;
-
-  snapshot.projectiles.reserve(*projectile_count);
-  for (std::uint16_t i = 0; i < *projectile_count; ++i) {
-    const auto id = stream.TryRead<std::uint16_t>();
-    const auto owner_id = stream.TryRead<std::uint16_t>();
-    const auto x = stream.TryRead<float>();
-    const auto y = stream.TryRead<float>();
-    if (!id || !owner_id || !x || !y) return false;
-    snapshot.projectiles.push_back(ProjectileSnapshot{*id, *owner_id, *x, *y});
+  const auto* frame = receiver.LastRead();
+  const auto& records = frame->records;
+  const auto first_projectile =
+    std::ranges::partition_point(records, [](const auto& record) {
+      return (record.id & kProjectileRecordBit) == 0;
+    });
+  snapshot.tick = frame->sequence;
+  snapshot.players.resize(
+    static_cast<std::size_t>(first_projectile - records.begin()));
+  snapshot.projectiles.resize(
+    static_cast<std::size_t>(records.end() - first_projectile));
+
+  auto record = records.begin();
+  for (auto& player : snapshot.players) {
+    player.id = static_cast<std::uint16_t>(record->id);
+    player.x = kSnapshotXCodec.Dequantise(record->fields[0]);
+    player.y = kSnapshotYCodec.Dequantise(record->fields[1]);
+    player.health = static_cast<std::uint16_t>(record->fields[2]);
+    ++record;
   }
-  return true;
+  for (auto& projectile : snapshot.projectiles) {
+    projectile.id = static_cast<std::uint16_t>(record->id);
+    projectile.ownerId = static_cast<std::uint16_t>(record->fields[2]);
+    projectile.x = kSnapshotXCodec.Dequantise(record->fields[0]);
+    projectile.y = kSnapshotYCodec.Dequantise(record->fields[1]);
+    ++record;
+  }
+  return status;
 }
 
 }  // namespace projectile_arena
@@ -2,15 +2,21 @@
 #include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <limits>
+#include <numbers>
+#include <optional>
 #include <print>
-#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "packet_capture.hpp"
 #include "protocol.hpp"
+#include "rewind_buffer.hpp"
 #include "server_connection_hub.hpp"
 #include "socketwire_example_utils.hpp"
+#include "spatial_grid.hpp"
+#include "tick_scheduler.hpp"
 
 using namespace socketwire;  // NOLINT
 
@@ -21,16 +27,41 @@ using Client = socketwire_examples::ServerConnectionHub::Client;
 constexpr float kKPlayerRadius = 15.0f;
 constexpr float kKProjectileRadius = 6.0f;
 constexpr float kKProjectileSpeed = 420.0f;
+constexpr float kKPlayerSpeed = 180.0f;
+constexpr float kKHitRadius = kKProjectileRadius + kKPlayerRadius;
 constexpr std::uint16_t kKProjectileDamage = 25;
+constexpr std::chrono::milliseconds kPollInterval{1};
+// Shots are judged against the view their shooter saw, up to this far back;
+// a slower link fires from where it was this long ago.
+constexpr std::chrono::milliseconds kKMaxRewind{200};
+constexpr double kKSnapshotSeconds =
+  std::chrono::duration<double>(projectile_arena::kSnapshotInterval).count();
+constexpr double kKMaxRewindTicks =
+  std::chrono::duration<double>(kKMaxRewind).count() / kKSnapshotSeconds;
+// Snapshot ticks of player positions kept for rewinding.
+constexpr std::size_t kKHistoryDepth = 8;
+static_assert(kKHistoryDepth > kKMaxRewindTicks + 1.0,
+              "history must cover the whole rewind window");
 
 struct PlayerState {
   std::uint16_t id = 0;
   Client* client = nullptr;
   float x = 450.0f;
   float y = 300.0f;
+  // Position at the start of the last simulated tick, for swept hits.
+  float lastX = 450.0f;
+  float lastY = 300.0f;
   float axisX = 0.0f;
   float axisY = 0.0f;
   std::uint16_t health = projectile_arena::kKMaxHealth;
+  socketwire_examples::DeltaBaseline snapshotAck;
+  // This player's ring in |player_history|.
+  std::uint32_t historySlot = 0;
+};
+
+struct Position {
+  float x = 0.0f;
+  float y = 0.0f;
 };
 
 struct ProjectileState {
@@ -42,15 +73,86 @@ struct ProjectileState {
   float vy = 0.0f;
 };
 
+// Live projectiles stay packed in one vector for the per-tick loops. Ids are
+// the stable handles: |slots_| maps an id to its current index, so removal
+// moves the last projectile into the hole.
+class ProjectileStore {
+ public:
+  [[nodiscard]] bool Contains(std::uint16_t id) const {
+    return slots_[id] != kNoSlot;
+  }
+
+  void Add(const ProjectileState& projectile) {
+    slots_[projectile.id] = static_cast<std::uint32_t>(items_.size());
+    items_.push_back(projectile);
+  }
+
+  void Remove(std::uint16_t id) {
+    const std::uint32_t slot = slots_[id];
+    if (slot == kNoSlot) return;
+    const ProjectileState last = items_.back();
+    items_.pop_back();
+    slots_[id] = kNoSlot;
+    if (last.id == id) return;
+    items_[slot] = last;
+    slots_[last.id] = slot;
+  }
+
+  [[nodiscard]] std::vector<ProjectileState>& Items() { return items_; }
+  [[nodiscard]] const std::vector<ProjectileState>& Items() const {
+    return items_;
+  }
+  [[nodiscard]] std::size_t Size() const { return items_.size(); }
+
+ private:
+  static constexpr std::uint32_t kNoSlot = 0xffffffffu;
+
+  std::vector<ProjectileState> items_;
+  std::vector<std::uint32_t> slots_ = std::vector<std::uint32_t>(
+    std::size_t{std::numeric_limits<std::uint16_t>::max()} + 1u, kNoSlot);
+};
+
 std::unordered_map<Client*, PlayerState> players;
-std::vector<ProjectileState> projectiles;
+ProjectileStore projectiles;
+// Players bucketed by end-of-tick position; grid ids index |grid_players|.
+socketwire_examples::SpatialGrid player_grid(64.0f);
+std::vector<PlayerState*> grid_players;
 std::uint16_t next_player_id = 1;
 std::uint16_t next_projectile_id = 1;
 std::uint32_t server_tick = 0;
+// Simulation steps since the last snapshot, for where "now" falls between
+// snapshot ticks.
+std::uint32_t steps_since_snapshot = 0;
+// Every player's position at each of the last snapshots, by snapshot tick.
+socketwire_examples::RewindBuffer<Position, kKHistoryDepth> player_history;
+// Players a rewound shot might reach; reused across shots.
+std::vector<PlayerState*> rewind_candidates;
+projectile_arena::SnapshotSender snapshot_sender(
+  projectile_arena::kSnapshotSchema);
+// Reused every broadcast and for every received packet.
+projectile_arena::WorldSnapshot world_snapshot;
+BitStream receive_stream;
 std::uint64_t fire_command_accepted = 0;
 
 float ClampAxis(float value) { return std::clamp(value, -1.0f, 1.0f); }
 
+// Earliest fraction of the tick at which two circles moving in straight
+// lines come within |radius| of each other. |rx, ry| is the offset between
+// them at the start of the tick and |dx, dy| how it changes over the tick.
+std::optional<float> SweptCircleHit(float rx, float ry, float dx, float dy,
+                                    float radius) {
+  const float c = rx * rx + ry * ry - radius * radius;
+  if (c <= 0.0f) return 0.0f;
+  const float a = dx * dx + dy * dy;
+  const float b = rx * dx + ry * dy;
+  if (a <= 0.0f || b >= 0.0f) return std::nullopt;
+  const float discriminant = b * b - a * c;
+  if (discriminant < 0.0f) return std::nullopt;
+  const float t = (-b - std::sqrt(discriminant)) / a;
+  if (t > 1.0f) return std::nullopt;
+  return t;
+}
+
 PlayerState& EnsurePlayer(Client& client) {
   auto it = players.find(&client);
   if (it != players.end()) return it->second;
@@ -61,6 +163,9 @@ PlayerState& EnsurePlayer(Client& client) {
   player.client = &client;
   player.x = 120.0f + static_cast<float>((id - 1) % 6) * 90.0f;
   player.y = 160.0f + (static_cast<float>(id - 1) / 6.0f) * 90.0f;
+  player.lastX = player.x;
+  player.lastY = player.y;
+  player.historySlot = player_history.Acquire();
   auto inserted = players.emplace(&client, player).first;
   std::println("player {} joined from port {}", id, client.port);
 
@@ -71,11 +176,128 @@ PlayerState& EnsurePlayer(Client& client) {
   return inserted->second;
 }
 
+void Damage(PlayerState& player) {
+  player.health =
+    player.health > kKProjectileDamage
+      ? static_cast<std::uint16_t>(player.health - kKProjectileDamage)
+      : 0;
+}
+
+// The current time in snapshot ticks; only meaningful once a snapshot has
+// gone out.
+double NowTicks() {
+  return static_cast<double>(server_tick - 1) +
+         static_cast<double>(std::min(steps_since_snapshot,
+                                      projectile_arena::kTicksPerSnapshot)) /
+           projectile_arena::kTicksPerSnapshot;
+}
+
+// Where |player| was at snapshot time |time|, blended between recorded
+// snapshots the way clients draw it, and moving on from the newest one to
+// where it is |now|. Nothing if it was not in that snapshot.
+std::optional<Position> RewoundPosition(const PlayerState& player,
+                                        double time, double now) {
+  const std::uint32_t newest = server_tick - 1;
+  if (time >= newest) {
+    const Position* last = player_history.At(player.historySlot, newest);
+    if (last == nullptr) return std::nullopt;
+    if (now <= newest) return *last;
+    const auto t = static_cast<float>((time - newest) / (now - newest));
+    return Position{std::lerp(last->x, player.x, t),
+                    std::lerp(last->y, player.y, t)};
+  }
+  const auto span = player_history.Around(player.historySlot, time);
+  if (span.from == nullptr) return std::nullopt;
+  return Position{std::lerp(span.from->x, span.to->x, span.t),
+                  std::lerp(span.from->y, span.to->y, span.t)};
+}
+
+// Moves a shot fired at snapshot time |time| on to |now| one simulation
+// step at a time, sweeping it against the other players where they were at
+// each step. Returns true if it hit one of them on the way.
+bool CatchUp(ProjectileState& projectile, double time, double now) {
+  if (time >= now) return false;
+  const auto rewind_seconds =
+    static_cast<float>((now - time) * kKSnapshotSeconds);
+  const float end_x = projectile.x + projectile.vx * rewind_seconds;
+  const float end_y = projectile.y + projectile.vy * rewind_seconds;
+  const float reach = kKHitRadius + kKPlayerSpeed * rewind_seconds *
+                                      std::numbers::sqrt2_v<float>;
+  const float min_x = std::min(projectile.x, end_x) - reach;
+  const float min_y = std::min(projectile.y, end_y) - reach;
+  const float max_x = std::max(projectile.x, end_x) + reach;
+  const float max_y = std::max(projectile.y, end_y) + reach;
+  rewind_candidates.clear();
+  for (auto& entry : players) {
+    PlayerState& player = entry.second;
+    if (player.id == projectile.ownerId || player.x < min_x ||
+        player.x > max_x || player.y < min_y || player.y > max_y) {
+      continue;
+    }
+    rewind_candidates.push_back(&player);
+  }
+
+  const double step = 1.0 / projectile_arena::kTicksPerSnapshot;
+  while (time < now) {
+    const double next = std::min(time + step, now);
+    const auto dt = static_cast<float>((next - time) * kKSnapshotSeconds);
+    const float start_x = projectile.x;
+    const float start_y = projectile.y;
+    projectile.x += projectile.vx * dt;
+    projectile.y += projectile.vy * dt;
+
+    PlayerState* target = nullptr;
+    float target_time = 0.0f;
+    for (PlayerState* player : rewind_candidates) {
+      const auto from = RewoundPosition(*player, time, now);
+      const auto to = RewoundPosition(*player, next, now);
+      if (!from || !to) continue;
+      const auto hit = SweptCircleHit(
+        start_x - from->x, start_y - from->y,
+        (projectile.x - start_x) - (to->x - from->x),
+        (projectile.y - start_y) - (to->y - from->y), kKHitRadius);
+      if (hit && (target == nullptr || *hit < target_time)) {
+        target = player;
+        target_time = *hit;
+      }
+    }
+    if (target != nullptr) {
+      Damage(*target);
+      return true;
+    }
+    time = next;
+  }
+  return false;
+}
+
+bool LeftArena(const ProjectileState& projectile) {
+  return projectile.x < -20.0f || projectile.x > 920.0f ||
+         projectile.y < -20.0f || projectile.y > 620.0f;
+}
+
+// Lag compensation: the shot leaves from where the shooter was in the view
+// it fired from, at most kKMaxRewind ago, and is caught up to now against
+// the players as that view showed them, so a shot that lined up on screen
+// hits.
 void HandleFire(PlayerState& player,
                 const projectile_arena::FireCommand& fire) {
+  // All 65536 ids are in flight, so there is no free one to hand out.
+  if (projectiles.Size() > std::numeric_limits<std::uint16_t>::max()) return;
   ++fire_command_accepted;
-  float dx = fire.aimX - player.x;
-  float dy = fire.aimY - player.y;
+
+  double now = 0.0;
+  double time = 0.0;
+  Position origin{player.x, player.y};
+  if (server_tick > 0) {
+    now = NowTicks();
+    time = socketwire_examples::ClampRewindTime(
+      fire.viewTick + static_cast<double>(fire.viewFraction), now,
+      kKMaxRewindTicks);
+    origin = RewoundPosition(player, time, now).value_or(origin);
+  }
+
+  float dx = fire.aimX - origin.x;
+  float dy = fire.aimY - origin.y;
   const float length = std::sqrt(dx * dx + dy * dy);
   if (length < 0.001f) {
     dx = 1.0f;
@@ -85,22 +307,24 @@ void HandleFire(PlayerState& player,
     dy /= length;
   }
 
-  projectiles.push_back(ProjectileState{
+  while (projectiles.Contains(next_projectile_id)) ++next_projectile_id;
+  ProjectileState projectile{
     next_projectile_id++,
     player.id,
-    player.x,
-    player.y,
+    origin.x,
+    origin.y,
     dx * kKProjectileSpeed,
     dy * kKProjectileSpeed,
-  });
-  std::println("player {} fired at {:.1f} {:.1f}", player.id, fire.aimX,
-               fire.aimY);
+  };
+  if (CatchUp(projectile, time, now) || LeftArena(projectile)) return;
+  projectiles.Add(projectile);
 }
 
 void HandlePacket(Client& client, const void* data, std::size_t size) {
   socketwire_examples::benchmark::RecordPayloadRx(size);
 
-  BitStream stream(static_cast<const std::uint8_t*>(data), size);
+  BitStream& stream = receive_stream;
+  socketwire_examples::LoadPacket(stream, data, size);
   projectile_arena::MessageType type{};
   if (!projectile_arena::ReadType(stream, type)) return;
 
@@ -126,86 +350,123 @@ void HandlePacket(Client& client, const void* data, std::size_t size) {
     if (projectile_arena::ReadFire(stream, fire)) {
       HandleFire(it->second, fire);
     }
+    return;
   }
-}
 
-void ResolveProjectileHits() {
-  std::vector<std::uint16_t> hit_projectiles;
-
-  for (const auto& projectile : projectiles) {
-    for (auto& entry : players) {
-      auto& player = entry.second;
-      if (player.id == projectile.ownerId) continue;
-
-      const float dx = projectile.x - player.x;
-      const float dy = projectile.y - player.y;
-      const float hit_radius = kKProjectileRadius + kKPlayerRadius;
-      if (dx * dx + dy * dy > hit_radius * hit_radius) continue;
-
-      player.health = player.health > kKProjectileDamage
-                        ? static_cast<std::uint16_t>(player.health -
-                                                     kKProjectileDamage)
-                        : 0;
-      hit_projectiles.push_back(projectile.id);
-      break;
+  if (type == projectile_arena::MessageType::kSnapshotAck) {
+    std::uint32_t tick = 0;
+    // Acks for ticks not sent yet would pin a baseline the client never saw.
+    if (projectile_arena::ReadSnapshotAck(stream, tick) &&
+        static_cast<std::int32_t>(server_tick - tick) > 0) {
+      it->second.snapshotAck.Acknowledge(tick);
     }
   }
+}
 
-  if (hit_projectiles.empty()) return;
+// Moves every projectile, damages the first player it sweeps through this
+// tick and drops it on a hit or once it leaves the arena. Sweeping both the
+// projectile and the players keeps fast shots from tunnelling through at low
+// tick rates.
+void UpdateProjectiles(float dt) {
+  const float player_step = kKPlayerSpeed * dt * std::numbers::sqrt2_v<float>;
+  const float reach = kKHitRadius + player_step;
+
+  auto& items = projectiles.Items();
+  for (std::size_t i = 0; i < items.size();) {
+    ProjectileState& projectile = items[i];
+    const float start_x = projectile.x;
+    const float start_y = projectile.y;
+    projectile.x += projectile.vx * dt;
+    projectile.y += projectile.vy * dt;
 
-  std::erase_if(projectiles, [&](const ProjectileState& projectile) {
-    return std::find(hit_projectiles.begin(), hit_projectiles.end(),
-                     projectile.id) != hit_projectiles.end();
-  });
+    PlayerState* target = nullptr;
+    float target_time = 0.0f;
+    player_grid.ForEachInBox(
+      std::min(start_x, projectile.x) - reach,
+      std::min(start_y, projectile.y) - reach,
+      std::max(start_x, projectile.x) + reach,
+      std::max(start_y, projectile.y) + reach,
+      [&](const socketwire_examples::SpatialGrid::Entry& entry) {
+        PlayerState* player = grid_players[entry.id];
+        if (player->id == projectile.ownerId) return;
+        const auto time = SweptCircleHit(
+          start_x - player->lastX, start_y - player->lastY,
+          (projectile.x - start_x) - (player->x - player->lastX),
+          (projectile.y - start_y) - (player->y - player->lastY),
+          kKHitRadius);
+        if (time && (target == nullptr || *time < target_time)) {
+          target = player;
+          target_time = *time;
+        }
+      });
+
+    if (target != nullptr) Damage(*target);
+    if (target != nullptr || LeftArena(projectile)) {
+      projectiles.Remove(projectile.id);
+      continue;
+    }
+    ++i;
+  }
 }
 
 void UpdateWorld(float dt) {
+  player_grid.Clear();
+  grid_players.clear();
   for (auto& entry : players) {
     auto& player = entry.second;
-    player.x = std::clamp(player.x + player.axisX * 180.0f * dt, 24.0f, 876.0f);
-    player.y = std::clamp(player.y + player.axisY * 180.0f * dt, 24.0f, 576.0f);
-  }
-
-  for (auto& projectile : projectiles) {
-    projectile.x += projectile.vx * dt;
-    projectile.y += projectile.vy * dt;
+    player.lastX = player.x;
+    player.lastY = player.y;
+    player.x =
+      std::clamp(player.x + player.axisX * kKPlayerSpeed * dt, 24.0f, 876.0f);
+    player.y =
+      std::clamp(player.y + player.axisY * kKPlayerSpeed * dt, 24.0f, 576.0f);
+    player_grid.Insert(static_cast<std::uint32_t>(grid_players.size()),
+                       player.x, player.y);
+    grid_players.push_back(&player);
   }
 
-  ResolveProjectileHits();
-
-  std::erase_if(projectiles, [](const ProjectileState& projectile) {
-    return projectile.x < -20.0f || projectile.x > 920.0f ||
-           projectile.y < -20.0f || projectile.y > 620.0f;
-  });
+  UpdateProjectiles(dt);
 }
 
-projectile_arena::WorldSnapshot MakeSnapshot() {
-  projectile_arena::WorldSnapshot snapshot;
-  snapshot.tick = server_tick++;
-  snapshot.players.reserve(players.size());
+// Refills |world_snapshot| in place; its vectors keep their capacity.
+void MakeSnapshot() {
+  world_snapshot.tick = server_tick++;
+  world_snapshot.players.resize(players.size());
+  auto player_out = world_snapshot.players.begin();
   for (const auto& entry : players) {
     const auto& player = entry.second;
-    snapshot.players.push_back(
-      projectile_arena::PlayerSnapshot{player.id, player.x, player.y,
-                                       player.health});
+    *player_out++ = projectile_arena::PlayerSnapshot{player.id, player.x,
+                                                     player.y, player.health};
   }
 
-  snapshot.projectiles.reserve(projectiles.size());
-  for (const auto& projectile : projectiles) {
-    snapshot.projectiles.push_back(projectile_arena::ProjectileSnapshot{
+  world_snapshot.projectiles.resize(projectiles.Size());
+  auto projectile_out = world_snapshot.projectiles.begin();
+  for (const auto& projectile : projectiles.Items()) {
+    *projectile_out++ = projectile_arena::ProjectileSnapshot{
       projectile.id,
       projectile.ownerId,
       projectile.x,
       projectile.y,
-    });
+    };
+  }
+}
+
+void RecordHistory(std::uint32_t tick) {
+  for (const auto& entry : players) {
+    const auto& player = entry.second;
+    player_history.Record(player.historySlot, tick,
+                          Position{player.x, player.y});
   }
-  return snapshot;
 }
 
 void BroadcastSnapshot() {
-  auto snapshot = projectile_arena::MakeSnapshot(MakeSnapshot());
+  MakeSnapshot();
+  RecordHistory(world_snapshot.tick);
+  projectile_arena::RecordSnapshot(snapshot_sender, world_snapshot);
   for (auto& entry : players) {
     auto& player = entry.second;
+    const auto& snapshot =
+      projectile_arena::SnapshotPacketFor(snapshot_sender, player.snapshotAck);
     if (player.client->connection->SendUnreliable(1, snapshot)) {
       socketwire_examples::benchmark::RecordPayloadTx(snapshot.GetSizeBytes());
     }
@@ -225,7 +486,7 @@ socketwire_examples::benchmark::GameMetrics CollectGameMetrics() {
     if (std::isnan(player.x) || std::isnan(player.y)) ++game.nanPositionCount;
     if (std::isinf(player.x) || std::isinf(player.y)) ++game.infPositionCount;
   }
-  for (const auto& projectile : projectiles) {
+  for (const auto& projectile : projectiles.Items()) {
     if (std::isnan(projectile.x) || std::isnan(projectile.y)) {
       ++game.nanPositionCount;
     }
@@ -245,6 +506,9 @@ int main(int argc, const char** argv) {
   socketwire_examples::benchmark::MetricsCollector metrics(
     bench_options, "projectile-arena", "socketwire", "server");
   socketwire_examples::benchmark::SetActiveCollector(&metrics);
+  metrics.SetDefaultTickBudgetMs(
+    std::chrono::duration<double, std::milli>(projectile_arena::kTickInterval)
+      .count());
 
   const std::uint16_t port =
     bench_options.enabled ? bench_options.port
@@ -252,19 +516,23 @@ int main(int argc, const char** argv) {
                               argc, argv, 1, "SOCKETWIRE_PROJECTILE_ARENA_PORT",
                               projectile_arena::kKPort);
 
-  auto socket = socketwire_examples::CreateUdpSocket(port);
-  if (socket == nullptr) {
+  const auto server_socket = socketwire_examples::CreateServerSocket(
+    port, bench_options.replayPath, bench_options.replaySpeed);
+  if (server_socket.socket == nullptr) {
     std::println("Cannot bind projectile-arena server");
     return 1;
   }
 
   ReliableConnectionConfig cfg;
   cfg.numChannels = 2;
-  socketwire_examples::ServerConnectionHub hub(socket.get(), cfg);
+  socketwire_examples::ServerConnectionHub hub(server_socket.socket.get(), cfg);
+  socketwire_examples::PacketCaptureWriter capture(bench_options.capturePath);
+  hub.SetCaptureWriter(&capture);
   hub.SetDisconnectedCallback([](auto& client) {
     auto it = players.find(&client);
     if (it != players.end()) {
       std::println("player {:d} disconnected", it->second.id);
+      player_history.Release(it->second.historySlot);
       players.erase(it);
     }
   });
@@ -274,29 +542,40 @@ int main(int argc, const char** argv) {
 
   std::println("projectile-arena server listening on port {}",
                static_cast<unsigned>(port));
-  auto last_frame = std::chrono::steady_clock::now();
-  auto last_snapshot = last_frame;
+  socketwire_examples::TickScheduler scheduler(
+    {.simInterval = projectile_arena::kTickInterval,
+     .pollInterval = kPollInterval});
 
   while (true) {
+    const std::uint32_t steps = scheduler.WaitNext();
+    if (steps == 0) {
+      hub.Poll();
+      hub.Update();
+      continue;
+    }
+    metrics.RecordTickPacing(scheduler.LastLateness(), steps,
+                             scheduler.LastDropped());
     const auto frame_start = std::chrono::steady_clock::now();
     const auto update_start = frame_start;
 
+    metrics.BeginTick();
     hub.Poll();
     hub.Update();
+    metrics.MarkTickPhase(socketwire_examples::benchmark::TickPhase::kPoll);
 
-    const auto now = std::chrono::steady_clock::now();
-    const auto frame_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(now - last_frame)
-        .count();
-    if (frame_ms >= 16) {
-      last_frame = now;
-      UpdateWorld(static_cast<float>(frame_ms) / 1000.0f);
+    for (std::uint32_t step = 0; step < steps; ++step) {
+      UpdateWorld(scheduler.StepSeconds());
     }
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kSimulate);
 
-    if (now - last_snapshot > std::chrono::milliseconds(50)) {
-      last_snapshot = now;
+    steps_since_snapshot += steps;
+    if (steps_since_snapshot >= projectile_arena::kTicksPerSnapshot) {
+      steps_since_snapshot = 0;
       BroadcastSnapshot();
     }
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kBroadcast);
 
     if (bench_options.enabled) {
       const auto update_end = std::chrono::steady_clock::now();
@@ -318,12 +597,19 @@ int main(int argc, const char** argv) {
             .count()) /
         1000.0);
       metrics.MaybeWriteSample();
-      if (metrics.Done()) break;
     }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    metrics.EndTick();
+    if ((bench_options.enabled && metrics.Done()) ||
+        server_socket.ReplayFinished()) {
+      break;
+    }
   }
 
+  if (server_socket.replay != nullptr) {
+    metrics.SetReplayStats(server_socket.replay->ReplayedPackets(),
+                           server_socket.replay->DroppedSendBytes());
+    server_socket.PrintReplaySummary();
+  }
   metrics.Finish();
   socketwire_examples::benchmark::SetActiveCollector(nullptr);
 }
@@ -0,0 +1,189 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <print>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "benchmark_utils.hpp"
+#include "bot_driver.hpp"
+#include "entity.h"
+#include "protocol.h"
+#include "reliable_connection.hpp"
+#include "socketwire_example_utils.hpp"
+
+static constexpr std::uint16_t kDefaultShipSwarmPort = 10133;
+
+class ShipBot final : public socketwire::IReliableConnectionHandler {
+ public:
+  ShipBot(socketwire_examples::ResolvedEndpoint endpoint, std::uint16_t port,
+          std::uint32_t seed)
+      : endpoint_(std::move(endpoint)), port_(port), seed_(seed) {}
+
+  bool Start() {
+    socket_ = socketwire_examples::CreateUdpSocket(0);
+    if (socket_ == nullptr) return false;
+
+    socketwire::ReliableConnectionConfig cfg;
+    cfg.numChannels = 2;
+    connection_ =
+      std::make_unique<socketwire::ReliableConnection>(socket_.get(), cfg);
+    connection_->SetHandler(this);
+    (void)socketwire_examples::ConnectNextAddress(*connection_, endpoint_,
+                                                  port_);
+    nextConnectAttempt_ =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
+    return true;
+  }
+
+  void Step(std::uint64_t frame) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!connected_ && now >= nextConnectAttempt_) {
+      (void)socketwire_examples::ConnectNextAddress(*connection_, endpoint_,
+                                                    port_);
+      nextConnectAttempt_ = now + std::chrono::milliseconds(250);
+    }
+    connection_->Poll();
+    connection_->Update();
+    snapshotDecoder_.FlushAcks(connection_.get());
+
+    if (connected_ && !sentJoin_) {
+      SendJoin(connection_.get());
+      sentJoin_ = true;
+      ++appSentPackets_;
+    }
+
+    if (myEntity_ == kInvalidEntity) return;
+    const float thr =
+      socketwire_examples::benchmark::DeterministicAxis(seed_, frame, 0);
+    const float steer =
+      socketwire_examples::benchmark::DeterministicAxis(seed_, frame, 1);
+    inputs_.Push(inputFrame_++, ShipInput{thr, steer});
+    SendEntityInput(connection_.get(), myEntity_, inputs_);
+    ++appSentPackets_;
+  }
+
+  void Collect(socketwire_examples::benchmark::BotSample& sample) const {
+    sample.AddConnection(*connection_);
+    socketwire_examples::benchmark::GameMetrics game;
+    game.appSentPackets = appSentPackets_;
+    game.appReceivedPackets = appReceivedPackets_;
+    game.joinSuccessCount = myEntity_ != kInvalidEntity ? 1 : 0;
+    game.entityCountClient = entities_.size();
+    game.nanPositionCount = nanPositionCount_;
+    game.infPositionCount = infPositionCount_;
+    sample.MergeGame(game);
+  }
+
+  void Disconnect() { connection_->Disconnect(); }
+
+  void OnConnected() override { connected_ = true; }
+  void OnDisconnected() override { connected_ = false; }
+
+  void OnReliableReceived(std::uint8_t, const void* data,
+                          std::size_t size) override {
+    ProcessPacket(data, size);
+  }
+
+  void OnUnreliableReceived(std::uint8_t, const void* data,
+                            std::size_t size) override {
+    ProcessPacket(data, size);
+  }
+
+ private:
+  void ProcessPacket(const void* data, std::size_t size) {
+    socketwire_examples::benchmark::RecordPayloadRx(size);
+    ++appReceivedPackets_;
+    switch (GetPacketType(data, size)) {
+      case kEServerToClientNewEntity: {
+        Entity entity;
+        DeserializeNewEntity(data, size, entity);
+        entities_.try_emplace(entity.eid, entity);
+        break;
+      }
+      case kEServerToClientSetControlledEntity:
+        DeserializeSetControlledEntity(data, size, myEntity_);
+        break;
+      case kEServerToClientSnapshot:
+        if (!snapshotDecoder_.Read(data, size, snapshot_, snapshotTick_)) {
+          break;
+        }
+        for (const SnapshotEntity& entry : snapshot_) {
+          if (std::isnan(entry.x) || std::isnan(entry.y)) ++nanPositionCount_;
+          if (std::isinf(entry.x) || std::isinf(entry.y)) ++infPositionCount_;
+          const auto it = entities_.find(entry.eid);
+          if (it != entities_.end()) {
+            it->second.x = entry.x;
+            it->second.y = entry.y;
+            it->second.ori = entry.ori;
+          }
+        }
+        break;
+      case kEServerToClientClockReply:
+      case kEClientToServerJoin:
+      case kEClientToServerInput:
+      case kEClientToServerClockRequest:
+      case kEClientToServerSnapshotAck:
+        break;
+    }
+  }
+
+  socketwire_examples::ResolvedEndpoint endpoint_;
+  std::uint16_t port_ = kDefaultShipSwarmPort;
+  std::uint32_t seed_ = 1;
+  std::unique_ptr<socketwire::ISocket> socket_;
+  std::unique_ptr<socketwire::ReliableConnection> connection_;
+  std::chrono::steady_clock::time_point nextConnectAttempt_{};
+  bool connected_ = false;
+  bool sentJoin_ = false;
+  std::uint16_t myEntity_ = kInvalidEntity;
+  ShipInputWindow inputs_;
+  std::uint32_t inputFrame_ = 0;
+  std::unordered_map<std::uint16_t, Entity> entities_;
+  std::vector<SnapshotEntity> snapshot_;
+  WorldSnapshotDecoder snapshotDecoder_;
+  std::uint32_t snapshotTick_ = 0;
+  std::uint64_t appSentPackets_ = 0;
+  std::uint64_t appReceivedPackets_ = 0;
+  std::uint64_t nanPositionCount_ = 0;
+  std::uint64_t infPositionCount_ = 0;
+};
+
+int main(int argc, const char** argv) {
+  auto bench_options = socketwire_examples::benchmark::ParseOptions(
+    argc, argv, kDefaultShipSwarmPort);
+  bench_options.enabled = true;
+  socketwire_examples::benchmark::MetricsCollector metrics(
+    bench_options, "ship-swarm", "socketwire", "bots");
+
+  auto server_endpoint = socketwire_examples::ResolveEndpoint(
+    bench_options.host, bench_options.port);
+  if (!server_endpoint) {
+    std::println("cannot resolve host '{}'", bench_options.host);
+    return 1;
+  }
+
+  using Driver = socketwire_examples::benchmark::BotDriver<ShipBot>;
+  const int threads = Driver::DefaultThreadCount(bench_options);
+  // Bots step, and so send input, once per server step; at the driver's
+  // default 16 ms the server would find no new input on four steps in ten.
+  Driver driver(metrics, threads, kTickInterval);
+  const int spawned = driver.Spawn(
+    bench_options.clients, [&](int index) -> std::unique_ptr<ShipBot> {
+      auto bot = std::make_unique<ShipBot>(
+        *server_endpoint, bench_options.port,
+        bench_options.seed + static_cast<std::uint32_t>(index));
+      if (!bot->Start()) return nullptr;
+      return bot;
+    });
+  std::println("ship-swarm bots: {}/{} bots on {} threads against {}:{}",
+               spawned, bench_options.clients, threads, bench_options.host,
+               static_cast<unsigned>(bench_options.port));
+  if (spawned == 0) return 1;
+
+  driver.Run();
+  metrics.Finish();
+  return 0;
+}
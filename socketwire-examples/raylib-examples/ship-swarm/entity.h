@@ -1,6 +1,8 @@
 #pragma once
 #include <cstdint>
 
+#include "ship_soa.hpp"
+
 constexpr uint16_t kInvalidEntity = -1;
 constexpr float kWorldSize = 120.f;
 struct Entity {
@@ -25,3 +27,15 @@ struct Entity {
 };
 
 void SimulateEntity(Entity& e, float dt);
+
+// SimulateEntity's model for the bulk integrator in ship_soa.hpp; the
+// integrator bench checks that the two stay within a small tolerance.
+constexpr socketwire_examples::ShipTuning kShipTuning{
+  .thrustAccel = 1.5f,
+  .brakeAccel = 6.f,
+  .minThrottle = -0.3f,
+  .maxThrottle = 1.f,
+  .steerRate = 0.3f,
+  .worldSize = kWorldSize,
+  .wrapOrientation = true,
+};
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <numbers>
 #include <print>
 #include <string>
 #include <string_view>
@@ -12,7 +13,9 @@
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "clock_sync.hpp"
 #include "entity.h"
+#include "interpolation_buffer.hpp"
 #include "protocol.h"
 #include "raylib.h"
 #include "reliable_connection.hpp"
@@ -24,7 +27,27 @@ static std::unordered_map<std::uint16_t, std::size_t> index_map;
 static std::uint16_t my_entity = kInvalidEntity;
 static std::uint32_t total_in_data = 0;
 static std::uint32_t total_out_data = 0;
-static std::uint32_t server_time_msec = 0;
+// Server clock estimate, used to tell how old the newest snapshot is.
+static socketwire_examples::ClockSync clock_sync(kTickInterval);
+static std::uint32_t snapshot_tick = 0;
+// Snapshots wait here until their playout time, which trails the server by
+// one tick plus the jitter the link has shown lately.
+static socketwire_examples::InterpolationBuffer<std::vector<SnapshotEntity>>
+  snapshot_buffer({.snapshotIntervalMs =
+                     std::chrono::duration<double, std::milli>(kTickInterval)
+                       .count()});
+static std::vector<SnapshotEntity> snapshot_entries;
+static WorldSnapshotDecoder snapshot_decoder;
+// Ships in the server's view of this client, ascending; others keep their last
+// position and are not drawn.
+static std::vector<std::uint16_t> visible_eids;
+// One input frame per server step, whatever the render rate: the server
+// consumes one frame per kTickInterval, so one per 60 Hz frame would leave
+// four steps in ten starved. Each render frame pushes an input for every step
+// deadline it passed and sends them together in one packet.
+static ShipInputWindow input_window;
+static std::uint32_t input_frame = 0;
+static std::chrono::steady_clock::time_point next_input_time;
 
 static constexpr std::uint16_t kDefaultShipSwarmPort = 10133;
 
@@ -146,20 +169,51 @@ static void GetEntity(std::uint16_t eid, Callable callable) {
 }
 
 static void OnSnapshot(const void* data, std::size_t size) {
-  std::uint16_t eid = kInvalidEntity;
-  float x = 0.f;
-  float y = 0.f;
-  float ori = 0.f;
-  DeserializeSnapshot(data, size, eid, x, y, ori);
-  GetEntity(eid, [&](Entity& e) {
-    e.x = x;
-    e.y = y;
-    e.ori = ori;
-  });
+  if (!snapshot_decoder.Read(data, size, snapshot_entries, snapshot_tick)) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  const double server_ms =
+    static_cast<double>(snapshot_tick) *
+    std::chrono::duration<double, std::milli>(kTickInterval).count();
+  if (auto* slot = snapshot_buffer.Push(server_ms, now)) {
+    *slot = snapshot_entries;
+  }
+}
+
+// Ships in the newer snapshot around the playout time, placed between their
+// two positions; ships that just came into view start at the newer one.
+static void ApplySnapshots(std::chrono::steady_clock::time_point now) {
+  const auto frame = snapshot_buffer.Sample(now);
+  if (frame.to == nullptr) return;
+  visible_eids.clear();
+  for (const SnapshotEntity& to : *frame.to) {
+    visible_eids.push_back(to.eid);
+    const auto from = std::ranges::lower_bound(*frame.from, to.eid, {},
+                                               &SnapshotEntity::eid);
+    GetEntity(to.eid, [&](Entity& e) {
+      if (from == frame.from->end() || from->eid != to.eid) {
+        e.x = to.x;
+        e.y = to.y;
+        e.ori = to.ori;
+        return;
+      }
+      e.x = std::lerp(from->x, to.x, frame.t);
+      e.y = std::lerp(from->y, to.y, frame.t);
+      e.ori = from->ori + std::remainder(to.ori - from->ori,
+                                         2.f * std::numbers::pi_v<float>) *
+                            frame.t;
+    });
+  }
 }
 
-static void OnTime(const void* data, std::size_t size) {
-  DeserializeTimeMsec(data, size, server_time_msec);
+static void OnClockReply(const void* data, std::size_t size,
+                         const socketwire::ReliableConnection& connection) {
+  std::uint64_t stamp = 0;
+  std::int64_t server_micros = 0;
+  DeserializeClockReply(data, size, stamp, server_micros);
+  clock_sync.OnReply(stamp, server_micros, std::chrono::steady_clock::now(),
+                     connection.GetRtt());
 }
 
 static void DrawShip(float ship_len, float ship_width, float x, float y,
@@ -189,6 +243,9 @@ static void DrawEntity(const Entity& e) {
 
 class ClientHandler final : public socketwire::IReliableConnectionHandler {
  public:
+  explicit ClientHandler(socketwire::ReliableConnection& connection)
+      : connection_(connection) {}
+
   void OnConnected() override { connected = true; }
   void OnDisconnected() override { connected = false; }
 
@@ -207,8 +264,10 @@ class ClientHandler final : public socketwire::IReliableConnectionHandler {
   bool connected = false;
 
  private:
-  static void ProcessPacket([[maybe_unused]] std::uint8_t channel,
-                            const void* data, std::size_t size) {
+  socketwire::ReliableConnection& connection_;
+
+  void ProcessPacket([[maybe_unused]] std::uint8_t channel, const void* data,
+                     std::size_t size) {
     total_in_data += static_cast<std::uint32_t>(size);
     switch (GetPacketType(data, size)) {
       case kEServerToClientNewEntity:
@@ -220,11 +279,13 @@ class ClientHandler final : public socketwire::IReliableConnectionHandler {
       case kEServerToClientSnapshot:
         OnSnapshot(data, size);
         break;
-      case kEServerToClientTimeMsec:
-        OnTime(data, size);
+      case kEServerToClientClockReply:
+        OnClockReply(data, size, connection_);
         break;
       case kEClientToServerJoin:
       case kEClientToServerInput:
+      case kEClientToServerClockRequest:
+      case kEClientToServerSnapshotAck:
         break;
     }
   }
@@ -233,23 +294,37 @@ class ClientHandler final : public socketwire::IReliableConnectionHandler {
 static void SimulateWorld(
   socketwire::ReliableConnection& connection, bool bench_mode,
   const socketwire_examples::benchmark::Options& bench_options,
-  std::uint64_t bench_frame) {
+  std::chrono::steady_clock::time_point now) {
   if (my_entity == kInvalidEntity) return;
 
+  if (next_input_time == std::chrono::steady_clock::time_point{}) {
+    next_input_time = now;
+  }
+  std::size_t frames = 0;
+  for (; now >= next_input_time; next_input_time += kTickInterval) ++frames;
+  if (frames == 0) return;
+  // After a stall the server would skip all but the last few anyway.
+  frames = std::min(frames, kInputWindow);
+
   GetEntity(my_entity, [&](Entity&) {
-    const float thr = bench_mode
-                        ? socketwire_examples::benchmark::DeterministicAxis(
-                            bench_options.seed, bench_frame, 0)
-                        : ((IsKeyDown(KEY_UP) ? 1.f : 0.f) +
-                           (IsKeyDown(KEY_DOWN) ? -1.f : 0.f));
-    const float steer = bench_mode
+    for (std::size_t i = 0; i < frames; ++i) {
+      const float thr = bench_mode
                           ? socketwire_examples::benchmark::DeterministicAxis(
-                              bench_options.seed, bench_frame, 1)
-                          : ((IsKeyDown(KEY_LEFT) ? -1.f : 0.f) +
-                             (IsKeyDown(KEY_RIGHT) ? 1.f : 0.f));
-    SendEntityInput(&connection, my_entity, thr, steer);
+                              bench_options.seed, input_frame, 0)
+                          : ((IsKeyDown(KEY_UP) ? 1.f : 0.f) +
+                             (IsKeyDown(KEY_DOWN) ? -1.f : 0.f));
+      const float steer = bench_mode
+                            ? socketwire_examples::benchmark::DeterministicAxis(
+                                bench_options.seed, input_frame, 1)
+                            : ((IsKeyDown(KEY_LEFT) ? -1.f : 0.f) +
+                               (IsKeyDown(KEY_RIGHT) ? 1.f : 0.f));
+      input_window.Push(input_frame, ShipInput{thr, steer});
+      ++input_frame;
+    }
+    SendEntityInput(&connection, my_entity, input_window);
     total_out_data += static_cast<std::uint32_t>(
-      sizeof(std::uint8_t) + sizeof(std::uint16_t) + sizeof(std::uint8_t));
+      sizeof(std::uint8_t) + sizeof(std::uint16_t) + sizeof(std::uint32_t) +
+      sizeof(std::uint8_t) + input_window.Size());
   });
 }
 
@@ -280,7 +355,9 @@ static void DrawWorld(const Camera2D& camera, const BandwidthAccumulator& bw,
               GetColor(0xffffffff));
   }
 
-  for (const Entity& e : entities) DrawEntity(e);
+  for (const Entity& e : entities) {
+    if (std::ranges::binary_search(visible_eids, e.eid)) DrawEntity(e);
+  }
 
   EndMode2D();
   DrawText(TextFormat("Bandwidth: in %0.2f kbit/s",
@@ -289,13 +366,29 @@ static void DrawWorld(const Camera2D& camera, const BandwidthAccumulator& bw,
   DrawText(TextFormat("Bandwidth: out %0.2f kbit/s",
                       static_cast<float>(GetDeltaData(bw.outData)) / 1024.f),
            8, 20, 12, WHITE);
-  DrawText(TextFormat("%s %s:%u | entities %zu",
+  DrawText(TextFormat("%s %s:%u | entities %zu in view of %zu",
                       handler.connected ? "Connected to" : "Connecting to",
                       endpoint.host.c_str(),
-                      static_cast<unsigned>(endpoint.port), entities.size()),
+                      static_cast<unsigned>(endpoint.port),
+                      visible_eids.size(), entities.size()),
            8, 32, 12, WHITE);
+  if (clock_sync.Synced()) {
+    const auto now = std::chrono::steady_clock::now();
+    DrawText(TextFormat("Server tick %u | snapshot age %.1f ms | clock "
+                        "offset %+.1f ms",
+                        static_cast<unsigned>(clock_sync.ServerTick(now)),
+                        clock_sync.TickAgeMs(snapshot_tick, now),
+                        clock_sync.OffsetMs()),
+             8, 44, 12, WHITE);
+    DrawText(TextFormat("Interp delay %.1f ms | jitter p95 %.1f ms | "
+                        "underflows %llu",
+                        snapshot_buffer.DelayMs(), snapshot_buffer.JitterMs(),
+                        static_cast<unsigned long long>(
+                          snapshot_buffer.Underflows())),
+             8, 56, 12, WHITE);
+  }
   if (handler.connected && entities.empty()) {
-    DrawText("Waiting for world state", 8, 44, 12, LIGHTGRAY);
+    DrawText("Waiting for world state", 8, 68, 12, LIGHTGRAY);
   }
   EndDrawing();
 }
@@ -347,7 +440,7 @@ int main(int argc, const char** argv) {
   socketwire::ReliableConnectionConfig cfg;
   cfg.numChannels = 2;
   socketwire::ReliableConnection connection(socket.get(), cfg);
-  ClientHandler handler;
+  ClientHandler handler(connection);
   connection.SetHandler(&handler);
   if (!socketwire_examples::ConnectNextAddress(connection, *server_endpoint,
                                                endpoint.port)) {
@@ -384,7 +477,6 @@ int main(int argc, const char** argv) {
   auto next_connect_attempt =
     std::chrono::steady_clock::now() + std::chrono::milliseconds(250);
   BandwidthAccumulator bandwidth_accumulator;
-  std::uint64_t bench_frame = 0;
   while (bench_options.enabled ? !metrics.Done() : !WindowShouldClose()) {
     const auto frame_start = std::chrono::steady_clock::now();
     const float dt = bench_options.enabled ? (1.f / 60.f) : GetFrameTime();
@@ -398,6 +490,10 @@ int main(int argc, const char** argv) {
     }
     connection.Poll();
     connection.Update();
+    snapshot_decoder.FlushAcks(&connection);
+    if (handler.connected && clock_sync.RequestDue(now)) {
+      SendClockRequest(&connection, clock_sync.OnRequestSent(now));
+    }
 
     if (handler.connected && !sent_join) {
       SendJoin(&connection);
@@ -405,9 +501,10 @@ int main(int argc, const char** argv) {
       sent_join = true;
     }
 
+    ApplySnapshots(std::chrono::steady_clock::now());
     UpdateBandwidth(dt, bandwidth_accumulator);
     SimulateWorld(connection, bench_options.enabled, bench_options,
-                  bench_frame);
+                  std::chrono::steady_clock::now());
     const auto update_end = std::chrono::steady_clock::now();
     if (!bench_options.enabled) {
       UpdateCamera(camera);
@@ -419,6 +516,12 @@ int main(int argc, const char** argv) {
       socketwire_examples::benchmark::GameMetrics game_metrics;
       game_metrics.joinSuccessCount = my_entity != kInvalidEntity ? 1 : 0;
       game_metrics.entityCountClient = entities.size();
+      if (clock_sync.Synced()) {
+        game_metrics.snapshotAgeMs =
+          clock_sync.TickAgeMs(snapshot_tick, update_end);
+      }
+      game_metrics.interpolationDelayMs = snapshot_buffer.DelayMs();
+      game_metrics.interpolationUnderflowCount = snapshot_buffer.Underflows();
       metrics.SetGameMetrics(game_metrics);
       metrics.RecordUpdateMs(
         static_cast<double>(
@@ -434,7 +537,6 @@ int main(int argc, const char** argv) {
         1000.0);
       metrics.MaybeWriteSample();
       std::this_thread::sleep_for(std::chrono::milliseconds(16));
-      ++bench_frame;
     }
   }
 
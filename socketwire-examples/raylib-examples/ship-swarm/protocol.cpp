@@ -1,14 +1,34 @@
 #include "protocol.h"
 
+#include <algorithm>
 #include <cstdint>
 
 #include "benchmark_utils.hpp"
 #include "bit_stream.hpp"
-#include "quantisation.h"
+#include "quantisation.hpp"
 #include "reliable_connection.hpp"
 
 namespace {
 
+using socketwire_examples::quantisation::Angle;
+using socketwire_examples::quantisation::BoundedFloat;
+
+// Inputs are 4 bits each, two to a byte.
+constexpr BoundedFloat<4> kInputCodec{-1.f, 1.f};
+// Ships stay within +-kWorldSize on both axes.
+constexpr BoundedFloat<11> kPositionXCodec{-kWorldSize, kWorldSize};
+constexpr BoundedFloat<10> kPositionYCodec{-kWorldSize, kWorldSize};
+constexpr Angle<8> kOrientationCodec{};
+static_assert(kPositionXCodec.kBits + kPositionYCodec.kBits +
+                kOrientationCodec.kBits ==
+              kSnapshotShipBits);
+
+constexpr socketwire_examples::DeltaSchema<3> kSnapshotSchema{
+  .idBits = 16,
+  .fieldBits = {kPositionXCodec.kBits, kPositionYCodec.kBits,
+                kOrientationCodec.kBits},
+};
+
 void WriteEntity(socketwire::BitStream& bs, const Entity& ent) {
   bs.Write<std::uint32_t>(ent.color);
   bs.Write<bool>(ent.serverControlled);
@@ -68,49 +88,121 @@ void SendSetControlledEntity(socketwire::ReliableConnection* connection,
 }
 
 void SendEntityInput(socketwire::ReliableConnection* connection,
-                     std::uint16_t eid, float thr, float steer) {
+                     std::uint16_t eid, const ShipInputWindow& inputs) {
   socketwire::BitStream bs;
   bs.Write<std::uint8_t>(kEClientToServerInput);
   bs.Write<std::uint16_t>(eid);
+  bs.Write<std::uint32_t>(inputs.NewestFrame());
+  bs.Write<std::uint8_t>(static_cast<std::uint8_t>(inputs.Size()));
 
-  const Float4bitsQuantized thr_packed(thr, -1.f, 1.f);
-  const Float4bitsQuantized steer_packed(steer, -1.f, 1.f);
-  const auto thr_steer_packed = static_cast<std::uint8_t>(
-    (thr_packed.packedVal << 4) | steer_packed.packedVal);
-  bs.Write<std::uint8_t>(thr_steer_packed);
+  for (std::size_t age = 0; age < inputs.Size(); ++age) {
+    const ShipInput& input = inputs.At(age);
+    const auto thr_steer_packed =
+      static_cast<std::uint8_t>((kInputCodec.Quantise(input.thr) << 4) |
+                                kInputCodec.Quantise(input.steer));
+    bs.Write<std::uint8_t>(thr_steer_packed);
+  }
 
   if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
 
-using PositionXQuantized = PackedFloat<std::uint16_t, 11>;
-using PositionYQuantized = PackedFloat<std::uint16_t, 10>;
+WorldSnapshotEncoder::WorldSnapshotEncoder() : sender_(kSnapshotSchema) {}
 
-void SendSnapshot(socketwire::ReliableConnection* connection, std::uint16_t eid,
-                  float x, float y, float ori) {
-  socketwire::BitStream bs;
-  bs.Write<std::uint8_t>(kEServerToClientSnapshot);
-  bs.Write<std::uint16_t>(eid);
+void WorldSnapshotEncoder::Build(const WorldState& world,
+                                 const std::vector<std::uint32_t>& visible) {
+  tick_ = world.tick;
+  auto& frame = sender_.BeginFrame(world.sequence);
+  for (const std::uint32_t index : visible) {
+    frame.records.push_back({
+      .id = world.eids[index],
+      .fields = {kPositionXCodec.Quantise(world.x[index]),
+                 kPositionYCodec.Quantise(world.y[index]),
+                 kOrientationCodec.Quantise(world.ori[index])},
+    });
+  }
+  sender_.Commit();
+}
+
+const socketwire::BitStream& WorldSnapshotEncoder::Encode(
+  const socketwire_examples::DeltaBaseline& ack) {
+  return sender_.PacketFor(ack, [this](socketwire::BitStream& header) {
+    header.Write<std::uint8_t>(kEServerToClientSnapshot);
+    header.Write<std::uint32_t>(tick_);
+  });
+}
+
+void SendSnapshot(socketwire::ReliableConnection* connection,
+                  const socketwire::BitStream& packet) {
+  if (connection->SendUnreliable(1, packet)) {
+    socketwire_examples::benchmark::RecordPayloadTx(packet.GetSizeBytes());
+  }
+}
+
+WorldSnapshotDecoder::WorldSnapshotDecoder() : receiver_(kSnapshotSchema) {}
+
+bool WorldSnapshotDecoder::Read(const void* data, std::size_t size,
+                                std::vector<SnapshotEntity>& entries,
+                                std::uint32_t& tick) {
+  entries.clear();
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  std::uint8_t type = 0;
+  bs.Read<std::uint8_t>(type);
+  const auto server_tick = bs.TryRead<std::uint32_t>();
+  if (!server_tick) return false;
+  if (receiver_.Read(bs) != socketwire_examples::DeltaReadStatus::kOk) {
+    return false;
+  }
+  const socketwire_examples::DeltaFrame<3>* frame = receiver_.LastRead();
+  if (!pendingAck_ ||
+      static_cast<std::int32_t>(frame->sequence - *pendingAck_) > 0) {
+    pendingAck_ = frame->sequence;
+  }
+  if (frame != receiver_.Latest()) return false;
 
-  const PositionXQuantized x_packed(x, -kWorldSize, kWorldSize);
-  const PositionYQuantized y_packed(y, -kWorldSize, kWorldSize);
-  const auto ori_packed = PackFloat<std::uint8_t>(ori, -kPi, kPi, 8);
-  bs.Write<std::uint16_t>(x_packed.packedVal);
-  bs.Write<std::uint16_t>(y_packed.packedVal);
-  bs.Write<std::uint8_t>(ori_packed);
+  tick = *server_tick;
+  for (const auto& record : frame->records) {
+    entries.push_back(SnapshotEntity{
+      .eid = static_cast<std::uint16_t>(record.id),
+      .x = kPositionXCodec.Dequantise(record.fields[0]),
+      .y = kPositionYCodec.Dequantise(record.fields[1]),
+      .ori = kOrientationCodec.Dequantise(record.fields[2]),
+    });
+  }
+  return true;
+}
 
+void WorldSnapshotDecoder::FlushAcks(
+  socketwire::ReliableConnection* connection) {
+  if (!pendingAck_) return;
+  socketwire::BitStream bs;
+  bs.Write<std::uint8_t>(kEClientToServerSnapshotAck);
+  bs.Write<std::uint32_t>(*pendingAck_);
   if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
+  pendingAck_.reset();
 }
 
-void SendTimeMsec(socketwire::ReliableConnection* connection,
-                  std::uint32_t time_msec) {
+// Unreliable: a retransmitted request would measure the retransmit timer.
+void SendClockRequest(socketwire::ReliableConnection* connection,
+                      std::uint64_t stamp) {
   socketwire::BitStream bs;
-  bs.Write<std::uint8_t>(kEServerToClientTimeMsec);
-  bs.Write<std::uint32_t>(time_msec);
-  if (connection->SendUnreliable(0, bs)) {
+  bs.Write<std::uint8_t>(kEClientToServerClockRequest);
+  bs.Write<std::uint64_t>(stamp);
+  if (connection->SendUnreliable(1, bs)) {
+    socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
+  }
+}
+
+void SendClockReply(socketwire::ReliableConnection* connection,
+                    std::uint64_t stamp, std::int64_t server_micros) {
+  socketwire::BitStream bs;
+  bs.Write<std::uint8_t>(kEServerToClientClockReply);
+  bs.Write<std::uint64_t>(stamp);
+  bs.Write<std::int64_t>(server_micros);
+  if (connection->SendUnreliable(1, bs)) {
     socketwire_examples::benchmark::RecordPayloadTx(bs.GetSizeBytes());
   }
 }
@@ -136,52 +228,54 @@ void DeserializeSetControlledEntity(const void* data, std::size_t size,
 }
 
 void DeserializeEntityInput(const void* data, std::size_t size,
-                            std::uint16_t& eid, float& thr, float& steer) {
+                            std::uint16_t& eid, std::uint32_t& newest_frame,
+                            std::vector<ShipInput>& inputs) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
   bs.Read<std::uint8_t>(type);
   bs.Read<std::uint16_t>(eid);
+  bs.Read<std::uint32_t>(newest_frame);
+  std::uint8_t count = 0;
+  bs.Read<std::uint8_t>(count);
 
-  std::uint8_t thr_steer_packed = 0;
-  bs.Read<std::uint8_t>(thr_steer_packed);
-
-  static const auto kNeutralPackedValue =
-    PackFloat<std::uint8_t>(0.f, -1.f, 1.f, 4);
-  Float4bitsQuantized thr_packed(thr_steer_packed >> 4);
-  Float4bitsQuantized steer_packed(thr_steer_packed & 0x0f);
-  thr = thr_packed.packedVal == kNeutralPackedValue
-          ? 0.f
-          : thr_packed.Unpack(-1.f, 1.f);
-  steer = steer_packed.packedVal == kNeutralPackedValue
-            ? 0.f
-            : steer_packed.Unpack(-1.f, 1.f);
+  // 0 falls between two codes; the one it rounds to decodes as exactly 0.
+  const std::uint32_t neutral = kInputCodec.Quantise(0.f);
+  inputs.clear();
+  for (std::size_t i = 0; i < std::min<std::size_t>(count, kInputWindow);
+       ++i) {
+    const auto thr_steer_packed = bs.TryRead<std::uint8_t>();
+    if (!thr_steer_packed) break;
+    const std::uint32_t thr_packed = *thr_steer_packed >> 4;
+    const std::uint32_t steer_packed = *thr_steer_packed & 0x0fu;
+    ShipInput& input = inputs.emplace_back();
+    input.thr =
+      thr_packed == neutral ? 0.f : kInputCodec.Dequantise(thr_packed);
+    input.steer =
+      steer_packed == neutral ? 0.f : kInputCodec.Dequantise(steer_packed);
+  }
 }
 
-void DeserializeSnapshot(const void* data, std::size_t size, std::uint16_t& eid,
-                         float& x, float& y, float& ori) {
+void DeserializeSnapshotAck(const void* data, std::size_t size,
+                           std::uint32_t& sequence) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
   bs.Read<std::uint8_t>(type);
-  bs.Read<std::uint16_t>(eid);
-
-  std::uint16_t x_packed = 0;
-  std::uint16_t y_packed = 0;
-  std::uint8_t ori_packed = 0;
-  bs.Read<std::uint16_t>(x_packed);
-  bs.Read<std::uint16_t>(y_packed);
-  bs.Read<std::uint8_t>(ori_packed);
+  bs.Read<std::uint32_t>(sequence);
+}
 
-  PositionXQuantized x_packed_val(x_packed);
-  PositionYQuantized y_packed_val(y_packed);
-  x = x_packed_val.Unpack(-kWorldSize, kWorldSize);
-  y = y_packed_val.Unpack(-kWorldSize, kWorldSize);
-  ori = UnpackFloat<std::uint8_t>(ori_packed, -kPi, kPi, 8);
+void DeserializeClockRequest(const void* data, std::size_t size,
+                             std::uint64_t& stamp) {
+  socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
+  std::uint8_t type = 0;
+  bs.Read<std::uint8_t>(type);
+  bs.Read<std::uint64_t>(stamp);
 }
 
-void DeserializeTimeMsec(const void* data, std::size_t size,
-                         std::uint32_t& time_msec) {
+void DeserializeClockReply(const void* data, std::size_t size,
+                           std::uint64_t& stamp, std::int64_t& server_micros) {
   socketwire::BitStream bs(static_cast<const std::uint8_t*>(data), size);
   std::uint8_t type = 0;
   bs.Read<std::uint8_t>(type);
-  bs.Read<std::uint32_t>(time_msec);
+  bs.Read<std::uint64_t>(stamp);
+  bs.Read<std::int64_t>(server_micros);
 }
@@ -1,13 +1,22 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <vector>
 
 #include "entity.h"
+#include "input_stream.hpp"
+#include "snapshot_delta.hpp"
 
 namespace socketwire {
+class BitStream;
 class ReliableConnection;
-}
+}  // namespace socketwire
+
+// The server's fixed step; snapshot ticks are counted in it.
+constexpr std::chrono::milliseconds kTickInterval{10};
 
 enum MessageType : std::uint8_t {
   kEClientToServerJoin = 0,
@@ -15,7 +24,9 @@ enum MessageType : std::uint8_t {
   kEServerToClientSetControlledEntity,
   kEClientToServerInput,
   kEServerToClientSnapshot,
-  kEServerToClientTimeMsec
+  kEClientToServerClockRequest,
+  kEClientToServerSnapshotAck,
+  kEServerToClientClockReply
 };
 
 void SendJoin(socketwire::ReliableConnection* connection);
@@ -23,21 +34,124 @@ void SendNewEntity(socketwire::ReliableConnection* connection,
                    const Entity& ent);
 void SendSetControlledEntity(socketwire::ReliableConnection* connection,
                              std::uint16_t eid);
+
+struct ShipInput {
+  float thr = 0.f;
+  float steer = 0.f;
+};
+
+// Frames per input packet; a frame's input survives kInputWindow - 1 lost
+// packets in a row.
+constexpr std::size_t kInputWindow = 8;
+using ShipInputWindow =
+  socketwire_examples::InputWindow<ShipInput, kInputWindow>;
+using ShipInputBuffer = socketwire_examples::InputBuffer<ShipInput, 32>;
+
+// The newest frame number, a count, then 4-bit throttle and steer per frame,
+// newest first; frames are consecutive, so only the newest is written.
 void SendEntityInput(socketwire::ReliableConnection* connection,
-                     std::uint16_t eid, float thr, float steer);
-void SendSnapshot(socketwire::ReliableConnection* connection, std::uint16_t eid,
-                  float x, float y, float ori);
-void SendTimeMsec(socketwire::ReliableConnection* connection,
-                  std::uint32_t time_msec);
+                     std::uint16_t eid, const ShipInputWindow& inputs);
+
+// One entry of a world snapshot: 16-bit eid, 11-bit x, 10-bit y and 8-bit
+// orientation, delta-encoded against the client's last acked snapshot.
+struct SnapshotEntity {
+  std::uint16_t eid = kInvalidEntity;
+  float x = 0.f;
+  float y = 0.f;
+  float ori = 0.f;
+};
+
+// Bits of one ship's snapshot fields: x, y and orientation.
+constexpr std::size_t kSnapshotShipBits = 11 + 10 + 8;
+// Message type and tick, then the delta's sequence, baseline flag, baseline
+// distance varint and the end markers of its remove and change lists.
+constexpr std::size_t kSnapshotHeaderBits = 8 + 32 + 32 + 1 + 10 + 2;
+// The largest snapshot is a full view turnover: every ship in the baseline
+// leaves (flag and eid) and as many new ones enter (flag, eid, new flag and
+// all fields). A changed ship costs at most 3 bits more than a new one but
+// never comes with a removal.
+constexpr std::size_t kSnapshotTurnoverBitsPerShip =
+  (1 + 16) + (1 + 16 + 1 + kSnapshotShipBits);
+// A client sees at most this many ships around its own, so its snapshot is
+// one packet under the default 1400-byte transport packet even when the
+// whole view turns over between acks.
+constexpr std::size_t kSnapshotEntitiesPerPacket =
+  (1400 * 8 - kSnapshotHeaderBits) / kSnapshotTurnoverBitsPerShip;
+
+// The ship fields snapshots carry, copied out of the simulation once per
+// tick so clients' snapshots can be encoded while the next tick runs.
+// |tick| is the server tick they were taken at, dropped ticks included.
+struct WorldState {
+  std::uint32_t sequence = 0;
+  std::uint32_t tick = 0;
+  std::vector<std::uint16_t> eids;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> ori;
+};
+
+// Server side of one client's snapshot stream. Build() records the ships the
+// client can see; Encode() delta-encodes them against the client's newest
+// ack, so ships entering or leaving the view go out as adds and removes,
+// stamped with the world's server tick. Both only touch this encoder and may
+// run on a worker thread.
+class WorldSnapshotEncoder {
+ public:
+  WorldSnapshotEncoder();
+
+  // |visible| holds indices into |world|.
+  void Build(const WorldState& world,
+             const std::vector<std::uint32_t>& visible);
+  // The packet stays valid until the next Build().
+  const socketwire::BitStream& Encode(
+    const socketwire_examples::DeltaBaseline& ack);
+
+ private:
+  socketwire_examples::SnapshotDeltaSender<3> sender_;
+  std::uint32_t tick_ = 0;
+};
+
+void SendSnapshot(socketwire::ReliableConnection* connection,
+                  const socketwire::BitStream& packet);
+
+// Client side of the snapshot stream. Read() rebuilds the ships in view and
+// queues an ack; FlushAcks() sends it.
+class WorldSnapshotDecoder {
+ public:
+  WorldSnapshotDecoder();
+
+  // Replaces |entries| with every ship in view, ordered by eid. Returns false
+  // when the packet is truncated, references a lost baseline or is older than
+  // the state already applied.
+  bool Read(const void* data, std::size_t size,
+            std::vector<SnapshotEntity>& entries, std::uint32_t& tick);
+  void FlushAcks(socketwire::ReliableConnection* connection);
+
+ private:
+  socketwire_examples::SnapshotDeltaReceiver<3> receiver_;
+  std::optional<std::uint32_t> pendingAck_;
+};
+
+// Clock sync (clock_sync.hpp): the client's stamp, echoed back with the
+// server's time in microseconds since its first tick.
+void SendClockRequest(socketwire::ReliableConnection* connection,
+                      std::uint64_t stamp);
+void SendClockReply(socketwire::ReliableConnection* connection,
+                    std::uint64_t stamp, std::int64_t server_micros);
 
 MessageType GetPacketType(const void* data, std::size_t size);
 
 void DeserializeNewEntity(const void* data, std::size_t size, Entity& ent);
 void DeserializeSetControlledEntity(const void* data, std::size_t size,
                                     std::uint16_t& eid);
+// |inputs| gets the packet's inputs newest first; a truncated packet yields
+// the inputs that fit.
 void DeserializeEntityInput(const void* data, std::size_t size,
-                            std::uint16_t& eid, float& thr, float& steer);
-void DeserializeSnapshot(const void* data, std::size_t size, std::uint16_t& eid,
-                         float& x, float& y, float& ori);
-void DeserializeTimeMsec(const void* data, std::size_t size,
-                         std::uint32_t& time_msec);
+                            std::uint16_t& eid, std::uint32_t& newest_frame,
+                            std::vector<ShipInput>& inputs);
+void DeserializeSnapshotAck(const void* data, std::size_t size,
+                           std::uint32_t& sequence);
+void DeserializeClockRequest(const void* data, std::size_t size,
+                             std::uint64_t& stamp);
+void DeserializeClockReply(const void* data, std::size_t size,
+                           std::uint64_t& stamp, std::int64_t& server_micros);
@@ -1,24 +1,66 @@
-#include <algorithm>
 #include <chrono>
 #include <cstdio>
-#include <map>
+#include <optional>
 #include <print>
 #include <random>
-#include <thread>
 #include <vector>
 
 #include "benchmark_utils.hpp"
+#include "client_states.hpp"
+#include "clock_sync.hpp"
 #include "entity.h"
+#include "entity_registry.hpp"
+#include "interest_management.hpp"
+#include "packet_capture.hpp"
+#include "parallel_for.hpp"
 #include "protocol.h"
 #include "server_connection_hub.hpp"
+#include "ship_soa.hpp"
 #include "socketwire_example_utils.hpp"
-
+#include "tick_scheduler.hpp"
+
+// What one client can see. Ships are never removed, so indices into
+// |entities| double as interest ids.
+struct ClientView {
+  std::size_t shipIndex = 0;
+  socketwire_examples::InterestSet interest;
+  // Ships already sent to this client with kEServerToClientNewEntity.
+  std::vector<bool> introduced;
+  WorldSnapshotEncoder snapshots;
+  socketwire_examples::DeltaBaseline ack;
+  // Only the network thread touches this; encodes never read it.
+  ShipInputBuffer inputs;
+};
+
+// The client camera starts zoomed out over the whole world, but the ships
+// around its own are the ones worth a per-tick update.
+static constexpr socketwire_examples::InterestConfig kInterestConfig{
+  .viewRadius = 60.f,
+  .leaveMargin = 5.f,
+  .maxEntities = kSnapshotEntitiesPerPacket,
+  .wrapSize = kWorldSize,
+};
+
+// Colour, eid and ownership per ship; the kinematics live in |ships| at the
+// same index and the copies in |entities| go stale after the first tick. All
+// three and |controllers| are parallel to ship_ids.Ids().
+static socketwire_examples::EntityRegistry<std::uint16_t> ship_ids(
+  kInvalidEntity);
 static std::vector<Entity> entities;
-static std::map<std::uint16_t,
-                socketwire_examples::ServerConnectionHub::Client*>
-  controlled_map;
+static socketwire_examples::ShipArrays ships;
+static std::vector<socketwire_examples::ServerConnectionHub::Client*>
+  controllers;
+// The last tick handed to the snapshot encoders. Only PublishWorld() writes
+// it, and only while no encode is in flight.
+static WorldState published;
+static socketwire_examples::SpatialGrid published_grid(20.f);
+static std::uint32_t snapshot_sequence = 0;
+static std::uint32_t sim_tick = 0;
+static std::uint64_t ai_seed = 0;
+static socketwire_examples::ClientStates<ClientView> client_views;
 
 static constexpr std::uint16_t kDefaultShipSwarmPort = 10133;
+static constexpr std::chrono::milliseconds kPollInterval{1};
 
 static std::uint16_t ResolveListenPort(
   int argc, const char** argv,
@@ -48,10 +90,11 @@ static float RandomOrientation() {
   return distribution(RandomGenerator());
 }
 
-static std::uint16_t NextEntityId() {
-  std::uint16_t max_eid = entities.empty() ? kInvalidEntity : entities[0].eid;
-  for (const Entity& e : entities) max_eid = std::max(max_eid, e.eid);
-  return static_cast<std::uint16_t>(max_eid + 1);
+// Ship |index| with its current kinematics, for reliable introductions.
+static Entity ShipEntity(std::size_t index) {
+  Entity ent = entities[index];
+  ships.Load(index, ent);
+  return ent;
 }
 
 static Entity MakeShip(std::uint16_t eid, bool server_controlled) {
@@ -81,86 +124,211 @@ static Entity MakeShip(std::uint16_t eid, bool server_controlled) {
   return ent;
 }
 
-static void BroadcastEntity(socketwire_examples::ServerConnectionHub& hub,
-                            const Entity& ent) {
-  for (auto* client : hub.Clients()) {
-    if (client != nullptr && client->connection != nullptr &&
-        client->connection->IsConnected()) {
-      SendNewEntity(client->connection.get(), ent);
-    }
-  }
+// Returns the new ship's index, or nullopt when every eid is taken.
+static std::optional<std::size_t> AddShip(
+  socketwire_examples::ServerConnectionHub::Client* controller) {
+  const std::optional<std::uint16_t> eid = ship_ids.Create();
+  if (!eid) return std::nullopt;
+  Entity const ent = MakeShip(*eid, controller == nullptr);
+  entities.push_back(ent);
+  controllers.push_back(controller);
+  return ships.Add(ent);
 }
 
-static void OnJoin(socketwire_examples::ServerConnectionHub& hub,
-                   socketwire_examples::ServerConnectionHub::Client& client) {
-  for (const Entity& ent : entities) {
-    SendNewEntity(client.connection.get(), ent);
+// Ships reach a client with kEServerToClientNewEntity the first time they
+// enter its view, so joining no longer costs a packet per ship in the world.
+// A client that joins again keeps its ship: a second one would be orphaned,
+// and an encode in flight may be reading the view's shipIndex.
+static void OnJoin(socketwire_examples::ServerConnectionHub::Client& client) {
+  if (const ClientView* view = client_views.Find(client)) {
+    SendSetControlledEntity(client.connection.get(),
+                            ship_ids.IdAt(view->shipIndex));
+    return;
   }
 
-  const std::uint16_t new_eid = NextEntityId();
-  Entity const ent = MakeShip(new_eid, false);
-  entities.push_back(ent);
-  controlled_map[new_eid] = &client;
+  const std::optional<std::size_t> index = AddShip(&client);
+  if (!index) return;
+  client_views.Emplace(client).shipIndex = *index;
 
-  BroadcastEntity(hub, ent);
-  SendSetControlledEntity(client.connection.get(), new_eid);
+  SendSetControlledEntity(client.connection.get(), entities[*index].eid);
 }
 
-static void CreateServerEntity(socketwire_examples::ServerConnectionHub& hub) {
-  const std::uint16_t new_eid = NextEntityId();
-  Entity const ent = MakeShip(new_eid, true);
-  entities.push_back(ent);
-  controlled_map[new_eid] = nullptr;
-  BroadcastEntity(hub, ent);
-}
+static void CreateServerEntity() { AddShip(nullptr); }
 
-static void OnInput(const void* data, std::size_t size) {
+// Every packet repeats the client's last few frames; the buffer keeps the
+// ones it has not seen and ConsumeInputs() applies one per tick.
+static void OnInput(socketwire_examples::ServerConnectionHub::Client& client,
+                    const void* data, std::size_t size) {
+  static std::vector<ShipInput> inputs;
   std::uint16_t eid = kInvalidEntity;
-  float thr = 0.f;
-  float steer = 0.f;
-  DeserializeEntityInput(data, size, eid, thr, steer);
-
-  for (Entity& e : entities) {
-    if (e.eid == eid) {
-      e.thr = thr;
-      e.steer = steer;
-      return;
-    }
+  std::uint32_t newest_frame = 0;
+  DeserializeEntityInput(data, size, eid, newest_frame, inputs);
+
+  // Clients may only steer the ship they control.
+  const std::optional<std::size_t> index = ship_ids.IndexOf(eid);
+  if (!index || controllers[*index] != &client) return;
+  ClientView* view = client_views.Find(client);
+  if (view == nullptr) return;
+  for (std::size_t age = 0; age < inputs.size(); ++age) {
+    view->inputs.Offer(newest_frame - static_cast<std::uint32_t>(age),
+                      inputs[age]);
   }
 }
 
-static void UpdateAi(Entity& e) {
-  if (RandomInt(0, 99) == 0) e.thr = e.thr > 0.f ? 0.f : 1.f;
-  if (RandomInt(0, 9) == 0) {
-    e.steer =
-      e.steer != 0.f ? 0.f : static_cast<float>(RandomInt(0, 1) * 2 - 1);
+static void ConsumeInputs() {
+  for (const auto& entry : client_views.Entries()) {
+    ClientView& view = entry->state;
+    const ShipInput& input = view.inputs.Consume();
+    ships.thr[view.shipIndex] = input.thr;
+    ships.steer[view.shipIndex] = input.steer;
   }
 }
 
-static void SimulateWorld(socketwire_examples::ServerConnectionHub& hub,
+// Ships per simulation chunk; smaller worlds stay on the network thread.
+static constexpr std::size_t kMinShipsPerChunk = 4096;
+// Clients per interest/encode chunk.
+static constexpr std::size_t kMinViewsPerChunk = 8;
+
+// AI dice hashed from the run seed, tick, ship and roll (splitmix64), so the
+// AI makes the same choices whichever thread handles a ship, in any order.
+static std::uint32_t AiRoll(std::size_t index, std::uint32_t roll) {
+  std::uint64_t z = ai_seed ^ ((static_cast<std::uint64_t>(sim_tick) << 32) |
+                               (static_cast<std::uint64_t>(index) << 2) | roll);
+  z += 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return static_cast<std::uint32_t>((z ^ (z >> 31)) >> 32);
+}
+
+static void UpdateAi(std::size_t index) {
+  float& thr = ships.thr[index];
+  float& steer = ships.steer[index];
+  if (AiRoll(index, 0) % 100 == 0) thr = thr > 0.f ? 0.f : 1.f;
+  if (AiRoll(index, 1) % 10 == 0) {
+    steer = steer != 0.f ? 0.f : (AiRoll(index, 2) & 1u) != 0 ? 1.f : -1.f;
+  }
+}
+
+// Client ships take their next buffered input, then each chunk sets its
+// ships' AI input and integrates them; ships do not interact, so the split
+// cannot change the result, which stays the same as SimulateEntity() per
+// ship.
+static void SimulateWorld(socketwire_examples::ParallelFor& parallel,
                           float dt) {
-  for (Entity& e : entities) {
-    if (e.serverControlled) UpdateAi(e);
+  ++sim_tick;
+  ConsumeInputs();
+  parallel.Run(ships.Size(), kMinShipsPerChunk,
+               [dt](std::size_t, std::size_t begin, std::size_t end) {
+                 for (std::size_t i = begin; i < end; ++i) {
+                   if (entities[i].serverControlled) UpdateAi(i);
+                 }
+                 socketwire_examples::IntegrateShips(ships, kShipTuning, dt,
+                                                     begin, end);
+               });
+}
 
-    SimulateEntity(e, dt);
+static void OnSnapshotAck(
+  socketwire_examples::ServerConnectionHub::Client& client, const void* data,
+  std::size_t size) {
+  std::uint32_t sequence = 0;
+  DeserializeSnapshotAck(data, size, sequence);
+  // Acks for ticks not sent yet would pin a baseline the client never saw.
+  if (static_cast<std::int32_t>(snapshot_sequence - sequence) < 0) return;
 
-    for (auto* client : hub.Clients()) {
-      if (client != nullptr && client->connection != nullptr &&
-          client->connection->IsConnected()) {
-        SendSnapshot(client->connection.get(), e.eid, e.x, e.y, e.ori);
-      }
-    }
+  if (ClientView* view = client_views.Find(client)) {
+    view->ack.Acknowledge(sequence);
+  }
+}
+
+// One client's snapshot for the published tick. The ack is copied at launch
+// because acks keep arriving on this thread while the encode runs.
+struct SnapshotJob {
+  socketwire_examples::ServerConnectionHub::Client* client = nullptr;
+  ClientView* view = nullptr;
+  socketwire_examples::DeltaBaseline ack;
+  const socketwire::BitStream* packet = nullptr;
+};
+static std::vector<SnapshotJob> snapshot_jobs;
+
+// Copies the ship fields snapshots need and indexes them, so encoders read a
+// tick that stays put while the next one is simulated.
+static void PublishWorld(std::uint64_t tick) {
+  published.sequence = ++snapshot_sequence;
+  published.tick = static_cast<std::uint32_t>(tick);
+  published.eids.assign(ship_ids.Ids().begin(), ship_ids.Ids().end());
+  published.x.assign(ships.x.begin(), ships.x.end());
+  published.y.assign(ships.y.begin(), ships.y.end());
+  published.ori.assign(ships.ori.begin(), ships.ori.end());
+  published_grid.Clear();
+  for (std::size_t i = 0; i < published.x.size(); ++i) {
+    published_grid.Insert(static_cast<std::uint32_t>(i), published.x[i],
+                          published.y[i]);
   }
 }
 
-static void UpdateTime(socketwire_examples::ServerConnectionHub& hub,
-                       std::uint32_t cur_time) {
+// Each joined client gets the ships within its view radius, nearest first, as
+// a delta against its newest ack. Outbound traffic follows the density around
+// each ship instead of the size of the world. Interest and encoding touch
+// only the published world and the client's own view, so they run on the
+// pool while this thread polls and simulates the next tick.
+static void LaunchSnapshots(socketwire_examples::ServerConnectionHub& hub,
+                            socketwire_examples::ParallelFor& parallel) {
+  snapshot_jobs.clear();
   for (auto* client : hub.Clients()) {
-    if (client != nullptr && client->connection != nullptr &&
-        client->connection->IsConnected()) {
-      SendTimeMsec(client->connection.get(), cur_time);
+    if (client == nullptr || client->connection == nullptr ||
+        !client->connection->IsConnected()) {
+      continue;
+    }
+    if (ClientView* view = client_views.Find(*client)) {
+      snapshot_jobs.push_back({client, view, view->ack, nullptr});
     }
   }
+
+  parallel.Launch(snapshot_jobs.size(), kMinViewsPerChunk,
+                  [](std::size_t, std::size_t begin, std::size_t end) {
+                    for (std::size_t i = begin; i < end; ++i) {
+                      SnapshotJob& job = snapshot_jobs[i];
+                      ClientView& view = *job.view;
+                      view.interest.Update(published_grid,
+                                           published.x[view.shipIndex],
+                                           published.y[view.shipIndex],
+                                           kInterestConfig);
+                      view.snapshots.Build(published, view.interest.Visible());
+                      job.packet = &view.snapshots.Encode(job.ack);
+                    }
+                  });
+}
+
+// Sends what the last LaunchSnapshots() encoded, one client after another on
+// this thread; the connections batch them into datagrams on Update().
+static void FlushSnapshots(socketwire_examples::ParallelFor& parallel) {
+  parallel.Wait();
+  for (const SnapshotJob& job : snapshot_jobs) {
+    if (job.packet == nullptr || job.client->connection == nullptr ||
+        !job.client->connection->IsConnected()) {
+      continue;
+    }
+    ClientView& view = *job.view;
+    view.introduced.resize(entities.size());
+    for (const std::uint32_t index : view.interest.Entered()) {
+      if (view.introduced[index]) continue;
+      SendNewEntity(job.client->connection.get(), ShipEntity(index));
+      view.introduced[index] = true;
+    }
+    SendSnapshot(job.client->connection.get(), *job.packet);
+  }
+  snapshot_jobs.clear();
+}
+
+// Answered as soon as the request is read, so the reply time sits halfway
+// through the client's measured round trip.
+static void OnClockRequest(
+  socketwire_examples::ServerConnectionHub::Client& client, const void* data,
+  std::size_t size, std::chrono::steady_clock::time_point start) {
+  std::uint64_t stamp = 0;
+  DeserializeClockRequest(data, size, stamp);
+  SendClockReply(client.connection.get(), stamp,
+                 socketwire_examples::ServerMicrosSince(start));
 }
 
 int main(int argc, const char** argv) {
@@ -169,75 +337,109 @@ int main(int argc, const char** argv) {
   socketwire_examples::benchmark::MetricsCollector metrics(
     bench_options, "ship-swarm", "socketwire", "server");
   socketwire_examples::benchmark::SetActiveCollector(&metrics);
+  metrics.SetDefaultTickBudgetMs(
+    std::chrono::duration<double, std::milli>(kTickInterval).count());
+  socketwire_examples::ParallelFor parallel(
+    socketwire_examples::ParallelFor::ResolveWorkers(
+      bench_options.simWorkers));
+  ai_seed = RandomGenerator()();
 
   const std::uint16_t listen_port =
     ResolveListenPort(argc, argv, bench_options);
 
-  auto socket = socketwire_examples::CreateUdpSocket(listen_port);
-  if (socket == nullptr) return 1;
+  const auto server_socket = socketwire_examples::CreateServerSocket(
+    listen_port, bench_options.replayPath, bench_options.replaySpeed);
+  if (server_socket.socket == nullptr) return 1;
 
   std::println("ship-swarm server listening on UDP port {}",
                static_cast<unsigned>(listen_port));
 
   socketwire::ReliableConnectionConfig cfg;
   cfg.numChannels = 2;
-  socketwire_examples::ServerConnectionHub hub(socket.get(), cfg);
+  socketwire_examples::ServerConnectionHub hub(server_socket.socket.get(), cfg);
+  socketwire_examples::PacketCaptureWriter capture(bench_options.capturePath);
+  hub.SetCaptureWriter(&capture);
 
   hub.SetConnectedCallback([](auto& client) {
     std::println("client connected from port {}",
                  static_cast<unsigned>(client.port));
   });
 
-  hub.SetDisconnectedCallback([](auto& client) {
+  hub.SetDisconnectedCallback([&parallel](auto& client) {
     std::println("client disconnected from port {}",
                  static_cast<unsigned>(client.port));
-    for (auto& entry : controlled_map) {
-      if (entry.second == &client) entry.second = nullptr;
+    for (auto*& controller : controllers) {
+      if (controller == &client) controller = nullptr;
     }
+    // An encode in flight may still be writing into the view.
+    parallel.Wait();
+    std::erase_if(snapshot_jobs, [&client](const SnapshotJob& job) {
+      return job.client == &client;
+    });
+    client_views.Erase(client);
   });
 
+  const auto start = std::chrono::steady_clock::now();
   hub.SetPacketCallback(
     [&](auto& client, std::uint8_t, const void* data, std::size_t size, bool) {
       socketwire_examples::benchmark::RecordPayloadRx(size);
       switch (GetPacketType(data, size)) {
         case kEClientToServerJoin:
-          OnJoin(hub, client);
+          OnJoin(client);
           break;
         case kEClientToServerInput:
-          OnInput(data, size);
+          OnInput(client, data, size);
+          break;
+        case kEClientToServerSnapshotAck:
+          OnSnapshotAck(client, data, size);
+          break;
+        case kEClientToServerClockRequest:
+          OnClockRequest(client, data, size, start);
           break;
         case kEServerToClientNewEntity:
         case kEServerToClientSetControlledEntity:
         case kEServerToClientSnapshot:
-        case kEServerToClientTimeMsec:
+        case kEServerToClientClockReply:
           break;
       }
     });
 
   constexpr std::size_t num_ships = 100;
-  for (std::size_t i = 0; i < num_ships; ++i) CreateServerEntity(hub);
+  for (std::size_t i = 0; i < num_ships; ++i) CreateServerEntity();
 
-  const auto start = std::chrono::steady_clock::now();
-  auto last_time = start;
+  socketwire_examples::TickScheduler scheduler(
+    {.simInterval = kTickInterval, .pollInterval = kPollInterval}, start);
   while (true) {
-    if (bench_options.enabled && metrics.Done()) break;
+    if ((bench_options.enabled && metrics.Done()) ||
+        server_socket.ReplayFinished()) {
+      break;
+    }
+    const std::uint32_t steps = scheduler.WaitNext();
+    if (steps == 0) {
+      hub.Poll();
+      hub.Update();
+      continue;
+    }
+    metrics.RecordTickPacing(scheduler.LastLateness(), steps,
+                             scheduler.LastDropped());
     const auto frame_start = std::chrono::steady_clock::now();
-    const auto cur_time = std::chrono::steady_clock::now();
-    const float dt =
-      static_cast<float>(std::chrono::duration_cast<std::chrono::milliseconds>(
-                           cur_time - last_time)
-                           .count()) *
-      0.001f;
-    last_time = cur_time;
-
-    const auto update_start = std::chrono::steady_clock::now();
+    const auto update_start = frame_start;
+    metrics.BeginTick();
     hub.Poll();
     hub.Update();
-    SimulateWorld(hub, dt);
-    const auto elapsed_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(cur_time - start)
-        .count();
-    UpdateTime(hub, static_cast<std::uint32_t>(elapsed_ms));
+    metrics.MarkTickPhase(socketwire_examples::benchmark::TickPhase::kPoll);
+    for (std::uint32_t step = 0; step < steps; ++step) {
+      SimulateWorld(parallel, scheduler.StepSeconds());
+    }
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kSimulate);
+    // Snapshots go out one tick after they are encoded: the previous tick's
+    // encodes ran alongside this tick's poll and simulation.
+    FlushSnapshots(parallel);
+    PublishWorld(scheduler.CurrentTick());
+    LaunchSnapshots(hub, parallel);
+    metrics.MarkTickPhase(
+      socketwire_examples::benchmark::TickPhase::kBroadcast);
     const auto update_end = std::chrono::steady_clock::now();
 
     if (bench_options.enabled) {
@@ -247,6 +449,14 @@ int main(int argc, const char** argv) {
         socketwire_examples::benchmark::StatsFromClients(clients));
       socketwire_examples::benchmark::GameMetrics game_metrics;
       game_metrics.entityCountServer = entities.size();
+      for (const auto& entry : client_views.Entries()) {
+        game_metrics.inputBufferDepth += entry->state.inputs.Depth();
+        game_metrics.inputStarvationCount += entry->state.inputs.Starved();
+      }
+      if (!client_views.Empty()) {
+        game_metrics.inputBufferDepth /=
+          static_cast<double>(client_views.Size());
+      }
       metrics.SetGameMetrics(game_metrics);
       metrics.RecordUpdateMs(
         static_cast<double>(
@@ -262,10 +472,14 @@ int main(int argc, const char** argv) {
         1000.0);
       metrics.MaybeWriteSample();
     }
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    metrics.EndTick();
   }
 
+  if (server_socket.replay != nullptr) {
+    metrics.SetReplayStats(server_socket.replay->ReplayedPackets(),
+                           server_socket.replay->DroppedSendBytes());
+    server_socket.PrintReplaySummary();
+  }
   metrics.Finish();
   socketwire_examples::benchmark::SetActiveCollector(nullptr);
 }
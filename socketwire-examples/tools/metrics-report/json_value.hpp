@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace metrics_report {
+
+// Just enough JSON for the metrics lines the examples write: objects, arrays,
+// strings with simple escapes, numbers, booleans and null.
+struct JsonValue {
+  enum class Kind : std::uint8_t {
+    kNull,
+    kBool,
+    kNumber,
+    kString,
+    kArray,
+    kObject
+  };
+
+  Kind kind = Kind::kNull;
+  bool boolean = false;
+  double number = 0.0;
+  std::string text;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  [[nodiscard]] const JsonValue* Find(std::string_view key) const {
+    for (const auto& [name, value] : members) {
+      if (name == key) return &value;
+    }
+    return nullptr;
+  }
+
+  [[nodiscard]] std::optional<double> Number(std::string_view key) const {
+    const JsonValue* value = Find(key);
+    if (value == nullptr) return std::nullopt;
+    if (value->kind == Kind::kNumber) return value->number;
+    if (value->kind == Kind::kBool) return value->boolean ? 1.0 : 0.0;
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::string String(std::string_view key) const {
+    const JsonValue* value = Find(key);
+    if (value == nullptr) return {};
+    if (value->kind == Kind::kString) return value->text;
+    if (value->kind == Kind::kNumber) {
+      const auto integral = static_cast<std::int64_t>(value->number);
+      if (static_cast<double>(integral) == value->number) {
+        return std::to_string(integral);
+      }
+      return std::to_string(value->number);
+    }
+    if (value->kind == Kind::kBool) return value->boolean ? "true" : "false";
+    return {};
+  }
+};
+
+class JsonParser {
+ public:
+  explicit JsonParser(std::string_view text) : text_(text) {}
+
+  bool Parse(JsonValue& out) {
+    if (!ParseValue(out, 0)) return false;
+    SkipSpace();
+    return pos_ == text_.size();
+  }
+
+ private:
+  static constexpr int kMaxDepth = 32;
+
+  void SkipSpace() {
+    while (pos_ < text_.size() &&
+           std::isspace(static_cast<unsigned char>(text_[pos_])) != 0) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(char expected) {
+    SkipSpace();
+    if (pos_ >= text_.size() || text_[pos_] != expected) return false;
+    ++pos_;
+    return true;
+  }
+
+  bool ConsumeWord(std::string_view word) {
+    if (text_.substr(pos_, word.size()) != word) return false;
+    pos_ += word.size();
+    return true;
+  }
+
+  bool ParseValue(JsonValue& out, int depth) {
+    if (depth > kMaxDepth) return false;
+    SkipSpace();
+    if (pos_ >= text_.size()) return false;
+
+    const char c = text_[pos_];
+    if (c == '{') return ParseObject(out, depth);
+    if (c == '[') return ParseArray(out, depth);
+    if (c == '"') {
+      out.kind = JsonValue::Kind::kString;
+      return ParseString(out.text);
+    }
+    if (ConsumeWord("true")) {
+      out.kind = JsonValue::Kind::kBool;
+      out.boolean = true;
+      return true;
+    }
+    if (ConsumeWord("false")) {
+      out.kind = JsonValue::Kind::kBool;
+      out.boolean = false;
+      return true;
+    }
+    if (ConsumeWord("null")) {
+      out.kind = JsonValue::Kind::kNull;
+      return true;
+    }
+    return ParseNumber(out);
+  }
+
+  bool ParseObject(JsonValue& out, int depth) {
+    out.kind = JsonValue::Kind::kObject;
+    ++pos_;
+    if (Consume('}')) return true;
+    do {
+      std::string key;
+      SkipSpace();
+      if (!ParseString(key) || !Consume(':')) return false;
+      JsonValue value;
+      if (!ParseValue(value, depth + 1)) return false;
+      out.members.emplace_back(std::move(key), std::move(value));
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  bool ParseArray(JsonValue& out, int depth) {
+    out.kind = JsonValue::Kind::kArray;
+    ++pos_;
+    if (Consume(']')) return true;
+    do {
+      JsonValue value;
+      if (!ParseValue(value, depth + 1)) return false;
+      out.items.push_back(std::move(value));
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+  bool ParseString(std::string& out) {
+    if (pos_ >= text_.size() || text_[pos_] != '"') return false;
+    ++pos_;
+    while (pos_ < text_.size()) {
+      const char c = text_[pos_++];
+      if (c == '"') return true;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (pos_ >= text_.size()) return false;
+      const char escaped = text_[pos_++];
+      switch (escaped) {
+        case 'n':
+          out += '\n';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'u':
+          // Metrics never carry non-ASCII text; keep a placeholder.
+          if (pos_ + 4 > text_.size()) return false;
+          pos_ += 4;
+          out += '?';
+          break;
+        default:
+          out += escaped;
+          break;
+      }
+    }
+    return false;
+  }
+
+  bool ParseNumber(JsonValue& out) {
+    const char* begin = text_.data() + pos_;
+    const char* end = text_.data() + text_.size();
+    double value = 0.0;
+    const auto [next, error] = std::from_chars(begin, end, value);
+    if (error != std::errc{} || next == begin) return false;
+    pos_ += static_cast<std::size_t>(next - begin);
+    out.kind = JsonValue::Kind::kNumber;
+    out.number = value;
+    return true;
+  }
+
+  std::string_view text_;
+  std::size_t pos_ = 0;
+};
+
+inline bool ParseJson(std::string_view text, JsonValue& out) {
+  return JsonParser(text).Parse(out);
+}
+
+}  // namespace metrics_report
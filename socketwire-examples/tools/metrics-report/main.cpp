@@ -0,0 +1,608 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <print>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "json_value.hpp"
+#include "svg_chart.hpp"
+
+namespace metrics_report {
+namespace {
+
+struct Options {
+  std::string outPath = "metrics-report.html";
+  std::string title = "SocketWire benchmark report";
+  std::vector<std::string> inputs;
+};
+
+// Fields that identify one run; whichever of them differ between the loaded
+// series make up the series labels.
+constexpr std::array<std::string_view, 8> kIdentityFields{
+  "file",    "example",        "role",    "transport",
+  "profile", "server_workers", "clients", "run",
+};
+
+struct Series {
+  std::map<std::string, std::string, std::less<>> identity;
+  std::string label{};
+  std::vector<JsonValue> samples{};
+  std::optional<JsonValue> final{};
+  std::optional<JsonValue> tickProfile{};
+
+  [[nodiscard]] std::string Field(std::string_view name) const {
+    const auto it = identity.find(name);
+    return it == identity.end() ? std::string{} : it->second;
+  }
+};
+
+enum class MetricMode : std::uint8_t { kValue, kRate, kEchoLoss };
+
+struct MetricDef {
+  std::string_view title;
+  std::string_view unit;
+  std::array<std::string_view, 2> keys;
+  MetricMode mode = MetricMode::kValue;
+  double scale = 1.0;
+};
+
+constexpr std::array<MetricDef, 13> kMetrics{{
+  {"Payload TX", "kB/s", {"payload_tx_bytes", ""}, MetricMode::kRate, 1e-3},
+  {"Payload RX", "kB/s", {"payload_rx_bytes", ""}, MetricMode::kRate, 1e-3},
+  {"Transport loss", "packets/s", {"lost_packets", "Lost_packets"},
+   MetricMode::kRate, 1.0},
+  {"Echo loss", "% of sent", {"reliable_sent", ""}, MetricMode::kEchoLoss,
+   1.0},
+  {"RTT", "ms", {"rtt_ms", ""}, MetricMode::kValue, 1.0},
+  {"CPU", "%", {"cpu_percent", ""}, MetricMode::kValue, 1.0},
+  {"RSS", "MB", {"rss_kb", ""}, MetricMode::kValue, 1.0 / 1024.0},
+  {"Tick p50", "ms", {"tick_ms_p50", ""}, MetricMode::kValue, 1.0},
+  {"Tick p95", "ms", {"tick_ms_p95", ""}, MetricMode::kValue, 1.0},
+  {"Tick p99", "ms", {"tick_ms_p99", ""}, MetricMode::kValue, 1.0},
+  {"Tick max", "ms", {"tick_ms_max", ""}, MetricMode::kValue, 1.0},
+  {"Update", "ms", {"update_ms_avg", ""}, MetricMode::kValue, 1.0},
+  {"Connected clients", "clients", {"connected_clients", ""},
+   MetricMode::kValue, 1.0},
+}};
+
+constexpr std::array<std::string_view, 5> kEchoBuckets{
+  "reliable", "unreliable", "unsequenced", "sequenced", "deadline"};
+
+void PrintUsage() {
+  std::println(
+    "usage: metrics-report [--out report.html] [--title text] "
+    "metrics.jsonl...");
+}
+
+bool ParseArgs(int argc, const char** argv, Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strcmp(arg, "--out") == 0 && i + 1 < argc) {
+      options.outPath = argv[++i];
+    } else if (std::strcmp(arg, "--title") == 0 && i + 1 < argc) {
+      options.title = argv[++i];
+    } else if (std::strcmp(arg, "--help") == 0 ||
+               std::strcmp(arg, "-h") == 0) {
+      return false;
+    } else {
+      options.inputs.emplace_back(arg);
+    }
+  }
+  return !options.inputs.empty();
+}
+
+std::optional<double> MetricKey(const JsonValue& row, const MetricDef& def) {
+  for (const auto key : def.keys) {
+    if (key.empty()) continue;
+    if (auto value = row.Number(key)) return value;
+  }
+  return std::nullopt;
+}
+
+std::optional<double> EchoLossPercent(const JsonValue& row) {
+  double sent = 0.0;
+  double lost = 0.0;
+  bool any = false;
+  for (const auto bucket : kEchoBuckets) {
+    const auto bucket_sent = row.Number(std::format("{}_sent", bucket));
+    const auto bucket_lost = row.Number(std::format("{}_Lost", bucket));
+    if (!bucket_sent || !bucket_lost) continue;
+    sent += *bucket_sent;
+    lost += *bucket_lost;
+    any = true;
+  }
+  if (!any || sent <= 0.0) return std::nullopt;
+  return lost / sent * 100.0;
+}
+
+// Time series of |def| for one run, x in seconds of elapsed_ms.
+std::vector<std::pair<double, double>> MetricPoints(const Series& series,
+                                                    const MetricDef& def) {
+  std::vector<std::pair<double, double>> points;
+  std::optional<std::pair<double, double>> previous;
+  for (const JsonValue& row : series.samples) {
+    const double t = row.Number("elapsed_ms").value_or(0.0) / 1000.0;
+    if (def.mode == MetricMode::kEchoLoss) {
+      if (auto loss = EchoLossPercent(row)) points.emplace_back(t, *loss);
+      continue;
+    }
+
+    const auto value = MetricKey(row, def);
+    if (!value) continue;
+    if (def.mode == MetricMode::kValue) {
+      points.emplace_back(t, *value * def.scale);
+      continue;
+    }
+
+    // Counters are cumulative; a drop means the source restarted them.
+    if (previous && t > previous->first) {
+      const double delta = std::max(0.0, *value - previous->second);
+      points.emplace_back(t, delta / (t - previous->first) * def.scale);
+    }
+    previous = std::make_pair(t, *value);
+  }
+  return points;
+}
+
+// One number per run for the comparison tables: the rate over the whole
+// measurement for counters, the mean for gauges, the peak for RSS and ticks.
+std::optional<double> MetricSummary(const Series& series,
+                                    const MetricDef& def) {
+  if (def.mode == MetricMode::kEchoLoss) {
+    if (series.final) {
+      if (auto loss = EchoLossPercent(*series.final)) return loss;
+    }
+    const auto points = MetricPoints(series, def);
+    if (points.empty()) return std::nullopt;
+    return points.back().second;
+  }
+
+  if (def.mode == MetricMode::kRate) {
+    std::optional<std::pair<double, double>> first;
+    std::optional<std::pair<double, double>> last;
+    for (const JsonValue& row : series.samples) {
+      const auto value = MetricKey(row, def);
+      if (!value) continue;
+      const double t = row.Number("elapsed_ms").value_or(0.0) / 1000.0;
+      if (!first) first = std::make_pair(t, *value);
+      last = std::make_pair(t, *value);
+    }
+    if (!first || !last || last->first <= first->first) return std::nullopt;
+    return std::max(0.0, last->second - first->second) /
+           (last->first - first->first) * def.scale;
+  }
+
+  const auto points = MetricPoints(series, def);
+  if (points.empty()) return std::nullopt;
+  const bool peak = def.keys[0] == "rss_kb" || def.keys[0].starts_with("tick_");
+  double result = 0.0;
+  for (const auto& point : points) {
+    result = peak ? std::max(result, point.second) : result + point.second;
+  }
+  return peak ? result : result / static_cast<double>(points.size());
+}
+
+std::string SeriesKey(const std::map<std::string, std::string, std::less<>>&
+                        identity) {
+  std::string key;
+  for (const auto& [name, value] : identity) {
+    key += std::format("{}={};", name, value);
+  }
+  return key;
+}
+
+void LoadFile(const std::string& path, std::vector<Series>& series,
+              std::map<std::string, std::size_t>& index,
+              std::size_t& bad_lines) {
+  std::ifstream input(path);
+  if (!input) {
+    std::println("cannot open {}", path);
+    return;
+  }
+
+  const std::string file = std::filesystem::path(path).stem().string();
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line.front() != '{') continue;
+
+    JsonValue row;
+    if (!ParseJson(line, row) || row.kind != JsonValue::Kind::kObject) {
+      ++bad_lines;
+      continue;
+    }
+
+    std::map<std::string, std::string, std::less<>> identity;
+    identity["file"] = file;
+    for (const auto field : kIdentityFields) {
+      if (field == "file") continue;
+      std::string value = row.String(field);
+      if (value.empty() && field == "clients") {
+        value = row.String("clients_requested");
+      }
+      if (!value.empty()) identity[std::string(field)] = std::move(value);
+    }
+
+    const std::string key = SeriesKey(identity);
+    auto [it, inserted] = index.try_emplace(key, series.size());
+    if (inserted) series.push_back(Series{.identity = std::move(identity)});
+    Series& target = series[it->second];
+
+    if (const JsonValue* profile = row.Find("tick_profile");
+        profile != nullptr) {
+      target.tickProfile = *profile;
+    } else if (row.String("record") == "final") {
+      target.final = std::move(row);
+    } else if (row.Find("elapsed_ms") != nullptr) {
+      target.samples.push_back(std::move(row));
+    }
+  }
+}
+
+// Labels only name the identity fields that actually differ between series.
+void AssignLabels(std::vector<Series>& series) {
+  std::vector<std::string_view> varying;
+  for (const auto field : kIdentityFields) {
+    std::set<std::string> values;
+    for (const Series& s : series) values.insert(s.Field(field));
+    if (values.size() > 1) varying.push_back(field);
+  }
+  if (varying.empty()) varying = {"example", "role"};
+
+  for (Series& s : series) {
+    std::string label;
+    for (const auto field : varying) {
+      const std::string value = s.Field(field);
+      if (value.empty()) continue;
+      if (!label.empty()) label += ' ';
+      if (field == "file" || field == "example" || field == "role" ||
+          field == "transport" || field == "profile") {
+        label += value;
+      } else if (field == "server_workers") {
+        label += std::format("workers={}", value);
+      } else {
+        label += std::format("{}={}", field, value);
+      }
+    }
+    s.label = label.empty() ? "run" : label;
+  }
+}
+
+std::string Legend(const std::vector<const Series*>& series) {
+  std::string html = "<div class=\"legend\">";
+  for (std::size_t i = 0; i < series.size(); ++i) {
+    html += std::format(
+      "<span><i style=\"background:{}\"></i>{}</span>", SeriesColor(i),
+      EscapeXml(series[i]->label));
+  }
+  html += "</div>";
+  return html;
+}
+
+std::string FormatCell(std::optional<double> value) {
+  return value ? FormatTick(*value) : std::string("&ndash;");
+}
+
+std::string TimeSeriesSection(const std::vector<const Series*>& series) {
+  std::string html = "<h2>Time series</h2>" + Legend(series) +
+                     "<div class=\"grid\">";
+  for (const MetricDef& def : kMetrics) {
+    std::vector<ChartSeries> lines;
+    bool any = false;
+    for (const Series* s : series) {
+      ChartSeries line{.label = s->label, .points = MetricPoints(*s, def)};
+      any = any || !line.points.empty();
+      lines.push_back(std::move(line));
+    }
+    if (!any) continue;
+    html += RenderLineChart(
+      {.title = std::format("{} ({})", def.title, def.unit),
+       .xLabel = "elapsed s",
+       .yLabel = std::string(def.unit)},
+      lines);
+  }
+  html += "</div>";
+  return html;
+}
+
+std::string SummarySection(const std::vector<const Series*>& series) {
+  std::string html =
+    "<h2>Runs</h2><table><tr><th>series</th><th>samples</th>"
+    "<th>status</th>";
+  for (const MetricDef& def : kMetrics) {
+    html += std::format("<th>{}<br><small>{}</small></th>", def.title,
+                        def.unit);
+  }
+  html += "</tr>";
+  for (std::size_t i = 0; i < series.size(); ++i) {
+    const Series& s = *series[i];
+    html += std::format(
+      "<tr><td><i class=\"swatch\" style=\"background:{}\"></i>{}</td>"
+      "<td>{}</td><td>{}</td>",
+      SeriesColor(i), EscapeXml(s.label), s.samples.size(),
+      s.final ? EscapeXml(s.final->String("status")) : std::string{});
+    for (const MetricDef& def : kMetrics) {
+      html += std::format("<td>{}</td>", FormatCell(MetricSummary(s, def)));
+    }
+    html += "</tr>";
+  }
+  html += "</table>";
+  return html;
+}
+
+// Scaling view: one line per configuration (everything but clients and run),
+// x = clients, y = the run summary averaged over repeated runs. Covers both
+// client sweeps and --server-workers comparisons.
+std::string ScalingSection(const std::vector<const Series*>& series) {
+  std::set<std::string> clients;
+  std::set<std::string> workers;
+  for (const Series* s : series) {
+    clients.insert(s->Field("clients"));
+    workers.insert(s->Field("server_workers"));
+  }
+  if (clients.size() < 2 && workers.size() < 2) return {};
+
+  struct Group {
+    std::string label;
+    std::map<double, std::vector<const Series*>> byClients;
+  };
+  std::map<std::string, Group> groups;
+  for (const Series* s : series) {
+    auto identity = s->identity;
+    identity.erase("clients");
+    identity.erase("run");
+    identity.erase("file");
+    auto& group = groups[SeriesKey(identity)];
+    if (group.label.empty()) {
+      group.label = std::format(
+        "{} {}{}", s->Field("example"), s->Field("role"),
+        s->Field("server_workers").empty()
+          ? std::string{}
+          : std::format(" workers={}", s->Field("server_workers")));
+    }
+    const double x = std::atof(s->Field("clients").c_str());
+    group.byClients[std::max(1.0, x)].push_back(s);
+  }
+
+  double min_clients = 1e18;
+  double max_clients = 0.0;
+  for (const auto& [key, group] : groups) {
+    for (const auto& [x, runs] : group.byClients) {
+      min_clients = std::min(min_clients, x);
+      max_clients = std::max(max_clients, x);
+    }
+  }
+
+  const auto average = [](const std::vector<const Series*>& runs,
+                          const MetricDef& def) -> std::optional<double> {
+    double sum = 0.0;
+    int count = 0;
+    for (const Series* run : runs) {
+      if (auto value = MetricSummary(*run, def)) {
+        sum += *value;
+        ++count;
+      }
+    }
+    if (count == 0) return std::nullopt;
+    return sum / count;
+  };
+
+  std::string html = "<h2>Scaling and worker comparison</h2>";
+  html += "<div class=\"legend\">";
+  std::size_t color = 0;
+  for (const auto& [key, group] : groups) {
+    html += std::format("<span><i style=\"background:{}\"></i>{}</span>",
+                        SeriesColor(color++), EscapeXml(group.label));
+  }
+  html += "</div><div class=\"grid\">";
+
+  for (const MetricDef& def : kMetrics) {
+    std::vector<ChartSeries> lines;
+    bool any = false;
+    for (const auto& [key, group] : groups) {
+      ChartSeries line{.label = group.label};
+      for (const auto& [x, runs] : group.byClients) {
+        if (auto value = average(runs, def)) {
+          line.points.emplace_back(x, *value);
+        }
+      }
+      any = any || !line.points.empty();
+      lines.push_back(std::move(line));
+    }
+    if (!any) continue;
+    html += RenderLineChart(
+      {.title = std::format("{} ({}) vs clients", def.title, def.unit),
+       .xLabel = "clients",
+       .yLabel = std::string(def.unit),
+       .logX = max_clients / min_clients >= 100.0,
+       .markers = true},
+      lines);
+  }
+  html += "</div>";
+
+  // Side-by-side table: one row per client count, one column block per
+  // configuration.
+  static constexpr std::array<std::size_t, 4> kTableMetrics{0, 4, 5, 9};
+  html += "<table><tr><th rowspan=\"2\">clients</th>";
+  for (const auto& [key, group] : groups) {
+    html += std::format("<th colspan=\"{}\">{}</th>", kTableMetrics.size(),
+                        EscapeXml(group.label));
+  }
+  html += "</tr><tr>";
+  for (std::size_t g = 0; g < groups.size(); ++g) {
+    for (const std::size_t m : kTableMetrics) {
+      html += std::format("<th>{}<br><small>{}</small></th>",
+                          kMetrics[m].title, kMetrics[m].unit);
+    }
+  }
+  html += "</tr>";
+  std::set<double> all_clients;
+  for (const auto& [key, group] : groups) {
+    for (const auto& [x, runs] : group.byClients) all_clients.insert(x);
+  }
+  for (const double x : all_clients) {
+    html += std::format("<tr><td>{}</td>", FormatTick(x));
+    for (const auto& [key, group] : groups) {
+      const auto it = group.byClients.find(x);
+      for (const std::size_t m : kTableMetrics) {
+        html += std::format(
+          "<td>{}</td>", it == group.byClients.end()
+                           ? std::string("&ndash;")
+                           : FormatCell(average(it->second, kMetrics[m])));
+      }
+    }
+    html += "</tr>";
+  }
+  html += "</table>";
+  return html;
+}
+
+std::string TickSection(const std::vector<const Series*>& series) {
+  std::vector<const Series*> profiled;
+  for (const Series* s : series) {
+    if (s->tickProfile) profiled.push_back(s);
+  }
+  if (profiled.empty()) return {};
+
+  std::string html =
+    "<h2>Tick profile</h2><table><tr><th>series</th><th>budget ms</th>"
+    "<th>ticks</th><th>overruns</th><th>p50</th><th>p90</th><th>p95</th>"
+    "<th>p99</th><th>p99.9</th><th>max</th></tr>";
+  std::vector<ChartSeries> histograms;
+  for (const Series* s : profiled) {
+    const JsonValue& p = *s->tickProfile;
+    const double ticks = p.Number("ticks").value_or(0.0);
+    const double overruns = p.Number("overruns").value_or(0.0);
+    html += std::format(
+      "<tr><td>{}</td><td>{}</td><td>{}</td><td>{} ({:.2f}%)</td><td>{}</td>"
+      "<td>{}</td><td>{}</td><td>{}</td><td>{}</td><td>{}</td></tr>",
+      EscapeXml(s->label), FormatCell(p.Number("budget_ms")),
+      FormatTick(ticks), FormatTick(overruns),
+      ticks > 0.0 ? overruns / ticks * 100.0 : 0.0,
+      FormatCell(p.Number("p50_ms")), FormatCell(p.Number("p90_ms")),
+      FormatCell(p.Number("p95_ms")), FormatCell(p.Number("p99_ms")),
+      FormatCell(p.Number("p999_ms")), FormatCell(p.Number("max_ms")));
+
+    ChartSeries line{.label = s->label};
+    if (const JsonValue* buckets = p.Find("histogram"); buckets != nullptr) {
+      for (const JsonValue& bucket : buckets->items) {
+        if (bucket.items.size() != 2) continue;
+        line.points.emplace_back(bucket.items[0].number,
+                                 bucket.items[1].number);
+      }
+    }
+    histograms.push_back(std::move(line));
+  }
+  html += "</table>";
+  html += RenderLineChart({.title = "Tick time histogram",
+                           .xLabel = "tick ms (bucket upper edge)",
+                           .yLabel = "ticks",
+                           .logX = true,
+                           .markers = true,
+                           .width = 760},
+                          histograms);
+
+  html +=
+    "<h3>Slowest ticks</h3><table><tr><th>series</th><th>tick</th>"
+    "<th>at ms</th><th>total ms</th><th>poll</th><th>simulate</th>"
+    "<th>broadcast</th><th>metrics</th></tr>";
+  for (const Series* s : profiled) {
+    const JsonValue* slowest = s->tickProfile->Find("slowest");
+    if (slowest == nullptr) continue;
+    for (const JsonValue& tick : slowest->items) {
+      html += std::format(
+        "<tr><td>{}</td><td>{}</td><td>{}</td><td>{}</td><td>{}</td>"
+        "<td>{}</td><td>{}</td><td>{}</td></tr>",
+        EscapeXml(s->label), tick.String("tick"), tick.String("at_ms"),
+        FormatCell(tick.Number("total_ms")), FormatCell(tick.Number("poll_ms")),
+        FormatCell(tick.Number("simulate_ms")),
+        FormatCell(tick.Number("broadcast_ms")),
+        FormatCell(tick.Number("metrics_ms")));
+    }
+  }
+  html += "</table>";
+  return html;
+}
+
+constexpr std::string_view kStyle =
+  "body{font-family:sans-serif;margin:24px;color:#222}"
+  "h1{font-size:20px}h2{font-size:16px;margin-top:32px}"
+  "table{border-collapse:collapse;font-size:12px;margin:8px 0}"
+  "td,th{border:1px solid #ddd;padding:3px 6px;text-align:right}"
+  "td:first-child,th:first-child{text-align:left}"
+  ".grid{display:grid;grid-template-columns:repeat(auto-fill,"
+  "minmax(560px,1fr));gap:12px}"
+  ".legend span{display:inline-block;margin-right:14px;font-size:12px}"
+  ".legend i,.swatch{display:inline-block;width:10px;height:10px;"
+  "margin-right:4px}";
+
+}  // namespace
+}  // namespace metrics_report
+
+int main(int argc, const char** argv) {
+  using namespace metrics_report;  // NOLINT
+
+  Options options;
+  if (!ParseArgs(argc, argv, options)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::vector<Series> series;
+  std::map<std::string, std::size_t> index;
+  std::size_t bad_lines = 0;
+  for (const auto& path : options.inputs) {
+    LoadFile(path, series, index, bad_lines);
+  }
+  std::erase_if(series, [](const Series& s) {
+    return s.samples.empty() && !s.final && !s.tickProfile;
+  });
+  if (series.empty()) {
+    std::println("no metrics records found");
+    return 1;
+  }
+  AssignLabels(series);
+
+  std::vector<const Series*> ordered;
+  for (const Series& s : series) ordered.push_back(&s);
+  std::ranges::stable_sort(ordered, [](const Series* a, const Series* b) {
+    return a->label < b->label;
+  });
+
+  std::string html = std::format(
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>{0}</title>"
+    "<style>{1}</style></head><body><h1>{0}</h1><p>{2} series from {3} "
+    "file(s).</p>",
+    EscapeXml(options.title), kStyle, ordered.size(), options.inputs.size());
+  html += SummarySection(ordered);
+  html += ScalingSection(ordered);
+  html += TimeSeriesSection(ordered);
+  html += TickSection(ordered);
+  html += "</body></html>\n";
+
+  std::FILE* out = std::fopen(options.outPath.c_str(), "w");
+  if (out == nullptr) {
+    std::println("cannot write {}", options.outPath);
+    return 1;
+  }
+  std::fwrite(html.data(), 1, html.size(), out);
+  std::fclose(out);
+
+  std::println("wrote {} ({} series{})", options.outPath, ordered.size(),
+               bad_lines > 0 ? std::format(", {} unreadable lines", bad_lines)
+                             : std::string{});
+  return 0;
+}
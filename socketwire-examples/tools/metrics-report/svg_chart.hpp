@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace metrics_report {
+
+struct ChartSeries {
+  std::string label;
+  std::vector<std::pair<double, double>> points{};
+};
+
+struct ChartOptions {
+  std::string title;
+  std::string xLabel{};
+  std::string yLabel{};
+  bool logX = false;
+  bool markers = false;
+  int width = 560;
+  int height = 300;
+};
+
+inline constexpr std::array<std::string_view, 10> kPalette{
+  "#1f77b4", "#d62728", "#2ca02c", "#ff7f0e", "#9467bd",
+  "#8c564b", "#e377c2", "#17becf", "#7f7f7f", "#bcbd22",
+};
+
+inline std::string_view SeriesColor(std::size_t index) {
+  return kPalette[index % kPalette.size()];
+}
+
+inline std::string EscapeXml(std::string_view text) {
+  std::string out;
+  out.reserve(text.size());
+  for (const char c : text) {
+    switch (c) {
+      case '<':
+        out += "&lt;";
+        break;
+      case '>':
+        out += "&gt;";
+        break;
+      case '&':
+        out += "&amp;";
+        break;
+      case '"':
+        out += "&quot;";
+        break;
+      default:
+        out += c;
+        break;
+    }
+  }
+  return out;
+}
+
+// Compact axis label: 1234567 -> "1.23M", 0.0042 -> "0.0042".
+inline std::string FormatTick(double value) {
+  const double magnitude = std::fabs(value);
+  if (magnitude >= 1e9) return std::format("{:.3g}G", value / 1e9);
+  if (magnitude >= 1e6) return std::format("{:.3g}M", value / 1e6);
+  if (magnitude >= 1e4) return std::format("{:.3g}k", value / 1e3);
+  return std::format("{:.4g}", value);
+}
+
+// Step of about |target| intervals across |range|, rounded to 1, 2 or 5 times
+// a power of ten.
+inline double NiceStep(double range, int target) {
+  if (range <= 0.0) return 1.0;
+  const double raw = range / static_cast<double>(target);
+  const double power = std::pow(10.0, std::floor(std::log10(raw)));
+  const double fraction = raw / power;
+  if (fraction <= 1.0) return power;
+  if (fraction <= 2.0) return 2.0 * power;
+  if (fraction <= 5.0) return 5.0 * power;
+  return 10.0 * power;
+}
+
+inline std::string RenderLineChart(const ChartOptions& options,
+                                   const std::vector<ChartSeries>& series) {
+  constexpr double kLeft = 64.0;
+  constexpr double kRight = 16.0;
+  constexpr double kTop = 28.0;
+  constexpr double kBottom = 44.0;
+  const double plot_w = options.width - kLeft - kRight;
+  const double plot_h = options.height - kTop - kBottom;
+
+  const auto to_x = [&](double x) {
+    return options.logX ? std::log10(std::max(x, 1e-9)) : x;
+  };
+
+  double min_x = std::numeric_limits<double>::infinity();
+  double max_x = -std::numeric_limits<double>::infinity();
+  double max_y = 0.0;
+  double min_y = 0.0;
+  for (const auto& line : series) {
+    for (const auto& [x, y] : line.points) {
+      if (!std::isfinite(x) || !std::isfinite(y)) continue;
+      min_x = std::min(min_x, to_x(x));
+      max_x = std::max(max_x, to_x(x));
+      min_y = std::min(min_y, y);
+      max_y = std::max(max_y, y);
+    }
+  }
+
+  std::string svg = std::format(
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{}\" height=\"{}\" "
+    "viewBox=\"0 0 {} {}\" font-family=\"sans-serif\" font-size=\"11\">"
+    "<rect width=\"100%\" height=\"100%\" fill=\"#fff\"/>"
+    "<text x=\"{}\" y=\"18\" font-size=\"13\" font-weight=\"bold\">{}</text>",
+    options.width, options.height, options.width, options.height, kLeft,
+    EscapeXml(options.title));
+
+  if (!std::isfinite(min_x)) {
+    svg += std::format(
+      "<text x=\"{}\" y=\"{}\" fill=\"#888\">no data</text></svg>",
+      kLeft + plot_w / 2.0 - 20.0, kTop + plot_h / 2.0);
+    return svg;
+  }
+  if (max_x == min_x) {
+    min_x -= 1.0;
+    max_x += 1.0;
+  }
+  const double y_step = NiceStep(max_y - min_y, 5);
+  max_y = std::max(y_step, std::ceil(max_y / y_step) * y_step);
+  min_y = std::floor(min_y / y_step) * y_step;
+
+  const auto px = [&](double x) {
+    return kLeft + (to_x(x) - min_x) / (max_x - min_x) * plot_w;
+  };
+  const auto py = [&](double y) {
+    return kTop + plot_h - (y - min_y) / (max_y - min_y) * plot_h;
+  };
+
+  // Grid and axis labels.
+  for (double y = min_y; y <= max_y + y_step * 0.5; y += y_step) {
+    svg += std::format(
+      "<line x1=\"{:.1f}\" y1=\"{:.1f}\" x2=\"{:.1f}\" y2=\"{:.1f}\" "
+      "stroke=\"#e5e5e5\"/><text x=\"{:.1f}\" y=\"{:.1f}\" "
+      "text-anchor=\"end\" fill=\"#555\">{}</text>",
+      kLeft, py(y), kLeft + plot_w, py(y), kLeft - 6.0, py(y) + 4.0,
+      FormatTick(y));
+  }
+  if (options.logX) {
+    for (double decade = std::floor(min_x); decade <= max_x; decade += 1.0) {
+      if (decade < min_x) continue;
+      const double x = std::pow(10.0, decade);
+      svg += std::format(
+        "<line x1=\"{0:.1f}\" y1=\"{1:.1f}\" x2=\"{0:.1f}\" y2=\"{2:.1f}\" "
+        "stroke=\"#e5e5e5\"/><text x=\"{0:.1f}\" y=\"{3:.1f}\" "
+        "text-anchor=\"middle\" fill=\"#555\">{4}</text>",
+        px(x), kTop, kTop + plot_h, kTop + plot_h + 14.0, FormatTick(x));
+    }
+  } else {
+    const double x_step = NiceStep(max_x - min_x, 6);
+    for (double x = std::ceil(min_x / x_step) * x_step; x <= max_x;
+         x += x_step) {
+      svg += std::format(
+        "<line x1=\"{0:.1f}\" y1=\"{1:.1f}\" x2=\"{0:.1f}\" y2=\"{2:.1f}\" "
+        "stroke=\"#e5e5e5\"/><text x=\"{0:.1f}\" y=\"{3:.1f}\" "
+        "text-anchor=\"middle\" fill=\"#555\">{4}</text>",
+        px(x), kTop, kTop + plot_h, kTop + plot_h + 14.0, FormatTick(x));
+    }
+  }
+  svg += std::format(
+    "<rect x=\"{}\" y=\"{}\" width=\"{}\" height=\"{}\" fill=\"none\" "
+    "stroke=\"#999\"/>"
+    "<text x=\"{}\" y=\"{}\" text-anchor=\"middle\" fill=\"#333\">{}</text>"
+    "<text transform=\"translate(12 {}) rotate(-90)\" text-anchor=\"middle\" "
+    "fill=\"#333\">{}</text>",
+    kLeft, kTop, plot_w, plot_h, kLeft + plot_w / 2.0,
+    options.height - 8.0, EscapeXml(options.xLabel), kTop + plot_h / 2.0,
+    EscapeXml(options.yLabel));
+
+  for (std::size_t i = 0; i < series.size(); ++i) {
+    const auto color = SeriesColor(i);
+    std::string path;
+    for (const auto& [x, y] : series[i].points) {
+      if (!std::isfinite(x) || !std::isfinite(y)) continue;
+      path += std::format("{}{:.1f},{:.1f}", path.empty() ? "" : " ", px(x),
+                          py(y));
+      if (options.markers) {
+        svg += std::format(
+          "<circle cx=\"{:.1f}\" cy=\"{:.1f}\" r=\"3\" fill=\"{}\"/>", px(x),
+          py(y), color);
+      }
+    }
+    if (!path.empty()) {
+      svg += std::format(
+        "<polyline points=\"{}\" fill=\"none\" stroke=\"{}\" "
+        "stroke-width=\"1.5\"><title>{}</title></polyline>",
+        path, color, EscapeXml(series[i].label));
+    }
+  }
+
+  svg += "</svg>";
+  return svg;
+}
+
+}  // namespace metrics_report